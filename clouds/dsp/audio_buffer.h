@@ -41,6 +41,21 @@
 const int32_t kCrossFadeSize = 256;
 const int32_t kInterpolationTail = 8;
 
+// Samples are converted to and from mu-law by blocks of this size.
+const int32_t kMuLawBlockSize = 64;
+
+// Positions in a buffer are 32-bit sample indices, and the players add up to
+// two of them before wrapping. Larger buffers are truncated to this size (9
+// hours at 32kHz).
+const int32_t kMaxAudioBufferSize = 1 << 30;
+
+// The players compute delays and positions in single precision in buffers up
+// to this size (the largest hardware buffer). A float only has 24 bits of
+// mantissa: longer buffers would lose the fractional part of the positions,
+// and beyond 2^24 samples, whole samples. Their positions are computed in
+// double precision instead.
+const int32_t kMaxSinglePrecisionBufferSize = 1 << 17;
+
 namespace clouds {
 
 enum Resolution {
@@ -150,6 +165,9 @@ class AudioBuffer {
         ++write_head_;
         in += stride;
       }
+    } else if (write && !crossfade_counter_ &&
+        resolution == RESOLUTION_8_BIT_MU_LAW) {
+      WriteMuLaw(in, size, stride);
     } else {
       while (size--) {
         float sample = *in;
@@ -175,6 +193,8 @@ class AudioBuffer {
         ++write_head_;
         in += stride;
       }
+    } else if (resolution == RESOLUTION_8_BIT_MU_LAW) {
+      WriteMuLaw(in, size, stride);
     } else {
       while (size--) {
         Write(*in);
@@ -183,6 +203,43 @@ class AudioBuffer {
     }
   }
   
+  // Bulk transfers, for loading or saving the contents of the buffer. The
+  // samples are either 16-bit or mu-law encoded bytes, converted to and from
+  // the resolution of the buffer - mu-law bytes are copied as they are into
+  // a mu-law buffer. Import() writes at the write head, without crossfade.
+  // Export() reads in chronological order, from the sample at the write head
+  // (the oldest one) onwards, starting "position" samples later.
+  template<typename T>
+  inline void Import(const T* in, int32_t size, int32_t stride) {
+    while (size) {
+      int32_t n = std::min(size, size_ - write_head_);
+      Store(write_head_, in, n, stride);
+      UpdateTail(write_head_, n);
+      in += n * stride;
+      write_head_ += n;
+      if (write_head_ >= size_) {
+        write_head_ = 0;
+      }
+      size -= n;
+    }
+  }
+
+  template<typename T>
+  inline void Export(
+      int32_t position,
+      T* out,
+      int32_t size,
+      int32_t stride) const {
+    int32_t index = (write_head_ + position) % size_;
+    while (size) {
+      int32_t n = std::min(size, size_ - index);
+      Load(index, out, n, stride);
+      out += n * stride;
+      index = 0;
+      size -= n;
+    }
+  }
+
   template<InterpolationMethod method>
   inline float Read(int32_t integral, uint16_t fractional) const {
     if (method == INTERPOLATION_ZOH) {
@@ -277,10 +334,147 @@ class AudioBuffer {
     return ((((a * t) - b_neg) * t + c) * t + x0) * scale;
   }
   
+  // Raw samples, for readers which process several positions at once.
+  inline const int16_t* s16() const { return s16_; }
+  inline const int8_t* s8() const { return s8_; }
+  
   inline int32_t size() const { return size_; }
   inline int32_t head() const { return write_head_; }
   
  private:
+  // Same result as calls to Write(), without crossfade.
+  inline void WriteMuLaw(const float* in, int32_t size, int32_t stride) {
+    int16_t pcm[kMuLawBlockSize];
+    while (size) {
+      int32_t n = std::min(size, size_ - write_head_);
+      n = std::min(n, kMuLawBlockSize);
+      for (int32_t i = 0; i < n; ++i) {
+        pcm[i] = stmlib::Clip16(static_cast<int32_t>(*in * 32768.0f));
+        in += stride;
+      }
+      Lin2MuLaw(pcm, reinterpret_cast<uint8_t*>(&s8_[write_head_]), n);
+      UpdateTail(write_head_, n);
+      write_head_ += n;
+      if (write_head_ >= size_) {
+        write_head_ = 0;
+      }
+      size -= n;
+    }
+  }
+  
+  // Copies the samples written at the beginning of the buffer after its end,
+  // for the interpolators.
+  inline void UpdateTail(int32_t index, int32_t size) {
+    int32_t end = std::min(index + size, kInterpolationTail);
+    for (int32_t i = index; i < end; ++i) {
+      if (resolution == RESOLUTION_16_BIT) {
+        s16_[i + size_] = s16_[i];
+      } else {
+        s8_[i + size_] = s8_[i];
+      }
+    }
+  }
+  
+  // Runs of samples, encoded to mu-law by blocks. Decoding is faster with
+  // direct table lookups.
+  template<typename T>
+  inline void Store(int32_t index, const T* in, int32_t size, int32_t stride) {
+    for (int32_t i = 0; i < size; ++i) {
+      Store(index + i, *in);
+      in += stride;
+    }
+  }
+  
+  inline void Store(
+      int32_t index,
+      const int16_t* in,
+      int32_t size,
+      int32_t stride) {
+    if (resolution != RESOLUTION_8_BIT_MU_LAW) {
+      Store<int16_t>(index, in, size, stride);
+      return;
+    }
+    int16_t pcm[kMuLawBlockSize];
+    while (size) {
+      int32_t n = std::min(size, kMuLawBlockSize);
+      for (int32_t i = 0; i < n; ++i) {
+        pcm[i] = *in;
+        in += stride;
+      }
+      Lin2MuLaw(pcm, reinterpret_cast<uint8_t*>(&s8_[index]), n);
+      index += n;
+      size -= n;
+    }
+  }
+  
+  template<typename T>
+  inline void Load(int32_t index, T* out, int32_t size, int32_t stride) const {
+    for (int32_t i = 0; i < size; ++i) {
+      Load(index + i, out);
+      out += stride;
+    }
+  }
+  
+  inline void Load(
+      int32_t index,
+      uint8_t* out,
+      int32_t size,
+      int32_t stride) const {
+    if (resolution != RESOLUTION_16_BIT) {
+      Load<uint8_t>(index, out, size, stride);
+      return;
+    }
+    uint8_t mu_law[kMuLawBlockSize];
+    while (size) {
+      int32_t n = std::min(size, kMuLawBlockSize);
+      Lin2MuLaw(&s16_[index], mu_law, n);
+      for (int32_t i = 0; i < n; ++i) {
+        *out = mu_law[i];
+        out += stride;
+      }
+      index += n;
+      size -= n;
+    }
+  }
+  
+  inline void Store(int32_t index, int16_t sample) {
+    if (resolution == RESOLUTION_16_BIT) {
+      s16_[index] = sample;
+    } else if (resolution == RESOLUTION_8_BIT_MU_LAW) {
+      s8_[index] = Lin2MuLaw(sample);
+    } else {
+      s8_[index] = sample >> 8;
+    }
+  }
+
+  inline void Store(int32_t index, uint8_t mu_law) {
+    if (resolution == RESOLUTION_8_BIT_MU_LAW) {
+      s8_[index] = mu_law;
+    } else {
+      Store(index, static_cast<int16_t>(MuLaw2Lin(mu_law)));
+    }
+  }
+
+  inline void Load(int32_t index, int16_t* sample) const {
+    if (resolution == RESOLUTION_16_BIT) {
+      *sample = s16_[index];
+    } else if (resolution == RESOLUTION_8_BIT_MU_LAW) {
+      *sample = MuLaw2Lin(s8_[index]);
+    } else {
+      *sample = s8_[index] << 8;
+    }
+  }
+
+  inline void Load(int32_t index, uint8_t* mu_law) const {
+    if (resolution == RESOLUTION_8_BIT_MU_LAW) {
+      *mu_law = s8_[index];
+    } else {
+      int16_t sample;
+      Load(index, &sample);
+      *mu_law = Lin2MuLaw(sample);
+    }
+  }
+
   int16_t* s16_;
   int8_t* s8_;
   
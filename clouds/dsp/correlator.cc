@@ -29,6 +29,7 @@
 #include "clouds/dsp/correlator.h"
 
 #include <algorithm>
+#include <cstring>
 
 namespace clouds {
 
@@ -40,6 +41,7 @@ void Correlator::Init(uint32_t* source, uint32_t* destination) {
   offset_ = 0;
   best_match_ = 0;
   done_ = true;
+  backend_ = kDefaultCorrelatorBackend;
 }
 
 void Correlator::EvaluateNextCandidate() {
@@ -57,7 +59,8 @@ void Correlator::EvaluateNextCandidate() {
     uint32_t source_bits = source[i];
     uint32_t destination_bits = 0;
     destination_bits |= destination[i] << offset_bits;
-    destination_bits |= destination[i + 1] >> (32 - offset_bits);
+    // Shifting by 32 is undefined, so the shift is done in two steps.
+    destination_bits |= (destination[i + 1] >> 1) >> (31 - offset_bits);
     uint32_t count = ~(source_bits ^ destination_bits);
     count = count - ((count >> 1) & 0x55555555);
     count = (count & 0x33333333) + ((count >> 2) & 0x33333333);
@@ -72,6 +75,65 @@ void Correlator::EvaluateNextCandidate() {
   done_ = candidate_ >= size_;
 }
 
+void Correlator::EvaluateAllCandidates() {
+  if (done_) {
+    return;
+  }
+  const int32_t num_words = size_ >> 5;
+  const int32_t num_offset_words = (size_ + 31) >> 5;
+  const int32_t num_destination_words = num_offset_words + num_words;
+  const uint32_t* source = &source_[0];
+  uint32_t* destination = &destination_[0];
+  
+  // Candidates are visited by bit offset rather than in order. The destination
+  // is shifted by one bit in place before each pass, so that the inner loop
+  // only sees aligned words and can process them 64 bits at a time.
+  uint32_t first_word = destination[0];
+  for (int32_t offset_bits = 0; offset_bits < 32; ++offset_bits) {
+    if (offset_bits) {
+      for (int32_t i = 0; i < num_destination_words; ++i) {
+        destination[i] = (destination[i] << 1) | (destination[i + 1] >> 31);
+      }
+    }
+    for (int32_t offset_words = 0; offset_words < num_offset_words;
+         ++offset_words) {
+      int32_t candidate = (offset_words << 5) + offset_bits;
+      if (candidate >= size_) {
+        break;
+      } else if (candidate < candidate_) {
+        continue;
+      }
+      const uint32_t* d = &destination[offset_words];
+      uint32_t xcorr = 0;
+      int32_t i = 0;
+      for (; i + 1 < num_words; i += 2) {
+        uint64_t source_bits;
+        uint64_t destination_bits;
+        memcpy(&source_bits, &source[i], sizeof(uint64_t));
+        memcpy(&destination_bits, &d[i], sizeof(uint64_t));
+        xcorr += __builtin_popcountll(~(source_bits ^ destination_bits));
+      }
+      if (i < num_words) {
+        xcorr += __builtin_popcount(~(source[i] ^ d[i]));
+      }
+      if (xcorr > best_score_ ||
+          (xcorr == best_score_ && candidate < best_match_)) {
+        best_match_ = candidate;
+        best_score_ = xcorr;
+      }
+    }
+  }
+  
+  // Undo the 31 shifts.
+  for (int32_t i = num_destination_words - 1; i > 0; --i) {
+    destination[i] = (destination[i - 1] << 1) | (destination[i] >> 31);
+  }
+  destination[0] = first_word;
+  
+  candidate_ = size_;
+  done_ = true;
+}
+
 void Correlator::StartSearch(
     int32_t size,
     int32_t offset,
@@ -85,4 +147,30 @@ void Correlator::StartSearch(
   done_ = false;
 }
 
+void Correlator::HandOver(Correlator* search) {
+  // The candidates read one more word than they span.
+  int32_t num_words = size_ >> 5;
+  copy(&source_[0], &source_[num_words], &search->source_[0]);
+  copy(
+      &destination_[0],
+      &destination_[2 * num_words + 1],
+      &search->destination_[0]);
+  search->offset_ = offset_;
+  search->increment_ = increment_;
+  search->size_ = size_;
+  search->candidate_ = candidate_;
+  search->best_score_ = best_score_;
+  search->best_match_ = best_match_;
+  search->done_ = done_;
+  search->backend_ = backend_;
+  done_ = true;
+}
+
+void Correlator::TakeOver(const Correlator& search) {
+  candidate_ = search.candidate_;
+  best_score_ = search.best_score_;
+  best_match_ = search.best_match_;
+  done_ = search.done_;
+}
+
 }  // namespace clouds
@@ -34,6 +34,21 @@
 #include "stmlib/stmlib.h"
 
 namespace clouds {
+
+enum CorrelatorBackend {
+  // Evaluates a slice of the candidates at each call, using 32-bit words.
+  CORRELATOR_BACKEND_SCALAR,
+  // Evaluates all the candidates at once, using 64-bit words and the hardware
+  // population count.
+  CORRELATOR_BACKEND_POPCOUNT
+};
+
+#if defined(__POPCNT__)
+const CorrelatorBackend kDefaultCorrelatorBackend = \
+    CORRELATOR_BACKEND_POPCOUNT;
+#else
+const CorrelatorBackend kDefaultCorrelatorBackend = CORRELATOR_BACKEND_SCALAR;
+#endif  // __POPCNT__
   
 class Correlator {
  public:
@@ -49,6 +64,10 @@ class Correlator {
   }
 
   inline void EvaluateSomeCandidates() {
+    if (backend_ == CORRELATOR_BACKEND_POPCOUNT) {
+      EvaluateAllCandidates();
+      return;
+    }
     size_t num_candidates = (size_ >> 2) + 16;
     while (num_candidates) {
       EvaluateNextCandidate();
@@ -57,6 +76,19 @@ class Correlator {
   }
 
   void EvaluateNextCandidate();
+  void EvaluateAllCandidates();
+  
+  // For hosts running the search on another thread. HandOver() copies the
+  // search in progress to another correlator, with buffers of the same size,
+  // and stops it here: best_match() then returns the best candidate found so
+  // far - the unaligned position if none has been evaluated. TakeOver()
+  // adopts the best match found by the copy.
+  void HandOver(Correlator* search);
+  void TakeOver(const Correlator& search);
+  
+  inline void set_backend(CorrelatorBackend backend) {
+    backend_ = backend;
+  }
 
   inline uint32_t* source() { return source_; }
   inline uint32_t* destination() { return destination_; }
@@ -80,6 +112,8 @@ class Correlator {
   
   bool done_;
   
+  CorrelatorBackend backend_;
+  
   DISALLOW_COPY_AND_ASSIGN(Correlator);
 };
 
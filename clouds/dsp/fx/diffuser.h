@@ -32,9 +32,11 @@
 #include "stmlib/stmlib.h"
 
 #include "clouds/dsp/fx/fx_engine.h"
+#include "clouds/dsp/fx/simd_fx_engine.h"
 
 namespace clouds {
 
+template<typename E = FxEngine<2048, FORMAT_32_BIT> >
 class Diffuser {
  public:
   Diffuser() { }
@@ -45,29 +47,41 @@ class Diffuser {
   }
   
   void Process(FloatFrame* in_out, size_t size) {
-    typedef E::Reserve<126,
-      E::Reserve<180,
-      E::Reserve<269,
-      E::Reserve<444,
-      E::Reserve<151,
-      E::Reserve<205,
-      E::Reserve<245,
-      E::Reserve<405> > > > > > > > Memory;
-    E::DelayLine<Memory, 0> apl1;
-    E::DelayLine<Memory, 1> apl2;
-    E::DelayLine<Memory, 2> apl3;
-    E::DelayLine<Memory, 3> apl4;
-    E::DelayLine<Memory, 4> apr1;
-    E::DelayLine<Memory, 5> apr2;
-    E::DelayLine<Memory, 6> apr3;
-    E::DelayLine<Memory, 7> apr4;
-    E::Context c;
+    typedef typename E::template Reserve<126,
+      typename E::template Reserve<180,
+      typename E::template Reserve<269,
+      typename E::template Reserve<444,
+      typename E::template Reserve<151,
+      typename E::template Reserve<205,
+      typename E::template Reserve<245,
+      typename E::template Reserve<405> > > > > > > > Memory;
+    typename E::template DelayLine<Memory, 0> apl1;
+    typename E::template DelayLine<Memory, 1> apl2;
+    typename E::template DelayLine<Memory, 2> apl3;
+    typename E::template DelayLine<Memory, 3> apl4;
+    typename E::template DelayLine<Memory, 4> apr1;
+    typename E::template DelayLine<Memory, 5> apr2;
+    typename E::template DelayLine<Memory, 6> apr3;
+    typename E::template DelayLine<Memory, 7> apr4;
+    typename E::Context c;
     const float kap = 0.625f;
-    while (size--) {
-      engine_.Start(&c);
+    
+    const size_t kBlockSize = E::max_block_size;
+    float l[kBlockSize];
+    float r[kBlockSize];
+    float wet[kBlockSize];
+    std::fill(&l[0], &l[kBlockSize], 0.0f);
+    std::fill(&r[0], &r[kBlockSize], 0.0f);
+    
+    while (size) {
+      size_t block_size = std::min(size, kBlockSize);
+      for (size_t i = 0; i < block_size; ++i) {
+        l[i] = in_out[i].l;
+        r[i] = in_out[i].r;
+      }
+      engine_.Start(&c, block_size);
       
-      float wet = 0.0f;
-      c.Read(in_out->l);
+      c.Read(&l[0]);
       c.Read(apl1 TAIL, kap);
       c.WriteAllPass(apl1, -kap);
       c.Read(apl2 TAIL, kap);
@@ -76,10 +90,12 @@ class Diffuser {
       c.WriteAllPass(apl3, -kap);
       c.Read(apl4 TAIL, kap);
       c.WriteAllPass(apl4, -kap);
-      c.Write(wet, 0.0f);
-      in_out->l += amount_ * (wet - in_out->l);
+      c.Write(&wet[0], 0.0f);
+      for (size_t i = 0; i < block_size; ++i) {
+        in_out[i].l += amount_ * (wet[i] - in_out[i].l);
+      }
       
-      c.Read(in_out->r);
+      c.Read(&r[0]);
       c.Read(apr1 TAIL, kap);
       c.WriteAllPass(apr1, -kap);
       c.Read(apr2 TAIL, kap);
@@ -88,10 +104,13 @@ class Diffuser {
       c.WriteAllPass(apr3, -kap);
       c.Read(apr4 TAIL, kap);
       c.WriteAllPass(apr4, -kap);
-      c.Write(wet, 0.0f);
-      in_out->r += amount_ * (wet - in_out->r);
-
-      ++in_out;
+      c.Write(&wet[0], 0.0f);
+      for (size_t i = 0; i < block_size; ++i) {
+        in_out[i].r += amount_ * (wet[i] - in_out[i].r);
+      }
+      
+      in_out += block_size;
+      size -= block_size;
     }
   }
   
@@ -100,13 +119,16 @@ class Diffuser {
   }
   
  private:
-  typedef FxEngine<2048, FORMAT_32_BIT> E;
   E engine_;
   
   float amount_;
   DISALLOW_COPY_AND_ASSIGN(Diffuser);
 };
 
+// Same as Diffuser, processed in blocks by SimdFxEngine. Each delay line is
+// followed by a gap.
+typedef Diffuser<SimdFxEngine<2048 + 64> > SimdDiffuser;
+
 }  // namespace clouds
 
 #endif  // CLOUDS_DSP_FX_DIFFUSER_H_
@@ -103,6 +103,12 @@ class FxEngine {
   typedef typename DataType<format>::T T;
   FxEngine() { }
   ~FxEngine() { }
+  
+  // The effects are written against the block interface of SimdFxEngine, so
+  // that they can run on both engines. Here, a block is a single sample.
+  enum {
+    max_block_size = 1
+  };
 
   void Init(T* buffer) {
     buffer_ = buffer;
@@ -167,6 +173,26 @@ class FxEngine {
       accumulator_ *= scale;
     }
     
+    inline void Load(const float* values) {
+      Load(values[0]);
+    }
+    
+    inline void Read(const float* values, float scale) {
+      Read(values[0], scale);
+    }
+    
+    inline void Read(const float* values) {
+      Read(values[0]);
+    }
+    
+    inline void Write(float* values) {
+      Write(values[0]);
+    }
+    
+    inline void Write(float* values, float scale) {
+      Write(values[0], scale);
+    }
+    
     template<typename D>
     inline void Write(D& d, int32_t offset, float scale) {
       STATIC_ASSERT(D::base + D::length <= size, delay_memory_full);
@@ -252,6 +278,11 @@ class FxEngine {
       accumulator_ += x * scale;
     }
     
+    template<typename D>
+    inline void Interpolate(D& d, const float* offset, const float* scale) {
+      Interpolate(d, offset[0], scale[0]);
+    }
+    
    private:
     float accumulator_;
     float previous_read_;
@@ -267,6 +298,10 @@ class FxEngine {
         frequency * 32.0f);
   }
   
+  inline void Start(Context* c, size_t block_size) {
+    Start(c);
+  }
+  
   inline void Start(Context* c) {
     --write_ptr_;
     if (write_ptr_ < 0) {
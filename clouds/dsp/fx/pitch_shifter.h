@@ -33,15 +33,19 @@
 
 #include "clouds/dsp/frame.h"
 #include "clouds/dsp/fx/fx_engine.h"
+#include "clouds/dsp/fx/simd_fx_engine.h"
 
 namespace clouds {
 
+// The read heads are computed sample by sample. On SimdFxEngine, the reads
+// are gathered.
+template<typename E = FxEngine<4096, FORMAT_16_BIT> >
 class PitchShifter {
  public:
   PitchShifter() { }
   ~PitchShifter() { }
   
-  void Init(uint16_t* buffer) {
+  void Init(typename E::T* buffer) {
     engine_.Init(buffer);
     phase_ = 0;
     size_ = 2047.0f;
@@ -51,45 +55,68 @@ class PitchShifter {
     engine_.Clear();
   }
 
-  inline void Process(FloatFrame* input_output, size_t size) {
-    while (size--) {
-      Process(input_output);
-      ++input_output;
-    }
-  }
-  
-  void Process(FloatFrame* input_output) {
-    typedef E::Reserve<2047, E::Reserve<2047> > Memory;
-    E::DelayLine<Memory, 0> left;
-    E::DelayLine<Memory, 1> right;
-    E::Context c;
-    engine_.Start(&c);
+  void Process(FloatFrame* input_output, size_t size) {
+    typedef typename E::template Reserve<2047,
+      typename E::template Reserve<2047> > Memory;
+    typename E::template DelayLine<Memory, 0> left;
+    typename E::template DelayLine<Memory, 1> right;
+    typename E::Context c;
     
-    phase_ += (1.0f - ratio_) / size_;
-    if (phase_ >= 1.0f) {
-      phase_ -= 1.0f;
-    }
-    if (phase_ <= 0.0f) {
-      phase_ += 1.0f;
-    }
-    float tri = 2.0f * (phase_ >= 0.5f ? 1.0f - phase_ : phase_);
-    float phase = phase_ * size_;
-    float half = phase + size_ * 0.5f;
-    if (half >= size_) {
-      half -= size_;
-    }
+    const size_t kBlockSize = E::max_block_size;
+    float l[kBlockSize];
+    float r[kBlockSize];
+    float phase[kBlockSize];
+    float half[kBlockSize];
+    float tri[kBlockSize];
+    float one_minus_tri[kBlockSize];
+    std::fill(&l[0], &l[kBlockSize], 0.0f);
+    std::fill(&r[0], &r[kBlockSize], 0.0f);
+    std::fill(&phase[0], &phase[kBlockSize], 0.0f);
+    std::fill(&half[0], &half[kBlockSize], 0.0f);
+    std::fill(&tri[0], &tri[kBlockSize], 0.0f);
+    std::fill(&one_minus_tri[0], &one_minus_tri[kBlockSize], 0.0f);
     
-    c.Read(input_output->l, 1.0f);
-    c.Write(left, 0.0f);
-    c.Interpolate(left, phase, tri);
-    c.Interpolate(left, half, 1.0f - tri);
-    c.Write(input_output->l, 0.0f);
-
-    c.Read(input_output->r, 1.0f);
-    c.Write(right, 0.0f);
-    c.Interpolate(right, phase, tri);
-    c.Interpolate(right, half, 1.0f - tri);
-    c.Write(input_output->r, 0.0f);
+    while (size) {
+      size_t block_size = std::min(size, kBlockSize);
+      for (size_t i = 0; i < block_size; ++i) {
+        phase_ += (1.0f - ratio_) / size_;
+        if (phase_ >= 1.0f) {
+          phase_ -= 1.0f;
+        }
+        if (phase_ <= 0.0f) {
+          phase_ += 1.0f;
+        }
+        tri[i] = 2.0f * (phase_ >= 0.5f ? 1.0f - phase_ : phase_);
+        one_minus_tri[i] = 1.0f - tri[i];
+        phase[i] = phase_ * size_;
+        half[i] = phase[i] + size_ * 0.5f;
+        if (half[i] >= size_) {
+          half[i] -= size_;
+        }
+        l[i] = input_output[i].l;
+        r[i] = input_output[i].r;
+      }
+      engine_.Start(&c, block_size);
+      
+      c.Read(&l[0], 1.0f);
+      c.Write(left, 0.0f);
+      c.Interpolate(left, &phase[0], &tri[0]);
+      c.Interpolate(left, &half[0], &one_minus_tri[0]);
+      c.Write(&l[0], 0.0f);
+      
+      c.Read(&r[0], 1.0f);
+      c.Write(right, 0.0f);
+      c.Interpolate(right, &phase[0], &tri[0]);
+      c.Interpolate(right, &half[0], &one_minus_tri[0]);
+      c.Write(&r[0], 0.0f);
+      
+      for (size_t i = 0; i < block_size; ++i) {
+        input_output[i].l = l[i];
+        input_output[i].r = r[i];
+      }
+      input_output += block_size;
+      size -= block_size;
+    }
   }
   
   inline void set_ratio(float ratio) {
@@ -102,7 +129,6 @@ class PitchShifter {
   }
   
  private:
-  typedef FxEngine<4096, FORMAT_16_BIT> E;
   E engine_;
   float phase_;
   float ratio_;
@@ -111,6 +137,10 @@ class PitchShifter {
   DISALLOW_COPY_AND_ASSIGN(PitchShifter);
 };
 
+// Same as PitchShifter, with float storage (twice the memory), processed in
+// blocks by SimdFxEngine. Each delay line is followed by a gap.
+typedef PitchShifter<SimdFxEngine<4096 + 32> > SimdPitchShifter;
+
 }  // namespace clouds
 
 #endif  // CLOUDS_DSP_FX_MINI_CHORUS_H_
\ No newline at end of file
@@ -32,20 +32,24 @@
 #include "stmlib/stmlib.h"
 
 #include "clouds/dsp/fx/fx_engine.h"
+#include "clouds/dsp/fx/simd_fx_engine.h"
 
 namespace clouds {
 
+template<typename E = FxEngine<16384, FORMAT_12_BIT> >
 class Reverb {
  public:
   Reverb() { }
   ~Reverb() { }
   
-  void Init(uint16_t* buffer) {
+  void Init(typename E::T* buffer) {
     engine_.Init(buffer);
     engine_.SetLFOFrequency(LFO_1, 0.5f / 32000.0f);
     engine_.SetLFOFrequency(LFO_2, 0.3f / 32000.0f);
     lp_ = 0.7f;
     diffusion_ = 0.625f;
+    lp_decay_1_ = 0.0f;
+    lp_decay_2_ = 0.0f;
   }
   
   void Process(FloatFrame* in_out, size_t size) {
@@ -53,27 +57,27 @@ class Reverb {
     // (4 AP diffusers on the input, then a loop of 2x 2AP+1Delay).
     // Modulation is applied in the loop of the first diffuser AP for additional
     // smearing; and to the two long delays for a slow shimmer/chorus effect.
-    typedef E::Reserve<113,
-      E::Reserve<162,
-      E::Reserve<241,
-      E::Reserve<399,
-      E::Reserve<1653,
-      E::Reserve<2038,
-      E::Reserve<3411,
-      E::Reserve<1913,
-      E::Reserve<1663,
-      E::Reserve<4782> > > > > > > > > > Memory;
-    E::DelayLine<Memory, 0> ap1;
-    E::DelayLine<Memory, 1> ap2;
-    E::DelayLine<Memory, 2> ap3;
-    E::DelayLine<Memory, 3> ap4;
-    E::DelayLine<Memory, 4> dap1a;
-    E::DelayLine<Memory, 5> dap1b;
-    E::DelayLine<Memory, 6> del1;
-    E::DelayLine<Memory, 7> dap2a;
-    E::DelayLine<Memory, 8> dap2b;
-    E::DelayLine<Memory, 9> del2;
-    E::Context c;
+    typedef typename E::template Reserve<113,
+      typename E::template Reserve<162,
+      typename E::template Reserve<241,
+      typename E::template Reserve<399,
+      typename E::template Reserve<1653,
+      typename E::template Reserve<2038,
+      typename E::template Reserve<3411,
+      typename E::template Reserve<1913,
+      typename E::template Reserve<1663,
+      typename E::template Reserve<4782> > > > > > > > > > Memory;
+    typename E::template DelayLine<Memory, 0> ap1;
+    typename E::template DelayLine<Memory, 1> ap2;
+    typename E::template DelayLine<Memory, 2> ap3;
+    typename E::template DelayLine<Memory, 3> ap4;
+    typename E::template DelayLine<Memory, 4> dap1a;
+    typename E::template DelayLine<Memory, 5> dap1b;
+    typename E::template DelayLine<Memory, 6> del1;
+    typename E::template DelayLine<Memory, 7> dap2a;
+    typename E::template DelayLine<Memory, 8> dap2b;
+    typename E::template DelayLine<Memory, 9> del2;
+    typename E::Context c;
 
     const float kap = diffusion_;
     const float klp = lp_;
@@ -83,17 +87,25 @@ class Reverb {
 
     float lp_1 = lp_decay_1_;
     float lp_2 = lp_decay_2_;
+    
+    const size_t kBlockSize = E::max_block_size;
+    float input[kBlockSize];
+    float apout[kBlockSize];
+    float wet[kBlockSize];
+    std::fill(&input[0], &input[kBlockSize], 0.0f);
 
-    while (size--) {
-      float wet;
-      float apout = 0.0f;
-      engine_.Start(&c);
+    while (size) {
+      size_t block_size = std::min(size, kBlockSize);
+      for (size_t i = 0; i < block_size; ++i) {
+        input[i] = in_out[i].l + in_out[i].r;
+      }
+      engine_.Start(&c, block_size);
       
       // Smear AP1 inside the loop.
       c.Interpolate(ap1, 10.0f, LFO_1, 60.0f, 1.0f);
       c.Write(ap1, 100, 0.0f);
       
-      c.Read(in_out->l + in_out->r, gain);
+      c.Read(&input[0], gain);
 
       // Diffuse through 4 allpasses.
       c.Read(ap1 TAIL, kap);
@@ -104,10 +116,10 @@ class Reverb {
       c.WriteAllPass(ap3, -kap);
       c.Read(ap4 TAIL, kap);
       c.WriteAllPass(ap4, -kap);
-      c.Write(apout);
+      c.Write(&apout[0]);
       
       // Main reverb loop.
-      c.Load(apout);
+      c.Load(&apout[0]);
       c.Interpolate(del2, 4680.0f, LFO_2, 100.0f, krt);
       c.Lp(lp_1, klp);
       c.Read(dap1a TAIL, -kap);
@@ -115,11 +127,13 @@ class Reverb {
       c.Read(dap1b TAIL, kap);
       c.WriteAllPass(dap1b, -kap);
       c.Write(del1, 2.0f);
-      c.Write(wet, 0.0f);
+      c.Write(&wet[0], 0.0f);
 
-      in_out->l += (wet - in_out->l) * amount;
+      for (size_t i = 0; i < block_size; ++i) {
+        in_out[i].l += (wet[i] - in_out[i].l) * amount;
+      }
 
-      c.Load(apout);
+      c.Load(&apout[0]);
       // c.Interpolate(del1, 4450.0f, LFO_1, 50.0f, krt);
       c.Read(del1 TAIL, krt);
       c.Lp(lp_2, klp);
@@ -128,11 +142,14 @@ class Reverb {
       c.Read(dap2b TAIL, -kap);
       c.WriteAllPass(dap2b, kap);
       c.Write(del2, 2.0f);
-      c.Write(wet, 0.0f);
+      c.Write(&wet[0], 0.0f);
 
-      in_out->r += (wet - in_out->r) * amount;
+      for (size_t i = 0; i < block_size; ++i) {
+        in_out[i].r += (wet[i] - in_out[i].r) * amount;
+      }
       
-      ++in_out;
+      in_out += block_size;
+      size -= block_size;
     }
     
     lp_decay_1_ = lp_1;
@@ -160,7 +177,6 @@ class Reverb {
   }
   
  private:
-  typedef FxEngine<16384, FORMAT_12_BIT> E;
   E engine_;
   
   float amount_;
@@ -175,6 +191,10 @@ class Reverb {
   DISALLOW_COPY_AND_ASSIGN(Reverb);
 };
 
+// Same topology and settings, with float storage (twice the memory), processed
+// in blocks by SimdFxEngine. Each delay line is followed by a gap.
+typedef Reverb<SimdFxEngine<16384 + 128> > SimdReverb;
+
 }  // namespace clouds
 
 #endif  // CLOUDS_DSP_FX_REVERB_H_
@@ -0,0 +1,404 @@
+// Copyright 2014 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Block-based variant of FxEngine, for hosts with SIMD instructions.
+//
+// Delay memory is stored as floats, and the instructions of a Context work
+// on blocks of kFxBlockSize consecutive samples: each Read() or Write()
+// reads or writes a contiguous run of the delay line, and the arithmetic is
+// vectorized across the samples of the block. This is equivalent to running
+// the instructions sample by sample as long as no sample of a block reads a
+// value written by an earlier sample of the same block - that is to say, as
+// long as all delays read before being written in the program are at least
+// kFxBlockSize samples long. Lp() and Hp() are recursive and run sample by
+// sample.
+//
+// Unlike in FxEngine, write_ptr_ increases with time, so that the samples of
+// a block are stored in increasing order. Each delay line is followed by a
+// gap of kFxBlockSize samples instead of 1, otherwise the writes of a block
+// to the head of a line would overwrite the tail of the next line before it is
+// read. To make up for it, the size of the delay memory does not have to be a
+// power of 2.
+
+#ifndef CLOUDS_DSP_FX_SIMD_FX_ENGINE_H_
+#define CLOUDS_DSP_FX_SIMD_FX_ENGINE_H_
+
+#include <algorithm>
+
+#include "stmlib/stmlib.h"
+
+#include "stmlib/dsp/dsp.h"
+#include "stmlib/dsp/cosine_oscillator.h"
+
+#include "clouds/dsp/fx/fx_engine.h"
+#include "clouds/dsp/simd.h"
+
+namespace clouds {
+
+// The shortest delay read before being written in the effects is the 10
+// samples smearing of the first diffuser allpass of the reverb. Also shorter
+// than the LFO update period, so that the LFOs are updated at most once per
+// block.
+const size_t kFxBlockSize = 8;
+
+template<size_t size>
+class SimdFxEngine {
+ public:
+  typedef float T;
+  SimdFxEngine() { }
+  ~SimdFxEngine() { }
+  
+  enum {
+    max_block_size = kFxBlockSize
+  };
+
+  void Init(float* buffer) {
+    buffer_ = buffer;
+    Clear();
+  }
+  
+  void Clear() {
+    std::fill(&buffer_[0], &buffer_[size], 0.0f);
+    write_ptr_ = 0;
+    lfo_counter_ = 31;
+  }
+
+  struct Empty { };
+  
+  template<int32_t l, typename T = Empty>
+  struct Reserve {
+    typedef T Tail;
+    enum {
+      length = l
+    };
+  };
+  
+  template<typename Memory, int32_t index>
+  struct DelayLine {
+    enum {
+      length = DelayLine<typename Memory::Tail, index - 1>::length,
+      base = DelayLine<Memory, index - 1>::base + DelayLine<Memory, index - 1>::length + kFxBlockSize
+    };
+  };
+
+  template<typename Memory>
+  struct DelayLine<Memory, 0> {
+    enum {
+      length = Memory::length,
+      base = 0
+    };
+  };
+
+  // Blocks of samples passed to Load(), Read() and Write() are arrays of
+  // kFxBlockSize floats, passed as pointers to their first element. The
+  // accumulator is kept as vectors rather than as an array of floats, so that
+  // the compiler can hold it in registers for the whole program.
+  class Context {
+   friend class SimdFxEngine;
+   public:
+    Context() { }
+    ~Context() { }
+    
+    inline void Load(const float* values) {
+      for (size_t i = 0; i < kNumVectors; ++i) {
+        accumulator_[i] = SimdFloat::Load(&values[i * kSimdWidth]);
+      }
+    }
+
+    inline void Read(const float* values, float scale) {
+      const SimdFloat s(scale);
+      for (size_t i = 0; i < kNumVectors; ++i) {
+        accumulator_[i] = accumulator_[i] + \
+            SimdFloat::Load(&values[i * kSimdWidth]) * s;
+      }
+    }
+
+    inline void Read(const float* values) {
+      for (size_t i = 0; i < kNumVectors; ++i) {
+        accumulator_[i] = accumulator_[i] + \
+            SimdFloat::Load(&values[i * kSimdWidth]);
+      }
+    }
+
+    inline void Write(float* values) {
+      for (size_t i = 0; i < kNumVectors; ++i) {
+        accumulator_[i].Store(&values[i * kSimdWidth]);
+      }
+    }
+
+    inline void Write(float* values, float scale) {
+      Write(values);
+      Scale(scale);
+    }
+    
+    template<typename D>
+    inline void Write(D& d, int32_t offset, float scale) {
+      STATIC_ASSERT(
+          D::base + D::length + kFxBlockSize <= size,
+          delay_memory_full);
+      int32_t position = Position<D>(offset == -1 ? D::length - 1 : offset);
+      if (size_ == kFxBlockSize &&
+          static_cast<size_t>(position) + kFxBlockSize <= size) {
+        Write(&buffer_[position]);
+      } else {
+        float w[kFxBlockSize];
+        Write(w);
+        for (size_t i = 0; i < size_; ++i) {
+          buffer_[Wrap(position + i)] = w[i];
+        }
+      }
+      Scale(scale);
+    }
+    
+    template<typename D>
+    inline void Write(D& d, float scale) {
+      Write(d, 0, scale);
+    }
+
+    template<typename D>
+    inline void WriteAllPass(D& d, int32_t offset, float scale) {
+      Write(d, offset, scale);
+      for (size_t i = 0; i < kNumVectors; ++i) {
+        accumulator_[i] = accumulator_[i] + previous_read_[i];
+      }
+    }
+    
+    template<typename D>
+    inline void WriteAllPass(D& d, float scale) {
+      WriteAllPass(d, 0, scale);
+    }
+    
+    template<typename D>
+    inline void Read(D& d, int32_t offset, float scale) {
+      STATIC_ASSERT(
+          D::base + D::length + kFxBlockSize <= size,
+          delay_memory_full);
+      float scratch[kFxBlockSize];
+      const float* r = Fetch(
+          Position<D>(offset == -1 ? D::length - 1 : offset),
+          scratch);
+      const SimdFloat s(scale);
+      for (size_t i = 0; i < kNumVectors; ++i) {
+        previous_read_[i] = SimdFloat::Load(&r[i * kSimdWidth]);
+        accumulator_[i] = accumulator_[i] + previous_read_[i] * s;
+      }
+    }
+    
+    template<typename D>
+    inline void Read(D& d, float scale) {
+      Read(d, 0, scale);
+    }
+    
+    inline void Lp(float& state, float coefficient) {
+      float x[kFxBlockSize];
+      Write(x);
+      float s = state;
+      for (size_t i = 0; i < size_; ++i) {
+        s += coefficient * (x[i] - s);
+        x[i] = s;
+      }
+      state = s;
+      Load(x);
+    }
+
+    inline void Hp(float& state, float coefficient) {
+      float x[kFxBlockSize];
+      Write(x);
+      float s = state;
+      for (size_t i = 0; i < size_; ++i) {
+        s += coefficient * (x[i] - s);
+        x[i] -= s;
+      }
+      state = s;
+      Load(x);
+    }
+    
+    template<typename D>
+    inline void Interpolate(D& d, float offset, float scale) {
+      STATIC_ASSERT(
+          D::base + D::length + kFxBlockSize <= size,
+          delay_memory_full);
+      MAKE_INTEGRAL_FRACTIONAL(offset);
+      int32_t position = Position<D>(offset_integral);
+      float scratch[2][kFxBlockSize];
+      const float* a = Fetch(position, scratch[0]);
+      const float* b = Fetch(Wrap(position - 1), scratch[1]);
+      const SimdFloat f(offset_fractional);
+      const SimdFloat s(scale);
+      for (size_t i = 0; i < kNumVectors; ++i) {
+        SimdFloat a_i = SimdFloat::Load(&a[i * kSimdWidth]);
+        SimdFloat b_i = SimdFloat::Load(&b[i * kSimdWidth]);
+        previous_read_[i] = a_i + (b_i - a_i) * f;
+        accumulator_[i] = accumulator_[i] + previous_read_[i] * s;
+      }
+    }
+    
+    template<typename D>
+    inline void Interpolate(
+        D& d, float offset, LFOIndex index, float amplitude, float scale) {
+      if (lfo_update_ >= size_) {
+        Interpolate(d, offset + amplitude * lfo_value_[index], scale);
+        return;
+      }
+      // The LFOs are updated within the block.
+      float offsets[kFxBlockSize];
+      float scales[kFxBlockSize];
+      for (size_t i = 0; i < kFxBlockSize; ++i) {
+        float lfo = i < lfo_update_
+            ? lfo_value_[index]
+            : next_lfo_value_[index];
+        offsets[i] = offset + amplitude * lfo;
+        scales[i] = scale;
+      }
+      Interpolate(d, offsets, scales);
+    }
+    
+    // Per-sample offsets and scales. Can read the values written by the
+    // same block.
+    template<typename D>
+    inline void Interpolate(D& d, const float* offset, const float* scale) {
+      STATIC_ASSERT(
+          D::base + D::length + kFxBlockSize <= size,
+          delay_memory_full);
+      int32_t integral[kFxBlockSize];
+      float fractional[kFxBlockSize];
+      int32_t integral_b[kFxBlockSize];
+      for (size_t i = 0; i < kFxBlockSize; ++i) {
+        int32_t offset_integral = static_cast<int32_t>(offset[i]);
+        fractional[i] = offset[i] - static_cast<float>(offset_integral);
+        integral[i] = Wrap(Position<D>(offset_integral) + i);
+        integral_b[i] = Wrap(integral[i] - 1);
+      }
+      for (size_t i = 0; i < kNumVectors; ++i) {
+        size_t j = i * kSimdWidth;
+        SimdFloat a = SimdFloat::Gather(buffer_, &integral[j]);
+        SimdFloat b = SimdFloat::Gather(buffer_, &integral_b[j]);
+        previous_read_[i] = a + (b - a) * SimdFloat::Load(&fractional[j]);
+        accumulator_[i] = accumulator_[i] + \
+            previous_read_[i] * SimdFloat::Load(&scale[j]);
+      }
+    }
+    
+   private:
+    static const size_t kNumVectors = kFxBlockSize / kSimdWidth;
+    
+    // Position of the first sample of the block in the delay memory.
+    template<typename D>
+    inline int32_t Position(int32_t offset) const {
+      return Wrap(write_ptr_ + D::base + D::length - 1 - offset);
+    }
+    
+    // Positions are at most one lap away from the delay memory.
+    static inline int32_t Wrap(int32_t position) {
+      if (position >= static_cast<int32_t>(size)) {
+        position -= size;
+      } else if (position < 0) {
+        position += size;
+      }
+      return position;
+    }
+    
+    // Returns a pointer to the block of samples starting at position, copied
+    // into scratch if it wraps around the end of the delay memory.
+    inline const float* Fetch(int32_t position, float* scratch) const {
+      if (static_cast<size_t>(position) + kFxBlockSize <= size) {
+        return &buffer_[position];
+      }
+      for (size_t i = 0; i < kFxBlockSize; ++i) {
+        scratch[i] = buffer_[Wrap(position + i)];
+      }
+      return scratch;
+    }
+    
+    inline void Scale(float scale) {
+      const SimdFloat s(scale);
+      for (size_t i = 0; i < kNumVectors; ++i) {
+        accumulator_[i] = accumulator_[i] * s;
+      }
+    }
+    
+    SimdFloat accumulator_[kNumVectors];
+    SimdFloat previous_read_[kNumVectors];
+    float lfo_value_[2];
+    float next_lfo_value_[2];
+    size_t lfo_update_;
+    float* buffer_;
+    int32_t write_ptr_;
+    size_t size_;
+
+    DISALLOW_COPY_AND_ASSIGN(Context);
+  };
+  
+  inline void SetLFOFrequency(LFOIndex index, float frequency) {
+    lfo_[index].template Init<stmlib::COSINE_OSCILLATOR_APPROXIMATE>(
+        frequency * 32.0f);
+  }
+  
+  // Starts a block of block_size samples, at most kFxBlockSize.
+  inline void Start(Context* c, size_t block_size) {
+    for (size_t i = 0; i < Context::kNumVectors; ++i) {
+      c->accumulator_[i] = 0.0f;
+      c->previous_read_[i] = 0.0f;
+    }
+    c->buffer_ = buffer_;
+    c->write_ptr_ = write_ptr_;
+    c->size_ = block_size;
+    // As in FxEngine, the LFOs are updated every 32 samples, starting with
+    // the 32nd. When the update falls within the block, lfo_update_ is the
+    // index of the first sample using the new values.
+    c->lfo_value_[0] = c->next_lfo_value_[0] = lfo_[0].value();
+    c->lfo_value_[1] = c->next_lfo_value_[1] = lfo_[1].value();
+    c->lfo_update_ = block_size;
+    if (lfo_counter_ < static_cast<int32_t>(block_size)) {
+      c->next_lfo_value_[0] = lfo_[0].Next();
+      c->next_lfo_value_[1] = lfo_[1].Next();
+      if (lfo_counter_ == 0) {
+        c->lfo_value_[0] = c->next_lfo_value_[0];
+        c->lfo_value_[1] = c->next_lfo_value_[1];
+      } else {
+        c->lfo_update_ = lfo_counter_;
+      }
+      lfo_counter_ += 32;
+    }
+    lfo_counter_ -= static_cast<int32_t>(block_size);
+    write_ptr_ += block_size;
+    if (write_ptr_ >= static_cast<int32_t>(size)) {
+      write_ptr_ -= size;
+    }
+  }
+  
+ private:
+  int32_t write_ptr_;
+  int32_t lfo_counter_;
+  float* buffer_;
+  stmlib::CosineOscillator lfo_[2];
+  
+  DISALLOW_COPY_AND_ASSIGN(SimdFxEngine);
+};
+
+}  // namespace clouds
+
+#endif  // CLOUDS_DSP_FX_SIMD_FX_ENGINE_H_
@@ -39,6 +39,10 @@
 
 namespace clouds {
 
+// The phase of a grain is a 16.16 fixed point number, so a grain cannot read
+// more than this number of samples from the buffer.
+const float kMaxGrainExtent = 32767.0f;
+
 enum GrainQuality {
   GRAIN_QUALITY_LOW,
   GRAIN_QUALITY_MEDIUM,
@@ -73,8 +77,10 @@ class Grain {
     envelope_phase_ = 0.0f;
     envelope_phase_increment_ = 2.0f / static_cast<float>(width);
     if (window_shape >= 0.5f) {
+      // A slope of 1 keeps the triangular window when the smoothness is 0,
+      // that is to say, for a window shape of exactly 0.5.
       envelope_smoothness_ = (window_shape - 0.5f) * 2.0f;
-      envelope_slope_ = 0.0f;
+      envelope_slope_ = 1.0f;
     } else {
       envelope_smoothness_ = 0.0f;
       envelope_slope_ = 0.5f / (window_shape + 0.01f);
@@ -0,0 +1,303 @@
+// Copyright 2014 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Grains stored as a structure of arrays, and rendered kSimdWidth at a time.
+
+#ifndef CLOUDS_DSP_GRAIN_BANK_H_
+#define CLOUDS_DSP_GRAIN_BANK_H_
+
+#include "stmlib/stmlib.h"
+
+#include <algorithm>
+
+#include "clouds/dsp/audio_buffer.h"
+#include "clouds/dsp/frame.h"
+#include "clouds/dsp/simd.h"
+
+#include "clouds/resources.h"
+
+// Only built for hosts with a vector unit - on the hardware, its memory is
+// better spent on the recording buffers.
+#if defined(__SSE2__)
+#define CLOUDS_GRAIN_BANK
+#endif  // __SSE2__
+
+#ifdef CLOUDS_GRAIN_BANK
+
+namespace clouds {
+
+// A multiple of kSimdWidth.
+#ifdef CLOUDS_MAX_NUM_SIMD_GRAINS
+const int32_t kMaxNumSimdGrains = CLOUDS_MAX_NUM_SIMD_GRAINS;
+#else
+const int32_t kMaxNumSimdGrains = 4096;
+#endif  // CLOUDS_MAX_NUM_SIMD_GRAINS
+
+// Unlike Grain, there is no quality setting: all grains are rendered with
+// Hermite interpolation and the smooth window. The position and envelope of
+// each grain are computed from its age (in samples), rather than accumulated.
+class GrainBank {
+ public:
+  GrainBank() { }
+  ~GrainBank() { }
+  
+  void Init() {
+    for (int32_t i = 0; i < kMaxNumSimdGrains; ++i) {
+      Stop(i);
+    }
+  }
+  
+  void Start(
+      int32_t index,
+      int32_t pre_delay,
+      int32_t buffer_size,
+      int32_t start,
+      int32_t width,
+      float phase_increment,
+      float window_shape,
+      float gain_l,
+      float gain_r) {
+    first_sample_[index] = (start + buffer_size) % buffer_size;
+    age_[index] = -static_cast<float>(pre_delay);
+    phase_increment_[index] = phase_increment;
+    envelope_phase_increment_[index] = 2.0f / static_cast<float>(width);
+    if (window_shape >= 0.5f) {
+      envelope_smoothness_[index] = (window_shape - 0.5f) * 2.0f;
+      envelope_slope_[index] = 1.0f;
+    } else {
+      envelope_smoothness_[index] = 0.0f;
+      envelope_slope_[index] = 0.5f / (window_shape + 0.01f);
+    }
+    gain_l_[index] = gain_l;
+    gain_r_[index] = gain_r;
+    active_[index] = true;
+  }
+  
+  // Renders the first num_grains grains, and adds them to an interleaved
+  // stereo block.
+  template<int32_t num_channels, Resolution resolution>
+  void OverlapAdd(
+      const AudioBuffer<resolution>* buffer,
+      int32_t num_grains,
+      float* destination,
+      size_t size) {
+    std::fill(&accumulator_l_[0], &accumulator_l_[size * kSimdWidth], 0.0f);
+    std::fill(&accumulator_r_[0], &accumulator_r_[size * kSimdWidth], 0.0f);
+    for (int32_t i = 0; i < num_grains; i += kSimdWidth) {
+      bool active = false;
+      for (size_t j = 0; j < kSimdWidth; ++j) {
+        active = active || active_[i + j];
+      }
+      if (active) {
+        RenderGroup<num_channels>(buffer, i, size);
+      }
+    }
+    
+    // Sum across lanes.
+    const float* accumulator_l = accumulator_l_;
+    const float* accumulator_r = accumulator_r_;
+    while (size--) {
+      float l = 0.0f;
+      float r = 0.0f;
+      for (size_t j = 0; j < kSimdWidth; ++j) {
+        l += accumulator_l[j];
+        r += accumulator_r[j];
+      }
+      *destination++ += l;
+      *destination++ += r;
+      accumulator_l += kSimdWidth;
+      accumulator_r += kSimdWidth;
+    }
+  }
+  
+  inline bool active(int32_t index) const { return active_[index]; }
+  
+ private:
+  // Inactive grains are silent and read the first samples of the buffer.
+  void Stop(int32_t index) {
+    first_sample_[index] = 0;
+    age_[index] = 0.0f;
+    phase_increment_[index] = 0.0f;
+    envelope_phase_increment_[index] = 0.0f;
+    envelope_smoothness_[index] = 0.0f;
+    envelope_slope_[index] = 0.0f;
+    gain_l_[index] = 0.0f;
+    gain_r_[index] = 0.0f;
+    active_[index] = false;
+  }
+  
+  template<int32_t num_channels, Resolution resolution>
+  void RenderGroup(
+      const AudioBuffer<resolution>* buffer,
+      int32_t first_grain,
+      size_t size) {
+    // Keeps the index of the window lookup within the table.
+    const float kMaxWindowPhase = 4095.0f / 4096.0f;
+    
+    const int32_t* first_sample = &first_sample_[first_grain];
+    SimdFloat age = SimdFloat::Load(&age_[first_grain]);
+    const SimdFloat phase_increment = SimdFloat::Load(
+        &phase_increment_[first_grain]);
+    const SimdFloat envelope_phase_increment = SimdFloat::Load(
+        &envelope_phase_increment_[first_grain]);
+    const SimdFloat smoothness = SimdFloat::Load(
+        &envelope_smoothness_[first_grain]);
+    const SimdFloat slope = SimdFloat::Load(&envelope_slope_[first_grain]);
+    const SimdFloat gain_l = SimdFloat::Load(&gain_l_[first_grain]);
+    const SimdFloat gain_r = SimdFloat::Load(&gain_r_[first_grain]);
+    const SimdFloat bleed_l = SimdFloat(1.0f) - gain_l;
+    const SimdFloat bleed_r = SimdFloat(1.0f) - gain_r;
+    const bool s16 = resolution == RESOLUTION_16_BIT || \
+        resolution == RESOLUTION_8_BIT_MU_LAW;
+    const SimdFloat scale = s16 ? 1.0f / 32768.0f : 1.0f / 128.0f;
+    const bool smooth = (SimdFloat(0.0f) < smoothness).any();
+    const int32_t buffer_size = buffer[0].size();
+    
+    float* accumulator_l = accumulator_l_;
+    float* accumulator_r = accumulator_r_;
+    while (size--) {
+      // Envelope. Silent during the pre-delay, and after the end of the grain.
+      const SimdFloat t = SimdFloat::Max(age, 0.0f);
+      const SimdFloat envelope_phase = t * envelope_phase_increment;
+      const SimdFloat playing = (age >= 0.0f) & \
+          (envelope_phase + envelope_phase_increment < 2.0f);
+      SimdFloat gain = SimdFloat::Min(
+          envelope_phase,
+          SimdFloat(2.0f) - envelope_phase);
+      gain = SimdFloat::Max(SimdFloat::Min(gain * slope, 1.0f), 0.0f);
+      if (smooth) {
+        const SimdFloat window = Interpolate(
+            lut_window,
+            SimdFloat::Min(gain, kMaxWindowPhase),
+            4096.0f);
+        gain += smoothness * (window - gain);
+      }
+      gain = (gain * scale) & playing;
+      
+      int32_t integral[kSimdWidth];
+      SimdFloat fractional;
+      (t * phase_increment).Split(integral, &fractional);
+      for (size_t j = 0; j < kSimdWidth; ++j) {
+        integral[j] += first_sample[j];
+        if (integral[j] >= buffer_size) {
+          integral[j] -= buffer_size;
+        }
+      }
+      
+      const SimdFloat l = ReadHermite(buffer[0], integral, fractional) * gain;
+      SimdFloat out_l = SimdFloat::Load(accumulator_l);
+      SimdFloat out_r = SimdFloat::Load(accumulator_r);
+      if (num_channels == 1) {
+        out_l += l * gain_l;
+        out_r += l * gain_r;
+      } else {
+        const SimdFloat r = ReadHermite(buffer[1], integral, fractional) * \
+            gain;
+        out_l += l * gain_l + r * bleed_r;
+        out_r += r * gain_r + l * bleed_l;
+      }
+      out_l.Store(accumulator_l);
+      out_r.Store(accumulator_r);
+      accumulator_l += kSimdWidth;
+      accumulator_r += kSimdWidth;
+      age += 1.0f;
+    }
+    age.Store(&age_[first_grain]);
+    
+    // Retire the grains which have reached the end of their envelope.
+    for (size_t j = 0; j < kSimdWidth; ++j) {
+      const int32_t index = first_grain + j;
+      const float envelope_phase_increment = envelope_phase_increment_[index];
+      const float t = std::max(age_[index], 0.0f);
+      if (active_[index] &&
+          t * envelope_phase_increment + envelope_phase_increment >= 2.0f) {
+        Stop(index);
+      }
+    }
+  }
+  
+  // Returns the unscaled samples at the grains' positions.
+  template<Resolution resolution>
+  static inline SimdFloat ReadHermite(
+      const AudioBuffer<resolution>& buffer,
+      const int32_t* integral,
+      SimdFloat t) {
+    SimdFloat xm1, x0, x1, x2;
+    if (resolution == RESOLUTION_16_BIT) {
+      GatherInt16Pairs(buffer.s16(), integral, &xm1, &x0);
+      GatherInt16Pairs(buffer.s16() + 2, integral, &x1, &x2);
+    } else if (resolution == RESOLUTION_8_BIT_MU_LAW) {
+      SimdFloat taps[4];
+      GatherMuLawQuads(buffer.s8(), integral, taps);
+      xm1 = taps[0];
+      x0 = taps[1];
+      x1 = taps[2];
+      x2 = taps[3];
+    } else {
+      float taps[4][kSimdWidth];
+      for (size_t j = 0; j < kSimdWidth; ++j) {
+        const int8_t* s = &buffer.s8()[integral[j]];
+        for (size_t k = 0; k < 4; ++k) {
+          taps[k][j] = s[k];
+        }
+      }
+      xm1 = SimdFloat::Load(taps[0]);
+      x0 = SimdFloat::Load(taps[1]);
+      x1 = SimdFloat::Load(taps[2]);
+      x2 = SimdFloat::Load(taps[3]);
+    }
+    
+    // Same interpolator as AudioBuffer::ReadHermite().
+    const SimdFloat c = (x1 - xm1) * 0.5f;
+    const SimdFloat v = x0 - x1;
+    const SimdFloat w = c + v;
+    const SimdFloat a = w + v + (x2 - x0) * 0.5f;
+    const SimdFloat b_neg = w + a;
+    return (((a * t) - b_neg) * t + c) * t + x0;
+  }
+  
+  int32_t first_sample_[kMaxNumSimdGrains];
+  float age_[kMaxNumSimdGrains];
+  float phase_increment_[kMaxNumSimdGrains];
+  float envelope_phase_increment_[kMaxNumSimdGrains];
+  float envelope_smoothness_[kMaxNumSimdGrains];
+  float envelope_slope_[kMaxNumSimdGrains];
+  float gain_l_[kMaxNumSimdGrains];
+  float gain_r_[kMaxNumSimdGrains];
+  bool active_[kMaxNumSimdGrains];
+  
+  // Contribution of each lane, for each sample of the block.
+  float accumulator_l_[kMaxBlockSize * kSimdWidth];
+  float accumulator_r_[kMaxBlockSize * kSimdWidth];
+  
+  DISALLOW_COPY_AND_ASSIGN(GrainBank);
+};
+
+}  // namespace clouds
+
+#endif  // CLOUDS_GRAIN_BANK
+
+#endif  // CLOUDS_DSP_GRAIN_BANK_H_
@@ -49,9 +49,16 @@ void GranularProcessor::Init(
   buffer_[1] = small_buffer;
   buffer_size_[0] = large_buffer_size;
   buffer_size_[1] = small_buffer_size;
+  recording_buffer_ = NULL;
+  recording_buffer_size_ = 0;
   
   num_channels_ = 2;
   low_fidelity_ = false;
+  num_grains_ = 0;
+  grain_backend_ = kDefaultGrainBackend;
+  spectral_precision_ = PHASE_VOCODER_PRECISION_STANDARD;
+  fx_backend_ = kDefaultFxBackend;
+  simd_fx_ = false;
   bypass_ = false;
   
   src_down_.Init();
@@ -64,6 +71,44 @@ void GranularProcessor::Init(
   dry_wet_ = 0.0f;
 }
 
+void GranularProcessor::GetBufferLayout(
+    void** buffer,
+    size_t* buffer_size,
+    void** workspace,
+    size_t* workspace_size) const {
+  if (recording_buffer_ && playback_mode_ != PLAYBACK_MODE_SPECTRAL) {
+    // External sample memory, split between the channels. The large buffer
+    // is fully allocated to FX workspace.
+    size_t channel_size = (recording_buffer_size_ / num_channels_) & ~3;
+    buffer[0] = recording_buffer_;
+    buffer_size[0] = channel_size;
+    buffer[1] = num_channels_ == 1
+        ? NULL
+        : static_cast<uint8_t*>(recording_buffer_) + channel_size;
+    buffer_size[1] = num_channels_ == 1 ? 0 : channel_size;
+    *workspace = buffer_[0];
+    *workspace_size = buffer_size_[0];
+  } else if (num_channels_ == 1) {
+    // Large buffer: 120k of sample memory.
+    // small buffer: fully allocated to FX workspace.
+    buffer[0] = buffer_[0];
+    buffer_size[0] = buffer_size_[0];
+    buffer[1] = NULL;
+    buffer_size[1] = 0;
+    *workspace = buffer_[1];
+    *workspace_size = buffer_size_[1];
+  } else {
+    // Large buffer: 64k of sample memory + FX workspace.
+    // small buffer: 64k of sample memory.
+    buffer_size[0] = buffer_size[1] = buffer_size_[1];
+    buffer[0] = buffer_[0];
+    buffer[1] = buffer_[1];
+    
+    *workspace_size = buffer_size_[0] - buffer_size_[1];
+    *workspace = static_cast<uint8_t*>(buffer[0]) + buffer_size[0];
+  }
+}
+
 void GranularProcessor::ResetFilters() {
   for (int32_t i = 0; i < 2; ++i) {
     fb_filter_[i].Init();
@@ -217,15 +262,26 @@ void GranularProcessor::Process(
     float diffusion = playback_mode_ == PLAYBACK_MODE_GRANULAR 
         ? texture > 0.75f ? (texture - 0.75f) * 4.0f : 0.0f
         : parameters_.density;
-    diffuser_.set_amount(diffusion);
-    diffuser_.Process(out_, size);
+    if (simd_fx_) {
+      simd_diffuser_.set_amount(diffusion);
+      simd_diffuser_.Process(out_, size);
+    } else {
+      diffuser_.set_amount(diffusion);
+      diffuser_.Process(out_, size);
+    }
   }
   
   if (playback_mode_ == PLAYBACK_MODE_LOOPING_DELAY &&
       (!parameters_.freeze || looper_.synchronized())) {
-    pitch_shifter_.set_ratio(SemitonesToRatio(parameters_.pitch));
-    pitch_shifter_.set_size(parameters_.size);
-    pitch_shifter_.Process(out_, size);
+    if (simd_fx_) {
+      simd_pitch_shifter_.set_ratio(SemitonesToRatio(parameters_.pitch));
+      simd_pitch_shifter_.set_size(parameters_.size);
+      simd_pitch_shifter_.Process(out_, size);
+    } else {
+      pitch_shifter_.set_ratio(SemitonesToRatio(parameters_.pitch));
+      pitch_shifter_.set_size(parameters_.size);
+      pitch_shifter_.Process(out_, size);
+    }
   }
   
   // Apply filters.
@@ -264,12 +320,21 @@ void GranularProcessor::Process(
   reverb_amount += feedback * (2.0f - feedback) * freeze_lp_;
   CONSTRAIN(reverb_amount, 0.0f, 1.0f);
   
-  reverb_.set_amount(reverb_amount * 0.54f);
-  reverb_.set_diffusion(0.7f);
-  reverb_.set_time(0.35f + 0.63f * reverb_amount);
-  reverb_.set_input_gain(0.2f);
-  reverb_.set_lp(0.6f + 0.37f * feedback);
-  reverb_.Process(out_, size);
+  if (simd_fx_) {
+    simd_reverb_.set_amount(reverb_amount * 0.54f);
+    simd_reverb_.set_diffusion(0.7f);
+    simd_reverb_.set_time(0.35f + 0.63f * reverb_amount);
+    simd_reverb_.set_input_gain(0.2f);
+    simd_reverb_.set_lp(0.6f + 0.37f * feedback);
+    simd_reverb_.Process(out_, size);
+  } else {
+    reverb_.set_amount(reverb_amount * 0.54f);
+    reverb_.set_diffusion(0.7f);
+    reverb_.set_time(0.35f + 0.63f * reverb_amount);
+    reverb_.set_input_gain(0.2f);
+    reverb_.set_lp(0.6f + 0.37f * feedback);
+    reverb_.Process(out_, size);
+  }
   
   const float post_gain = 1.2f;
   ParameterInterpolator dry_wet_mod(&dry_wet_, parameters_.dry_wet, size);
@@ -304,11 +369,17 @@ void GranularProcessor::GetPersistentData(
   block->size = sizeof(PersistentState);
   ++block;
 
+  void* buffer[2];
+  size_t buffer_size[2];
+  void* workspace;
+  size_t workspace_size;
+  GetBufferLayout(buffer, buffer_size, &workspace, &workspace_size);
+  
   // Create save block holding the audio buffers.
   for (int32_t i = 0; i < num_channels_; ++i) {
     block->tag = FourCC<'b', 'u', 'f', 'f'>::value;
-    block->data = buffer_[i];
-    block->size = buffer_size_[num_channels_ - 1];
+    block->data = buffer[i];
+    block->size = buffer_size[i];
     ++block;
   }
   *num_blocks = block - first_block;
@@ -367,7 +438,76 @@ bool GranularProcessor::LoadPersistentData(const uint32_t* data) {
   return true;
 }
 
-void GranularProcessor::Prepare() {
+template<typename T>
+void GranularProcessor::Import(const T* frames, size_t num_frames) {
+  if (reset_buffers_ || previous_playback_mode_ != playback_mode_) {
+    Prepare();
+  }
+  if (playback_mode_ == PLAYBACK_MODE_SPECTRAL) {
+    return;
+  }
+  for (int32_t i = 0; i < num_channels_; ++i) {
+    if (low_fidelity_) {
+      buffer_8_[i].Import(&frames[i], num_frames, num_channels_);
+    } else {
+      buffer_16_[i].Import(&frames[i], num_frames, num_channels_);
+    }
+  }
+  parameters_.freeze = true;
+}
+
+template<typename T>
+size_t GranularProcessor::Export(
+    size_t position,
+    T* frames,
+    size_t num_frames) const {
+  size_t size = recording_size();
+  if (position >= size) {
+    return 0;
+  }
+  num_frames = min(num_frames, size - position);
+  for (int32_t i = 0; i < num_channels_; ++i) {
+    if (low_fidelity_) {
+      buffer_8_[i].Export(position, &frames[i], num_frames, num_channels_);
+    } else {
+      buffer_16_[i].Export(position, &frames[i], num_frames, num_channels_);
+    }
+  }
+  return num_frames;
+}
+
+void GranularProcessor::ImportFrames(const int16_t* frames, size_t num_frames) {
+  Import(frames, num_frames);
+}
+
+void GranularProcessor::ImportFrames(const uint8_t* frames, size_t num_frames) {
+  Import(frames, num_frames);
+}
+
+size_t GranularProcessor::ExportFrames(
+    size_t position,
+    int16_t* frames,
+    size_t num_frames) const {
+  return Export(position, frames, num_frames);
+}
+
+size_t GranularProcessor::ExportFrames(
+    size_t position,
+    uint8_t* frames,
+    size_t num_frames) const {
+  return Export(position, frames, num_frames);
+}
+
+size_t GranularProcessor::recording_size() const {
+  if (reset_buffers_ ||
+      previous_playback_mode_ == PLAYBACK_MODE_SPECTRAL ||
+      previous_playback_mode_ == PLAYBACK_MODE_LAST) {
+    return 0;
+  }
+  return low_fidelity_ ? buffer_8_[0].size() : buffer_16_[0].size();
+}
+
+bool GranularProcessor::PrepareBuffers() {
   bool playback_mode_changed = previous_playback_mode_ != playback_mode_;
   bool benign_change = previous_playback_mode_ != PLAYBACK_MODE_SPECTRAL
       && playback_mode_ != PLAYBACK_MODE_SPECTRAL
@@ -375,7 +515,11 @@ void GranularProcessor::Prepare() {
   
   if (!reset_buffers_ && playback_mode_changed && benign_change) {
     ResetFilters();
-    pitch_shifter_.Clear();
+    if (simd_fx_) {
+      simd_pitch_shifter_.Clear();
+    } else {
+      pitch_shifter_.Clear();
+    }
     previous_playback_mode_ = playback_mode_;
   }
   
@@ -388,78 +532,109 @@ void GranularProcessor::Prepare() {
     size_t buffer_size[2];
     void* workspace;
     size_t workspace_size;
-    if (num_channels_ == 1) {
-      // Large buffer: 120k of sample memory.
-      // small buffer: fully allocated to FX workspace.
-      buffer[0] = buffer_[0];
-      buffer_size[0] = buffer_size_[0];
-      buffer[1] = NULL;
-      buffer_size[1] = 0;
-      workspace = buffer_[1];
-      workspace_size = buffer_size_[1];
-    } else {
-      // Large buffer: 64k of sample memory + FX workspace.
-      // small buffer: 64k of sample memory.
-      buffer_size[0] = buffer_size[1] = buffer_size_[1];
-      buffer[0] = buffer_[0];
-      buffer[1] = buffer_[1];
-      
-      workspace_size = buffer_size_[0] - buffer_size_[1];
-      workspace = static_cast<uint8_t*>(buffer[0]) + buffer_size[0];
-    }
+    GetBufferLayout(buffer, buffer_size, &workspace, &workspace_size);
     float sr = sample_rate();
 
     BufferAllocator allocator(workspace, workspace_size);
-    diffuser_.Init(allocator.Allocate<float>(2048));
-    reverb_.Init(allocator.Allocate<uint16_t>(16384));
-    
     size_t correlator_block_size = (kMaxWSOLASize / 32) + 2;
+    
+    // The SIMD effects store floats, and the pitch shifter can no longer
+    // share its memory with the correlator.
+    size_t simd_fx_size = (2112 + 16512 + 4128) * sizeof(float) + \
+        correlator_block_size * 3 * sizeof(uint32_t);
+    simd_fx_ = fx_backend_ == FX_BACKEND_SIMD && \
+        workspace_size >= simd_fx_size;
+    if (simd_fx_) {
+      simd_diffuser_.Init(allocator.Allocate<float>(2112));
+      simd_reverb_.Init(allocator.Allocate<float>(16512));
+      simd_pitch_shifter_.Init(allocator.Allocate<float>(4128));
+    } else {
+      diffuser_.Init(allocator.Allocate<float>(2048));
+      reverb_.Init(allocator.Allocate<uint16_t>(16384));
+    }
+    
     uint32_t* correlator_data = allocator.Allocate<uint32_t>(
         correlator_block_size * 3);
     correlator_.Init(
         &correlator_data[0],
         &correlator_data[correlator_block_size]);
-    pitch_shifter_.Init((uint16_t*)correlator_data);
+    if (!simd_fx_) {
+      pitch_shifter_.Init((uint16_t*)correlator_data);
+    }
     
     if (playback_mode_ == PLAYBACK_MODE_SPECTRAL) {
       phase_vocoder_.Init(
           buffer, buffer_size,
           lut_sine_window_4096, 4096,
-          num_channels_, resolution(), sr);
+          num_channels_, resolution(), sr,
+          spectral_precision_);
     } else {
       for (int32_t i = 0; i < num_channels_; ++i) {
         if (resolution() == 8) {
           buffer_8_[i].Init(
               buffer[i],
-              (buffer_size[i]),
+              min(buffer_size[i], size_t(kMaxAudioBufferSize)),
               tail_buffer_[i]);
         } else {
           buffer_16_[i].Init(
               buffer[i],
-              ((buffer_size[i]) >> 1),
+              min(buffer_size[i] >> 1, size_t(kMaxAudioBufferSize)),
               tail_buffer_[i]);
         }
       }
-      int32_t num_grains = (num_channels_ == 1 ? 40 : 32) * \
-          (low_fidelity_ ? 23 : 16) >> 4;
+      int32_t num_grains = num_grains_;
+      if (!num_grains) {
+        num_grains = (num_channels_ == 1 ? 40 : 32) * \
+            (low_fidelity_ ? 23 : 16) >> 4;
+      }
       player_.Init(num_channels_, num_grains);
+      player_.set_backend(grain_backend_);
       ws_player_.Init(&correlator_, num_channels_);
       looper_.Init(num_channels_);
     }
     reset_buffers_ = false;
     previous_playback_mode_ = playback_mode_;
+    return true;
   }
-  
+  return false;
+}
+
+void GranularProcessor::LoadCorrelator() {
+  if (resolution() == 8) {
+    ws_player_.LoadCorrelator(buffer_8_);
+  } else {
+    ws_player_.LoadCorrelator(buffer_16_);
+  }
+}
+
+void GranularProcessor::Prepare() {
+  PrepareBuffers();
   if (playback_mode_ == PLAYBACK_MODE_SPECTRAL) {
     phase_vocoder_.Buffer();
   } else if (playback_mode_ == PLAYBACK_MODE_STRETCH) {
-    if (resolution() == 8) {
-      ws_player_.LoadCorrelator(buffer_8_);
-    } else {
-      ws_player_.LoadCorrelator(buffer_16_);
-    }
+    LoadCorrelator();
     correlator_.EvaluateSomeCandidates();
   }
 }
 
+bool GranularProcessor::BeginPrepare() {
+  bool buffers_changed = PrepareBuffers();
+  if (playback_mode_ == PLAYBACK_MODE_STRETCH) {
+    LoadCorrelator();
+  }
+  return buffers_changed;
+}
+
+void GranularProcessor::PrepareAll() {
+  if (playback_mode_ == PLAYBACK_MODE_SPECTRAL) {
+    while (phase_vocoder_.pending()) {
+      phase_vocoder_.Buffer();
+    }
+  } else if (playback_mode_ == PLAYBACK_MODE_STRETCH) {
+    while (!correlator_.done()) {
+      correlator_.EvaluateSomeCandidates();
+    }
+  }
+}
+
 }  // namespace clouds
@@ -56,6 +56,19 @@ enum PlaybackMode {
   PLAYBACK_MODE_LAST
 };
 
+enum FxBackend {
+  FX_BACKEND_SCALAR,
+  // Float storage and block processing, see SimdFxEngine. Needs about 90k of
+  // workspace, and falls back to the scalar effects with less.
+  FX_BACKEND_SIMD
+};
+
+#if defined(__SSE2__)
+const FxBackend kDefaultFxBackend = FX_BACKEND_SIMD;
+#else
+const FxBackend kDefaultFxBackend = FX_BACKEND_SCALAR;
+#endif  // __SSE2__
+
 // State of the recording buffer as saved in one of the 4 sample memories.
 struct PersistentState {
   int32_t write_head[2];
@@ -84,6 +97,19 @@ class GranularProcessor {
   void Process(ShortFrame* input, ShortFrame* output, size_t size);
   void Prepare();
   
+  // Prepare() split up, for hosts running the background work on another
+  // thread. BeginPrepare() is called from the audio thread: it re-lays out
+  // the buffers after a change of settings - returning true when it did - and
+  // loads the correlator. The pending work, a correlator search or STFT
+  // frames, is then reached through mutable_correlator() and
+  // mutable_phase_vocoder(), and handed over piecewise. PrepareAll() instead
+  // does it all at once on the calling thread.
+  bool BeginPrepare();
+  void PrepareAll();
+  
+  inline Correlator* mutable_correlator() { return &correlator_; }
+  inline PhaseVocoder* mutable_phase_vocoder() { return &phase_vocoder_; }
+  
   inline Parameters* mutable_parameters() {
     return &parameters_;
   }
@@ -108,6 +134,55 @@ class GranularProcessor {
     silence_ = silence;
   }
   
+  // Records into an external block of memory - which can be arbitrarily large,
+  // for example a memory-mapped file holding minutes of audio - instead of the
+  // sample memory carved from the buffers passed to Init(). The block is split
+  // between the two channels in stereo. The buffers passed to Init() are then
+  // only used as FX workspace. Not used in spectral mode. Pass NULL to record
+  // into the buffers passed to Init() again.
+  inline void set_recording_buffer(void* buffer, size_t size) {
+    recording_buffer_ = buffer;
+    recording_buffer_size_ = size;
+    reset_buffers_ = true;
+  }
+  
+  // Maximum number of simultaneous grains in granular mode - beyond
+  // kMaxNumGrains, only with the SIMD grain backend. 0 restores the default,
+  // which depends on the quality setting.
+  inline void set_num_grains(int32_t num_grains) {
+    reset_buffers_ = reset_buffers_ || num_grains != num_grains_;
+    num_grains_ = num_grains;
+  }
+  
+  inline void set_grain_backend(GrainBackend grain_backend) {
+    reset_buffers_ = reset_buffers_ || grain_backend != grain_backend_;
+    grain_backend_ = grain_backend;
+  }
+  
+  // The high precision profile uses a larger FFT in spectral mode, when the
+  // buffers have room for it.
+  inline void set_spectral_precision(PhaseVocoderPrecision precision) {
+    reset_buffers_ = reset_buffers_ || precision != spectral_precision_;
+    spectral_precision_ = precision;
+  }
+  
+  inline void set_fx_backend(FxBackend fx_backend) {
+    reset_buffers_ = reset_buffers_ || fx_backend != fx_backend_;
+    fx_backend_ = fx_backend;
+  }
+  
+  // The backend actually used, after the fallback to the scalar effects.
+  inline FxBackend fx_backend() const {
+    return simd_fx_ ? FX_BACKEND_SIMD : FX_BACKEND_SCALAR;
+  }
+  
+  // 0 when not in spectral mode.
+  inline size_t spectral_fft_size() const {
+    return playback_mode_ == PLAYBACK_MODE_SPECTRAL
+        ? phase_vocoder_.fft_size()
+        : 0;
+  }
+  
   inline void set_bypass(bool bypass) {
     bypass_ = bypass;
   }
@@ -132,6 +207,8 @@ class GranularProcessor {
     num_channels_ = num_channels;
   }
   
+  inline int32_t num_channels() const { return num_channels_; }
+  
   inline void set_low_fidelity(bool low_fidelity) {
     reset_buffers_ = reset_buffers_ || low_fidelity != low_fidelity_;
     low_fidelity_ = low_fidelity;
@@ -148,23 +225,58 @@ class GranularProcessor {
   bool LoadPersistentData(const uint32_t* data);
   void PreparePersistentData();
 
- private:
-  inline int32_t resolution() const {
-    return low_fidelity_ ? 8 : 16;
-  }
+  // Streaming access to the recording buffers, for hosts saving or restoring
+  // large amounts of audio one chunk at a time. Frames hold one sample per
+  // channel, either 16-bit or mu-law encoded, converted on the fly to and
+  // from the resolution of the buffers. Importing appends frames at the
+  // write heads and freezes the processor. Exporting reads frames in
+  // chronological order, starting "position" frames after the oldest one,
+  // and returns the number of frames read. Not available in spectral mode,
+  // and not to be called concurrently with Process() or Prepare().
+  void ImportFrames(const int16_t* frames, size_t num_frames);
+  void ImportFrames(const uint8_t* frames, size_t num_frames);
+  size_t ExportFrames(size_t position, int16_t* frames, size_t num_frames)
+      const;
+  size_t ExportFrames(size_t position, uint8_t* frames, size_t num_frames)
+      const;
+
+  // Number of frames in the recording buffers, 0 when they are not set up.
+  size_t recording_size() const;
 
   inline float sample_rate() const {
     return 32000.0f / \
         (low_fidelity_ ? kDownsamplingFactor : 1);
   }
-     
+
+ private:
+  inline int32_t resolution() const {
+    return low_fidelity_ ? 8 : 16;
+  }
+
   void ResetFilters();
+  bool PrepareBuffers();
+  void LoadCorrelator();
+  void GetBufferLayout(
+      void** buffer,
+      size_t* buffer_size,
+      void** workspace,
+      size_t* workspace_size) const;
   void ProcessGranular(FloatFrame* input, FloatFrame* output, size_t size);
 
+  template<typename T>
+  void Import(const T* frames, size_t num_frames);
+  template<typename T>
+  size_t Export(size_t position, T* frames, size_t num_frames) const;
+
   PlaybackMode playback_mode_;
   PlaybackMode previous_playback_mode_;
   int32_t num_channels_;
   bool low_fidelity_;
+  int32_t num_grains_;
+  GrainBackend grain_backend_;
+  PhaseVocoderPrecision spectral_precision_;
+  FxBackend fx_backend_;
+  bool simd_fx_;
   
   bool silence_;
   bool bypass_;
@@ -175,6 +287,9 @@ class GranularProcessor {
   void* buffer_[2];
   size_t buffer_size_[2];
   
+  void* recording_buffer_;
+  size_t recording_buffer_size_;
+  
   Correlator correlator_;
   
   GranularSamplePlayer player_;
@@ -182,9 +297,12 @@ class GranularProcessor {
   LoopingSamplePlayer looper_;
   PhaseVocoder phase_vocoder_;
   
-  Diffuser diffuser_;
-  Reverb reverb_;
-  PitchShifter pitch_shifter_;
+  Diffuser<> diffuser_;
+  Reverb<> reverb_;
+  PitchShifter<> pitch_shifter_;
+  SimdDiffuser simd_diffuser_;
+  SimdReverb simd_reverb_;
+  SimdPitchShifter simd_pitch_shifter_;
   stmlib::Svf fb_filter_[2];
   stmlib::Svf hp_filter_[2];
   stmlib::Svf lp_filter_[2];
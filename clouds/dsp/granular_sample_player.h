@@ -35,12 +35,13 @@
 
 #include "stmlib/dsp/atan.h"
 #include "stmlib/dsp/units.h"
-#include "stmlib/utils/random.h"
 
 #include "clouds/dsp/audio_buffer.h"
 #include "clouds/dsp/frame.h"
 #include "clouds/dsp/grain.h"
+#include "clouds/dsp/grain_bank.h"
 #include "clouds/dsp/parameters.h"
+#include "clouds/dsp/random_generator.h"
 
 #include "clouds/resources.h"
 
@@ -48,6 +49,26 @@ namespace clouds {
 
 const int32_t kMaxNumGrains = 64;
 
+enum GrainBackend {
+  GRAIN_BACKEND_SCALAR,
+  GRAIN_BACKEND_SIMD,
+  // SIMD above kMaxNumScalarBackendGrains grains, scalar otherwise.
+  GRAIN_BACKEND_AUTO
+};
+
+const GrainBackend kDefaultGrainBackend = GRAIN_BACKEND_AUTO;
+
+// Up to this number of grains, BenchmarkGrains does not show the SIMD backend
+// to be reliably faster than the scalar one - which also sounds like the
+// hardware.
+const int32_t kMaxNumScalarBackendGrains = kMaxNumGrains;
+
+#ifdef CLOUDS_GRAIN_BANK
+const int32_t kMaxNumPlayerGrains = kMaxNumSimdGrains;
+#else
+const int32_t kMaxNumPlayerGrains = kMaxNumGrains;
+#endif  // CLOUDS_GRAIN_BANK
+
 using namespace stmlib;
 
 class GranularSamplePlayer {
@@ -56,17 +77,47 @@ class GranularSamplePlayer {
   ~GranularSamplePlayer() { }
   
   void Init(int32_t num_channels, int32_t max_num_grains) {
-    max_num_grains_ = max_num_grains;
-    num_midfi_grains_ = 3 * max_num_grains / 4;
+    requested_num_grains_ = max_num_grains;
     gain_normalization_ = 1.0f;
-    for (int32_t i = 0; i < kMaxNumGrains; ++i) {
-      grains_[i].Init();
-    }
     num_grains_ = 0.0f;
     num_channels_ = num_channels;
     grain_size_hint_ = 1024.0f;
+    random_.Init(kDefaultRandomSeed);
+    set_backend(kDefaultGrainBackend);
   }
   
+  // The scalar backend renders at most kMaxNumGrains grains, with a quality
+  // decreasing with the number of active grains. The SIMD backend renders up
+  // to kMaxNumSimdGrains grains, all at the highest quality. Switching backend
+  // stops all grains.
+  void set_backend(GrainBackend backend) {
+    if (backend == GRAIN_BACKEND_AUTO) {
+      backend = requested_num_grains_ > kMaxNumScalarBackendGrains
+          ? GRAIN_BACKEND_SIMD
+          : GRAIN_BACKEND_SCALAR;
+    }
+#ifndef CLOUDS_GRAIN_BANK
+    backend = GRAIN_BACKEND_SCALAR;
+#endif  // CLOUDS_GRAIN_BANK
+    backend_ = backend;
+    max_num_grains_ = std::min(
+        requested_num_grains_,
+        backend == GRAIN_BACKEND_SIMD ? kMaxNumPlayerGrains : kMaxNumGrains);
+    num_midfi_grains_ = 3 * max_num_grains_ / 4;
+    for (int32_t i = 0; i < kMaxNumGrains; ++i) {
+      grains_[i].Init();
+    }
+#ifdef CLOUDS_GRAIN_BANK
+    bank_.Init();
+#endif  // CLOUDS_GRAIN_BANK
+  }
+  
+  inline GrainBackend backend() const { return backend_; }
+  inline int32_t max_num_grains() const { return max_num_grains_; }
+  
+  // Smoothed number of active grains.
+  inline float num_grains() const { return num_grains_; }
+  
   template<Resolution resolution>
   void Play(
       const AudioBuffer<resolution>* buffer,
@@ -90,7 +141,7 @@ class GranularSamplePlayer {
     bool seed_trigger = parameters.trigger;
     for (size_t t = 0; t < size; ++t) {
       grain_rate_phasor_ += 1.0f;
-      bool seed_probabilistic = Random::GetFloat() < p
+      bool seed_probabilistic = random_.GetFloat() < p
           && target_num_grains > num_grains_;
       bool seed_deterministic = grain_rate_phasor_ >= space_between_grains;
       bool seed = seed_probabilistic || seed_deterministic || seed_trigger;
@@ -104,9 +155,8 @@ class GranularSamplePlayer {
           quality = GRAIN_QUALITY_HIGH;
         }
         
-        Grain* g = &grains_[index];
         ScheduleGrain(
-            g,
+            index,
             parameters,
             t,
             buffer->size(),
@@ -119,6 +169,38 @@ class GranularSamplePlayer {
     
     // Overlap grains.
     std::fill(&out[0], &out[size * 2], 0.0f);
+    if (backend_ == GRAIN_BACKEND_SIMD) {
+      OverlapAddSimd(buffer, out, size);
+    } else {
+      OverlapAddScalar(buffer, out, size);
+    }
+    
+    // Compute normalization factor.
+    int32_t active_grains = max_num_grains_ - num_available_grains;
+    SLOPE(num_grains_, static_cast<float>(active_grains), 0.9f, 0.2f);
+
+    float gain_normalization = num_grains_ > 2.0f
+        ? fast_rsqrt_carmack(num_grains_ - 1.0f)
+        : 1.0f;  
+    float window_gain = 1.0f + 2.0f * parameters.granular.window_shape;
+    CONSTRAIN(window_gain, 1.0f, 2.0f);
+    gain_normalization *= Crossfade(
+        1.0f, window_gain, parameters.granular.overlap);
+
+    // Apply gain normalization.
+    for (size_t t = 0; t < size; ++t) {
+      ONE_POLE(gain_normalization_, gain_normalization, 0.01f)
+      *out++ *= gain_normalization_;
+      *out++ *= gain_normalization_;
+    }
+  }
+  
+ private:
+  template<Resolution resolution>
+  void OverlapAddScalar(
+      const AudioBuffer<resolution>* buffer,
+      float* out,
+      size_t size) {
     float* e = envelope_buffer_;
     for (int32_t i = 0; i < max_num_grains_; ++i) {
       Grain* g = &grains_[i];
@@ -142,32 +224,35 @@ class GranularSamplePlayer {
         }
       }
     }
-    
-    // Compute normalization factor.
-    int32_t active_grains = max_num_grains_ - num_available_grains;
-    SLOPE(num_grains_, static_cast<float>(active_grains), 0.9f, 0.2f);
-
-    float gain_normalization = num_grains_ > 2.0f
-        ? fast_rsqrt_carmack(num_grains_ - 1.0f)
-        : 1.0f;  
-    float window_gain = 1.0f + 2.0f * parameters.granular.window_shape;
-    CONSTRAIN(window_gain, 1.0f, 2.0f);
-    gain_normalization *= Crossfade(
-        1.0f, window_gain, parameters.granular.overlap);
-
-    // Apply gain normalization.
-    for (size_t t = 0; t < size; ++t) {
-      ONE_POLE(gain_normalization_, gain_normalization, 0.01f)
-      *out++ *= gain_normalization_;
-      *out++ *= gain_normalization_;
+  }
+  
+  template<Resolution resolution>
+  void OverlapAddSimd(
+      const AudioBuffer<resolution>* buffer,
+      float* out,
+      size_t size) {
+#ifdef CLOUDS_GRAIN_BANK
+    if (num_channels_ == 1) {
+      bank_.OverlapAdd<1>(buffer, max_num_grains_, out, size);
+    } else {
+      bank_.OverlapAdd<2>(buffer, max_num_grains_, out, size);
     }
+#endif  // CLOUDS_GRAIN_BANK
+  }
+  
+  inline bool grain_active(int32_t index) {
+#ifdef CLOUDS_GRAIN_BANK
+    if (backend_ == GRAIN_BACKEND_SIMD) {
+      return bank_.active(index);
+    }
+#endif  // CLOUDS_GRAIN_BANK
+    return grains_[index].active();
   }
   
- private:
   int32_t FillAvailableGrainsList() {
     int32_t num_available_grains = 0;
     for (int32_t i = 0; i < max_num_grains_; ++i) {
-      if (!grains_[i].active()) {
+      if (!grain_active(i)) {
         available_grains_[num_available_grains] = i;
         ++num_available_grains;
       }
@@ -176,7 +261,7 @@ class GranularSamplePlayer {
   }
   
   void ScheduleGrain(
-      Grain* grain,
+      int32_t index,
       const Parameters& parameters,
       int32_t pre_delay,
       int32_t buffer_size,
@@ -188,7 +273,7 @@ class GranularSamplePlayer {
     float grain_size = Interpolate(lut_grain_size, parameters.size, 256.0f);
     float pitch_ratio = SemitonesToRatio(pitch);
     float inv_pitch_ratio = SemitonesToRatio(-pitch);
-    float pan = 0.5f + parameters.stereo_spread * (Random::GetFloat() - 0.5f);
+    float pan = 0.5f + parameters.stereo_spread * (random_.GetFloat() - 0.5f);
     float gain_l, gain_r;
     if (num_channels_ == 1) {
       gain_l = Interpolate(lut_sin, pan, 256.0f);
@@ -207,8 +292,9 @@ class GranularSamplePlayer {
       // The grain's play-head moves faster than the buffer record-head.
       // we must make sure that the grain will not consume too much data.
       // In some situations, it might be necessary to reduce the size of the
-      // grain.
-      grain_size = std::min(grain_size, buffer_size * 0.25f * inv_pitch_ratio);
+      // grain. With a very large buffer, the grain's phase sets the limit.
+      float max_extent = std::min(buffer_size * 0.25f, kMaxGrainExtent);
+      grain_size = std::min(grain_size, max_extent * inv_pitch_ratio);
     }
 
     float eaten_by_play_head = grain_size * pitch_ratio;
@@ -220,9 +306,35 @@ class GranularSamplePlayer {
     available -= eaten_by_recording_head;
 
     int32_t size = static_cast<int32_t>(grain_size) & ~1;
-    int32_t start = buffer_head - static_cast<int32_t>(
-        position * available + eaten_by_play_head);
-    grain->Start(
+    int32_t start = buffer_head;
+    if (buffer_size <= kMaxSinglePrecisionBufferSize) {
+      start -= static_cast<int32_t>(position * available + eaten_by_play_head);
+    } else {
+      // Long buffers: the start is too far behind the head to be computed in
+      // single precision.
+      double available = static_cast<double>(buffer_size);
+      available -= eaten_by_play_head;
+      available -= eaten_by_recording_head;
+      start -= static_cast<int32_t>(position * available + eaten_by_play_head);
+    }
+    ONE_POLE(grain_size_hint_, grain_size, 0.1f);
+    
+#ifdef CLOUDS_GRAIN_BANK
+    if (backend_ == GRAIN_BACKEND_SIMD) {
+      bank_.Start(
+          index,
+          pre_delay,
+          buffer_size,
+          start,
+          size,
+          pitch_ratio,
+          window_shape,
+          gain_l,
+          gain_r);
+      return;
+    }
+#endif  // CLOUDS_GRAIN_BANK
+    grains_[index].Start(
         pre_delay,
         buffer_size,
         start,
@@ -232,9 +344,11 @@ class GranularSamplePlayer {
         gain_l,
         gain_r,
         quality);
-    ONE_POLE(grain_size_hint_, grain_size, 0.1f);
   }
   
+  RandomGenerator random_;
+  GrainBackend backend_;
+  int32_t requested_num_grains_;
   int32_t max_num_grains_;
   int32_t num_midfi_grains_;
   int32_t num_channels_;
@@ -245,7 +359,10 @@ class GranularSamplePlayer {
   float grain_rate_phasor_;
   
   Grain grains_[kMaxNumGrains];
-  int32_t available_grains_[kMaxNumGrains];
+#ifdef CLOUDS_GRAIN_BANK
+  GrainBank bank_;
+#endif  // CLOUDS_GRAIN_BANK
+  int32_t available_grains_[kMaxNumPlayerGrains];
   float envelope_buffer_[kMaxBlockSize];
   
   DISALLOW_COPY_AND_ASSIGN(GranularSamplePlayer);
@@ -71,6 +71,19 @@ class LoopingSamplePlayer {
       const AudioBuffer<resolution>* buffer,
       const Parameters& parameters,
       float* out, size_t size) {
+    if (buffer->size() <= kMaxSinglePrecisionBufferSize) {
+      PlayInternal<resolution, float>(buffer, parameters, out, size);
+    } else {
+      PlayInternal<resolution, double>(buffer, parameters, out, size);
+    }
+  }
+  
+ private:
+  template<Resolution resolution, typename T>
+  void PlayInternal(
+      const AudioBuffer<resolution>* buffer,
+      const Parameters& parameters,
+      float* out, size_t size) {
       
     int32_t max_delay = buffer->size() - kCrossfadeDuration;
     tap_delay_counter_ += size;
@@ -86,92 +99,114 @@ class LoopingSamplePlayer {
       loop_reset_ = phase_;
       phase_ = 0.0f;
     }
+    
+    T phase = phase_;
+    T current_delay = current_delay_;
+    T loop_point = loop_point_;
+    T loop_duration = loop_duration_;
+    T tail_start = tail_start_;
+    T loop_reset = loop_reset_;
 
     if (!parameters.freeze) {
       while (size--) {
-        float target_delay = parameters.position * max_delay;
+        T target_delay = static_cast<T>(parameters.position) * max_delay;
         if (synchronized_) {
           target_delay = tap_delay_;
         }
-        float error = (target_delay - current_delay_);
-        float delay = current_delay_ + 0.00005f * error;
-        current_delay_ = delay;
-        int32_t delay_int = (buffer->head() - 4 - size + buffer->size()) << 12;
-        delay_int -= static_cast<int32_t>(delay * 4096.0f);
+        T error = (target_delay - current_delay);
+        T delay = current_delay + static_cast<T>(0.00005f) * error;
+        current_delay = delay;
+        int32_t integral;
+        uint16_t fractional;
+        ComputePosition(
+            buffer->head() - 4 - static_cast<int32_t>(size) + buffer->size(),
+            delay,
+            &integral,
+            &fractional);
         
-        float l = buffer[0].ReadHermite((delay_int >> 12), delay_int << 4);
+        float l = buffer[0].ReadHermite(integral, fractional);
         if (num_channels_ == 1) {
           *out++ = l;
           *out++ = l;
         } else if (num_channels_ == 2) {
-          float r = buffer[1].ReadHermite((delay_int >> 12), delay_int << 4);
+          float r = buffer[1].ReadHermite(integral, fractional);
           *out++ = l;
           *out++ = r;
         }
       }
-      phase_ = 0.0f;
+      phase = 0.0f;
     } else {
-      float loop_point = parameters.position * max_delay * 15.0f / 16.0f;
-      loop_point += kCrossfadeDuration;
+      T target_loop_point = static_cast<T>(parameters.position) * max_delay *
+          static_cast<T>(15.0f) / static_cast<T>(16.0f);
+      target_loop_point += kCrossfadeDuration;
       float d = parameters.size;
-      float loop_duration = (0.01f + 0.99f * d * d * d) * max_delay;
+      T target_loop_duration = static_cast<T>(0.01f + 0.99f * d * d * d) *
+          max_delay;
       if (synchronized_) {
-        loop_duration = tap_delay_;
+        target_loop_duration = tap_delay_;
       }
-      if (loop_point + loop_duration >= max_delay) {
-        loop_point = max_delay - loop_duration;
+      if (target_loop_point + target_loop_duration >= max_delay) {
+        target_loop_point = max_delay - target_loop_duration;
       }
-      float phase_increment = synchronized_
+      T phase_increment = synchronized_
           ? 1.0f
           : SemitonesToRatio(parameters.pitch);
       
       while (size--) {
-        if (phase_ >= loop_duration_ || phase_ == 0.0f) {
-          if (phase_ >= loop_duration_) {
-            loop_reset_ = loop_duration_;
+        if (phase >= loop_duration || phase == 0.0f) {
+          if (phase >= loop_duration) {
+            loop_reset = loop_duration;
           }
-          if (loop_reset_ >= loop_duration_) {
-            loop_reset_ = loop_duration_;
+          if (loop_reset >= loop_duration) {
+            loop_reset = loop_duration;
           }
-          tail_start_ = loop_duration_ - loop_reset_ + loop_point_;
-          phase_ = 0.0f;
+          tail_start = loop_duration - loop_reset + loop_point;
+          phase = 0.0f;
           tail_duration_ = std::min(
               kCrossfadeDuration,
-              kCrossfadeDuration * phase_increment);
-          loop_point_ = loop_point;
-          loop_duration_ = loop_duration;
+              kCrossfadeDuration * static_cast<float>(phase_increment));
+          loop_point = target_loop_point;
+          loop_duration = target_loop_duration;
         }
-        phase_ += phase_increment;
+        phase += phase_increment;
         
         float gain = 1.0f;
         if (tail_duration_ != 0.0f) {
-          gain = phase_ / tail_duration_;
+          gain = static_cast<float>(phase) / tail_duration_;
           CONSTRAIN(gain, 0.0f, 1.0f);
         }
-        int32_t delay_int = (buffer->head() - 4 + buffer->size()) << 12;
-        int32_t position = delay_int - static_cast<int32_t>(
-              (loop_duration_ - phase_ + loop_point_) * 4096.0f);
-        float l = buffer[0].ReadHermite((position >> 12), position << 4);
+        int32_t origin = buffer->head() - 4 + buffer->size();
+        int32_t integral;
+        uint16_t fractional;
+        ComputePosition(
+            origin,
+            loop_duration - phase + loop_point,
+            &integral,
+            &fractional);
+        float l = buffer[0].ReadHermite(integral, fractional);
         if (num_channels_ == 1) {
           out[0] = l * gain;
           out[1] = l * gain;
         } else if (num_channels_ == 2) {
-          float r = buffer[1].ReadHermite((position >> 12), position << 4);
+          float r = buffer[1].ReadHermite(integral, fractional);
           out[0] = l * gain;
           out[1] = r * gain;
         }
         
         if (gain != 1.0f) {
           gain = 1.0f - gain;
-          int32_t position = delay_int - static_cast<int32_t>(
-                (-phase_ + tail_start_) * 4096.0f);
+          ComputePosition(
+              origin,
+              -phase + tail_start,
+              &integral,
+              &fractional);
         
-          float l = buffer[0].ReadHermite((position >> 12), position << 4);
+          float l = buffer[0].ReadHermite(integral, fractional);
           if (num_channels_ == 1) {
             out[0] += l * gain;
             out[1] += l * gain;
           } else if (num_channels_ == 2) {
-            float r = buffer[1].ReadHermite((position >> 12), position << 4);
+            float r = buffer[1].ReadHermite(integral, fractional);
             out[0] += l * gain;
             out[1] += r * gain;
           }
@@ -179,17 +214,46 @@ class LoopingSamplePlayer {
         out += 2;
       }
     }
+    phase_ = phase;
+    current_delay_ = current_delay;
+    loop_point_ = loop_point;
+    loop_duration_ = loop_duration;
+    tail_start_ = tail_start;
+    loop_reset_ = loop_reset;
   }
   
- private:
-  float phase_;
-  float current_delay_;
+  // Position at a given delay (in samples) behind origin. The integral and
+  // fractional parts of the delay are converted separately: a single 20.12
+  // fixed point position would overflow for buffers longer than 2^19 samples.
+  template<typename T>
+  static inline void ComputePosition(
+      int32_t origin,
+      T delay,
+      int32_t* integral,
+      uint16_t* fractional) {
+    int32_t delay_integral = static_cast<int32_t>(delay);
+    int32_t delay_fractional = static_cast<int32_t>(
+        (delay - static_cast<T>(delay_integral)) * static_cast<T>(4096.0f));
+    int32_t position_integral = origin - delay_integral;
+    int32_t position_fractional = -delay_fractional;
+    if (position_fractional < 0) {
+      position_fractional += 4096;
+      --position_integral;
+    }
+    *integral = position_integral;
+    *fractional = static_cast<uint16_t>(position_fractional << 4);
+  }
+  
+  // Kept in double precision so that the state survives a switch between the
+  // single and double precision code paths.
+  double phase_;
+  double current_delay_;
 
-  float loop_point_;
-  float loop_duration_;
-  float tail_start_;
+  double loop_point_;
+  double loop_duration_;
+  double tail_start_;
   float tail_duration_;
-  float loop_reset_;
+  double loop_reset_;
   
   bool synchronized_;
   
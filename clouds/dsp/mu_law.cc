@@ -28,6 +28,10 @@
 
 #include "clouds/dsp/mu_law.h"
 
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+
 namespace clouds {
 
 /* extern */
@@ -66,4 +70,54 @@ int16_t lut_ulaw[256] = {
       56,     48,     40,     32,     24,     16,      8,      0
 };
 
+#if defined(__SSE2__)
+
+// Encodes 8 samples. Once offset, the magnitude of a sample is between 33 and
+// 8192: converted to a float, its exponent gives the segment number (+5), and
+// the top 4 bits of its mantissa the bits following the leading one.
+static inline __m128i Lin2MuLawSimd(__m128i pcm) {
+  pcm = _mm_srai_epi16(pcm, 2);
+  __m128i sign = _mm_srai_epi16(pcm, 15);
+  __m128i magnitude = _mm_sub_epi16(_mm_xor_si128(pcm, sign), sign);
+  magnitude = _mm_min_epi16(magnitude, _mm_set1_epi16(8159));
+  magnitude = _mm_add_epi16(magnitude, _mm_set1_epi16(0x84 >> 2));
+  
+  __m128i zero = _mm_setzero_si128();
+  __m128i lo = _mm_castps_si128(
+      _mm_cvtepi32_ps(_mm_unpacklo_epi16(magnitude, zero)));
+  __m128i hi = _mm_castps_si128(
+      _mm_cvtepi32_ps(_mm_unpackhi_epi16(magnitude, zero)));
+  __m128i uval = _mm_packs_epi32(
+      _mm_srli_epi32(lo, 19),
+      _mm_srli_epi32(hi, 19));
+  uval = _mm_sub_epi16(uval, _mm_set1_epi16((127 + 5) << 4));
+  
+  // Segment 8 (full scale) is clipped to the top of segment 7.
+  uval = _mm_min_epi16(uval, _mm_set1_epi16(0x7f));
+  __m128i mask = _mm_xor_si128(
+      _mm_set1_epi16(0xff),
+      _mm_and_si128(sign, _mm_set1_epi16(0x80)));
+  return _mm_xor_si128(uval, mask);
+}
+
+#endif  // __SSE2__
+
+void Lin2MuLaw(const int16_t* in, uint8_t* out, size_t size) {
+#if defined(__SSE2__)
+  while (size >= 16) {
+    __m128i a = Lin2MuLawSimd(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+    __m128i b = Lin2MuLawSimd(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 8)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(a, b));
+    in += 16;
+    out += 16;
+    size -= 16;
+  }
+#endif  // __SSE2__
+  while (size--) {
+    *out++ = Lin2MuLaw(*in++);
+  }
+}
+
 }  // namespace clouds
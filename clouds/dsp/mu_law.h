@@ -78,6 +78,10 @@ inline unsigned char Lin2MuLaw(int16_t pcm_val) {
   }
 }
 
+// Block version of Lin2MuLaw, vectorized with SSE2 when available - with the
+// same results. Decoding is already a single table lookup.
+void Lin2MuLaw(const int16_t* in, uint8_t* out, size_t size);
+
 }  // namespace clouds
 
 #endif  // CLOUDS_DSP_MU_LAW_H_
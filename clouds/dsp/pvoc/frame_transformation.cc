@@ -32,10 +32,10 @@
 
 #include "stmlib/dsp/atan.h"
 #include "stmlib/dsp/units.h"
-#include "stmlib/utils/random.h"
 
 #include "clouds/dsp/frame.h"
 #include "clouds/dsp/parameters.h"
+#include "clouds/dsp/simd.h"
 
 namespace clouds {
 
@@ -45,18 +45,30 @@ using namespace stmlib;
 void FrameTransformation::Init(
     float* buffer,
     int32_t fft_size,
-    int32_t num_textures) {
+    int32_t num_textures,
+    PhaseVocoderPrecision precision,
+    uint32_t random_seed) {
   fft_size_ = fft_size;
   size_ = (fft_size >> 1) - kHighFrequencyTruncation;
+  precision_ = precision;
   
   for (int32_t i = 0; i < num_textures; ++i) {
     textures_[i] = &buffer[i * size_];
   }
-  phases_ = static_cast<uint16_t*>((void*)(textures_[num_textures - 1]));
-  num_textures_ = num_textures - 1;  // Last texture is used for storing phases.
-  phases_delta_ = phases_ + size_;
+  if (precision_ == PHASE_VOCODER_PRECISION_HIGH) {
+    float_phases_ = textures_[num_textures - 2];
+    float_phases_delta_ = textures_[num_textures - 1];
+    fill(&float_phases_[0], &float_phases_[size_], 0.0f);
+    fill(&float_phases_delta_[0], &float_phases_delta_[size_], 0.0f);
+    num_textures_ = num_textures - 2;
+  } else {
+    phases_ = static_cast<uint16_t*>((void*)(textures_[num_textures - 1]));
+    num_textures_ = num_textures - 1;  // Last texture is used for storing phases.
+    phases_delta_ = phases_ + size_;
+  }
 
   glitch_algorithm_ = 0;
+  random_.Init(random_seed);
   Reset();
 }
 
@@ -77,8 +89,13 @@ void FrameTransformation::Process(
   bool glitch = parameters.gate;
   float pitch_ratio = SemitonesToRatio(parameters.pitch);
   
+  bool high_precision = precision_ == PHASE_VOCODER_PRECISION_HIGH;
   if (!freeze) {
-    RectangularToPolar(fft_out);
+    if (high_precision) {
+      RectangularToPolarHighPrecision(fft_out);
+    } else {
+      RectangularToPolar(fft_out);
+    }
     StoreMagnitudes(
         fft_out,
         parameters.position,
@@ -92,13 +109,21 @@ void FrameTransformation::Process(
     AddGlitch(ifft_in);
   }
   QuantizeMagnitudes(ifft_in, parameters.spectral.quantization);
-  SetPhases(ifft_in, parameters.spectral.phase_randomization, pitch_ratio);
-  PolarToRectangular(ifft_in);
+  if (high_precision) {
+    SetPhasesHighPrecision(
+        ifft_in,
+        parameters.spectral.phase_randomization,
+        pitch_ratio);
+    PolarToRectangularHighPrecision(ifft_in);
+  } else {
+    SetPhases(ifft_in, parameters.spectral.phase_randomization, pitch_ratio);
+    PolarToRectangular(ifft_in);
+  }
 
   if (!glitch) {
     // Decide on which glitch algorithm will be used next time... if glitch
     // is enabled on the next frame!
-    glitch_algorithm_ = stmlib::Random::GetSample() & 3;
+    glitch_algorithm_ = random_.GetSample() & 3;
   }
 
   ifft_in[0] = 0.0f;
@@ -133,7 +158,7 @@ void FrameTransformation::SetPhases(
   int32_t amount = static_cast<int32_t>(r * 32768.0f);
   for (int32_t i = 0; i < size_; ++i) {
     synthesis_phase[i] += \
-        static_cast<int32_t>(stmlib::Random::GetSample()) * amount >> 14;
+        static_cast<int32_t>(random_.GetSample()) * amount >> 14;
   }
 }
 
@@ -150,6 +175,64 @@ void FrameTransformation::PolarToRectangular(float* fft_data) {
   }
 }
 
+void FrameTransformation::RectangularToPolarHighPrecision(float* fft_data) {
+  float* real = &fft_data[0];
+  float* imag = &fft_data[fft_size_ >> 1];
+  float* magnitude = &fft_data[0];
+  // size_ is a multiple of kSimdWidth, and bin 0 is always null.
+  for (int32_t i = 0; i < size_; i += kSimdWidth) {
+    SimdFloat re = SimdFloat::Load(&real[i]);
+    SimdFloat im = SimdFloat::Load(&imag[i]);
+    SimdFloat angle = Atan2(im, re);
+    SimdFloat::Sqrt(re * re + im * im).Store(&magnitude[i]);
+    WrapPhase(angle - SimdFloat::Load(&float_phases_[i])).Store(
+        &float_phases_delta_[i]);
+    angle.Store(&float_phases_[i]);
+  }
+}
+
+void FrameTransformation::SetPhasesHighPrecision(
+    float* destination,
+    float phase_randomization,
+    float pitch_ratio) {
+  float* synthesis_phase = &destination[fft_size_ >> 1];
+  const SimdFloat ratio(pitch_ratio);
+  for (int32_t i = 0; i < size_; i += kSimdWidth) {
+    SimdFloat phase = SimdFloat::Load(&float_phases_[i]);
+    phase.Store(&synthesis_phase[i]);
+    phase = phase + SimdFloat::Load(&float_phases_delta_[i]) * ratio;
+    WrapPhase(phase).Store(&float_phases_[i]);
+  }
+  float r = phase_randomization;
+  r = (r - 0.05f) * 1.06f;
+  CONSTRAIN(r, 0.0f, 1.0f);
+  r *= r;
+  // Same scale as SetPhases(): up to +/- 1 turn.
+  float amount = r / 32768.0f;
+  for (int32_t i = 0; i < size_; ++i) {
+    synthesis_phase[i] += \
+        static_cast<float>(random_.GetSample()) * amount;
+  }
+}
+
+void FrameTransformation::PolarToRectangularHighPrecision(float* fft_data) {
+  float* real = &fft_data[0];
+  float* imag = &fft_data[fft_size_ >> 1];
+  float* magnitude = &fft_data[0];
+  float* angle = &fft_data[fft_size_ >> 1];
+  for (int32_t i = 0; i < size_; i += kSimdWidth) {
+    SimdFloat m = SimdFloat::Load(&magnitude[i]);
+    SimdFloat sine;
+    SimdFloat cosine;
+    SinCos(WrapPhase(SimdFloat::Load(&angle[i])), &sine, &cosine);
+    (m * cosine).Store(&real[i]);
+    (m * sine).Store(&imag[i]);
+  }
+  for (int32_t i = size_; i < fft_size_ >> 1; ++i) {
+    real[i] = imag[i] = 0.0f;
+  }
+}
+
 void FrameTransformation::AddGlitch(float* xf_polar) {
   float* x = xf_polar;
   switch (glitch_algorithm_) {
@@ -159,7 +242,7 @@ void FrameTransformation::AddGlitch(float* xf_polar) {
         // Create trails
         float held = 0.0;
         for (int32_t i = 0; i < size_; ++i) {
-          if ((stmlib::Random::GetSample() & 15) == 0) {
+          if ((random_.GetSample() & 15) == 0) {
             held = x[i];
           }
           x[i] = held;
@@ -171,7 +254,7 @@ void FrameTransformation::AddGlitch(float* xf_polar) {
     case 1:
       // Spectral shift up with aliasing.
       {
-        float factor = 1.0f + (stmlib::Random::GetSample() & 7) / 4.0f;
+        float factor = 1.0f + (random_.GetSample() & 7) / 4.0f;
         float source = 0.0f;
         for (int32_t i = 0; i < size_; ++i) {
           source += factor;
@@ -193,7 +276,7 @@ void FrameTransformation::AddGlitch(float* xf_polar) {
       {
         // Nasty high-pass
         for (int32_t i = 0; i < size_; ++i) {
-          uint32_t random = stmlib::Random::GetSample() & 15;
+          uint32_t random = random_.GetSample() & 15;
           if (random == 0) {
             x[i] *= static_cast<float>(i) / 16.0f;
           }
@@ -339,7 +422,7 @@ void FrameTransformation::StoreMagnitudes(
     uint16_t threshold = feedback * 65535.0f;
     for (int32_t i = 0; i < size_; ++i) {
       float x = *xf_polar++;
-      float gain = static_cast<uint16_t>(Random::GetSample()) <= threshold
+      float gain = static_cast<uint16_t>(random_.GetSample()) <= threshold
           ? 1.0f : 0.0f;
       a[i] = Crossfade(a[i], x, gain_a * gain);
       b[i] = Crossfade(b[i], x, gain_b * gain);
@@ -31,6 +31,7 @@
 
 #include "stmlib/stmlib.h"
 
+#include "clouds/dsp/random_generator.h"
 #include "clouds/dsp/pvoc/stft.h"
 
 #include "clouds/resources.h"
@@ -38,8 +39,18 @@
 namespace clouds {
 
 const int32_t kMaxNumTextures = 7;
+const int32_t kMaxNumHighPrecisionTextures = 18;
 const int32_t kHighFrequencyTruncation = 16;
 
+enum PhaseVocoderPrecision {
+  // 16-bit phases, converted with lookup tables. The last texture holds the
+  // phases.
+  PHASE_VOCODER_PRECISION_STANDARD,
+  // Float phases, converted with vectorized polynomials. The last two
+  // textures hold the phases.
+  PHASE_VOCODER_PRECISION_HIGH
+};
+
 struct Parameters;
 
 class FrameTransformation {
@@ -47,7 +58,14 @@ class FrameTransformation {
   FrameTransformation() { }
   ~FrameTransformation() { }
   
-  void Init(float* buffer, int32_t fft_size, int32_t num_textures);
+  // Each channel gets its own random seed, so that the glitches of the two
+  // channels are not correlated.
+  void Init(
+      float* buffer,
+      int32_t fft_size,
+      int32_t num_textures,
+      PhaseVocoderPrecision precision,
+      uint32_t random_seed);
   void Reset();
   
   void Process(
@@ -58,6 +76,12 @@ class FrameTransformation {
  private:
   void RectangularToPolar(float* fft_data);
   void PolarToRectangular(float* fft_data);
+  void RectangularToPolarHighPrecision(float* fft_data);
+  void PolarToRectangularHighPrecision(float* fft_data);
+  void SetPhasesHighPrecision(
+      float* destination,
+      float diffusion,
+      float pitch_ratio);
   void AddGlitch(float* xf_polar);
   void ShiftMagnitudes(
       float* source,
@@ -82,15 +106,21 @@ class FrameTransformation {
   int32_t fft_size_;
   int32_t num_textures_;
   int32_t size_;
+  PhaseVocoderPrecision precision_;
   
   // Magnitude buffers.
-  float* textures_[kMaxNumTextures];
+  float* textures_[kMaxNumHighPrecisionTextures];
   
   // Original phase and phase unrolling buffers.
   uint16_t* phases_;
   uint16_t* phases_delta_;
+  
+  // Same, in turns, for the high precision profile.
+  float* float_phases_;
+  float* float_phases_delta_;
 
   int8_t glitch_algorithm_;
+  RandomGenerator random_;
   
   DISALLOW_COPY_AND_ASSIGN(FrameTransformation);
 };
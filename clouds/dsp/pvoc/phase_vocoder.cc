@@ -29,6 +29,7 @@
 #include "clouds/dsp/pvoc/phase_vocoder.h"
 
 #include <algorithm>
+#include <cmath>
 
 #include "stmlib/utils/buffer_allocator.h"
 
@@ -44,11 +45,27 @@ void PhaseVocoder::Init(
     size_t largest_fft_size,
     int32_t num_channels,
     int32_t resolution,
-    float sample_rate) {
+    float sample_rate,
+    PhaseVocoderPrecision precision) {
   num_channels_ = num_channels;
 
   size_t fft_size = largest_fft_size;
   size_t hop_ratio = 4;
+  size_t num_textures = kMaxNumTextures;
+  
+  if (precision == PHASE_VOCODER_PRECISION_HIGH) {
+    size_t high_precision_fft_size = HighPrecisionFftSize(
+        buffer_size,
+        largest_fft_size);
+    if (high_precision_fft_size) {
+      fft_size = high_precision_fft_size;
+      num_textures = kMaxNumHighPrecisionTextures;
+    } else {
+      precision = PHASE_VOCODER_PRECISION_STANDARD;
+    }
+  }
+  fft_size_ = fft_size;
+  precision_ = precision;
   
   BufferAllocator allocator_0(buffer[0], buffer_size[0]);
   BufferAllocator allocator_1(buffer[1], buffer_size[1]);
@@ -56,7 +73,16 @@ void PhaseVocoder::Init(
   float* fft_buffer = allocator[0]->Allocate<float>(fft_size);
   float* ifft_buffer = allocator[num_channels_ - 1]->Allocate<float>(fft_size);
   
-  size_t num_textures = kMaxNumTextures;
+  // The window LUT is too short for the larger FFT sizes.
+  const float* window = large_window_lut;
+  size_t window_size = largest_fft_size;
+  if (precision == PHASE_VOCODER_PRECISION_HIGH) {
+    float* computed_window = allocator[0]->Allocate<float>(fft_size);
+    ComputeWindow(computed_window, fft_size);
+    window = computed_window;
+    window_size = fft_size;
+  }
+  
   size_t texture_size = (fft_size >> 1) - kHighFrequencyTruncation;
   for (int32_t i = 0; i < num_channels_; ++i) {
     short* ana_syn_buffer = allocator[i]->Allocate<short>(
@@ -71,14 +97,56 @@ void PhaseVocoder::Init(
         fft_size / hop_ratio,
         fft_buffer,
         ifft_buffer,
-        large_window_lut,
+        window,
+        window_size,
         ana_syn_buffer,
         &frame_transformation_[i]);
   }
   for (int32_t i = 0; i < num_channels_; ++i) {
     float* texture_buffer = allocator[i]->Allocate<float>(
         num_textures * texture_size);
-    frame_transformation_[i].Init(texture_buffer, fft_size, num_textures);
+    frame_transformation_[i].Init(
+        texture_buffer,
+        fft_size,
+        num_textures,
+        precision,
+        kDefaultRandomSeed + i);
+  }
+}
+
+size_t PhaseVocoder::HighPrecisionFftSize(
+    const size_t* buffer_size,
+    size_t smallest_fft_size) const {
+  // Largest size leaving room for 2 textures of magnitudes and 2 of phases.
+  for (size_t fft_size = kMaxFftSize; fft_size >= smallest_fft_size;
+       fft_size >>= 1) {
+    size_t texture_size = ((fft_size >> 1) - kHighFrequencyTruncation) * \
+        sizeof(float);
+    size_t channel_size = (fft_size + (fft_size >> 1)) * 2 * sizeof(short) + \
+        4 * texture_size;
+    size_t size[2] = { channel_size, num_channels_ == 2 ? channel_size : 0 };
+    size[0] += 2 * fft_size * sizeof(float);  // FFT input and window.
+    size[num_channels_ - 1] += fft_size * sizeof(float);  // IFFT output.
+    if (size[0] <= buffer_size[0] && size[1] <= buffer_size[1]) {
+      return fft_size;
+    }
+  }
+  return 0;
+}
+
+/* static */
+void PhaseVocoder::ComputeWindow(float* window, size_t size) {
+  // Same as lut_sine_window_4096: a (1 - x^2)^1.25 window, normalized for
+  // perfect reconstruction with an overlap of 2.
+  for (size_t i = 0; i < size; ++i) {
+    window[i] = powf(1.0f - powf(2.0f * i / size - 1.0f, 2.0f), 1.25f);
+  }
+  for (size_t i = 0; i < size / 2; ++i) {
+    float a = window[i];
+    float b = window[i + size / 2];
+    float compensation = 1.0f / sqrtf(a * a + b * b);
+    window[i] *= compensation;
+    window[i + size / 2] *= compensation;
   }
 }
 
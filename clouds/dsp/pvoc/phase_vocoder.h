@@ -51,7 +51,8 @@ class PhaseVocoder {
       const float* large_window_lut, size_t largest_fft_size,
       int32_t num_channels,
       int32_t resolution,
-      float sample_rate);
+      float sample_rate,
+      PhaseVocoderPrecision precision);
 
   void Process(
       const Parameters& parameters,
@@ -60,13 +61,32 @@ class PhaseVocoder {
       size_t size);
   void Buffer();
   
+  inline bool pending() const {
+    return stft_[0].pending() || (num_channels_ == 2 && stft_[1].pending());
+  }
+  
+  inline int32_t num_channels() const { return num_channels_; }
+  inline STFT* mutable_stft(int32_t channel) { return &stft_[channel]; }
+  
+  // The profile and FFT size picked by Init(). The high precision profile
+  // uses the largest FFT, up to kMaxFftSize, for which the buffers have room.
+  inline PhaseVocoderPrecision precision() const { return precision_; }
+  inline size_t fft_size() const { return fft_size_; }
+  
  private:
+  size_t HighPrecisionFftSize(
+      const size_t* buffer_size,
+      size_t smallest_fft_size) const;
+  static void ComputeWindow(float* window, size_t size);
+  
   FFT fft_;
   
   STFT stft_[2];
   FrameTransformation frame_transformation_[2];
 
   int32_t num_channels_;
+  PhaseVocoderPrecision precision_;
+  size_t fft_size_;
   
   DISALLOW_COPY_AND_ASSIGN(PhaseVocoder);
 };
@@ -0,0 +1,442 @@
+// Copyright 2014 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Real FFT for hosts with SSE. Has the same interface, data layout and scaling
+// as stmlib::ShyFFT, so that it can be used by STFT in its place:
+//
+// - Direct() takes N real samples, and returns the real part of bins 0 to N/2
+//   followed by the imaginary part of bins 1 to N/2 - 1.
+// - Inverse() takes the same layout, and returns N times the signal.
+// - The input buffer is used as scratch memory, and is lost.
+//
+// The N-point real FFT is computed as a N/2-point complex FFT of the even and
+// odd samples, followed by a split pass. The complex FFT is a Stockham
+// (self-sorting) radix-4 FFT, with a final radix-2 pass when needed. Data is
+// stored as separate arrays of real and imaginary parts, and each pass is
+// vectorized 4 butterflies at a time. N must be at least 32.
+
+#ifndef CLOUDS_DSP_PVOC_SIMD_FFT_H_
+#define CLOUDS_DSP_PVOC_SIMD_FFT_H_
+
+#include "stmlib/stmlib.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <xmmintrin.h>
+
+namespace clouds {
+
+template<size_t size>
+class SimdFFT {
+ public:
+  static const size_t max_size = size;
+  
+  SimdFFT() { }
+  ~SimdFFT() { }
+  
+  void Init() {
+    // Twiddles of the radix-4 passes. The pass on a sequence of length n uses
+    // n / 4 twiddles, stored at offset n / 4 - 1.
+    for (size_t n = 4; n <= size / 2; n <<= 1) {
+      for (size_t p = 0; p < n / 4; ++p) {
+        for (size_t k = 0; k < 3; ++k) {
+          double t = -2.0 * M_PI * double((k + 1) * p) / double(n);
+          pass_twiddles_[k][0][n / 4 - 1 + p] = cos(t);
+          pass_twiddles_[k][1][n / 4 - 1 + p] = sin(t);
+        }
+      }
+    }
+    
+    // Twiddles of the split pass. The pass for a N-point FFT uses N / 2
+    // twiddles, stored at offset N / 2 - 16.
+    for (size_t n = 32; n <= size; n <<= 1) {
+      for (size_t k = 0; k < n / 2; ++k) {
+        double t = 2.0 * M_PI * double(k) / double(n);
+        split_twiddles_[0][n / 2 - 16 + k] = cos(t);
+        split_twiddles_[1][n / 2 - 16 + k] = sin(t);
+      }
+    }
+  }
+  
+  inline void Direct(float* input, float* output) {
+    Direct(input, output, 0);
+  }
+  
+  inline void Inverse(float* input, float* output) {
+    Inverse(input, output, 0);
+  }
+  
+  void Direct(float* input, float* output, size_t num_passes) {
+    const size_t n = num_passes ? size_t(1) << num_passes : size;
+    const size_t m = n / 2;
+    
+    // The first pass reads the even and odd samples from the input.
+    Radix4FirstPass<true>(input, output, m);
+    float* source = output;
+    float* destination = input;
+    for (size_t length = m / 4, stride = 4; length > 1;
+         length /= 4, stride *= 4) {
+      if (length == 2) {
+        Radix2Pass<false>(source, destination, m);
+      } else {
+        Radix4Pass<false>(source, destination, m, length, stride);
+      }
+      std::swap(source, destination);
+    }
+    SplitDirect(source, output, n);
+  }
+  
+  void Inverse(float* input, float* output, size_t num_passes) {
+    const size_t n = num_passes ? size_t(1) << num_passes : size;
+    const size_t m = n / 2;
+    
+    // The inverse complex FFT is computed with the direct FFT, by swapping the
+    // real and imaginary parts before and after. The last pass writes back
+    // the interleaved samples to the output, so the split pass must write to
+    // the buffer which gets the data after an even number of passes.
+    size_t num_complex_passes = 1;
+    for (size_t length = m / 4; length > 1; length /= 4) {
+      ++num_complex_passes;
+    }
+    float* source = num_complex_passes & 1 ? input : output;
+    float* destination = num_complex_passes & 1 ? output : input;
+    SplitInverse(input, source, n);
+    
+    Radix4FirstPass<false>(source, destination, m);
+    std::swap(source, destination);
+    for (size_t length = m / 4, stride = 4; length > 1;
+         length /= 4, stride *= 4) {
+      bool last = length <= 4;
+      if (length == 2) {
+        Radix2Pass<true>(source, destination, m);
+      } else if (last) {
+        Radix4Pass<true>(source, destination, m, length, stride);
+      } else {
+        Radix4Pass<false>(source, destination, m, length, stride);
+      }
+      std::swap(source, destination);
+    }
+  }
+  
+ private:
+  static inline void Multiply(
+      __m128 a_r, __m128 a_i,
+      __m128 b_r, __m128 b_i,
+      __m128* r, __m128* i) {
+    *r = _mm_sub_ps(_mm_mul_ps(a_r, b_r), _mm_mul_ps(a_i, b_i));
+    *i = _mm_add_ps(_mm_mul_ps(a_r, b_i), _mm_mul_ps(a_i, b_r));
+  }
+  
+  static inline __m128 Reverse(__m128 x) {
+    return _mm_shuffle_ps(x, x, _MM_SHUFFLE(0, 1, 2, 3));
+  }
+  
+  // 4 radix-4 butterflies. Inputs are overwritten by the outputs.
+  static inline void Butterfly(
+      __m128* a_r, __m128* a_i,
+      __m128* b_r, __m128* b_i,
+      __m128* c_r, __m128* c_i,
+      __m128* d_r, __m128* d_i) {
+    __m128 apc_r = _mm_add_ps(*a_r, *c_r);
+    __m128 apc_i = _mm_add_ps(*a_i, *c_i);
+    __m128 amc_r = _mm_sub_ps(*a_r, *c_r);
+    __m128 amc_i = _mm_sub_ps(*a_i, *c_i);
+    __m128 bpd_r = _mm_add_ps(*b_r, *d_r);
+    __m128 bpd_i = _mm_add_ps(*b_i, *d_i);
+    // j * (b - d)
+    __m128 jbmd_r = _mm_sub_ps(*d_i, *b_i);
+    __m128 jbmd_i = _mm_sub_ps(*b_r, *d_r);
+    *a_r = _mm_add_ps(apc_r, bpd_r);
+    *a_i = _mm_add_ps(apc_i, bpd_i);
+    *b_r = _mm_sub_ps(amc_r, jbmd_r);
+    *b_i = _mm_sub_ps(amc_i, jbmd_i);
+    *c_r = _mm_sub_ps(apc_r, bpd_r);
+    *c_i = _mm_sub_ps(apc_i, bpd_i);
+    *d_r = _mm_add_ps(amc_r, jbmd_r);
+    *d_i = _mm_add_ps(amc_i, jbmd_i);
+  }
+  
+  static inline void Store(
+      float* destination,
+      size_t m,
+      size_t index,
+      bool interleaved,
+      __m128 r,
+      __m128 i) {
+    if (interleaved) {
+      // Real and imaginary parts were swapped by the inverse FFT.
+      _mm_storeu_ps(&destination[2 * index], _mm_unpacklo_ps(i, r));
+      _mm_storeu_ps(&destination[2 * index + 4], _mm_unpackhi_ps(i, r));
+    } else {
+      _mm_storeu_ps(&destination[index], r);
+      _mm_storeu_ps(&destination[m + index], i);
+    }
+  }
+  
+  // First pass, with a stride of 1: the butterflies are vectorized across
+  // twiddles, and the outputs are transposed.
+  template<bool interleaved_input>
+  void Radix4FirstPass(const float* source, float* destination, size_t m) {
+    const size_t quarter = m / 4;
+    const float* w1_r = &pass_twiddles_[0][0][quarter - 1];
+    const float* w1_i = &pass_twiddles_[0][1][quarter - 1];
+    const float* w2_r = &pass_twiddles_[1][0][quarter - 1];
+    const float* w2_i = &pass_twiddles_[1][1][quarter - 1];
+    const float* w3_r = &pass_twiddles_[2][0][quarter - 1];
+    const float* w3_i = &pass_twiddles_[2][1][quarter - 1];
+    float* destination_r = &destination[0];
+    float* destination_i = &destination[m];
+    for (size_t p = 0; p < quarter; p += 4) {
+      __m128 x_r[4];
+      __m128 x_i[4];
+      for (size_t k = 0; k < 4; ++k) {
+        size_t index = p + k * quarter;
+        if (interleaved_input) {
+          __m128 lo = _mm_loadu_ps(&source[2 * index]);
+          __m128 hi = _mm_loadu_ps(&source[2 * index + 4]);
+          x_r[k] = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+          x_i[k] = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+        } else {
+          x_r[k] = _mm_loadu_ps(&source[index]);
+          x_i[k] = _mm_loadu_ps(&source[m + index]);
+        }
+      }
+      Butterfly(
+          &x_r[0], &x_i[0], &x_r[1], &x_i[1],
+          &x_r[2], &x_i[2], &x_r[3], &x_i[3]);
+      Multiply(
+          x_r[1], x_i[1],
+          _mm_loadu_ps(&w1_r[p]), _mm_loadu_ps(&w1_i[p]),
+          &x_r[1], &x_i[1]);
+      Multiply(
+          x_r[2], x_i[2],
+          _mm_loadu_ps(&w2_r[p]), _mm_loadu_ps(&w2_i[p]),
+          &x_r[2], &x_i[2]);
+      Multiply(
+          x_r[3], x_i[3],
+          _mm_loadu_ps(&w3_r[p]), _mm_loadu_ps(&w3_i[p]),
+          &x_r[3], &x_i[3]);
+      _MM_TRANSPOSE4_PS(x_r[0], x_r[1], x_r[2], x_r[3]);
+      _MM_TRANSPOSE4_PS(x_i[0], x_i[1], x_i[2], x_i[3]);
+      for (size_t k = 0; k < 4; ++k) {
+        _mm_storeu_ps(&destination_r[4 * (p + k)], x_r[k]);
+        _mm_storeu_ps(&destination_i[4 * (p + k)], x_i[k]);
+      }
+    }
+  }
+  
+  // Pass on sequences of the given length, interleaved with the given stride
+  // (at least 4): the butterflies are vectorized across sequences.
+  template<bool last>
+  void Radix4Pass(
+      const float* source,
+      float* destination,
+      size_t m,
+      size_t length,
+      size_t stride) {
+    const size_t quarter = length / 4;
+    const size_t offset = quarter - 1;
+    const float* source_r = &source[0];
+    const float* source_i = &source[m];
+    for (size_t p = 0; p < quarter; ++p) {
+      __m128 w1_r = _mm_set1_ps(pass_twiddles_[0][0][offset + p]);
+      __m128 w1_i = _mm_set1_ps(pass_twiddles_[0][1][offset + p]);
+      __m128 w2_r = _mm_set1_ps(pass_twiddles_[1][0][offset + p]);
+      __m128 w2_i = _mm_set1_ps(pass_twiddles_[1][1][offset + p]);
+      __m128 w3_r = _mm_set1_ps(pass_twiddles_[2][0][offset + p]);
+      __m128 w3_i = _mm_set1_ps(pass_twiddles_[2][1][offset + p]);
+      for (size_t q = 0; q < stride; q += 4) {
+        __m128 x_r[4];
+        __m128 x_i[4];
+        for (size_t k = 0; k < 4; ++k) {
+          size_t index = q + stride * (p + k * quarter);
+          x_r[k] = _mm_loadu_ps(&source_r[index]);
+          x_i[k] = _mm_loadu_ps(&source_i[index]);
+        }
+        Butterfly(
+            &x_r[0], &x_i[0], &x_r[1], &x_i[1],
+            &x_r[2], &x_i[2], &x_r[3], &x_i[3]);
+        if (!last) {
+          Multiply(x_r[1], x_i[1], w1_r, w1_i, &x_r[1], &x_i[1]);
+          Multiply(x_r[2], x_i[2], w2_r, w2_i, &x_r[2], &x_i[2]);
+          Multiply(x_r[3], x_i[3], w3_r, w3_i, &x_r[3], &x_i[3]);
+        }
+        for (size_t k = 0; k < 4; ++k) {
+          size_t index = q + stride * (4 * p + k);
+          Store(destination, m, index, last, x_r[k], x_i[k]);
+        }
+      }
+    }
+  }
+  
+  // Final radix-2 pass, when log2(m) is odd.
+  template<bool interleaved_output>
+  void Radix2Pass(const float* source, float* destination, size_t m) {
+    const size_t stride = m / 2;
+    const float* source_r = &source[0];
+    const float* source_i = &source[m];
+    for (size_t q = 0; q < stride; q += 4) {
+      __m128 a_r = _mm_loadu_ps(&source_r[q]);
+      __m128 a_i = _mm_loadu_ps(&source_i[q]);
+      __m128 b_r = _mm_loadu_ps(&source_r[q + stride]);
+      __m128 b_i = _mm_loadu_ps(&source_i[q + stride]);
+      Store(
+          destination, m, q, interleaved_output,
+          _mm_add_ps(a_r, b_r), _mm_add_ps(a_i, b_i));
+      Store(
+          destination, m, q + stride, interleaved_output,
+          _mm_sub_ps(a_r, b_r), _mm_sub_ps(a_i, b_i));
+    }
+  }
+  
+  // Computes the spectrum of the real signal from the N/2-point complex FFT
+  // of its even and odd samples. Bins k and N/2 - k are computed together,
+  // so source and destination can be the same buffer.
+  void SplitDirect(const float* source, float* destination, size_t n) {
+    const size_t m = n / 2;
+    const float* cosine = &split_twiddles_[0][m - 16];
+    const float* sine = &split_twiddles_[1][m - 16];
+    const float* z_r = &source[0];
+    const float* z_i = &source[m];
+    float* x_r = &destination[0];
+    float* x_i = &destination[m];
+    
+    float dc_r = z_r[0];
+    float dc_i = z_i[0];
+    x_r[0] = dc_r + dc_i;
+    x_r[m] = dc_r - dc_i;
+    
+    const __m128 half = _mm_set1_ps(0.5f);
+    size_t k = 1;
+    for (; k + 4 <= m / 2; k += 4) {
+      size_t mirror = m - k - 3;
+      __m128 a_r = _mm_loadu_ps(&z_r[k]);
+      __m128 a_i = _mm_loadu_ps(&z_i[k]);
+      __m128 b_r = Reverse(_mm_loadu_ps(&z_r[mirror]));
+      __m128 b_i = Reverse(_mm_loadu_ps(&z_i[mirror]));
+      __m128 c = _mm_loadu_ps(&cosine[k]);
+      __m128 s = _mm_loadu_ps(&sine[k]);
+      __m128 e_r = _mm_mul_ps(_mm_add_ps(a_r, b_r), half);
+      __m128 e_i = _mm_mul_ps(_mm_sub_ps(a_i, b_i), half);
+      __m128 d_r = _mm_mul_ps(_mm_sub_ps(a_r, b_r), half);
+      __m128 d_i = _mm_mul_ps(_mm_add_ps(a_i, b_i), half);
+      __m128 t_r = _mm_sub_ps(_mm_mul_ps(c, d_i), _mm_mul_ps(s, d_r));
+      __m128 t_i = _mm_add_ps(_mm_mul_ps(c, d_r), _mm_mul_ps(s, d_i));
+      _mm_storeu_ps(&x_r[k], _mm_add_ps(e_r, t_r));
+      _mm_storeu_ps(&x_i[k], _mm_sub_ps(e_i, t_i));
+      _mm_storeu_ps(&x_r[mirror], Reverse(_mm_sub_ps(e_r, t_r)));
+      _mm_storeu_ps(
+          &x_i[mirror],
+          Reverse(_mm_sub_ps(_mm_setzero_ps(), _mm_add_ps(e_i, t_i))));
+    }
+    for (; k <= m / 2; ++k) {
+      size_t mirror = m - k;
+      float a_r = z_r[k];
+      float a_i = z_i[k];
+      float b_r = z_r[mirror];
+      float b_i = z_i[mirror];
+      float c = cosine[k];
+      float s = sine[k];
+      float e_r = 0.5f * (a_r + b_r);
+      float e_i = 0.5f * (a_i - b_i);
+      float d_r = 0.5f * (a_r - b_r);
+      float d_i = 0.5f * (a_i + b_i);
+      float t_r = c * d_i - s * d_r;
+      float t_i = c * d_r + s * d_i;
+      x_r[k] = e_r + t_r;
+      x_i[k] = e_i - t_i;
+      x_r[mirror] = e_r - t_r;
+      x_i[mirror] = -e_i - t_i;
+    }
+  }
+  
+  // Inverse of the above, with the real and imaginary parts of the output
+  // swapped, and scaled by 2.
+  void SplitInverse(const float* source, float* destination, size_t n) {
+    const size_t m = n / 2;
+    const float* cosine = &split_twiddles_[0][m - 16];
+    const float* sine = &split_twiddles_[1][m - 16];
+    const float* x_r = &source[0];
+    const float* x_i = &source[m];
+    float* z_i = &destination[0];
+    float* z_r = &destination[m];
+    
+    float dc = x_r[0];
+    float nyquist = x_r[m];
+    z_r[0] = dc + nyquist;
+    z_i[0] = dc - nyquist;
+    
+    size_t k = 1;
+    for (; k + 4 <= m / 2; k += 4) {
+      size_t mirror = m - k - 3;
+      __m128 a_r = _mm_loadu_ps(&x_r[k]);
+      __m128 a_i = _mm_loadu_ps(&x_i[k]);
+      __m128 b_r = Reverse(_mm_loadu_ps(&x_r[mirror]));
+      __m128 b_i = Reverse(_mm_loadu_ps(&x_i[mirror]));
+      __m128 c = _mm_loadu_ps(&cosine[k]);
+      __m128 s = _mm_loadu_ps(&sine[k]);
+      __m128 e_r = _mm_add_ps(a_r, b_r);
+      __m128 e_i = _mm_sub_ps(a_i, b_i);
+      __m128 d_r = _mm_sub_ps(a_r, b_r);
+      __m128 d_i = _mm_add_ps(a_i, b_i);
+      __m128 u_r = _mm_add_ps(_mm_mul_ps(c, d_i), _mm_mul_ps(s, d_r));
+      __m128 u_i = _mm_sub_ps(_mm_mul_ps(c, d_r), _mm_mul_ps(s, d_i));
+      _mm_storeu_ps(&z_r[k], _mm_sub_ps(e_r, u_r));
+      _mm_storeu_ps(&z_i[k], _mm_add_ps(e_i, u_i));
+      _mm_storeu_ps(&z_r[mirror], Reverse(_mm_add_ps(e_r, u_r)));
+      _mm_storeu_ps(&z_i[mirror], Reverse(_mm_sub_ps(u_i, e_i)));
+    }
+    for (; k <= m / 2; ++k) {
+      size_t mirror = m - k;
+      float a_r = x_r[k];
+      float a_i = x_i[k];
+      float b_r = x_r[mirror];
+      float b_i = x_i[mirror];
+      float c = cosine[k];
+      float s = sine[k];
+      float e_r = a_r + b_r;
+      float e_i = a_i - b_i;
+      float d_r = a_r - b_r;
+      float d_i = a_i + b_i;
+      float u_r = c * d_i + s * d_r;
+      float u_i = c * d_r - s * d_i;
+      z_r[k] = e_r - u_r;
+      z_i[k] = e_i + u_i;
+      z_r[mirror] = e_r + u_r;
+      z_i[mirror] = u_i - e_i;
+    }
+  }
+  
+  float pass_twiddles_[3][2][size / 4];
+  float split_twiddles_[2][size];
+  
+  DISALLOW_COPY_AND_ASSIGN(SimdFFT);
+};
+
+}  // namespace clouds
+
+#endif  // CLOUDS_DSP_PVOC_SIMD_FFT_H_
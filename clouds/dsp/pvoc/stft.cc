@@ -45,6 +45,7 @@ void STFT::Init(
     float* fft_buffer,
     float* ifft_buffer,
     const float* window_lut,
+    size_t window_lut_size,
     short* analysis_synthesis_buffer,
     Modifier* modifier) {
   fft_size_ = fft_size;
@@ -69,7 +70,7 @@ void STFT::Init(
   ifft_out_ = fft_out_ = ifft_buffer;
   
   window_ = window_lut;
-  window_stride_ = LUT_SINE_WINDOW_4096_SIZE / fft_size;
+  window_stride_ = window_lut_size / fft_size;
   modifier_ = modifier;
   
   parameters_ = NULL;
@@ -121,7 +122,11 @@ void STFT::Buffer() {
   if (ready_ == done_) {
     return;
   }
-  
+  LoadFrame();
+  AddFrame(TransformFrame(parameters_));
+}
+
+void STFT::LoadFrame() {
   // Copy block to FFT buffer and apply window.
   size_t source_ptr = process_ptr_;
   const float* w = window_;
@@ -133,7 +138,9 @@ void STFT::Buffer() {
     }
     w += window_stride_;
   }
-  
+}
+
+const float* STFT::TransformFrame(const Parameters* parameters) {
   // Compute FFT. fft_in is lost.
 #ifdef USE_ARM_FFT
   arm_rfft_fast_f32(fft_, fft_in_, fft_out_, 0);
@@ -151,8 +158,8 @@ void STFT::Buffer() {
   }
 #endif  // USE_ARM_FFT
   // Process in the frequency domain.
-  if (modifier_ != NULL && parameters_ != NULL) {
-    modifier_->Process(*parameters_, &fft_out_[0], &ifft_in_[0]);
+  if (modifier_ != NULL && parameters != NULL) {
+    modifier_->Process(*parameters, &fft_out_[0], &ifft_in_[0]);
   } else {
     copy(&fft_out_[0], &fft_out_[fft_size_], &ifft_in_[0]);
   }
@@ -173,7 +180,10 @@ void STFT::Buffer() {
     fft_->Inverse(ifft_in_, ifft_out_);
   }
 #endif  // USE_ARM_FFT
-  
+  return ifft_out_;
+}
+
+void STFT::AddFrame(const float* frame) {
   size_t destination_ptr = process_ptr_;
 #ifdef USE_ARM_FFT
   float inverse_window_size = 1.0f / \
@@ -183,9 +193,9 @@ void STFT::Buffer() {
       float(fft_size_ * fft_size_ / hop_size_ >> 1);
 #endif  // USE_ARM_FFT
     
-  w = window_;
+  const float* w = window_;
   for (size_t i = 0; i < fft_size_; ++i) {
-    float s = ifft_out_[i] * w[0] * inverse_window_size;
+    float s = frame[i] * w[0] * inverse_window_size;
     
     int32_t x = static_cast<int32_t>(s);
     if (i < fft_size_ - hop_size_) {
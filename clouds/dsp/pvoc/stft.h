@@ -33,8 +33,17 @@
 
 // #define USE_ARM_FFT
 
-#ifdef USE_ARM_FFT
+// The FFT is chosen at build time: CMSIS' arm_rfft_fast on the hardware, and
+// otherwise any class with the interface, data layout and scaling of ShyFFT.
+// SimdFFT is used on hosts with SSE2, unless USE_SHY_FFT is defined.
+#if !defined(USE_ARM_FFT) && !defined(USE_SHY_FFT) && defined(__SSE2__)
+  #define USE_SIMD_FFT
+#endif
+
+#if defined(USE_ARM_FFT)
   #include <arm_math.h>
+#elif defined(USE_SIMD_FFT)
+  #include "clouds/dsp/pvoc/simd_fft.h"
 #else
   #include "stmlib/fft/shy_fft.h"
 #endif  // USE_ARM_FFT
@@ -43,9 +52,18 @@ namespace clouds {
 
 struct Parameters;
 
+// With a fast FFT, the high precision phase vocoder can use larger sizes.
+#if defined(CLOUDS_MAX_FFT_SIZE)
+const size_t kMaxFftSize = CLOUDS_MAX_FFT_SIZE;
+#elif defined(USE_SIMD_FFT)
+const size_t kMaxFftSize = 16384;
+#else
 const size_t kMaxFftSize = 4096;
-#ifdef USE_ARM_FFT
+#endif  // CLOUDS_MAX_FFT_SIZE
+#if defined(USE_ARM_FFT)
   typedef arm_rfft_fast_instance_f32 FFT;
+#elif defined(USE_SIMD_FFT)
+  typedef SimdFFT<kMaxFftSize> FFT;
 #else
   typedef stmlib::ShyFFT<float, kMaxFftSize, stmlib::RotationPhasor> FFT;
 #endif  // USE_ARM_FFT
@@ -66,6 +84,7 @@ class STFT {
       float* fft_buffer,
       float* ifft_buffer,
       const float* window_lut,
+      size_t window_lut_size,
       short* stft_frame_processor_buffer,
       Modifier* modifier);
 
@@ -80,6 +99,25 @@ class STFT {
 
   void Buffer();
   
+  // Buffer() split up, for hosts running the transform on another thread.
+  // LoadFrame() windows the oldest pending frame into the FFT buffer, and
+  // TransformFrame() returns the transformed frame - valid until the next
+  // call. AddFrame() overlap-adds a transformed frame, not necessarily the
+  // one just loaded, in place of the oldest pending frame. The transform
+  // only touches the FFT buffers and the modifier, not the buffers used by
+  // Process().
+  void LoadFrame();
+  const float* TransformFrame(const Parameters* parameters);
+  void AddFrame(const float* frame);
+  
+  // Frames written by Process() and not yet processed by Buffer().
+  inline bool pending() const { return ready_ != done_; }
+  
+  // The oldest pending frame must be added before the next call to Process(),
+  // which reads its output. Exact when the hop size is a multiple of the
+  // block size.
+  inline bool frame_due() const { return ready_ - done_ >= 2; }
+  
  private:
   FFT* fft_;
   size_t fft_size_;
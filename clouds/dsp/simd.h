@@ -0,0 +1,246 @@
+// Copyright 2014 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Vector code used to render several grains in lockstep (one grain per lane),
+// and by the phase vocoder. The vector type itself is plaits' SimdFloat; this
+// file adds the sample gathers and the trigonometry used by clouds.
+
+#ifndef CLOUDS_DSP_SIMD_H_
+#define CLOUDS_DSP_SIMD_H_
+
+#include "stmlib/stmlib.h"
+
+#include "clouds/dsp/mu_law.h"
+
+#include "plaits/dsp/simd.h"
+
+namespace clouds {
+
+using plaits::kSimdWidth;
+using plaits::SimdFloat;
+using plaits::Interpolate;
+
+#if defined(__AVX2__)
+
+// Decodes one mu-law byte per lane. Same method as in the SSE2 version below.
+inline SimdFloat DecodeMuLaw(__m256i u) {
+  u = _mm256_xor_si256(u, _mm256_set1_epi32(0xff));
+  __m256i segment = _mm256_and_si256(
+      _mm256_srli_epi32(u, 4),
+      _mm256_set1_epi32(7));
+  __m256i mantissa = _mm256_slli_epi32(
+      _mm256_and_si256(u, _mm256_set1_epi32(0xf)), 19);
+  __m256 a = _mm256_castsi256_ps(_mm256_or_si256(
+      _mm256_slli_epi32(
+          _mm256_add_epi32(segment, _mm256_set1_epi32(127 + 7)), 23),
+      mantissa));
+  __m256 b = _mm256_castsi256_ps(_mm256_slli_epi32(
+      _mm256_add_epi32(segment, _mm256_set1_epi32(127 + 2)), 23));
+  __m256 magnitude = _mm256_sub_ps(
+      _mm256_add_ps(a, b),
+      _mm256_set1_ps(132.0f));
+  __m256i sign = _mm256_slli_epi32(
+      _mm256_and_si256(u, _mm256_set1_epi32(0x80)), 24);
+  return _mm256_or_ps(magnitude, _mm256_castsi256_ps(sign));
+}
+
+// Loads pairs of consecutive samples: first gets samples[indices[i]] and
+// second gets samples[indices[i] + 1].
+inline void GatherInt16Pairs(
+    const int16_t* samples,
+    const int32_t* indices,
+    SimdFloat* first,
+    SimdFloat* second) {
+  __m256i x = _mm256_i32gather_epi32(
+      reinterpret_cast<const int*>(samples),
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices)),
+      2);
+  *first = _mm256_cvtepi32_ps(
+      _mm256_srai_epi32(_mm256_slli_epi32(x, 16), 16));
+  *second = _mm256_cvtepi32_ps(_mm256_srai_epi32(x, 16));
+}
+
+// Loads and decodes 4 consecutive mu-law samples: taps[k] gets
+// MuLaw2Lin(samples[indices[i] + k]) - or -0.0f for the negative zero.
+inline void GatherMuLawQuads(
+    const int8_t* samples,
+    const int32_t* indices,
+    SimdFloat* taps) {
+  __m256i x = _mm256_i32gather_epi32(
+      reinterpret_cast<const int*>(samples),
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices)),
+      1);
+  const __m256i byte_mask = _mm256_set1_epi32(0xff);
+  taps[0] = DecodeMuLaw(_mm256_and_si256(x, byte_mask));
+  taps[1] = DecodeMuLaw(_mm256_and_si256(_mm256_srli_epi32(x, 8), byte_mask));
+  taps[2] = DecodeMuLaw(_mm256_and_si256(_mm256_srli_epi32(x, 16), byte_mask));
+  taps[3] = DecodeMuLaw(_mm256_srli_epi32(x, 24));
+}
+
+#elif defined(__SSE2__)
+
+// Decodes one mu-law byte per lane. The magnitude is (8 * mantissa + 132)
+// shifted by the segment number, minus 132: 8 * mantissa + 128 shifted by
+// the segment number and 4 shifted by the segment number are built as floats
+// from their exponent and mantissa bits.
+inline SimdFloat DecodeMuLaw(__m128i u) {
+  u = _mm_xor_si128(u, _mm_set1_epi32(0xff));
+  __m128i segment = _mm_and_si128(_mm_srli_epi32(u, 4), _mm_set1_epi32(7));
+  __m128i mantissa = _mm_slli_epi32(
+      _mm_and_si128(u, _mm_set1_epi32(0xf)), 19);
+  __m128 a = _mm_castsi128_ps(_mm_or_si128(
+      _mm_slli_epi32(_mm_add_epi32(segment, _mm_set1_epi32(127 + 7)), 23),
+      mantissa));
+  __m128 b = _mm_castsi128_ps(_mm_slli_epi32(
+      _mm_add_epi32(segment, _mm_set1_epi32(127 + 2)), 23));
+  __m128 magnitude = _mm_sub_ps(_mm_add_ps(a, b), _mm_set1_ps(132.0f));
+  __m128i sign = _mm_slli_epi32(_mm_and_si128(u, _mm_set1_epi32(0x80)), 24);
+  return _mm_or_ps(magnitude, _mm_castsi128_ps(sign));
+}
+
+inline void GatherInt16Pairs(
+    const int16_t* samples,
+    const int32_t* indices,
+    SimdFloat* first,
+    SimdFloat* second) {
+  int32_t pairs[4];
+  for (size_t i = 0; i < 4; ++i) {
+    std::memcpy(&pairs[i], &samples[indices[i]], sizeof(int32_t));
+  }
+  __m128i x = _mm_set_epi32(pairs[3], pairs[2], pairs[1], pairs[0]);
+  *first = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(x, 16), 16));
+  *second = _mm_cvtepi32_ps(_mm_srai_epi32(x, 16));
+}
+
+inline void GatherMuLawQuads(
+    const int8_t* samples,
+    const int32_t* indices,
+    SimdFloat* taps) {
+  int32_t quads[4];
+  for (size_t i = 0; i < 4; ++i) {
+    std::memcpy(&quads[i], &samples[indices[i]], sizeof(int32_t));
+  }
+  __m128i x = _mm_set_epi32(quads[3], quads[2], quads[1], quads[0]);
+  const __m128i byte_mask = _mm_set1_epi32(0xff);
+  taps[0] = DecodeMuLaw(_mm_and_si128(x, byte_mask));
+  taps[1] = DecodeMuLaw(_mm_and_si128(_mm_srli_epi32(x, 8), byte_mask));
+  taps[2] = DecodeMuLaw(_mm_and_si128(_mm_srli_epi32(x, 16), byte_mask));
+  taps[3] = DecodeMuLaw(_mm_srli_epi32(x, 24));
+}
+
+#else
+
+inline void GatherInt16Pairs(
+    const int16_t* samples,
+    const int32_t* indices,
+    SimdFloat* first,
+    SimdFloat* second) {
+  float a[kSimdWidth];
+  float b[kSimdWidth];
+  for (size_t i = 0; i < kSimdWidth; ++i) {
+    a[i] = samples[indices[i]];
+    b[i] = samples[indices[i] + 1];
+  }
+  *first = SimdFloat::Load(a);
+  *second = SimdFloat::Load(b);
+}
+
+inline void GatherMuLawQuads(
+    const int8_t* samples,
+    const int32_t* indices,
+    SimdFloat* taps) {
+  float x[4][kSimdWidth];
+  for (size_t i = 0; i < kSimdWidth; ++i) {
+    for (size_t k = 0; k < 4; ++k) {
+      x[k][i] = MuLaw2Lin(samples[indices[i] + k]);
+    }
+  }
+  for (size_t k = 0; k < 4; ++k) {
+    taps[k] = SimdFloat::Load(x[k]);
+  }
+}
+
+#endif
+
+// Wraps a phase, in turns, into [0, 1).
+inline SimdFloat WrapPhase(SimdFloat phase) {
+  int32_t integral[kSimdWidth];
+  SimdFloat fractional;
+  phase.Split(integral, &fractional);
+  return SimdFloat::Select(
+      fractional < SimdFloat(0.0f),
+      fractional + SimdFloat(1.0f),
+      fractional);
+}
+
+// Sine and cosine of a phase in [0, 1) turns. The sine is approximated by a
+// polynomial on [-0.25, 0.25], and the range is folded around +/-0.25. Error
+// below 1e-6.
+inline void SinCos(SimdFloat phase, SimdFloat* sine, SimdFloat* cosine) {
+  const SimdFloat half(0.5f);
+  const SimdFloat quarter(0.25f);
+  SimdFloat x[2] = { phase, phase + quarter };
+  SimdFloat y[2];
+  for (size_t i = 0; i < 2; ++i) {
+    // Into [-0.5, 0.5), then [-0.25, 0.25].
+    SimdFloat r = SimdFloat::Select(x[i] >= half, x[i] - SimdFloat(1.0f), x[i]);
+    r = SimdFloat::Select(quarter < r, half - r, r);
+    r = SimdFloat::Select(r < SimdFloat(-0.25f), SimdFloat(-0.5f) - r, r);
+    SimdFloat r2 = r * r;
+    y[i] = r * (SimdFloat(6.2831852f) + r2 * (SimdFloat(-41.341660f) + \
+        r2 * (SimdFloat(81.601268f) + r2 * (SimdFloat(-76.555030f) + \
+        r2 * SimdFloat(39.572244f)))));
+  }
+  *sine = y[0];
+  *cosine = y[1];
+}
+
+// Angle of (x, y), in [0, 1) turns. The arctangent is approximated by a
+// polynomial on [0, 1], and the other octants are obtained by symmetry. Error
+// below 2e-7 turns. The angle of (0, 0) is 0.
+inline SimdFloat Atan2(SimdFloat y, SimdFloat x) {
+  const SimdFloat zero(0.0f);
+  SimdFloat abs_x = SimdFloat::Max(x, zero - x);
+  SimdFloat abs_y = SimdFloat::Max(y, zero - y);
+  SimdFloat numerator = SimdFloat::Min(abs_x, abs_y);
+  SimdFloat denominator = SimdFloat::Max(
+      SimdFloat::Max(abs_x, abs_y),
+      SimdFloat(1e-30f));
+  SimdFloat a = numerator / denominator;
+  SimdFloat a2 = a * a;
+  SimdFloat t = a * (SimdFloat(0.15915441f) + a2 * (SimdFloat(-0.053027726f) + \
+      a2 * (SimdFloat(0.031533705f) + a2 * (SimdFloat(-0.021084076f) + \
+      a2 * (SimdFloat(0.012702329f) + a2 * (SimdFloat(-0.0053676346f) + \
+      a2 * SimdFloat(0.0010890329f)))))));
+  t = SimdFloat::Select(abs_x < abs_y, SimdFloat(0.25f) - t, t);
+  t = SimdFloat::Select(x < zero, SimdFloat(0.5f) - t, t);
+  t = SimdFloat::Select(y < zero, SimdFloat(1.0f) - t, t);
+  return SimdFloat::Select(t >= SimdFloat(1.0f), zero, t);
+}
+
+}  // namespace clouds
+
+#endif  // CLOUDS_DSP_SIMD_H_
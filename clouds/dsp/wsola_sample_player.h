@@ -47,7 +47,13 @@
 
 namespace clouds {
 
+// Larger windows give the correlator more candidates to search, which is
+// only affordable with CORRELATOR_BACKEND_POPCOUNT.
+#ifdef CLOUDS_MAX_WSOLA_SIZE
+const int32_t kMaxWSOLASize = CLOUDS_MAX_WSOLA_SIZE;
+#else
 const int32_t kMaxWSOLASize = 4096;
+#endif  // CLOUDS_MAX_WSOLA_SIZE
 
 using namespace stmlib;
 
@@ -254,7 +260,12 @@ class WSOLASamplePlayer {
     
     float position = position_;
     int32_t target_position = buffer->head();
-    target_position -= static_cast<int32_t>(limit * position);
+    if (limit <= kMaxSinglePrecisionBufferSize) {
+      target_position -= static_cast<int32_t>(limit * position);
+    } else {
+      target_position -= static_cast<int32_t>(
+          static_cast<double>(limit) * position);
+    }
     target_position -= window_size_;
     
     search_source_ = next_window_position;
@@ -29,11 +29,20 @@
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <vector>
+#include <sys/mman.h>
 #include <xmmintrin.h>
 
+#include "stmlib/utils/random.h"
+
 #include "clouds/dsp/granular_processor.h"
+#include "clouds/dsp/pvoc/simd_fft.h"
 #include "clouds/resources.h"
+#include "clouds/test/prepare_worker.h"
+#include "clouds/test/processor_pool.h"
+#include "clouds/test/sample_stream.h"
+#include "clouds/test/spin_wait.h"
 
 using namespace clouds;
 using namespace std;
@@ -223,8 +232,1427 @@ void TestGrainSize() {
   }
 }
 
+void BenchmarkLargeBuffer() {
+  const size_t kDurations[] = { 0, 10, 60, 600 };  // 0: hardware buffers.
+  const size_t kNumDurations = sizeof(kDurations) / sizeof(size_t);
+  const PlaybackMode kModes[] = {
+    PLAYBACK_MODE_GRANULAR,
+    PLAYBACK_MODE_STRETCH,
+    PLAYBACK_MODE_LOOPING_DELAY
+  };
+  const size_t kNumModes = sizeof(kModes) / sizeof(PlaybackMode);
+  const size_t kRenderDuration = 10;
+  
+  static uint8_t large_buffer[118784];
+  static uint8_t small_buffer[65536 - 128];
+  static GranularProcessor processor;
+  
+  printf("ns/sample    granular  stretch   looping\n");
+  for (size_t i = 0; i < kNumDurations; ++i) {
+    // Stereo, 16-bit.
+    size_t recording_size = kDurations[i] * kSampleRate * 2 * 2;
+    void* recording = NULL;
+    if (recording_size) {
+      recording = mmap(
+          NULL,
+          recording_size,
+          PROT_READ | PROT_WRITE,
+          MAP_PRIVATE | MAP_ANON,
+          -1,
+          0);
+    }
+    printf("%4ds      ", int(kDurations[i]));
+    for (size_t j = 0; j < kNumModes; ++j) {
+      processor.Init(
+          &large_buffer[0], sizeof(large_buffer),
+          &small_buffer[0], sizeof(small_buffer));
+      processor.set_recording_buffer(recording, recording_size);
+      processor.set_num_channels(2);
+      processor.set_low_fidelity(false);
+      processor.set_playback_mode(kModes[j]);
+      processor.Prepare();
+      
+      Parameters* p = processor.mutable_parameters();
+      ShortFrame input[kBlockSize];
+      ShortFrame output[kBlockSize];
+      float phase = 0.0f;
+      clock_t elapsed = 0;
+      for (size_t t = 0; t < kSampleRate * kRenderDuration; t += kBlockSize) {
+        // Grains and windows are scheduled all over the buffer.
+        p->gate = false;
+        p->trigger = false;
+        p->freeze = false;
+        p->position = (t % kSampleRate) / float(kSampleRate);
+        p->size = 0.5f;
+        p->pitch = 0.0f;
+        p->density = 0.9f;
+        p->texture = 0.5f;
+        p->feedback = 0.0f;
+        p->dry_wet = 1.0f;
+        p->reverb = 0.0f;
+        p->stereo_spread = 0.5f;
+        for (size_t k = 0; k < kBlockSize; ++k) {
+          phase += 220.0f / kSampleRate;
+          if (phase >= 1.0f) {
+            phase -= 1.0f;
+          }
+          // Low enough to stay clear of the output soft-limiter.
+          input[k].l = input[k].r = 4096.0f * sinf(phase * M_PI * 2);
+        }
+        clock_t start = clock();
+        processor.Process(input, output, kBlockSize);
+        processor.Prepare();
+        elapsed += clock() - start;
+      }
+      float ns_per_sample = float(elapsed) / CLOCKS_PER_SEC * 1e9f / \
+          (kSampleRate * kRenderDuration);
+      printf("%8.1f  ", ns_per_sample);
+    }
+    printf("\n");
+    if (recording) {
+      munmap(recording, recording_size);
+    }
+  }
+}
+
+// Position (modulo period samples) read by the looping player, recovered
+// from the phase of the quadrature signals written in the buffer.
+float LoopingPlayerPosition(const float* out, int32_t period) {
+  float phase = atan2f(out[0], out[1]) / (2.0f * M_PI);
+  if (phase < 0.0f) {
+    phase += 1.0f;
+  }
+  return phase * period;
+}
+
+float LoopingPlayerError(float position, double expected, int32_t period) {
+  float error = position - fmod(expected, period);
+  if (error > period / 2) {
+    error -= period;
+  } else if (error < -period / 2) {
+    error += period;
+  }
+  return fabs(error);
+}
+
+void TestLongLoopingDelay() {
+  // Longer than the 2^24 samples a float can index with sample accuracy.
+  const int32_t kSize = (1 << 25) + kInterpolationTail;
+  const int32_t kPeriod = 1024;
+  const float kTolerance = 0.05f;
+  
+  int16_t* memory[2];
+  int16_t tail[2][kCrossFadeSize];
+  AudioBuffer<RESOLUTION_16_BIT> buffer[2];
+  for (int32_t i = 0; i < 2; ++i) {
+    memory[i] = static_cast<int16_t*>(mmap(
+        NULL,
+        kSize * sizeof(int16_t),
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANON,
+        -1,
+        0));
+    buffer[i].Init(memory[i], kSize, tail[i]);
+  }
+  
+  // Fill the buffer with a quadrature pair, from which the playback position
+  // can be recovered.
+  for (int32_t i = 0; i < buffer[0].size(); ++i) {
+    float phase = float(i % kPeriod) / kPeriod * 2.0f * M_PI;
+    buffer[0].Write(0.99f * sinf(phase));
+    buffer[1].Write(0.99f * cosf(phase));
+  }
+  
+  LoopingSamplePlayer player;
+  player.Init(2);
+  
+  Parameters p;
+  memset(&p, 0, sizeof(p));
+  p.position = 0.7f;
+  
+  float out[kBlockSize * 2];
+  int32_t max_delay = buffer[0].size() - kCrossfadeDuration;
+  // ReadHermite(i, f) interpolates between samples i + 1 and i + 2.
+  int32_t origin = buffer[0].head() - 4 + buffer[0].size() + 1;
+
+  // Let the delay settle on its target.
+  for (int32_t t = 0; t < (1 << 20); t += kBlockSize) {
+    player.Play(buffer, p, out, kBlockSize);
+  }
+  double delay = static_cast<double>(p.position) * max_delay;
+  float delay_error = LoopingPlayerError(
+      LoopingPlayerPosition(&out[2 * kBlockSize - 2], kPeriod),
+      origin - delay,
+      kPeriod);
+  
+  // Frozen, the phase in the loop grows beyond 2^24 samples.
+  p.freeze = true;
+  p.position = 0.5f;
+  p.size = 1.0f;
+  double loop_duration = static_cast<double>(0.01f + 0.99f) * max_delay;
+  // The loop is as long as the buffer and starts at its end.
+  double loop_point = max_delay - loop_duration;
+  double phase_increment = SemitonesToRatio(p.pitch);
+  int32_t num_samples = (1 << 24) + 100000;
+  for (int32_t t = 0; t < num_samples; t += kBlockSize) {
+    player.Play(buffer, p, out, kBlockSize);
+  }
+  double phase = num_samples * phase_increment;
+  float loop_error = LoopingPlayerError(
+      LoopingPlayerPosition(&out[2 * kBlockSize - 2], kPeriod),
+      origin - (loop_duration - phase + loop_point),
+      kPeriod);
+
+  printf(
+      "Looping delay: delay error=%.4f, loop error=%.4f samples\n",
+      delay_error,
+      loop_error);
+  assert(delay_error < kTolerance && loop_error < kTolerance);
+  
+  for (int32_t i = 0; i < 2; ++i) {
+    munmap(memory[i], kSize * sizeof(int16_t));
+  }
+}
+
+void TestGrainBank() {
+  const float kWindowShapes[] = {
+    0.0f, 0.25f, 0.49f, 0.5f, 0.51f, 0.75f, 1.0f
+  };
+  const size_t kNumWindowShapes = sizeof(kWindowShapes) / sizeof(float);
+  const float kPitchRatios[] = { 0.5f, 1.0f, 1.7f };
+  const size_t kNumPitchRatios = sizeof(kPitchRatios) / sizeof(float);
+  const int32_t kBufferSize = 16384;
+  const int32_t kWidth = 2000;
+  const size_t kRenderDuration = 4096;
+  // Relative to the peak. Grain accumulates its envelope phase, GrainBank
+  // computes it from the age of the grain: the rounding errors differ, and
+  // the steepest window slopes amplify them to about 1e-3.
+  const float kTolerance = 4e-3f;
+  
+  static int16_t memory[2][kBufferSize];
+  static int16_t tail[2][kInterpolationTail];
+  static AudioBuffer<RESOLUTION_16_BIT> buffer[2];
+  static GrainBank bank;
+  
+  for (int32_t k = 0; k < 2; ++k) {
+    buffer[k].Init(&memory[k][0], kBufferSize, &tail[k][0]);
+    for (int32_t i = 0; i < kBufferSize; ++i) {
+      buffer[k].Write(Random::GetFloat() - 0.5f);
+    }
+  }
+  
+  int32_t num_failures = 0;
+  for (int32_t num_channels = 1; num_channels <= 2; ++num_channels) {
+    for (size_t i = 0; i < kNumWindowShapes; ++i) {
+      for (size_t j = 0; j < kNumPitchRatios; ++j) {
+        // Both backends get the same, quantized, phase increment.
+        int32_t phase_increment = static_cast<int32_t>(
+            kPitchRatios[j] * 65536.0f);
+        Grain grain;
+        grain.Init();
+        grain.Start(
+            5, buffer[0].size(), 1000, kWidth, phase_increment,
+            kWindowShapes[i], 0.8f, 0.3f, GRAIN_QUALITY_HIGH);
+        bank.Init();
+        bank.Start(
+            0, 5, buffer[0].size(), 1000, kWidth,
+            static_cast<float>(phase_increment) / 65536.0f,
+            kWindowShapes[i], 0.8f, 0.3f);
+        
+        float peak = 0.0f;
+        float error = 0.0f;
+        for (size_t t = 0; t < kRenderDuration; t += kBlockSize) {
+          float scalar[kBlockSize * 2];
+          float simd[kBlockSize * 2];
+          float envelope[kBlockSize];
+          std::fill(&scalar[0], &scalar[kBlockSize * 2], 0.0f);
+          std::fill(&simd[0], &simd[kBlockSize * 2], 0.0f);
+          if (num_channels == 1) {
+            grain.OverlapAdd<1, GRAIN_QUALITY_HIGH>(
+                buffer, scalar, envelope, kBlockSize);
+            bank.OverlapAdd<1>(buffer, kSimdWidth, simd, kBlockSize);
+          } else {
+            grain.OverlapAdd<2, GRAIN_QUALITY_HIGH>(
+                buffer, scalar, envelope, kBlockSize);
+            bank.OverlapAdd<2>(buffer, kSimdWidth, simd, kBlockSize);
+          }
+          for (size_t k = 0; k < kBlockSize * 2; ++k) {
+            peak = std::max(peak, fabsf(scalar[k]));
+            error = std::max(error, fabsf(scalar[k] - simd[k]));
+          }
+        }
+        if (peak == 0.0f || error > kTolerance * peak ||
+            grain.active() || bank.active(0)) {
+          printf(
+              "channels=%d window=%.2f ratio=%.1f: peak=%f error=%g\n",
+              num_channels, kWindowShapes[i], kPitchRatios[j], peak, error);
+          ++num_failures;
+        }
+      }
+    }
+  }
+  printf("Grain bank: %d mismatches\n", num_failures);
+  assert(num_failures == 0);
+}
+
+void BenchmarkGrains() {
+  const int32_t kNumGrains[] = { 16, 24, 32, 40, 48, 56, 64, 256, 1024, 4096 };
+  const size_t kNumNumGrains = sizeof(kNumGrains) / sizeof(int32_t);
+  const char* kBackendNames[] = { "scalar", "simd" };
+  const int32_t kBufferSize = 131072;
+  const size_t kRenderDuration = 3;
+  // The best of several runs is kept, to filter out the noise of the host.
+  const size_t kNumTrials = 5;
+  
+  static int16_t memory[2][kBufferSize];
+  static int16_t tail[2][kInterpolationTail];
+  static AudioBuffer<RESOLUTION_16_BIT> buffer[2];
+  static GranularSamplePlayer player;
+  
+  printf("grains  backend  active  ns/grain/sample  grains/core (32k / 48k)\n");
+  for (size_t i = 0; i < kNumNumGrains; ++i) {
+    for (int32_t j = GRAIN_BACKEND_SCALAR; j <= GRAIN_BACKEND_SIMD; ++j) {
+      GrainBackend backend = static_cast<GrainBackend>(j);
+      double best_ns = 0.0;
+      double active = 0.0;
+      for (size_t trial = 0; trial < kNumTrials; ++trial) {
+        for (int32_t k = 0; k < 2; ++k) {
+          buffer[k].Init(&memory[k][0], kBufferSize, &tail[k][0]);
+        }
+        player.Init(2, kNumGrains[i]);
+        player.set_backend(backend);
+        if (player.backend() != backend ||
+            player.max_num_grains() != kNumGrains[i]) {
+          break;
+        }
+      
+        Parameters p;
+        memset(&p, 0, sizeof(p));
+        p.position = 0.5f;
+        p.size = 0.5f;
+        p.stereo_spread = 0.5f;
+        p.granular.overlap = 1.0f;
+        p.granular.window_shape = 0.75f;
+      
+        float in[kBlockSize * 2];
+        float out[kBlockSize * 2];
+        float phase = 0.0f;
+        clock_t elapsed = 0;
+        double grain_samples = 0.0;
+        for (size_t t = 0; t < kSampleRate * kRenderDuration; t += kBlockSize) {
+          for (size_t k = 0; k < kBlockSize; ++k) {
+            phase += 220.0f / kSampleRate;
+            if (phase >= 1.0f) {
+              phase -= 1.0f;
+            }
+            in[2 * k] = in[2 * k + 1] = 0.5f * sinf(phase * M_PI * 2);
+          }
+          buffer[0].Write(&in[0], kBlockSize, 2);
+          buffer[1].Write(&in[1], kBlockSize, 2);
+          clock_t start = clock();
+          player.Play(buffer, p, out, kBlockSize);
+          // Skip the first second, during which the grains pile up.
+          if (t >= kSampleRate) {
+            elapsed += clock() - start;
+            grain_samples += player.num_grains() * kBlockSize;
+          }
+        }
+        double ns = double(elapsed) / CLOCKS_PER_SEC * 1e9 / grain_samples;
+        if (trial == 0 || ns < best_ns) {
+          best_ns = ns;
+        }
+        active = grain_samples / (kSampleRate * (kRenderDuration - 1));
+      }
+      if (best_ns == 0.0) {
+        continue;
+      }
+      printf(
+          "%6d  %-7s  %6.0f  %15.2f  %11.0f / %.0f\n",
+          kNumGrains[i],
+          kBackendNames[j],
+          active,
+          best_ns,
+          1e9 / (best_ns * 32000.0),
+          1e9 / (best_ns * 48000.0));
+    }
+  }
+}
+
+void BenchmarkProcessorPool() {
+  const size_t kNumProcessors = 16;
+  const size_t kNumWorkers[] = { 1, 2, 4, 8 };
+  const size_t kNumNumWorkers = sizeof(kNumWorkers) / sizeof(size_t);
+  const PlaybackMode kModes[] = {
+    PLAYBACK_MODE_GRANULAR,
+    PLAYBACK_MODE_STRETCH,
+    PLAYBACK_MODE_LOOPING_DELAY,
+    PLAYBACK_MODE_SPECTRAL
+  };
+  const size_t kRenderDuration = 5;
+  
+  static uint8_t large_buffer[kNumProcessors][118784];
+  static uint8_t small_buffer[kNumProcessors][65536 - 128];
+  static GranularProcessor processor[kNumProcessors];
+  static ShortFrame input[kNumProcessors][kBlockSize];
+  static ShortFrame output[kNumProcessors][kBlockSize];
+  
+  GranularProcessor* processors[kNumProcessors];
+  ShortFrame* inputs[kNumProcessors];
+  ShortFrame* outputs[kNumProcessors];
+  
+  printf("%d instances, all modes\n", int(kNumProcessors));
+  // Time spent waiting for the workers in ProcessorPool::Process().
+  printf("workers  ns/block  load  checksum\n");
+  uint32_t checksums[kNumNumWorkers];
+  for (size_t i = 0; i < kNumNumWorkers; ++i) {
+    for (size_t j = 0; j < kNumProcessors; ++j) {
+      processor[j].Init(
+          &large_buffer[j][0], sizeof(large_buffer[j]),
+          &small_buffer[j][0], sizeof(small_buffer[j]));
+      processor[j].set_num_channels(2);
+      processor[j].set_low_fidelity(false);
+      processor[j].set_playback_mode(kModes[j % 4]);
+      processor[j].Prepare();
+      processors[j] = &processor[j];
+      inputs[j] = input[j];
+      outputs[j] = output[j];
+    }
+    
+    ProcessorPool pool;
+    if (!pool.Init(processors, kNumProcessors, kNumWorkers[i])) {
+      printf("Could not start %d workers\n", int(kNumWorkers[i]));
+      return;
+    }
+    float phase = 0.0f;
+    double elapsed = 0.0;
+    uint32_t checksum = 0;
+    size_t num_blocks = kSampleRate * kRenderDuration / kBlockSize;
+    for (size_t t = 0; t < num_blocks; ++t) {
+      for (size_t j = 0; j < kNumProcessors; ++j) {
+        Parameters* p = pool.mutable_parameters(j);
+        p->position = 0.5f;
+        p->size = 0.5f;
+        p->pitch = 0.0f;
+        p->density = 0.9f;
+        p->texture = 0.5f;
+        p->feedback = 0.0f;
+        p->dry_wet = 1.0f;
+        p->reverb = 0.5f;
+        p->stereo_spread = 0.5f;
+      }
+      for (size_t k = 0; k < kBlockSize; ++k) {
+        phase += 220.0f / kSampleRate;
+        if (phase >= 1.0f) {
+          phase -= 1.0f;
+        }
+        short s = 16384.0f * sinf(phase * M_PI * 2);
+        for (size_t j = 0; j < kNumProcessors; ++j) {
+          input[j][k].l = input[j][k].r = s;
+        }
+      }
+      timespec start, end;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      pool.Process(inputs, outputs, kBlockSize);
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      elapsed += (end.tv_sec - start.tv_sec) * 1e9 + \
+          (end.tv_nsec - start.tv_nsec);
+      for (size_t j = 0; j < kNumProcessors; ++j) {
+        for (size_t k = 0; k < kBlockSize; ++k) {
+          checksum = checksum * 31 + uint16_t(output[j][k].l);
+          checksum = checksum * 31 + uint16_t(output[j][k].r);
+        }
+      }
+    }
+    size_t num_workers = pool.num_workers();
+    checksums[i] = checksum;
+    pool.Stop();
+    
+    double ns_per_block = elapsed / num_blocks;
+    double block_duration = 1e9 * kBlockSize / kSampleRate;
+    printf(
+        "%7d  %8.0f  %3.0f%%  %08x\n",
+        int(num_workers),
+        ns_per_block,
+        100.0 * ns_per_block / block_duration,
+        checksum);
+  }
+  // The output must not depend on the number of workers.
+  for (size_t i = 1; i < kNumNumWorkers; ++i) {
+    assert(checksums[i] == checksums[0]);
+  }
+}
+
+// Renders a sine through a processor, handing the work of Prepare() over to
+// a worker thread if one is given. The audio thread then lets the worker
+// finish each piece of work before the next block, so that no result is late.
+void RenderPrepareWorker(
+    GranularProcessor* processor,
+    PrepareWorker* worker,
+    PlaybackMode mode,
+    ShortFrame* output,
+    size_t num_blocks) {
+  static uint8_t large_buffer[118784];
+  static uint8_t small_buffer[65536 - 128];
+  static PrepareJob job;
+  
+  processor->Init(
+      &large_buffer[0], sizeof(large_buffer),
+      &small_buffer[0], sizeof(small_buffer));
+  processor->set_num_channels(2);
+  processor->set_low_fidelity(false);
+  processor->set_playback_mode(mode);
+  processor->Prepare();
+  job.Init(processor);
+  
+  Parameters* p = processor->mutable_parameters();
+  ShortFrame input[kBlockSize];
+  float phase = 0.0f;
+  for (size_t t = 0; t < num_blocks; ++t) {
+    for (size_t k = 0; k < kBlockSize; ++k) {
+      phase += 220.0f / kSampleRate;
+      if (phase >= 1.0f) {
+        phase -= 1.0f;
+      }
+      // Low enough to stay clear of the output soft-limiter.
+      input[k].l = input[k].r = 4096.0f * sinf(phase * M_PI * 2);
+    }
+    if (worker) {
+      Spinner spinner;
+      while (!job.ready()) {
+        spinner.Pause();
+      }
+      worker->Collect(&job);
+    }
+    p->gate = false;
+    p->trigger = false;
+    p->freeze = false;
+    p->position = 0.5f;
+    p->size = 0.5f;
+    p->pitch = 0.0f;
+    p->density = 0.7f;
+    p->texture = 0.5f;
+    p->feedback = 0.0f;
+    p->dry_wet = 1.0f;
+    p->reverb = 0.0f;
+    p->stereo_spread = 0.5f;
+    processor->Process(input, output, kBlockSize);
+    if (worker) {
+      worker->Request(&job);
+    } else {
+      processor->BeginPrepare();
+      processor->PrepareAll();
+    }
+    output += kBlockSize;
+  }
+  if (worker) {
+    assert(job.num_late_frames() == 0);
+  }
+}
+
+void TestPrepareWorker() {
+  const PlaybackMode kModes[] = {
+    PLAYBACK_MODE_STRETCH,
+    PLAYBACK_MODE_SPECTRAL
+  };
+  const size_t kNumModes = sizeof(kModes) / sizeof(PlaybackMode);
+  const size_t kNumBlocks = kSampleRate * 4 / kBlockSize;
+  
+  static GranularProcessor processor;
+  static ShortFrame inline_output[kNumBlocks * kBlockSize];
+  static ShortFrame worker_output[kNumBlocks * kBlockSize];
+  
+  // When its results are in time, the worker does the same work as an inline
+  // call - STFT frames one channel at a time, but all before they are
+  // needed - and the output is identical.
+  for (size_t i = 0; i < kNumModes; ++i) {
+    RenderPrepareWorker(&processor, NULL, kModes[i], inline_output, kNumBlocks);
+    
+    PrepareWorker worker;
+    if (!worker.Start()) {
+      printf("Could not start the worker\n");
+      return;
+    }
+    RenderPrepareWorker(
+        &processor, &worker, kModes[i], worker_output, kNumBlocks);
+    worker.Stop();
+    
+    size_t num_differences = 0;
+    for (size_t j = 0; j < kNumBlocks * kBlockSize; ++j) {
+      if (inline_output[j].l != worker_output[j].l ||
+          inline_output[j].r != worker_output[j].r) {
+        ++num_differences;
+      }
+    }
+    printf(
+        "mode %d: %d requests, %d differences\n",
+        int(kModes[i]),
+        int(worker.num_requests()),
+        int(num_differences));
+    assert(num_differences == 0);
+  }
+}
+
+void BenchmarkPrepareWorker() {
+  const PlaybackMode kModes[] = {
+    PLAYBACK_MODE_STRETCH,
+    PLAYBACK_MODE_SPECTRAL
+  };
+  const char* kModeNames[] = { "stretch", "spectral" };
+  const size_t kNumModes = sizeof(kModes) / sizeof(PlaybackMode);
+  const size_t kRenderDuration = 4;
+  const long kBlockDuration = 1000000000L / kSampleRate * kBlockSize;
+  
+  static uint8_t large_buffer[118784];
+  static uint8_t small_buffer[65536 - 128];
+  static GranularProcessor processor;
+  
+  // Time spent on the audio thread for each block, including the hand-over
+  // to the worker, which never waits. Blocks are rendered in real time, as in
+  // an audio callback.
+  printf("mode      prepare     mean (ns)  worst (ns)  ");
+  printf("latency (ns)  late  dropped\n");
+  for (size_t i = 0; i < kNumModes; ++i) {
+    for (int32_t background = 0; background < 2; ++background) {
+      processor.Init(
+          &large_buffer[0], sizeof(large_buffer),
+          &small_buffer[0], sizeof(small_buffer));
+      processor.set_num_channels(2);
+      processor.set_low_fidelity(false);
+      processor.set_playback_mode(kModes[i]);
+      processor.Prepare();
+      
+      static PrepareJob job;
+      job.Init(&processor);
+      PrepareWorker worker;
+      if (background && !worker.Start()) {
+        printf("Could not start the worker\n");
+        return;
+      }
+      
+      Parameters* p = processor.mutable_parameters();
+      ShortFrame input[kBlockSize];
+      ShortFrame output[kBlockSize];
+      float phase = 0.0f;
+      double total = 0.0;
+      double worst = 0.0;
+      size_t num_blocks = kSampleRate * kRenderDuration / kBlockSize;
+      timespec deadline;
+      clock_gettime(CLOCK_MONOTONIC, &deadline);
+      for (size_t t = 0; t < num_blocks; ++t) {
+        deadline.tv_nsec += kBlockDuration;
+        if (deadline.tv_nsec >= 1000000000L) {
+          deadline.tv_nsec -= 1000000000L;
+          ++deadline.tv_sec;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+        
+        for (size_t k = 0; k < kBlockSize; ++k) {
+          phase += 220.0f / kSampleRate;
+          if (phase >= 1.0f) {
+            phase -= 1.0f;
+          }
+          // Low enough to stay clear of the output soft-limiter.
+          input[k].l = input[k].r = 4096.0f * sinf(phase * M_PI * 2);
+        }
+        timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (background) {
+          worker.Collect(&job);
+        }
+        p->gate = false;
+        p->trigger = false;
+        p->freeze = false;
+        p->position = 0.5f;
+        p->size = 0.5f;
+        p->pitch = 0.0f;
+        p->density = 0.7f;
+        p->texture = 0.5f;
+        p->feedback = 0.0f;
+        p->dry_wet = 1.0f;
+        p->reverb = 0.0f;
+        p->stereo_spread = 0.5f;
+        processor.Process(input, output, kBlockSize);
+        if (background) {
+          worker.Request(&job);
+        } else {
+          processor.Prepare();
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = (end.tv_sec - start.tv_sec) * 1e9 + \
+            (end.tv_nsec - start.tv_nsec);
+        total += elapsed;
+        worst = max(worst, elapsed);
+      }
+      if (background) {
+        worker.Stop();
+      }
+      
+      printf(
+          "%-8s  %-10s  %9.0f  %10.0f  ",
+          kModeNames[i],
+          background ? "background" : "inline",
+          total / num_blocks,
+          worst);
+      if (background) {
+        printf(
+            "%12d  %4d  %7d\n",
+            int(worker.max_latency()),
+            int(job.num_late_frames()),
+            int(worker.num_dropped_requests()));
+      } else {
+        printf("%12s  %4s  %7s\n", "-", "-", "-");
+      }
+    }
+  }
+}
+
+void FillCorrelator(
+    Correlator* correlator,
+    int32_t size,
+    int32_t offset,
+    float noise) {
+  // The destination holds 2 * size bits of noise; the source is a corrupted
+  // copy of the destination starting at offset.
+  int32_t num_words = size / 32 + 2;
+  uint32_t* source = correlator->source();
+  uint32_t* destination = correlator->destination();
+  for (int32_t i = 0; i < 2 * num_words; ++i) {
+    destination[i] = Random::GetWord();
+  }
+  for (int32_t i = 0; i < num_words; ++i) {
+    source[i] = 0;
+  }
+  for (int32_t i = 0; i < size; ++i) {
+    int32_t j = i + offset;
+    uint32_t bit = (destination[j >> 5] >> (31 - (j & 0x1f))) & 1;
+    if (Random::GetFloat() < noise) {
+      bit ^= 1;
+    }
+    source[i >> 5] |= bit << (31 - (i & 0x1f));
+  }
+}
+
+void TestCorrelator() {
+  const int32_t kSizes[] = { 32, 96, 1000, 2048, 4096, 8192 };
+  const size_t kNumSizes = sizeof(kSizes) / sizeof(int32_t);
+  const float kNoise[] = { 0.0f, 0.3f, 0.5f };
+  const size_t kNumNoise = sizeof(kNoise) / sizeof(float);
+  const int32_t kMaxSize = 8192;
+  
+  static uint32_t source[kMaxSize / 32 + 2];
+  static uint32_t destination[2 * (kMaxSize / 32 + 2)];
+  Correlator correlator;
+  correlator.Init(source, destination);
+
+  int32_t num_failures = 0;
+  for (size_t i = 0; i < kNumSizes; ++i) {
+    for (size_t j = 0; j < kNumNoise; ++j) {
+      for (int32_t trial = 0; trial < 8; ++trial) {
+        int32_t size = kSizes[i];
+        int32_t offset = Random::GetWord() % size;
+        FillCorrelator(&correlator, size, offset, kNoise[j]);
+        
+        int32_t best_match[3];
+        for (int32_t k = 0; k < 3; ++k) {
+          // The scalar search runs again after the popcount search, to check
+          // that the latter leaves the destination bits untouched.
+          correlator.set_backend(k == 1
+              ? CORRELATOR_BACKEND_POPCOUNT
+              : CORRELATOR_BACKEND_SCALAR);
+          correlator.StartSearch(size, 0, 65536);
+          while (!correlator.done()) {
+            correlator.EvaluateSomeCandidates();
+          }
+          best_match[k] = correlator.best_match();
+        }
+        if (best_match[0] != best_match[1] ||
+            best_match[0] != best_match[2] ||
+            (kNoise[j] == 0.0f && best_match[0] != offset)) {
+          printf(
+              "size=%d noise=%.1f offset=%d: scalar=%d popcount=%d (%d)\n",
+              size, kNoise[j], offset,
+              best_match[0], best_match[1], best_match[2]);
+          ++num_failures;
+        }
+      }
+    }
+  }
+  printf("Correlator: %d mismatches\n", num_failures);
+}
+
+void BenchmarkCorrelator() {
+  const int32_t kSizes[] = { 1024, 2048, 4096, 8192, 16384 };
+  const size_t kNumSizes = sizeof(kSizes) / sizeof(int32_t);
+  const char* kBackendNames[] = { "scalar", "popcount" };
+  const int32_t kMaxSize = 16384;
+  const int32_t kNumSearches = 20;
+  
+  static uint32_t source[kMaxSize / 32 + 2];
+  static uint32_t destination[2 * (kMaxSize / 32 + 2)];
+  Correlator correlator;
+  correlator.Init(source, destination);
+  
+  printf("size     backend   ms/search\n");
+  for (size_t i = 0; i < kNumSizes; ++i) {
+    for (int32_t j = CORRELATOR_BACKEND_SCALAR;
+         j <= CORRELATOR_BACKEND_POPCOUNT;
+         ++j) {
+      correlator.set_backend(static_cast<CorrelatorBackend>(j));
+      clock_t elapsed = 0;
+      for (int32_t k = 0; k < kNumSearches; ++k) {
+        FillCorrelator(&correlator, kSizes[i], kSizes[i] / 3, 0.25f);
+        clock_t start = clock();
+        correlator.StartSearch(kSizes[i], 0, 65536);
+        while (!correlator.done()) {
+          correlator.EvaluateSomeCandidates();
+        }
+        elapsed += clock() - start;
+      }
+      printf(
+          "%5d    %-8s  %9.3f\n",
+          kSizes[i],
+          kBackendNames[j],
+          double(elapsed) / CLOCKS_PER_SEC * 1e3 / kNumSearches);
+    }
+  }
+}
+
+void TestFFT() {
+  static SimdFFT<kMaxFftSize> simd_fft;
+  static ShyFFT<float, kMaxFftSize, RotationPhasor> shy_fft;
+  static float signal[kMaxFftSize];
+  static float input[kMaxFftSize];
+  static float simd_output[kMaxFftSize];
+  static float shy_output[kMaxFftSize];
+  simd_fft.Init();
+  shy_fft.Init();
+  
+  printf("size   direct error   inverse error\n");
+  for (size_t num_passes = 8; (size_t(1) << num_passes) <= kMaxFftSize;
+       ++num_passes) {
+    size_t size = size_t(1) << num_passes;
+    for (size_t i = 0; i < size; ++i) {
+      signal[i] = Random::GetFloat() - 0.5f;
+    }
+    
+    // Errors are relative to the largest coefficient.
+    copy(&signal[0], &signal[size], &input[0]);
+    simd_fft.Direct(input, simd_output, num_passes);
+    copy(&signal[0], &signal[size], &input[0]);
+    shy_fft.Direct(input, shy_output, num_passes);
+    float direct_error = 0.0f;
+    float peak = 0.0f;
+    for (size_t i = 0; i < size; ++i) {
+      direct_error = max(direct_error, fabsf(simd_output[i] - shy_output[i]));
+      peak = max(peak, fabsf(shy_output[i]));
+    }
+    
+    copy(&shy_output[0], &shy_output[size], &input[0]);
+    simd_fft.Inverse(input, simd_output, num_passes);
+    copy(&shy_output[0], &shy_output[size], &input[0]);
+    shy_fft.Inverse(input, shy_output, num_passes);
+    float inverse_error = 0.0f;
+    peak = 0.0f;
+    for (size_t i = 0; i < size; ++i) {
+      inverse_error = max(inverse_error, fabsf(simd_output[i] - shy_output[i]));
+      peak = max(peak, fabsf(shy_output[i]));
+    }
+    printf(
+        "%4d   %12g   %13g\n",
+        int(size), direct_error / peak, inverse_error / peak);
+  }
+}
+
+void BenchmarkFFT() {
+  const char* kBackendNames[] = { "shy", "simd" };
+  const size_t kNumTransforms = 2000;
+  
+  static SimdFFT<kMaxFftSize> simd_fft;
+  static ShyFFT<float, kMaxFftSize, RotationPhasor> shy_fft;
+  static float input[kMaxFftSize];
+  static float output[kMaxFftSize];
+  simd_fft.Init();
+  shy_fft.Init();
+  
+  printf("size   backend   us/transform (direct + inverse)\n");
+  for (size_t num_passes = 8; (size_t(1) << num_passes) <= kMaxFftSize;
+       ++num_passes) {
+    size_t size = size_t(1) << num_passes;
+    for (size_t backend = 0; backend < 2; ++backend) {
+      clock_t start = clock();
+      for (size_t i = 0; i < kNumTransforms; ++i) {
+        // The input is lost after each transform; refill it.
+        for (size_t j = 0; j < size; ++j) {
+          input[j] = (j & 7) * 0.1f;
+        }
+        if (backend == 0) {
+          shy_fft.Direct(input, output, num_passes);
+          shy_fft.Inverse(output, input, num_passes);
+        } else {
+          simd_fft.Direct(input, output, num_passes);
+          simd_fft.Inverse(output, input, num_passes);
+        }
+      }
+      double elapsed = double(clock() - start) / CLOCKS_PER_SEC;
+      printf(
+          "%4d   %-7s   %12.2f\n",
+          int(size),
+          kBackendNames[backend],
+          elapsed * 1e6 / kNumTransforms);
+    }
+  }
+}
+
+void BenchmarkPhaseVocoder() {
+  const PhaseVocoderPrecision kPrecisions[] = {
+    PHASE_VOCODER_PRECISION_STANDARD,
+    PHASE_VOCODER_PRECISION_HIGH,
+    PHASE_VOCODER_PRECISION_HIGH
+  };
+  // The high precision profile picks the largest FFT fitting in the buffers.
+  const size_t kSmallBufferSizes[] = { 65536 - 128, 262144, 1048576 };
+  const size_t kNumProfiles = sizeof(kSmallBufferSizes) / sizeof(size_t);
+  const size_t kRenderDuration = 12;
+  const size_t kFreezeTime = 6;
+  const float kFrequency = 110.0f;
+  const size_t kAnalysisSize = 16384;
+  
+  static uint8_t large_buffer[1048576 + 118784 - (65536 - 128)];
+  static uint8_t small_buffer[1048576];
+  static GranularProcessor processor;
+  static SimdFFT<kAnalysisSize> fft;
+  static float analysis[kAnalysisSize];
+  static float windowed[kAnalysisSize];
+  static float spectrum[kAnalysisSize];
+  fft.Init();
+  
+  printf("fft size   ns/sample   purity live (dB)   purity frozen (dB)\n");
+  for (size_t i = 0; i < kNumProfiles; ++i) {
+    processor.Init(
+        &large_buffer[0], kSmallBufferSizes[i] + 118784 - (65536 - 128),
+        &small_buffer[0], kSmallBufferSizes[i]);
+    processor.set_num_channels(2);
+    processor.set_low_fidelity(false);
+    processor.set_playback_mode(PLAYBACK_MODE_SPECTRAL);
+    processor.set_spectral_precision(kPrecisions[i]);
+    processor.Prepare();
+    
+    Parameters* p = processor.mutable_parameters();
+    ShortFrame input[kBlockSize];
+    ShortFrame output[kBlockSize];
+    float phase = 0.0f;
+    clock_t elapsed = 0;
+    float purity[2] = { 0.0f, 0.0f };
+    size_t analysis_ptr = 0;
+    for (size_t t = 0; t < kSampleRate * kRenderDuration; t += kBlockSize) {
+      // Neutral settings: no warping, quantization or phase randomization.
+      p->gate = false;
+      p->trigger = false;
+      p->freeze = t >= kSampleRate * kFreezeTime;
+      p->position = 0.0f;
+      p->size = 0.5f;
+      p->pitch = 0.0f;
+      p->density = 0.5f;
+      p->texture = 0.5f;
+      p->feedback = 0.0f;
+      p->dry_wet = 1.0f;
+      p->reverb = 0.0f;
+      p->stereo_spread = 0.0f;
+      for (size_t k = 0; k < kBlockSize; ++k) {
+        phase += kFrequency / kSampleRate;
+        if (phase >= 1.0f) {
+          phase -= 1.0f;
+        }
+        // Low enough to stay clear of the output soft-limiter.
+        input[k].l = input[k].r = 4096.0f * sinf(phase * M_PI * 2);
+      }
+      clock_t start = clock();
+      processor.Process(input, output, kBlockSize);
+      processor.Prepare();
+      elapsed += clock() - start;
+      
+      for (size_t k = 0; k < kBlockSize; ++k) {
+        analysis[analysis_ptr] = output[k].l;
+        analysis_ptr = (analysis_ptr + 1) % kAnalysisSize;
+      }
+      
+      // Ratio between the energy within 10Hz of the input frequency and the
+      // energy everywhere else, at the end of the live and frozen segments.
+      size_t end = t + kBlockSize;
+      if (end == kSampleRate * kFreezeTime ||
+          end == kSampleRate * kRenderDuration) {
+        for (size_t k = 0; k < kAnalysisSize; ++k) {
+          // Blackman-Harris window, for a -92dB leakage.
+          float x = 2.0f * M_PI * k / kAnalysisSize;
+          float w = 0.35875f - 0.48829f * cosf(x) + 0.14128f * cosf(2.0f * x) \
+              - 0.01168f * cosf(3.0f * x);
+          windowed[k] = analysis[(analysis_ptr + k) % kAnalysisSize] * w;
+        }
+        fft.Direct(windowed, spectrum, 14);
+        double signal = 0.0;
+        double noise = 0.0;
+        for (size_t k = 1; k < kAnalysisSize / 2; ++k) {
+          float re = spectrum[k];
+          float im = spectrum[k + kAnalysisSize / 2];
+          float f = float(k) * kSampleRate / kAnalysisSize;
+          float energy = re * re + im * im;
+          if (fabs(f - kFrequency) < 10.0f) {
+            signal += energy;
+          } else {
+            noise += energy;
+          }
+        }
+        purity[end == kSampleRate * kRenderDuration] = \
+            10.0 * log10(signal / (noise + 1e-9));
+      }
+    }
+    printf(
+        "%5d      %9.1f   %16.1f   %18.1f\n",
+        int(processor.spectral_fft_size()),
+        double(elapsed) / CLOCKS_PER_SEC * 1e9 / \
+            (kSampleRate * kRenderDuration),
+        purity[0],
+        purity[1]);
+  }
+}
+
+void FillFxInput(FloatFrame* frames, size_t size, float* phase) {
+  for (size_t i = 0; i < size; ++i) {
+    *phase += 220.0f / kSampleRate;
+    if (*phase >= 1.0f) {
+      *phase -= 1.0f;
+    }
+    frames[i].l = 0.5f * sinf(*phase * M_PI * 2);
+    frames[i].r = Random::GetFloat() - 0.5f;
+  }
+}
+
+// Largest difference between the outputs of two effects.
+template<typename A, typename B>
+float CompareFx(A* a, B* b, size_t num_samples) {
+  float phase = 0.0f;
+  float error = 0.0f;
+  for (size_t t = 0; t < num_samples; ) {
+    // Blocks which are not a multiple of kFxBlockSize, to exercise the
+    // partial blocks.
+    size_t size = kMaxBlockSize - (t / kMaxBlockSize) % 5;
+    FloatFrame x[kMaxBlockSize];
+    FloatFrame y[kMaxBlockSize];
+    FillFxInput(x, size, &phase);
+    copy(&x[0], &x[size], &y[0]);
+    a->Process(x, size);
+    b->Process(y, size);
+    for (size_t i = 0; i < size; ++i) {
+      error = max(error, fabsf(x[i].l - y[i].l));
+      error = max(error, fabsf(x[i].r - y[i].r));
+    }
+    t += size;
+  }
+  return error;
+}
+
+void TestFx() {
+  const size_t kNumSamples = kSampleRate * 10;
+  // Summing the same terms in a different order, e.g. with FMA contraction,
+  // causes rounding differences.
+  const float kTolerance = 1e-5f;
+  
+  // The SIMD effects are compared with the same programs running on the
+  // scalar engine with float storage.
+  static float buffer[2][16512];
+  static Diffuser<FxEngine<2048, FORMAT_32_BIT> > diffuser;
+  static SimdDiffuser simd_diffuser;
+  static Reverb<FxEngine<16384, FORMAT_32_BIT> > reverb;
+  static SimdReverb simd_reverb;
+  static PitchShifter<FxEngine<4096, FORMAT_32_BIT> > pitch_shifter;
+  static SimdPitchShifter simd_pitch_shifter;
+  float error[3];
+  
+  diffuser.Init(buffer[0]);
+  simd_diffuser.Init(buffer[1]);
+  diffuser.set_amount(0.8f);
+  simd_diffuser.set_amount(0.8f);
+  error[0] = CompareFx(&diffuser, &simd_diffuser, kNumSamples);
+  
+  reverb.Init(buffer[0]);
+  simd_reverb.Init(buffer[1]);
+  reverb.set_amount(0.5f);
+  simd_reverb.set_amount(0.5f);
+  reverb.set_diffusion(0.7f);
+  simd_reverb.set_diffusion(0.7f);
+  reverb.set_time(0.9f);
+  simd_reverb.set_time(0.9f);
+  reverb.set_input_gain(0.2f);
+  simd_reverb.set_input_gain(0.2f);
+  reverb.set_lp(0.7f);
+  simd_reverb.set_lp(0.7f);
+  error[1] = CompareFx(&reverb, &simd_reverb, kNumSamples);
+  
+  pitch_shifter.Init(buffer[0]);
+  simd_pitch_shifter.Init(buffer[1]);
+  pitch_shifter.set_ratio(1.5f);
+  simd_pitch_shifter.set_ratio(1.5f);
+  pitch_shifter.set_size(0.5f);
+  simd_pitch_shifter.set_size(0.5f);
+  error[2] = CompareFx(&pitch_shifter, &simd_pitch_shifter, kNumSamples);
+  
+  const char* kNames[] = { "Diffuser", "Reverb", "Pitch shifter" };
+  for (size_t i = 0; i < 3; ++i) {
+    printf(
+        "%-14s  max error %g  %s\n",
+        kNames[i],
+        error[i],
+        error[i] <= kTolerance ? "PASS" : "FAIL");
+  }
+  for (size_t i = 0; i < 3; ++i) {
+    assert(error[i] <= kTolerance);
+  }
+}
+
+template<typename Fx>
+float TimeFx(Fx* fx) {
+  const size_t kRenderDuration = 20;
+  const size_t kInputSize = kSampleRate;
+  
+  // Timing each block would mostly measure clock().
+  static FloatFrame input[kInputSize];
+  float phase = 0.0f;
+  FillFxInput(input, kInputSize, &phase);
+  clock_t start = clock();
+  for (size_t t = 0; t < kSampleRate * kRenderDuration; t += kBlockSize) {
+    FloatFrame frames[kBlockSize];
+    copy(&input[t % kInputSize], &input[t % kInputSize + kBlockSize], frames);
+    fx->Process(frames, kBlockSize);
+  }
+  return double(clock() - start) / CLOCKS_PER_SEC * 1e9 / \
+      (kSampleRate * kRenderDuration);
+}
+
+void BenchmarkFx() {
+  static float buffer[16512];
+  static Diffuser<> diffuser;
+  static SimdDiffuser simd_diffuser;
+  static Reverb<> reverb;
+  static SimdReverb simd_reverb;
+  static PitchShifter<> pitch_shifter;
+  static SimdPitchShifter simd_pitch_shifter;
+  float ns[3][2];
+  
+  diffuser.Init(buffer);
+  diffuser.set_amount(0.8f);
+  ns[0][0] = TimeFx(&diffuser);
+  simd_diffuser.Init(buffer);
+  simd_diffuser.set_amount(0.8f);
+  ns[0][1] = TimeFx(&simd_diffuser);
+  
+  reverb.Init((uint16_t*)(buffer));
+  reverb.set_amount(0.5f);
+  reverb.set_diffusion(0.7f);
+  reverb.set_time(0.9f);
+  reverb.set_input_gain(0.2f);
+  reverb.set_lp(0.7f);
+  ns[1][0] = TimeFx(&reverb);
+  simd_reverb.Init(buffer);
+  simd_reverb.set_amount(0.5f);
+  simd_reverb.set_diffusion(0.7f);
+  simd_reverb.set_time(0.9f);
+  simd_reverb.set_input_gain(0.2f);
+  simd_reverb.set_lp(0.7f);
+  ns[1][1] = TimeFx(&simd_reverb);
+  
+  pitch_shifter.Init((uint16_t*)(buffer));
+  pitch_shifter.set_ratio(1.5f);
+  pitch_shifter.set_size(0.5f);
+  ns[2][0] = TimeFx(&pitch_shifter);
+  simd_pitch_shifter.Init(buffer);
+  simd_pitch_shifter.set_ratio(1.5f);
+  simd_pitch_shifter.set_size(0.5f);
+  ns[2][1] = TimeFx(&simd_pitch_shifter);
+  
+  // The effects are tuned for 32kHz. At 48kHz, they run with the same delay
+  // lengths - the load only scales with the sample rate.
+  const char* kNames[] = { "diffuser", "reverb", "pitch shifter" };
+  printf("                ns/sample         %% of a core at 32kHz / 48kHz\n");
+  printf("                scalar   simd     scalar          simd\n");
+  for (size_t i = 0; i < 3; ++i) {
+    printf(
+        "%-14s  %6.1f   %6.1f   %5.2f / %5.2f   %5.2f / %5.2f   (x%.1f)\n",
+        kNames[i],
+        ns[i][0],
+        ns[i][1],
+        ns[i][0] * 32000.0f * 1e-7f,
+        ns[i][0] * 48000.0f * 1e-7f,
+        ns[i][1] * 32000.0f * 1e-7f,
+        ns[i][1] * 48000.0f * 1e-7f,
+        ns[i][0] / ns[i][1]);
+  }
+}
+
+// Checksum of the recording buffers, as they are saved in a given format.
+uint32_t RecordingChecksum(
+    const GranularProcessor& processor,
+    SampleFormat format) {
+  const size_t kChunkSize = 1024;
+  int16_t frames[kChunkSize * 2];
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(frames);
+  size_t frame_size = processor.num_channels() * \
+      (format == SAMPLE_FORMAT_MU_LAW ? 1 : 2);
+  uint32_t checksum = 0;
+  size_t position = 0;
+  while (true) {
+    size_t n = format == SAMPLE_FORMAT_MU_LAW
+        ? processor.ExportFrames(position, (uint8_t*)(frames), kChunkSize)
+        : processor.ExportFrames(position, frames, kChunkSize);
+    if (!n) {
+      break;
+    }
+    for (size_t i = 0; i < n * frame_size; ++i) {
+      checksum = checksum * 31 + bytes[i];
+    }
+    position += n;
+  }
+  return checksum;
+}
+
+void BenchmarkSampleStream() {
+  const size_t kDuration = 600;
+  const char* kFileName = "clouds_stream.wav";
+  const char* kFormatNames[] = { "pcm16", "mu-law" };
+  
+  static uint8_t large_buffer[118784];
+  static uint8_t small_buffer[65536 - 128];
+  static GranularProcessor processor;
+  static SampleStream stream;
+  
+  // Stereo, 16-bit.
+  size_t recording_size = kDuration * kSampleRate * 2 * 2;
+  void* recording = mmap(
+      NULL,
+      recording_size,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANON,
+      -1,
+      0);
+  
+  // Saved files are likely to stay in the page cache: this measures the cost
+  // of the conversions and copies rather than the speed of the disk.
+  printf("buffer   file     size (MB)  save (MB/s)  load (MB/s)\n");
+  for (int32_t low_fidelity = 0; low_fidelity < 2; ++low_fidelity) {
+    for (int32_t format = 0; format < 2; ++format) {
+      double elapsed[2];
+      uint32_t checksum[2];
+      for (int32_t load = 0; load < 2; ++load) {
+        processor.Init(
+            &large_buffer[0], sizeof(large_buffer),
+            &small_buffer[0], sizeof(small_buffer));
+        processor.set_recording_buffer(recording, recording_size);
+        processor.set_num_channels(2);
+        processor.set_low_fidelity(low_fidelity);
+        processor.set_playback_mode(PLAYBACK_MODE_GRANULAR);
+        processor.Prepare();
+        if (!load) {
+          // Sine wave on the left channel, noise on the right channel.
+          int16_t frames[1024 * 2];
+          float phase = 0.0f;
+          size_t remaining = processor.recording_size();
+          while (remaining) {
+            size_t n = std::min(remaining, size_t(1024));
+            for (size_t i = 0; i < n; ++i) {
+              phase += 220.0f / kSampleRate;
+              if (phase >= 1.0f) {
+                phase -= 1.0f;
+              }
+              frames[2 * i] = 16384.0f * sinf(phase * M_PI * 2);
+              frames[2 * i + 1] = Random::GetSample() >> 1;
+            }
+            processor.ImportFrames(frames, n);
+            remaining -= n;
+          }
+        }
+        
+        timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bool success = load
+            ? stream.Load(kFileName, &processor)
+            : stream.Save(kFileName, processor, SampleFormat(format));
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (!success) {
+          printf("Failed to stream %s\n", kFileName);
+        }
+        elapsed[load] = (end.tv_sec - start.tv_sec) + \
+            (end.tv_nsec - start.tv_nsec) * 1e-9;
+        checksum[load] = RecordingChecksum(processor, SampleFormat(format));
+      }
+      float size = stream.num_bytes() / 1e6f;
+      printf(
+          "%-7s  %-7s  %9.1f  %11.1f  %11.1f  %s\n",
+          low_fidelity ? "mu-law" : "16-bit",
+          kFormatNames[format],
+          size,
+          size / elapsed[0],
+          size / elapsed[1],
+          checksum[0] == checksum[1] ? "" : "mismatch!");
+    }
+  }
+  remove(kFileName);
+  munmap(recording, recording_size);
+}
+
+void TestMuLaw() {
+  // Block encoding, against the scalar function - at all alignments.
+  static int16_t pcm[65536 + 16];
+  static uint8_t mu_law[65536 + 16];
+  size_t num_errors = 0;
+  for (size_t offset = 0; offset < 16; ++offset) {
+    for (size_t i = 0; i < 65536; ++i) {
+      pcm[offset + i] = static_cast<int16_t>(i);
+    }
+    Lin2MuLaw(&pcm[offset], &mu_law[offset], 65536 - offset);
+    for (size_t i = 0; i < 65536 - offset; ++i) {
+      num_errors += mu_law[offset + i] != Lin2MuLaw(pcm[offset + i]);
+    }
+  }
+  printf("Block encoding errors: %d\n", int(num_errors));
+  
+  // Grain readers, for all codes.
+  for (size_t i = 0; i < 256; ++i) {
+    mu_law[i] = i;
+  }
+  num_errors = 0;
+  for (size_t i = 0; i < 256; ++i) {
+    int32_t indices[kSimdWidth];
+    for (size_t j = 0; j < kSimdWidth; ++j) {
+      indices[j] = (i + j * 37) & 255;
+    }
+    SimdFloat taps[4];
+    GatherMuLawQuads((const int8_t*)(&mu_law[0]), indices, taps);
+    for (size_t k = 0; k < 4; ++k) {
+      float values[kSimdWidth];
+      taps[k].Store(values);
+      for (size_t j = 0; j < kSimdWidth; ++j) {
+        num_errors += values[j] != MuLaw2Lin(mu_law[indices[j] + k]);
+      }
+    }
+  }
+  printf("Grain reader errors: %d\n", int(num_errors));
+  
+  // Block writes, against sample by sample writes - including the wrapping
+  // of the write head and clipping.
+  const int32_t kBufferSize = 1000;
+  static int8_t memory[2][kBufferSize];
+  static int16_t tail[2][kInterpolationTail];
+  static AudioBuffer<RESOLUTION_8_BIT_MU_LAW> buffer[2];
+  buffer[0].Init(&memory[0][0], kBufferSize, &tail[0][0]);
+  buffer[1].Init(&memory[1][0], kBufferSize, &tail[1][0]);
+  for (int32_t t = 0; t < 10000; t += kBlockSize) {
+    float in[kBlockSize * 2];
+    for (size_t i = 0; i < kBlockSize * 2; ++i) {
+      in[i] = 3.0f * (Random::GetFloat() - 0.5f);
+    }
+    buffer[0].WriteFade(&in[1], kBlockSize, 2, true);
+    for (size_t i = 0; i < kBlockSize; ++i) {
+      buffer[1].Write(in[2 * i + 1]);
+    }
+  }
+  printf(
+      "Block write errors: %d\n",
+      memcmp(memory[0], memory[1], kBufferSize) != 0 ||
+          buffer[0].head() != buffer[1].head());
+}
+
+void BenchmarkMuLaw() {
+  const size_t kSize = 4096;
+  const size_t kNumIterations = 10000;
+  
+  static int16_t pcm[kSize];
+  static uint8_t mu_law[kSize + 4];
+  static int32_t indices[kSize];
+  for (size_t i = 0; i < kSize; ++i) {
+    pcm[i] = Random::GetSample();
+    mu_law[i] = Random::GetWord();
+    indices[i] = Random::GetWord() % kSize;
+  }
+  
+  // Encoding, and decoding of the 4 taps read by a grain.
+  double ns[2][2];
+  uint32_t checksum = 0;
+  for (int32_t block = 0; block < 2; ++block) {
+    clock_t start = clock();
+    for (size_t n = 0; n < kNumIterations; ++n) {
+      if (block) {
+        Lin2MuLaw(pcm, mu_law, kSize);
+      } else {
+        for (size_t i = 0; i < kSize; ++i) {
+          mu_law[i] = Lin2MuLaw(pcm[i]);
+        }
+      }
+      checksum += mu_law[n % kSize];
+    }
+    ns[0][block] = double(clock() - start);
+    
+    start = clock();
+    for (size_t n = 0; n < kNumIterations; ++n) {
+      SimdFloat sum = 0.0f;
+      for (size_t i = 0; i < kSize; i += kSimdWidth) {
+        SimdFloat taps[4];
+        if (block) {
+          GatherMuLawQuads((const int8_t*)(mu_law), &indices[i], taps);
+        } else {
+          float values[4][kSimdWidth];
+          for (size_t j = 0; j < kSimdWidth; ++j) {
+            const uint8_t* s = &mu_law[indices[i + j]];
+            for (size_t k = 0; k < 4; ++k) {
+              values[k][j] = MuLaw2Lin(s[k]);
+            }
+          }
+          for (size_t k = 0; k < 4; ++k) {
+            taps[k] = SimdFloat::Load(values[k]);
+          }
+        }
+        sum += taps[0] + taps[1] + taps[2] + taps[3];
+      }
+      float values[kSimdWidth];
+      sum.Store(values);
+      checksum += values[0];
+    }
+    ns[1][block] = double(clock() - start);
+  }
+  
+  const char* kNames[] = { "encode", "grain taps" };
+  const double kSamples[] = { 1.0, 4.0 };
+  printf("            Msamples/s\n");
+  printf("            scalar   simd\n");
+  for (size_t i = 0; i < 2; ++i) {
+    double samples = kSamples[i] * kSize * kNumIterations;
+    printf(
+        "%-10s  %6.0f   %6.0f   (x%.1f)\n",
+        kNames[i],
+        samples / ns[i][0] * CLOCKS_PER_SEC * 1e-6,
+        samples / ns[i][1] * CLOCKS_PER_SEC * 1e-6,
+        ns[i][0] / ns[i][1]);
+  }
+  printf("(checksum: %08x)\n", checksum);
+}
+
 int main(void) {
   _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
   TestDSP();
   // TestGrainSize();
+  // BenchmarkLargeBuffer();
+  // TestLongLoopingDelay();
+  // TestGrainBank();
+  // BenchmarkGrains();
+  // BenchmarkProcessorPool();
+  // TestPrepareWorker();
+  // BenchmarkPrepareWorker();
+  // TestCorrelator();
+  // BenchmarkCorrelator();
+  // TestFFT();
+  // BenchmarkFFT();
+  // BenchmarkPhaseVocoder();
+  // TestFx();
+  // BenchmarkFx();
+  // BenchmarkSampleStream();
+  // TestMuLaw();
+  // BenchmarkMuLaw();
 }
@@ -0,0 +1,230 @@
+// Copyright 2014 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Runs the background work of GranularProcessor::Prepare() on another
+// thread.
+
+#include "clouds/test/prepare_worker.h"
+
+#include <algorithm>
+
+#include "clouds/test/spin_wait.h"
+
+namespace clouds {
+
+using namespace std;
+
+void PrepareJob::Init(GranularProcessor* processor) {
+  processor_ = processor;
+  spectral_ = false;
+  type_ = PREPARE_JOB_NONE;
+  // The first frame handed over is the one of the left channel.
+  channel_ = 1;
+  num_requests_ = 0;
+  num_results_ = 0;
+  late_ = false;
+  num_late_frames_ = 0;
+  
+  const size_t correlator_block_size = (kMaxWSOLASize / 32) + 2;
+  search_.Init(&search_data_[0], &search_data_[correlator_block_size]);
+  ResetFrames();
+}
+
+void PrepareJob::ResetFrames() {
+  for (int32_t i = 0; i < 2; ++i) {
+    fill(&previous_frame_[i][0], &previous_frame_[i][kMaxFftSize], 0.0f);
+  }
+}
+
+bool PrepareWorker::Start() {
+  read_ptr_ = 0;
+  write_ptr_ = 0;
+  num_requests_ = 0;
+  num_dropped_requests_ = 0;
+  max_latency_ = 0;
+  // pthread_create() publishes the state above to the new thread.
+  running_ = true;
+  if (pthread_create(&thread_, NULL, &EntryPoint, this)) {
+    running_ = false;
+    return false;
+  }
+  return true;
+}
+
+void PrepareWorker::Stop() {
+  if (!running_) {
+    return;
+  }
+  Spinner spinner;
+  while (__atomic_load_n(&read_ptr_, __ATOMIC_ACQUIRE) != write_ptr_) {
+    spinner.Pause();
+  }
+  __atomic_store_n(&running_, false, __ATOMIC_RELAXED);
+  pthread_join(thread_, NULL);
+}
+
+void PrepareWorker::Collect(PrepareJob* job) {
+  GranularProcessor* processor = job->processor_;
+  PhaseVocoder* phase_vocoder = processor->mutable_phase_vocoder();
+  bool done = job->in_flight() && job->ready();
+  
+  if (done && job->type_ == PREPARE_JOB_SEARCH) {
+    Correlator* correlator = processor->mutable_correlator();
+    // Unless the search has been overtaken by the next one.
+    if (correlator->done()) {
+      correlator->TakeOver(job->search_);
+    }
+    job->type_ = PREPARE_JOB_NONE;
+  } else if (done && job->type_ == PREPARE_JOB_FRAME) {
+    STFT* stft = phase_vocoder->mutable_stft(job->channel_);
+    if (!job->late_) {
+      stft->AddFrame(job->frame_);
+    }
+    // Even when late, the frame is the freshest replacement for the next
+    // one.
+    copy(
+        &job->frame_[0],
+        &job->frame_[phase_vocoder->fft_size()],
+        &job->previous_frame_[job->channel_][0]);
+    job->type_ = PREPARE_JOB_NONE;
+  }
+  
+  if (!job->spectral_) {
+    return;
+  }
+  for (int32_t i = 0; i < phase_vocoder->num_channels(); ++i) {
+    STFT* stft = phase_vocoder->mutable_stft(i);
+    while (stft->frame_due()) {
+      if (job->type_ == PREPARE_JOB_FRAME && job->channel_ == i) {
+        job->late_ = true;
+      }
+      stft->AddFrame(job->previous_frame_[i]);
+      ++job->num_late_frames_;
+    }
+  }
+}
+
+bool PrepareWorker::Request(PrepareJob* job) {
+  ++num_requests_;
+  if (job->in_flight()) {
+    return true;
+  }
+  
+  GranularProcessor* processor = job->processor_;
+  if (processor->BeginPrepare()) {
+    job->ResetFrames();
+  }
+  job->spectral_ = processor->playback_mode() == PLAYBACK_MODE_SPECTRAL;
+  
+  // Picks the piece of work to hand over. The channels take turns.
+  PrepareJobType type = PREPARE_JOB_NONE;
+  int32_t channel = 0;
+  Correlator* correlator = processor->mutable_correlator();
+  PhaseVocoder* phase_vocoder = processor->mutable_phase_vocoder();
+  if (processor->playback_mode() == PLAYBACK_MODE_STRETCH) {
+    if (!correlator->done()) {
+      type = PREPARE_JOB_SEARCH;
+    }
+  } else if (job->spectral_) {
+    int32_t num_channels = phase_vocoder->num_channels();
+    for (int32_t i = 1; i <= num_channels; ++i) {
+      channel = (job->channel_ + i) % num_channels;
+      if (phase_vocoder->mutable_stft(channel)->pending()) {
+        type = PREPARE_JOB_FRAME;
+        break;
+      }
+    }
+  }
+  if (type == PREPARE_JOB_NONE) {
+    return true;
+  }
+  
+  uint32_t write_ptr = write_ptr_;
+  uint32_t read_ptr = __atomic_load_n(&read_ptr_, __ATOMIC_ACQUIRE);
+  if (write_ptr - read_ptr >= kPrepareQueueSize) {
+    ++num_dropped_requests_;
+    return false;
+  }
+  
+  if (type == PREPARE_JOB_SEARCH) {
+    correlator->HandOver(&job->search_);
+  } else {
+    phase_vocoder->mutable_stft(channel)->LoadFrame();
+    job->parameters_ = processor->parameters();
+    job->late_ = false;
+  }
+  job->type_ = type;
+  job->channel_ = channel;
+  clock_gettime(CLOCK_MONOTONIC, &job->time_);
+  ++job->num_requests_;
+  queue_[write_ptr & (kPrepareQueueSize - 1)] = job;
+  // Publishes the request, and the state handed over with it.
+  __atomic_store_n(&write_ptr_, write_ptr + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+/* static */
+void* PrepareWorker::EntryPoint(void* worker) {
+  static_cast<PrepareWorker*>(worker)->Work();
+  return NULL;
+}
+
+void PrepareWorker::Work() {
+  Spinner spinner;
+  while (__atomic_load_n(&running_, __ATOMIC_RELAXED)) {
+    uint32_t read_ptr = read_ptr_;
+    if (read_ptr == __atomic_load_n(&write_ptr_, __ATOMIC_ACQUIRE)) {
+      spinner.Pause();
+      continue;
+    }
+    spinner.Reset();
+    
+    PrepareJob* job = queue_[read_ptr & (kPrepareQueueSize - 1)];
+    if (job->type_ == PREPARE_JOB_SEARCH) {
+      while (!job->search_.done()) {
+        job->search_.EvaluateSomeCandidates();
+      }
+    } else {
+      STFT* stft = job->processor_->mutable_phase_vocoder()->mutable_stft(
+          job->channel_);
+      job->frame_ = stft->TransformFrame(&job->parameters_);
+    }
+    
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t latency = int64_t(now.tv_sec - job->time_.tv_sec) * 1000000000 + \
+        (now.tv_nsec - job->time_.tv_nsec);
+    if (latency > max_latency_) {
+      __atomic_store_n(&max_latency_, uint32_t(latency), __ATOMIC_RELAXED);
+    }
+    
+    // Publishes the result, and frees the slot.
+    __atomic_store_n(&job->num_results_, job->num_requests_, __ATOMIC_RELEASE);
+    __atomic_store_n(&read_ptr_, read_ptr + 1, __ATOMIC_RELEASE);
+  }
+}
+
+}  // namespace clouds
@@ -0,0 +1,176 @@
+// Copyright 2014 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Runs the background work of GranularProcessor::Prepare() on another
+// thread, without ever blocking the audio thread.
+//
+// On the hardware, Prepare() is polled from the main loop and is interrupted
+// by Process(). On a desktop host the two would run concurrently, so the work
+// is handed over instead, one piece at a time: a correlator search, or one
+// STFT frame. After each Process(), the audio thread calls Request(), which
+// re-lays out the buffers if the settings have changed, loads the correlator
+// or the next STFT frame, and queues the piece. The worker writes its result
+// into memory that the audio thread leaves alone while the piece is in
+// flight - a copy of the correlator, or the FFT buffers - and publishes it
+// with a release store. Before each Process(), the audio thread calls
+// Collect(), which folds a published result into the processor's state. If
+// the worker is late, Collect() does not wait: the processor goes on with
+// the best match found so far - the unaligned position - or overlap-adds
+// the previous output frame of the channel in place of the missing one,
+// and the late result is dropped. The worker polls the queue rather than
+// sleeping, and keeps a core busy.
+
+#ifndef CLOUDS_TEST_PREPARE_WORKER_H_
+#define CLOUDS_TEST_PREPARE_WORKER_H_
+
+#include "stmlib/stmlib.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#include "clouds/dsp/granular_processor.h"
+
+namespace clouds {
+
+// A power of 2. Each processor has at most one piece of work in flight.
+const uint32_t kPrepareQueueSize = 8;
+
+enum PrepareJobType {
+  PREPARE_JOB_NONE,
+  PREPARE_JOB_SEARCH,
+  PREPARE_JOB_FRAME
+};
+
+// The work handed over for one processor, and its results.
+class PrepareJob {
+ public:
+  PrepareJob() { }
+  ~PrepareJob() { }
+  
+  void Init(GranularProcessor* processor);
+  
+  // From Request() handing a piece of work over, to the Collect() picking up
+  // its result.
+  inline bool in_flight() const { return type_ != PREPARE_JOB_NONE; }
+  
+  // Nothing is in flight, or its result is ready to collect.
+  inline bool ready() const {
+    return !in_flight() || \
+        __atomic_load_n(&num_results_, __ATOMIC_ACQUIRE) == num_requests_;
+  }
+  
+  // STFT frames replaced by the previous frame of their channel, because the
+  // worker was late.
+  inline uint32_t num_late_frames() const { return num_late_frames_; }
+  
+ private:
+  friend class PrepareWorker;
+  
+  void ResetFrames();
+  
+  GranularProcessor* processor_;
+  
+  // The buffers are laid out for the spectral mode.
+  bool spectral_;
+  
+  // Written by the audio thread, and only read by the worker while the job
+  // is in flight.
+  PrepareJobType type_;
+  int32_t channel_;
+  Parameters parameters_;
+  timespec time_;
+  uint32_t num_requests_;
+  
+  // Written by the worker. num_results_ catches up with num_requests_, with a
+  // release store, when the result is ready.
+  uint32_t num_results_;
+  Correlator search_;
+  const float* frame_;
+  
+  // The STFT frame in flight has already been replaced.
+  bool late_;
+  uint32_t num_late_frames_;
+  
+  uint32_t search_data_[((kMaxWSOLASize / 32) + 2) * 3];
+  float previous_frame_[2][kMaxFftSize];
+  
+  DISALLOW_COPY_AND_ASSIGN(PrepareJob);
+};
+
+class PrepareWorker {
+ public:
+  PrepareWorker() { }
+  ~PrepareWorker() { }
+  
+  // Returns false if the thread could not be started.
+  bool Start();
+  // Completes the queued requests before stopping the thread. Their results
+  // are left for the next Collect().
+  void Stop();
+  
+  // Called from the audio thread before Process(). Never blocks.
+  void Collect(PrepareJob* job);
+  
+  // Called from the audio thread after Process(). Never blocks. Does nothing
+  // while the job is in flight - a change of settings then takes effect once
+  // the result has been collected. When the queue is full, the request is
+  // dropped and the pending work stays with the processor, for the next
+  // request. Returns false when the request was dropped.
+  bool Request(PrepareJob* job);
+  
+  inline uint32_t num_requests() const { return num_requests_; }
+  inline uint32_t num_dropped_requests() const {
+    return num_dropped_requests_;
+  }
+  
+  // Longest time between a request and the end of its processing, in ns.
+  inline uint32_t max_latency() const {
+    return __atomic_load_n(&max_latency_, __ATOMIC_RELAXED);
+  }
+  
+ private:
+  static void* EntryPoint(void* worker);
+  void Work();
+  
+  // The pointers and flags shared with the worker are accessed through the
+  // __atomic builtins.
+  PrepareJob* queue_[kPrepareQueueSize];
+  uint32_t read_ptr_;
+  uint32_t write_ptr_;
+  bool running_;
+  
+  uint32_t num_requests_;
+  uint32_t num_dropped_requests_;
+  uint32_t max_latency_;
+  
+  pthread_t thread_;
+  
+  DISALLOW_COPY_AND_ASSIGN(PrepareWorker);
+};
+
+}  // namespace clouds
+
+#endif  // CLOUDS_TEST_PREPARE_WORKER_H_
@@ -0,0 +1,137 @@
+// Copyright 2014 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Runs several GranularProcessor instances in parallel on worker threads.
+
+#include "clouds/test/processor_pool.h"
+
+#include <algorithm>
+
+#include "clouds/test/spin_wait.h"
+
+namespace clouds {
+
+using namespace std;
+
+bool ProcessorPool::Init(
+    GranularProcessor** processors,
+    size_t num_processors,
+    size_t num_workers) {
+  num_processors_ = min(num_processors, kMaxNumPoolProcessors);
+  num_workers_ = max(min(num_workers, kMaxNumPoolWorkers), size_t(1));
+  num_workers_ = min(num_workers_, num_processors_);
+  for (size_t i = 0; i < num_processors_; ++i) {
+    processors_[i] = processors[i];
+    parameters_[i] = processors[i]->parameters();
+    input_[i] = NULL;
+    output_[i] = NULL;
+  }
+  size_ = 0;
+  generation_ = 0;
+  num_processed_ = 0;
+  num_prepared_ = 0;
+  running_ = true;
+  __sync_synchronize();
+  
+  for (size_t i = 0; i < num_workers_; ++i) {
+    workers_[i].pool = this;
+    workers_[i].index = i;
+    if (pthread_create(
+            &workers_[i].thread,
+            NULL,
+            &WorkerEntryPoint,
+            &workers_[i])) {
+      num_workers_ = i;
+      Stop();
+      return false;
+    }
+  }
+  return true;
+}
+
+void ProcessorPool::Stop() {
+  running_ = false;
+  __sync_synchronize();
+  __sync_fetch_and_add(&generation_, 1);
+  for (size_t i = 0; i < num_workers_; ++i) {
+    pthread_join(workers_[i].thread, NULL);
+  }
+  num_workers_ = 0;
+}
+
+void ProcessorPool::Process(
+    ShortFrame* const* input,
+    ShortFrame* const* output,
+    size_t size) {
+  // Workers have all started the previous block, since they have processed
+  // it: the block can be overwritten.
+  copy(&input[0], &input[num_processors_], &input_[0]);
+  copy(&output[0], &output[num_processors_], &output_[0]);
+  size_ = size;
+  __sync_synchronize();
+  uint32_t generation = __sync_add_and_fetch(&generation_, 1);
+  SpinWaitFor(&num_processed_, generation * num_processors_);
+}
+
+void ProcessorPool::Sync() {
+  __sync_synchronize();
+  SpinWaitFor(&num_prepared_, generation_ * num_processors_);
+}
+
+/* static */
+void* ProcessorPool::WorkerEntryPoint(void* worker) {
+  Worker* w = static_cast<Worker*>(worker);
+  w->pool->Work(w->index);
+  return NULL;
+}
+
+void ProcessorPool::Work(size_t index) {
+  uint32_t generation = 0;
+  while (true) {
+    SpinWaitFor(&generation_, generation + 1);
+    generation = generation_;
+    if (!running_) {
+      break;
+    }
+    
+    // Instances are dealt to the workers in turn.
+    uint32_t num_instances = 0;
+    for (size_t i = index; i < num_processors_; i += num_workers_) {
+      GranularProcessor* processor = processors_[i];
+      *processor->mutable_parameters() = parameters_[i];
+      processor->Process(input_[i], output_[i], size_);
+      ++num_instances;
+    }
+    __sync_fetch_and_add(&num_processed_, num_instances);
+    
+    for (size_t i = index; i < num_processors_; i += num_workers_) {
+      processors_[i]->Prepare();
+    }
+    __sync_fetch_and_add(&num_prepared_, num_instances);
+  }
+}
+
+}  // namespace clouds
@@ -0,0 +1,124 @@
+// Copyright 2014 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Runs several GranularProcessor instances in parallel on worker threads, for
+// hosts processing many channels.
+//
+// Each instance is owned by one worker. For every block, the calling thread
+// publishes the block to the workers, and waits until all of them have
+// rendered their instances. Each worker then runs Prepare() on its instances
+// in the background, while the caller moves on - the next block of an
+// instance is rendered only once its Prepare() is complete.
+//
+// Block parameters are passed through mutable_parameters(), and copied into
+// the instance by its worker before rendering. Other settings (playback mode,
+// quality...) can only be changed after Sync(), which waits for the workers
+// to be idle. Idle workers poll for the next block rather than sleep, so
+// that the hand-off does not involve any lock or system call.
+//
+// Each instance has its own random generators: the output does not depend on
+// the number of workers.
+
+#ifndef CLOUDS_TEST_PROCESSOR_POOL_H_
+#define CLOUDS_TEST_PROCESSOR_POOL_H_
+
+#include "stmlib/stmlib.h"
+
+#include <pthread.h>
+
+#include "clouds/dsp/frame.h"
+#include "clouds/dsp/granular_processor.h"
+#include "clouds/dsp/parameters.h"
+
+namespace clouds {
+
+const size_t kMaxNumPoolProcessors = 64;
+const size_t kMaxNumPoolWorkers = 16;
+
+class ProcessorPool {
+ public:
+  ProcessorPool() { }
+  ~ProcessorPool() { }
+  
+  // The processors must be initialized. Returns false if the worker threads
+  // could not be started.
+  bool Init(
+      GranularProcessor** processors,
+      size_t num_processors,
+      size_t num_workers);
+  void Stop();
+  
+  // Renders one block with each processor, and returns when all outputs have
+  // been written.
+  void Process(
+      ShortFrame* const* input,
+      ShortFrame* const* output,
+      size_t size);
+  
+  // Waits until all the pending Prepare() calls are complete.
+  void Sync();
+  
+  inline Parameters* mutable_parameters(size_t index) {
+    return &parameters_[index];
+  }
+  
+  inline size_t num_workers() const { return num_workers_; }
+  
+ private:
+  struct Worker {
+    ProcessorPool* pool;
+    size_t index;
+    pthread_t thread;
+  };
+  
+  static void* WorkerEntryPoint(void* worker);
+  void Work(size_t index);
+  
+  GranularProcessor* processors_[kMaxNumPoolProcessors];
+  Parameters parameters_[kMaxNumPoolProcessors];
+  size_t num_processors_;
+  
+  Worker workers_[kMaxNumPoolWorkers];
+  size_t num_workers_;
+  
+  // Block published to the workers.
+  ShortFrame* input_[kMaxNumPoolProcessors];
+  ShortFrame* output_[kMaxNumPoolProcessors];
+  size_t size_;
+  
+  // All counters only increase (and wrap around): the number of blocks
+  // published, and the number of instances processed and prepared.
+  volatile uint32_t generation_;
+  volatile uint32_t num_processed_;
+  volatile uint32_t num_prepared_;
+  volatile bool running_;
+  
+  DISALLOW_COPY_AND_ASSIGN(ProcessorPool);
+};
+
+}  // namespace clouds
+
+#endif  // CLOUDS_TEST_PROCESSOR_POOL_H_
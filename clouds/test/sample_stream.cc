@@ -0,0 +1,224 @@
+// Copyright 2014 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Streams WAV files into and out of the recording buffers of a
+// GranularProcessor.
+
+#include "clouds/test/sample_stream.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace clouds {
+
+using namespace std;
+
+const uint16_t kWavFormatPcm = 1;
+const uint16_t kWavFormatMuLaw = 7;
+
+// WAV files are little-endian, like the hosts this runs on.
+struct WavFormat {
+  uint16_t tag;
+  uint16_t num_channels;
+  uint32_t sample_rate;
+  uint32_t byte_rate;
+  uint16_t block_align;
+  uint16_t bits_per_sample;
+};
+
+bool SampleStream::ReadHeader(
+    FILE* fp,
+    SampleFormat* format,
+    int32_t* num_channels,
+    uint32_t* data_size) {
+  char id[4];
+  uint32_t size;
+  if (fread(id, 4, 1, fp) != 1 || memcmp(id, "RIFF", 4) ||
+      fread(&size, 4, 1, fp) != 1 ||
+      fread(id, 4, 1, fp) != 1 || memcmp(id, "WAVE", 4)) {
+    return false;
+  }
+  
+  bool has_format = false;
+  while (fread(id, 4, 1, fp) == 1 && fread(&size, 4, 1, fp) == 1) {
+    if (!memcmp(id, "data", 4)) {
+      *data_size = size;
+      return has_format;
+    }
+    if (!memcmp(id, "fmt ", 4) && size >= sizeof(WavFormat)) {
+      WavFormat f;
+      if (fread(&f, sizeof(f), 1, fp) != 1) {
+        return false;
+      }
+      if (f.tag == kWavFormatPcm && f.bits_per_sample == 16) {
+        *format = SAMPLE_FORMAT_PCM_16;
+      } else if (f.tag == kWavFormatMuLaw && f.bits_per_sample == 8) {
+        *format = SAMPLE_FORMAT_MU_LAW;
+      } else {
+        return false;
+      }
+      *num_channels = f.num_channels;
+      has_format = true;
+      size -= sizeof(f);
+    }
+    // Skip the rest of the chunk, and the padding byte of odd-sized chunks.
+    if (fseek(fp, size + (size & 1), SEEK_CUR)) {
+      return false;
+    }
+  }
+  return false;
+}
+
+void SampleStream::WriteHeader(
+    FILE* fp,
+    SampleFormat format,
+    int32_t num_channels,
+    uint32_t sample_rate,
+    uint32_t data_size) {
+  bool mu_law = format == SAMPLE_FORMAT_MU_LAW;
+  WavFormat f;
+  f.tag = mu_law ? kWavFormatMuLaw : kWavFormatPcm;
+  f.num_channels = num_channels;
+  f.sample_rate = sample_rate;
+  f.bits_per_sample = mu_law ? 8 : 16;
+  f.block_align = num_channels * f.bits_per_sample / 8;
+  f.byte_rate = sample_rate * f.block_align;
+  
+  // Formats other than PCM have an (empty) extension field in the format
+  // chunk, and a "fact" chunk holding the number of frames.
+  uint32_t format_size = sizeof(f) + (mu_law ? 2 : 0);
+  uint32_t riff_size = 4 + 8 + format_size + (mu_law ? 12 : 0) + \
+      8 + data_size + (data_size & 1);
+  fwrite("RIFF", 4, 1, fp);
+  fwrite(&riff_size, 4, 1, fp);
+  fwrite("WAVE", 4, 1, fp);
+  fwrite("fmt ", 4, 1, fp);
+  fwrite(&format_size, 4, 1, fp);
+  fwrite(&f, sizeof(f), 1, fp);
+  if (mu_law) {
+    uint16_t extension_size = 0;
+    uint32_t fact_size = 4;
+    uint32_t num_frames = data_size / f.block_align;
+    fwrite(&extension_size, 2, 1, fp);
+    fwrite("fact", 4, 1, fp);
+    fwrite(&fact_size, 4, 1, fp);
+    fwrite(&num_frames, 4, 1, fp);
+  }
+  fwrite("data", 4, 1, fp);
+  fwrite(&data_size, 4, 1, fp);
+}
+
+bool SampleStream::Load(const char* file_name, GranularProcessor* processor) {
+  num_bytes_ = 0;
+  if (processor->playback_mode() == PLAYBACK_MODE_SPECTRAL) {
+    return false;
+  }
+  FILE* fp = fopen(file_name, "rb");
+  if (!fp) {
+    return false;
+  }
+  
+  SampleFormat format;
+  int32_t num_channels;
+  uint32_t data_size;
+  if (!ReadHeader(fp, &format, &num_channels, &data_size) ||
+      num_channels != processor->num_channels()) {
+    fclose(fp);
+    return false;
+  }
+  
+  bool mu_law = format == SAMPLE_FORMAT_MU_LAW;
+  size_t frame_size = num_channels * (mu_law ? 1 : 2);
+  size_t chunk_size = sizeof(chunk_) / frame_size;
+  size_t remaining = data_size / frame_size;
+  while (remaining) {
+    size_t n = fread(chunk_, frame_size, min(remaining, chunk_size), fp);
+    if (!n) {
+      break;
+    }
+    if (mu_law) {
+      processor->ImportFrames(reinterpret_cast<uint8_t*>(chunk_), n);
+    } else {
+      processor->ImportFrames(chunk_, n);
+    }
+    num_bytes_ += n * frame_size;
+    remaining -= n;
+  }
+  fclose(fp);
+  return true;
+}
+
+bool SampleStream::Save(
+    const char* file_name,
+    const GranularProcessor& processor,
+    SampleFormat format) {
+  num_bytes_ = 0;
+  size_t num_frames = processor.recording_size();
+  if (!num_frames) {
+    return false;
+  }
+  FILE* fp = fopen(file_name, "wb");
+  if (!fp) {
+    return false;
+  }
+  
+  bool mu_law = format == SAMPLE_FORMAT_MU_LAW;
+  size_t frame_size = processor.num_channels() * (mu_law ? 1 : 2);
+  
+  // The size of a WAV file is limited to 4GB. Beyond, only the most recent
+  // frames are saved.
+  size_t max_num_frames = (0xffffffff - 64) / frame_size;
+  size_t position = num_frames > max_num_frames
+      ? num_frames - max_num_frames
+      : 0;
+  uint32_t data_size = (num_frames - position) * frame_size;
+  WriteHeader(
+      fp,
+      format,
+      processor.num_channels(),
+      processor.sample_rate(),
+      data_size);
+  
+  size_t chunk_size = sizeof(chunk_) / frame_size;
+  while (position < num_frames) {
+    size_t n = mu_law
+        ? processor.ExportFrames(
+              position, reinterpret_cast<uint8_t*>(chunk_), chunk_size)
+        : processor.ExportFrames(position, chunk_, chunk_size);
+    if (fwrite(chunk_, frame_size, n, fp) != n) {
+      fclose(fp);
+      return false;
+    }
+    num_bytes_ += n * frame_size;
+    position += n;
+  }
+  if (data_size & 1) {
+    fputc(0, fp);
+  }
+  return fclose(fp) == 0;
+}
+
+}  // namespace clouds
@@ -0,0 +1,99 @@
+// Copyright 2014 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Streams WAV files into and out of the recording buffers of a
+// GranularProcessor.
+//
+// The file is read or written one chunk at a time, through the processor's
+// ImportFrames() and ExportFrames(), so a recording buffer holding hours of
+// audio (see set_recording_buffer()) can be saved or restored without
+// holding a second copy of it in memory. Files are either 16-bit PCM or 8-bit
+// mu-law. The mu-law encoding of the low fidelity buffers is the G.711 one,
+// so those buffers are saved to and loaded from mu-law files without any
+// conversion.
+
+#ifndef CLOUDS_TEST_SAMPLE_STREAM_H_
+#define CLOUDS_TEST_SAMPLE_STREAM_H_
+
+#include "stmlib/stmlib.h"
+
+#include <cstdio>
+
+#include "clouds/dsp/granular_processor.h"
+
+namespace clouds {
+
+enum SampleFormat {
+  SAMPLE_FORMAT_PCM_16,
+  SAMPLE_FORMAT_MU_LAW
+};
+
+// In bytes.
+const size_t kSampleStreamChunkSize = 65536;
+
+class SampleStream {
+ public:
+  SampleStream() { }
+  ~SampleStream() { }
+  
+  // Appends the contents of the file to the recording buffers - keeping only
+  // the most recent frames when the file is longer than the buffers. Returns
+  // false if the file cannot be read, is not a 16-bit PCM or mu-law file, has
+  // a different number of channels than the processor, or if the processor is
+  // in spectral mode. The sample rate is not checked.
+  bool Load(const char* file_name, GranularProcessor* processor);
+  
+  // Saves the whole recording buffers, oldest frame first.
+  bool Save(
+      const char* file_name,
+      const GranularProcessor& processor,
+      SampleFormat format);
+  
+  // Size of the audio data transferred by the last call to Load() or Save().
+  inline size_t num_bytes() const { return num_bytes_; }
+  
+ private:
+  bool ReadHeader(
+      FILE* fp,
+      SampleFormat* format,
+      int32_t* num_channels,
+      uint32_t* data_size);
+  void WriteHeader(
+      FILE* fp,
+      SampleFormat format,
+      int32_t num_channels,
+      uint32_t sample_rate,
+      uint32_t data_size);
+  
+  int16_t chunk_[kSampleStreamChunkSize / sizeof(int16_t)];
+  size_t num_bytes_;
+  
+  DISALLOW_COPY_AND_ASSIGN(SampleStream);
+};
+
+}  // namespace clouds
+
+#endif  // CLOUDS_TEST_SAMPLE_STREAM_H_
@@ -49,7 +49,8 @@ class AnalogSnareDrum {
 
   static const int kNumModes = 5;
 
-  void Init() {
+  void Init(float sample_rate) {
+    sample_rate_ = sample_rate;
     pulse_remaining_samples_ = 0;
     pulse_ = 0.0f;
     pulse_height_ = 0.0f;
@@ -75,8 +76,8 @@ class AnalogSnareDrum {
       float* out,
       size_t size) {
     const float decay_xt = decay * (1.0f + decay * (decay - 1.0f));
-    const int kTriggerPulseDuration = 1.0e-3 * kSampleRate;
-    const float kPulseDecayTime = 0.1e-3 * kSampleRate;
+    const int kTriggerPulseDuration = 1.0e-3 * sample_rate_;
+    const float kPulseDecayTime = 0.1e-3 * sample_rate_;
     const float q = 2000.0f * stmlib::SemitonesToRatio(decay_xt * 84.0f);
     const float noise_envelope_decay = 1.0f - 0.0017f * \
         stmlib::SemitonesToRatio(-decay * (50.0f + snappy * 10.0f));
@@ -180,6 +181,8 @@ class AnalogSnareDrum {
   }
 
  private:
+  float sample_rate_;
+
   int pulse_remaining_samples_;
   float pulse_;
   float pulse_height_;
@@ -44,11 +44,11 @@ class SyntheticBassDrumClick {
   SyntheticBassDrumClick() { }
   ~SyntheticBassDrumClick() { }
   
-  void Init() {
+  void Init(float sample_rate) {
     lp_ = 0.0f;
     hp_ = 0.0f;
     filter_.Init();
-    filter_.set_f_q<stmlib::FREQUENCY_FAST>(5000.0f / kSampleRate, 2.0f);
+    filter_.set_f_q<stmlib::FREQUENCY_FAST>(5000.0f / sample_rate, 2.0f);
   }
   
   float Process(float in) {
@@ -94,7 +94,8 @@ class SyntheticBassDrum {
   SyntheticBassDrum() { }
   ~SyntheticBassDrum() { }
 
-  void Init() {
+  void Init(float sample_rate) {
+    sample_rate_ = sample_rate;
     phase_ = 0.0f;
     phase_noise_ = 0.0f;
     f0_ = 0.0f;
@@ -107,7 +108,7 @@ class SyntheticBassDrum {
     tone_lp_ = 0.0f;
     sustain_gain_ = 0.0f;
     
-    click_.Init();
+    click_.Init(sample_rate);
     noise_.Init();
   }
   
@@ -147,11 +148,11 @@ class SyntheticBassDrum {
     dirtiness *= std::max(1.0f - 8.0f * f0, 0.0f);
     
     const float fm_decay = 1.0f - \
-        1.0f / (0.008f * (1.0f + fm_envelope_decay * 4.0f) * kSampleRate);
+        1.0f / (0.008f * (1.0f + fm_envelope_decay * 4.0f) * sample_rate_);
 
-    const float body_env_decay = 1.0f - 1.0f / (0.02f * kSampleRate) * \
+    const float body_env_decay = 1.0f - 1.0f / (0.02f * sample_rate_) * \
         stmlib::SemitonesToRatio(-decay * 60.0f);
-    const float transient_env_decay = 1.0f - 1.0f / (0.005f * kSampleRate);
+    const float transient_env_decay = 1.0f - 1.0f / (0.005f * sample_rate_);
     const float tone_f = std::min(
         4.0f * f0 * stmlib::SemitonesToRatio(tone * 108.0f),
         1.0f);
@@ -160,8 +161,8 @@ class SyntheticBassDrum {
     if (trigger) {
       fm_ = 1.0f;
       body_env_ = transient_env_ = 0.3f + 0.7f * accent;
-      body_env_pulse_width_ = kSampleRate * 0.001f;
-      fm_pulse_width_ = kSampleRate * 0.0013f;
+      body_env_pulse_width_ = sample_rate_ * 0.001f;
+      fm_pulse_width_ = sample_rate_ * 0.0013f;
     }
     
     stmlib::ParameterInterpolator sustain_gain(
@@ -220,6 +221,8 @@ class SyntheticBassDrum {
   }
 
  private:
+  float sample_rate_;
+
   float f0_;
   float phase_;
   float phase_noise_;
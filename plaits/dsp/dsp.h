@@ -47,7 +47,33 @@ static const float kSampleRate = 48000.0f;
 static const float kCorrectedSampleRate = 47872.34f;
 const float a0 = (440.0f / 8.0f) / kCorrectedSampleRate;
 
+// Constants depending on the sample rate at which a voice runs, computed once
+// when it is initialized. At kSampleRate, the pitch is still computed for the
+// actual rate of the hardware codec, as above.
+struct SampleRateConstants {
+  float sample_rate;
+  float corrected_sample_rate;
+  float a0;
+  
+  // Converts a normalized frequency tuned at kSampleRate.
+  float frequency_scale;
+  
+  void Init(float rate) {
+    sample_rate = rate;
+    corrected_sample_rate = rate == kSampleRate ? kCorrectedSampleRate : rate;
+    a0 = (440.0f / 8.0f) / corrected_sample_rate;
+    frequency_scale = kSampleRate / rate;
+  }
+};
+
+// The hardware renders blocks of kBlockSize samples. Other hosts can render
+// larger blocks, up to kMaxBlockSize - which sets the size of all the
+// temporary buffers used by the engines.
+#ifdef PLAITS_MAX_BLOCK_SIZE
+const size_t kMaxBlockSize = PLAITS_MAX_BLOCK_SIZE;
+#else
 const size_t kMaxBlockSize = 24;
+#endif  // PLAITS_MAX_BLOCK_SIZE
 const size_t kBlockSize = 12;
 
 }  // namespace plaits
@@ -47,25 +47,24 @@ void AdditiveEngine::Init(BufferAllocator* allocator) {
   for (int i = 0; i < kNumHarmonicOscillators; ++i) {
     harmonic_oscillator_[i].Init();
   }
+  snapshot_.Init();
 }
 
 void AdditiveEngine::Reset() {
 
 }
 
-void AdditiveEngine::UpdateAmplitudes(
+void AdditiveEngine::ComputeGains(
     float centroid,
     float slope,
     float bumps,
-    float* amplitudes,
+    float* gains,
     const int* harmonic_indices,
     size_t num_harmonics) {
   const float n = (static_cast<float>(num_harmonics) - 1.0f);
   const float margin = (1.0f / slope - 1.0f) / (1.0f + bumps);
   const float center = centroid * (n + margin) - 0.5f * margin;
 
-  float sum = 0.001f;
-
   for (size_t i = 0; i < num_harmonics; ++i) {
     float order = fabsf(static_cast<float>(i) - center) * slope;
     float gain = 1.0f - order;
@@ -79,6 +78,18 @@ void AdditiveEngine::UpdateAmplitudes(
     gain *= gain;
     gain *= gain;
     
+    gains[harmonic_indices[i]] = gain;
+  }
+}
+
+void AdditiveEngine::UpdateAmplitudes(
+    const float* gains,
+    float* amplitudes,
+    const int* harmonic_indices,
+    size_t num_harmonics) {
+  float sum = 0.001f;
+
+  for (size_t i = 0; i < num_harmonics; ++i) {
     int j = harmonic_indices[i];
     
     // Warning about the following line: this is not a proper LP filter because
@@ -89,7 +100,7 @@ void AdditiveEngine::UpdateAmplitudes(
     // normalized spectrum, and both of them cause more annoyances than this
     // "incorrect" solution.
     
-    ONE_POLE(amplitudes[j], gain, 0.001f);
+    ONE_POLE(amplitudes[j], gains[j], 0.001f);
     sum += amplitudes[j];
   }
 
@@ -128,10 +139,29 @@ void AdditiveEngine::Render(
   const float raw_slope = (1.0f - 0.6f * raw_bumps) * parameters.morph;
   const float slope = 0.01f + 1.99f * raw_slope * raw_slope * raw_slope;
   const float bumps = 16.0f * raw_bumps * raw_bumps;
+  
+  // The amplitudes keep converging towards the target spectrum, but the
+  // spectrum itself only depends on the parameters.
+  const float snapshot[] = { centroid, slope, bumps };
+  if (ParametersChanged(&snapshot_, snapshot)) {
+    ComputeGains(
+        centroid,
+        slope,
+        bumps,
+        &gains_[0],
+        integer_harmonics,
+        24);
+    ComputeGains(
+        centroid,
+        slope,
+        bumps,
+        &gains_[24],
+        organ_harmonics,
+        8);
+  }
+  
   UpdateAmplitudes(
-      centroid,
-      slope,
-      bumps,
+      &gains_[0],
       &amplitudes_[0],
       integer_harmonics,
       24);
@@ -139,9 +169,7 @@ void AdditiveEngine::Render(
   harmonic_oscillator_[1].Render<13>(f0, &amplitudes_[12], out, size);
 
   UpdateAmplitudes(
-      centroid,
-      slope,
-      bumps,
+      &gains_[24],
       &amplitudes_[24],
       organ_harmonics,
       8);
@@ -52,10 +52,15 @@ class AdditiveEngine : public Engine {
       bool* already_enveloped);
  
  private:
-  void UpdateAmplitudes(
+  void ComputeGains(
       float centroid,
       float slope,
       float bumps,
+      float* gains,
+      const int* harmonic_indices,
+      size_t num_harmonics);
+  void UpdateAmplitudes(
+      const float* gains,
       float* amplitudes,
       const int* harmonic_indices,
       size_t num_harmonics);
@@ -64,6 +69,10 @@ class AdditiveEngine : public Engine {
   
   float amplitudes_[kNumHarmonics];
   
+  // Target spectrum, only recomputed when the parameters change.
+  ParameterSnapshot<3> snapshot_;
+  float gains_[kNumHarmonics];
+  
   DISALLOW_COPY_AND_ASSIGN(AdditiveEngine);
 };
 
@@ -36,8 +36,8 @@ using namespace std;
 using namespace stmlib;
 
 void BassDrumEngine::Init(BufferAllocator* allocator) {
-  analog_bass_drum_.Init();
-  synthetic_bass_drum_.Init();
+  analog_bass_drum_.Init(rate_.sample_rate);
+  synthetic_bass_drum_.Init(rate_.sample_rate);
   overdrive_.Init();
 }
 
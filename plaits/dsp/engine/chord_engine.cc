@@ -59,14 +59,25 @@ void ChordEngine::Init(BufferAllocator* allocator) {
   chord_index_quantizer_.Init();
   morph_lp_ = 0.0f;
   timbre_lp_ = 0.0f;
+  snapshot_.Init();
   
-  ratios_ = allocator->Allocate<float>(kChordNumChords * kChordNumVoices);
+  ratios_ = shared_ratios_
+      ? NULL
+      : allocator->Allocate<float>(kChordNumChords * kChordNumVoices);
 }
 
 void ChordEngine::Reset() {
+  if (!shared_ratios_) {
+    ComputeRatios(ratios_);
+  }
+  snapshot_.Init();
+}
+
+/* static */
+void ChordEngine::ComputeRatios(float* ratios) {
   for (int i = 0; i < kChordNumChords; ++i) {
-    for (int j = 0; j < kChordNumVoices; ++j) {
-      ratios_[i * kChordNumVoices + j] = SemitonesToRatio(chords[i][j]);
+    for (int j = 0; j < kChordNumNotes; ++j) {
+      ratios[i * kChordNumVoices + j] = SemitonesToRatio(chords[i][j]);
     }
   }
 }
@@ -105,7 +116,8 @@ int ChordEngine::ComputeChordInversion(
     float inversion,
     float* ratios,
     float* amplitudes) {
-  const float* base_ratio = &ratios_[chord_index * kChordNumVoices];
+  const float* base_ratio = &(shared_ratios_ ? shared_ratios_ : ratios_)[
+      chord_index * kChordNumVoices];
   inversion = inversion * float(kChordNumNotes * 5);
 
   MAKE_INTEGRAL_FRACTIONAL(inversion);
@@ -180,19 +192,20 @@ void ChordEngine::Render(
   const int chord_index = chord_index_quantizer_.Process(
       parameters.harmonics * 1.02f, kChordNumChords);
 
-  float harmonics[kChordNumHarmonics * 2 + 2];
-  float note_amplitudes[kChordNumVoices];
-  float registration = max(1.0f - morph_lp_ * 2.15f, 0.0f);
-  
-  ComputeRegistration(registration, harmonics);
-  harmonics[kChordNumHarmonics * 2] = 0.0f;
-
-  float ratios[kChordNumVoices];
-  int aux_note_mask = ComputeChordInversion(
-      chord_index,
-      timbre_lp_,
-      ratios,
-      note_amplitudes);
+  // Once the smoothed parameters have settled, the registration and voicing
+  // are exactly the same as for the previous block.
+  const float snapshot[] = {
+      morph_lp_, timbre_lp_, static_cast<float>(chord_index) };
+  if (ParametersChanged(&snapshot_, snapshot)) {
+    float registration = max(1.0f - morph_lp_ * 2.15f, 0.0f);
+    ComputeRegistration(registration, harmonics_);
+    harmonics_[kChordNumHarmonics * 2] = 0.0f;
+    aux_note_mask_ = ComputeChordInversion(
+        chord_index,
+        timbre_lp_,
+        note_ratios_,
+        note_amplitudes_);
+  }
   
   fill(&out[0], &out[size], 0.0f);
   fill(&aux[0], &aux[size], 0.0f);
@@ -205,9 +218,9 @@ void ChordEngine::Render(
     CONSTRAIN(wavetable_amount, 0.0f, 1.0f);
 
     float divide_down_amount = 1.0f - wavetable_amount;
-    float* destination = (1 << note) & aux_note_mask ? aux : out;
+    float* destination = (1 << note) & aux_note_mask_ ? aux : out;
     
-    const float note_f0 = f0 * ratios[note];
+    const float note_f0 = f0 * note_ratios_[note];
     float divide_down_gain = 4.0f - note_f0 * 32.0f;
     CONSTRAIN(divide_down_gain, 0.0f, 1.0f);
     divide_down_amount *= divide_down_gain;
@@ -215,7 +228,7 @@ void ChordEngine::Render(
     if (wavetable_amount) {
       wavetable_voice_[note].Render(
           note_f0 * 1.004f,
-          note_amplitudes[note] * wavetable_amount,
+          note_amplitudes_[note] * wavetable_amount,
           waveform,
           wavetable,
           destination,
@@ -225,8 +238,8 @@ void ChordEngine::Render(
     if (divide_down_amount) {
       divide_down_voice_[note].Render(
           note_f0,
-          harmonics,
-          note_amplitudes[note] * divide_down_amount,
+          harmonics_,
+          note_amplitudes_[note] * divide_down_amount,
           destination,
           size);
     }
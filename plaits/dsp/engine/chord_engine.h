@@ -44,7 +44,7 @@ const int kChordNumHarmonics = 3;
 
 class ChordEngine : public Engine {
  public:
-  ChordEngine() { }
+  ChordEngine() : shared_ratios_(NULL) { }
   ~ChordEngine() { }
   
   virtual void Init(stmlib::BufferAllocator* allocator);
@@ -54,6 +54,16 @@ class ChordEngine : public Engine {
       float* aux,
       size_t size,
       bool* already_enveloped);
+  
+  // Fills a table of kChordNumChords * kChordNumVoices chord ratios.
+  static void ComputeRatios(float* ratios);
+  
+  // Uses a table filled by ComputeRatios() and shared with other instances,
+  // instead of a private copy rebuilt in the RAM block at each Reset().
+  // Must be called before Init().
+  inline void set_shared_ratios(const float* ratios) {
+    shared_ratios_ = ratios;
+  }
 
  private:
   void ComputeRegistration(float registration, float* amplitudes);
@@ -71,7 +81,16 @@ class ChordEngine : public Engine {
   float timbre_lp_;
   float previous_root_normalization_;
   
+  // Registration and voicing derived from the smoothed parameters. Only
+  // recomputed when they change.
+  ParameterSnapshot<3> snapshot_;
+  float harmonics_[kChordNumHarmonics * 2 + 2];
+  float note_ratios_[kChordNumVoices];
+  float note_amplitudes_[kChordNumVoices];
+  int aux_note_mask_;
+  
   float* ratios_;
+  const float* shared_ratios_;
   
   DISALLOW_COPY_AND_ASSIGN(ChordEngine);
 };
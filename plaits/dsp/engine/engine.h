@@ -29,6 +29,8 @@
 #ifndef PLAITS_DSP_ENGINE_ENGINE_H_
 #define PLAITS_DSP_ENGINE_ENGINE_H_
 
+#include <algorithm>
+
 #include "plaits/dsp/dsp.h"
 
 #include "stmlib/dsp/units.h"
@@ -36,10 +38,10 @@
 
 namespace plaits {
 
-inline float NoteToFrequency(float midi_note) {
+inline float NoteToFrequency(float midi_note, float normalized_a0) {
   midi_note -= 9.0f;
   CONSTRAIN(midi_note, -128.0f, 127.0f);
-  return a0 * 0.25f * stmlib::SemitonesToRatio(midi_note);
+  return normalized_a0 * 0.25f * stmlib::SemitonesToRatio(midi_note);
 }
 
 enum TriggerState {
@@ -75,9 +77,45 @@ struct PostProcessingSettings {
   bool already_enveloped;
 };
 
+// Values of the parameters from which an engine derived some coefficients
+// during the previous block. When they are exactly the same, the coefficients
+// can be reused instead of being recomputed.
+template<int num_parameters>
+class ParameterSnapshot {
+ public:
+  ParameterSnapshot() { }
+  ~ParameterSnapshot() { }
+  
+  // Also to be called whenever the coefficients are lost.
+  void Init() {
+    valid_ = false;
+  }
+  
+  // Stores the new values, and returns true if they differ from the
+  // previous ones.
+  inline bool Update(const float* values) {
+    if (valid_ && std::equal(&values[0], &values[num_parameters], values_)) {
+      return false;
+    }
+    std::copy(&values[0], &values[num_parameters], values_);
+    valid_ = true;
+    return true;
+  }
+  
+ private:
+  bool valid_;
+  float values_[num_parameters];
+  
+  DISALLOW_COPY_AND_ASSIGN(ParameterSnapshot);
+};
+
 class Engine {
  public:
-  Engine() { }
+  Engine() {
+    rate_.Init(kSampleRate);
+    num_tracked_blocks_ = 0;
+    num_fast_path_blocks_ = 0;
+  }
   ~Engine() { }
   virtual void Init(stmlib::BufferAllocator* allocator) = 0;
   virtual void Reset() = 0;
@@ -87,7 +125,44 @@ class Engine {
       float* aux,
       size_t size,
       bool* already_enveloped) = 0;
+  
+  // Must be called before Init.
+  inline void set_sample_rate(const SampleRateConstants& rate) {
+    rate_ = rate;
+  }
+  
+  // Number of blocks rendered since construction while tracking parameter
+  // changes, and number of them for which the block-rate coefficients were
+  // reused. Always 0 for the engines which do not use a ParameterSnapshot.
+  inline uint32_t num_tracked_blocks() const { return num_tracked_blocks_; }
+  inline uint32_t num_fast_path_blocks() const { return num_fast_path_blocks_; }
+  
   PostProcessingSettings post_processing_settings;
+  
+ protected:
+  template<int num_parameters>
+  inline bool ParametersChanged(
+      ParameterSnapshot<num_parameters>* snapshot,
+      const float* values) {
+    ++num_tracked_blocks_;
+    if (snapshot->Update(values)) {
+      return true;
+    }
+    ++num_fast_path_blocks_;
+    return false;
+  }
+  
+  // Hides the global function, so that engines follow the sample rate of
+  // their voice.
+  inline float NoteToFrequency(float midi_note) const {
+    return plaits::NoteToFrequency(midi_note, rate_.a0);
+  }
+  
+  SampleRateConstants rate_;
+  
+ private:
+  uint32_t num_tracked_blocks_;
+  uint32_t num_fast_path_blocks_;
 };
 
 template<int max_size>
@@ -104,6 +179,10 @@ class EngineRegistry {
     return engine_[index];
   }
   
+  inline const Engine* get(int index) const {
+    return engine_[index];
+  }
+  
   void RegisterInstance(
       Engine* instance,
       bool already_enveloped,
@@ -34,8 +34,8 @@ namespace plaits {
 using namespace stmlib;
 
 void HiHatEngine::Init(BufferAllocator* allocator) {
-  hi_hat_1_.Init();
-  hi_hat_2_.Init();
+  hi_hat_1_.Init(rate_.sample_rate);
+  hi_hat_2_.Init(rate_.sample_rate);
   temp_buffer_[0] = allocator->Allocate<float>(kMaxBlockSize);
   temp_buffer_[1] = allocator->Allocate<float>(kMaxBlockSize);
 }
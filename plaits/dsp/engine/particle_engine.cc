@@ -39,7 +39,7 @@ void ParticleEngine::Init(BufferAllocator* allocator) {
   for (int i = 0; i < kNumParticles; ++i) {
     particle_[i].Init();
   }
-  diffuser_.Init(allocator->Allocate<uint16_t>(8192));
+  diffuser_.Init(allocator->Allocate<uint16_t>(kDiffuserBufferSize));
   post_filter_.Init();
 }
 
@@ -36,8 +36,8 @@ using namespace std;
 using namespace stmlib;
 
 void SnareDrumEngine::Init(BufferAllocator* allocator) {
-  analog_snare_drum_.Init();
-  synthetic_snare_drum_.Init();
+  analog_snare_drum_.Init(rate_.sample_rate);
+  synthetic_snare_drum_.Init(rate_.sample_rate);
 }
 
 void SnareDrumEngine::Reset() {
@@ -36,13 +36,13 @@ using namespace std;
 using namespace stmlib;
 
 void SpeechEngine::Init(BufferAllocator* allocator) {
-  sam_speech_synth_.Init();
-  naive_speech_synth_.Init();
+  sam_speech_synth_.Init(rate_.sample_rate);
+  naive_speech_synth_.Init(rate_);
   lpc_speech_synth_word_bank_.Init(
       word_banks_,
       LPC_SPEECH_SYNTH_NUM_WORD_BANKS,
       allocator);
-  lpc_speech_synth_controller_.Init(&lpc_speech_synth_word_bank_);
+  lpc_speech_synth_controller_.Init(rate_, &lpc_speech_synth_word_bank_);
   word_bank_quantizer_.Init();
   
   temp_buffer_[0] = allocator->Allocate<float>(kMaxBlockSize);
@@ -38,11 +38,11 @@ using namespace stmlib;
 void StringEngine::Init(BufferAllocator* allocator) {
   temp_buffer_ = allocator->Allocate<float>(kMaxBlockSize);
   for (int i = 0; i < kNumStrings; ++i) {
-    voice_[i].Init(allocator);
+    voice_[i].Init(allocator, rate_.sample_rate);
     f0_[i] = 0.01f;
   }
   active_string_ = kNumStrings - 1;
-  f0_delay_.Init(allocator->Allocate<float>(16));
+  f0_delay_.Init(allocator->Allocate<float>(kStringEngineF0DelaySize));
 }
 
 void StringEngine::Reset() {
@@ -35,6 +35,7 @@
 namespace plaits {
 
 const int kNumStrings = 3;
+const size_t kStringEngineF0DelaySize = 16;
 
 class StringEngine : public Engine {
  public:
@@ -53,7 +54,7 @@ class StringEngine : public Engine {
   StringVoice voice_[kNumStrings];
 
   float f0_[kNumStrings];
-  DelayLine<float, 16> f0_delay_;
+  DelayLine<float, kStringEngineF0DelaySize> f0_delay_;
   int active_string_;
   float* temp_buffer_;
   
@@ -35,6 +35,8 @@
 
 namespace plaits {
 
+const size_t kDiffuserBufferSize = 8192;
+
 class Diffuser {
  public:
   Diffuser() { }
@@ -96,7 +98,7 @@ class Diffuser {
   }
   
  private:
-  typedef FxEngine<8192, FORMAT_12_BIT> E;
+  typedef FxEngine<kDiffuserBufferSize, FORMAT_12_BIT> E;
   E engine_;
   float lp_decay_;
   
@@ -0,0 +1,650 @@
+// Copyright 2016 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Banks of kSimdWidth independent oscillators running in lockstep, one per
+// SIMD lane. Each one is a sample-exact port of its scalar counterpart, the
+// per-lane branches of the polyBLEP code being replaced by masks.
+//
+// Parameters are given as arrays of kSimdWidth values. The output is
+// interleaved: out[i * kSimdWidth + lane].
+
+#ifndef PLAITS_DSP_OSCILLATOR_OSCILLATOR_BANK_H_
+#define PLAITS_DSP_OSCILLATOR_OSCILLATOR_BANK_H_
+
+#include "stmlib/stmlib.h"
+
+#include <algorithm>
+
+#include "plaits/dsp/oscillator/oscillator.h"
+#include "plaits/dsp/oscillator/variable_saw_oscillator.h"
+#include "plaits/dsp/simd.h"
+#include "plaits/resources.h"
+
+namespace plaits {
+
+// Vector versions of the functions from stmlib/dsp/polyblep.h.
+inline SimdFloat ThisBlepSample(SimdFloat t) {
+  return SimdFloat(0.5f) * t * t;
+}
+
+inline SimdFloat NextBlepSample(SimdFloat t) {
+  t = SimdFloat(1.0f) - t;
+  return SimdFloat(-0.5f) * t * t;
+}
+
+inline SimdFloat NextIntegratedBlepSample(SimdFloat t) {
+  const SimdFloat t1 = SimdFloat(0.5f) * t;
+  const SimdFloat t2 = t1 * t1;
+  const SimdFloat t4 = t2 * t2;
+  return SimdFloat(0.1875f) - t1 + SimdFloat(1.5f) * t2 - t4;
+}
+
+inline SimdFloat ThisIntegratedBlepSample(SimdFloat t) {
+  return NextIntegratedBlepSample(SimdFloat(1.0f) - t);
+}
+
+inline void InitLanes(float* lanes, float value) {
+  std::fill(&lanes[0], &lanes[kSimdWidth], value);
+}
+
+// Lockstep version of VariableShapeOscillator.
+class VariableShapeOscillatorBank {
+ public:
+  VariableShapeOscillatorBank() { }
+  ~VariableShapeOscillatorBank() { }
+
+  void Init() {
+    InitLanes(master_phase_, 0.0f);
+    InitLanes(slave_phase_, 0.0f);
+    InitLanes(next_sample_, 0.0f);
+    InitLanes(previous_pw_, 0.5f);
+    InitLanes(high_, 0.0f);
+
+    InitLanes(master_frequency_, 0.0f);
+    InitLanes(slave_frequency_, 0.01f);
+    InitLanes(pw_, 0.5f);
+    InitLanes(waveshape_, 0.0f);
+  }
+
+  template<bool enable_sync>
+  void Render(
+      const float* master_frequency,
+      const float* frequency,
+      const float* pw,
+      const float* waveshape,
+      float* out,
+      size_t size) {
+    const SimdFloat zero(0.0f);
+    const SimdFloat one(1.0f);
+    const SimdFloat max_frequency(kMaxFrequency);
+
+    SimdFloat master_f = SimdFloat::Min(
+        SimdFloat::Load(master_frequency), max_frequency);
+    SimdFloat f = SimdFloat::Min(SimdFloat::Load(frequency), max_frequency);
+    SimdFloat target_pw = SimdFloat::Select(
+        f >= SimdFloat(0.25f),
+        SimdFloat(0.5f),
+        SimdFloat::Min(
+            SimdFloat::Max(SimdFloat::Load(pw), f * SimdFloat(2.0f)),
+            one - SimdFloat(2.0f) * f));
+
+    SimdParameterInterpolator master_fm(master_frequency_, master_f, size);
+    SimdParameterInterpolator fm(slave_frequency_, f, size);
+    SimdParameterInterpolator pwm(pw_, target_pw, size);
+    SimdParameterInterpolator waveshape_modulation(
+        waveshape_, SimdFloat::Load(waveshape), size);
+
+    SimdFloat master_phase = SimdFloat::Load(master_phase_);
+    SimdFloat slave_phase = SimdFloat::Load(slave_phase_);
+    SimdFloat next_sample = SimdFloat::Load(next_sample_);
+    SimdFloat previous_pw = SimdFloat::Load(previous_pw_);
+    SimdFloat high = SimdFloat::Load(high_);
+
+    while (size--) {
+      SimdFloat reset = zero;
+      SimdFloat transition_during_reset = zero;
+      SimdFloat reset_time = zero;
+
+      SimdFloat this_sample = next_sample;
+      next_sample = zero;
+
+      const SimdFloat master_frequency = master_fm.Next();
+      const SimdFloat slave_frequency = fm.Next();
+      const SimdFloat pw = pwm.Next();
+      const SimdFloat waveshape = waveshape_modulation.Next();
+      const SimdFloat square_amount = SimdFloat::Max(
+          waveshape - SimdFloat(0.5f), zero) * SimdFloat(2.0f);
+      const SimdFloat triangle_amount = SimdFloat::Max(
+          one - waveshape * SimdFloat(2.0f), zero);
+      const SimdFloat slope_up = one / pw;
+      const SimdFloat slope_down = one / (one - pw);
+
+      if (enable_sync) {
+        master_phase += master_frequency;
+        reset = master_phase >= one;
+        if (reset.any()) {
+          master_phase = SimdFloat::Select(
+              reset, master_phase - one, master_phase);
+          reset_time = reset & (master_phase / master_frequency);
+
+          SimdFloat slave_phase_at_reset = slave_phase + \
+              (one - reset_time) * slave_frequency;
+          SimdFloat wrap = slave_phase_at_reset >= one;
+          slave_phase_at_reset = SimdFloat::Select(
+              wrap, slave_phase_at_reset - one, slave_phase_at_reset);
+          transition_during_reset = reset & (wrap | SimdFloat::AndNot(
+              high, slave_phase_at_reset >= pw));
+          SimdFloat value = ComputeNaiveSample(
+              slave_phase_at_reset,
+              pw,
+              slope_up,
+              slope_down,
+              triangle_amount,
+              square_amount);
+          this_sample -= reset & (value * ThisBlepSample(reset_time));
+          next_sample -= reset & (value * NextBlepSample(reset_time));
+        }
+      }
+
+      // The scalar version loops over the rising and falling edges until the
+      // phase is caught up. This can take at most three steps.
+      SimdFloat active = transition_during_reset | \
+          SimdFloat::AndNot(reset, SimdFloat::True());
+      SimdFloat triangle_step = (slope_up + slope_down) * slave_frequency;
+      triangle_step *= triangle_amount;
+
+      slave_phase += slave_frequency;
+      RisingEdge(
+          active, slave_phase, pw, previous_pw, slave_frequency,
+          square_amount, triangle_step, &high, &this_sample, &next_sample);
+      FallingEdge(
+          active, slave_frequency, triangle_amount, triangle_step,
+          &slave_phase, &high, &this_sample, &next_sample);
+      RisingEdge(
+          active, slave_phase, pw, previous_pw, slave_frequency,
+          square_amount, triangle_step, &high, &this_sample, &next_sample);
+
+      if (enable_sync) {
+        slave_phase = SimdFloat::Select(
+            reset, reset_time * slave_frequency, slave_phase);
+        high = SimdFloat::AndNot(reset, high);
+      }
+
+      next_sample += ComputeNaiveSample(
+          slave_phase,
+          pw,
+          slope_up,
+          slope_down,
+          triangle_amount,
+          square_amount);
+      previous_pw = pw;
+
+      (SimdFloat(2.0f) * this_sample - one).Store(out);
+      out += kSimdWidth;
+    }
+
+    master_phase.Store(master_phase_);
+    slave_phase.Store(slave_phase_);
+    next_sample.Store(next_sample_);
+    previous_pw.Store(previous_pw_);
+    high.Store(high_);
+  }
+
+ private:
+  inline void RisingEdge(
+      SimdFloat active,
+      SimdFloat phase,
+      SimdFloat pw,
+      SimdFloat previous_pw,
+      SimdFloat frequency,
+      SimdFloat square_amount,
+      SimdFloat triangle_step,
+      SimdFloat* high,
+      SimdFloat* this_sample,
+      SimdFloat* next_sample) const {
+    SimdFloat edge = SimdFloat::AndNot(*high, active & (phase >= pw));
+    if (!edge.any()) {
+      return;
+    }
+    SimdFloat t = (phase - pw) / (previous_pw - pw + frequency);
+    *this_sample += edge & (square_amount * ThisBlepSample(t));
+    *next_sample += edge & (square_amount * NextBlepSample(t));
+    *this_sample -= edge & (triangle_step * ThisIntegratedBlepSample(t));
+    *next_sample -= edge & (triangle_step * NextIntegratedBlepSample(t));
+    *high = *high | edge;
+  }
+
+  inline void FallingEdge(
+      SimdFloat active,
+      SimdFloat frequency,
+      SimdFloat triangle_amount,
+      SimdFloat triangle_step,
+      SimdFloat* phase,
+      SimdFloat* high,
+      SimdFloat* this_sample,
+      SimdFloat* next_sample) const {
+    const SimdFloat one(1.0f);
+    SimdFloat edge = active & *high & (*phase >= one);
+    if (!edge.any()) {
+      return;
+    }
+    *phase = SimdFloat::Select(edge, *phase - one, *phase);
+    SimdFloat t = *phase / frequency;
+    SimdFloat square_step = one - triangle_amount;
+    *this_sample -= edge & (square_step * ThisBlepSample(t));
+    *next_sample -= edge & (square_step * NextBlepSample(t));
+    *this_sample += edge & (triangle_step * ThisIntegratedBlepSample(t));
+    *next_sample += edge & (triangle_step * NextIntegratedBlepSample(t));
+    *high = SimdFloat::AndNot(edge, *high);
+  }
+
+  inline SimdFloat ComputeNaiveSample(
+      SimdFloat phase,
+      SimdFloat pw,
+      SimdFloat slope_up,
+      SimdFloat slope_down,
+      SimdFloat triangle_amount,
+      SimdFloat square_amount) const {
+    const SimdFloat one(1.0f);
+    SimdFloat low = phase < pw;
+    SimdFloat saw = phase;
+    SimdFloat square = SimdFloat::AndNot(low, one);
+    SimdFloat triangle = SimdFloat::Select(
+        low,
+        phase * slope_up,
+        one - (phase - pw) * slope_down);
+    saw += (square - saw) * square_amount;
+    saw += (triangle - saw) * triangle_amount;
+    return saw;
+  }
+
+  // Oscillator state.
+  float master_phase_[kSimdWidth];
+  float slave_phase_[kSimdWidth];
+  float next_sample_[kSimdWidth];
+  float previous_pw_[kSimdWidth];
+  float high_[kSimdWidth];  // Stored as a mask.
+
+  // For interpolation of parameters.
+  float master_frequency_[kSimdWidth];
+  float slave_frequency_[kSimdWidth];
+  float pw_[kSimdWidth];
+  float waveshape_[kSimdWidth];
+
+  DISALLOW_COPY_AND_ASSIGN(VariableShapeOscillatorBank);
+};
+
+// Lockstep version of VariableSawOscillator.
+class VariableSawOscillatorBank {
+ public:
+  VariableSawOscillatorBank() { }
+  ~VariableSawOscillatorBank() { }
+
+  void Init() {
+    InitLanes(phase_, 0.0f);
+    InitLanes(next_sample_, 0.0f);
+    InitLanes(previous_pw_, 0.5f);
+    InitLanes(high_, 0.0f);
+
+    InitLanes(frequency_, 0.01f);
+    InitLanes(pw_, 0.5f);
+    InitLanes(waveshape_, 0.0f);
+  }
+
+  void Render(
+      const float* frequency,
+      const float* pw,
+      const float* waveshape,
+      float* out,
+      size_t size) {
+    const SimdFloat zero(0.0f);
+    const SimdFloat one(1.0f);
+    const SimdFloat notch_depth(kVariableSawNotchDepth);
+
+    SimdFloat f = SimdFloat::Min(
+        SimdFloat::Load(frequency), SimdFloat(kMaxFrequency));
+    SimdFloat target_pw = SimdFloat::Select(
+        f >= SimdFloat(0.25f),
+        SimdFloat(0.5f),
+        SimdFloat::Min(
+            SimdFloat::Max(SimdFloat::Load(pw), f * SimdFloat(2.0f)),
+            one - SimdFloat(2.0f) * f));
+
+    SimdParameterInterpolator fm(frequency_, f, size);
+    SimdParameterInterpolator pwm(pw_, target_pw, size);
+    SimdParameterInterpolator waveshape_modulation(
+        waveshape_, SimdFloat::Load(waveshape), size);
+
+    SimdFloat phase = SimdFloat::Load(phase_);
+    SimdFloat next_sample = SimdFloat::Load(next_sample_);
+    SimdFloat previous_pw = SimdFloat::Load(previous_pw_);
+    SimdFloat high = SimdFloat::Load(high_);
+
+    while (size--) {
+      SimdFloat this_sample = next_sample;
+      next_sample = zero;
+
+      const SimdFloat frequency = fm.Next();
+      const SimdFloat pw = pwm.Next();
+      const SimdFloat waveshape = waveshape_modulation.Next();
+      const SimdFloat triangle_amount = waveshape;
+      const SimdFloat notch_amount = one - waveshape;
+      const SimdFloat slope_up = one / pw;
+      const SimdFloat slope_down = one / (one - pw);
+
+      phase += frequency;
+
+      SimdFloat rising = SimdFloat::AndNot(high, phase >= pw);
+      SimdFloat falling = SimdFloat::AndNot(rising, phase >= one);
+      if ((rising | falling).any()) {
+        const SimdFloat triangle_step = \
+            (slope_up + slope_down) * frequency * triangle_amount;
+        if (rising.any()) {
+          const SimdFloat notch = (notch_depth + one - pw) * notch_amount;
+          const SimdFloat t = (phase - pw) / (previous_pw - pw + frequency);
+          this_sample += rising & (notch * ThisBlepSample(t));
+          next_sample += rising & (notch * NextBlepSample(t));
+          this_sample -= rising & (triangle_step * ThisIntegratedBlepSample(t));
+          next_sample -= rising & (triangle_step * NextIntegratedBlepSample(t));
+        }
+        if (falling.any()) {
+          phase = SimdFloat::Select(falling, phase - one, phase);
+          const SimdFloat notch = (notch_depth + one) * notch_amount;
+          const SimdFloat t = phase / frequency;
+          this_sample -= falling & (notch * ThisBlepSample(t));
+          next_sample -= falling & (notch * NextBlepSample(t));
+          this_sample += falling & (triangle_step * ThisIntegratedBlepSample(t));
+          next_sample += falling & (triangle_step * NextIntegratedBlepSample(t));
+        }
+        high = SimdFloat::AndNot(falling, high | rising);
+      }
+
+      SimdFloat low = phase < pw;
+      SimdFloat notch_saw = SimdFloat::Select(low, phase, one + notch_depth);
+      SimdFloat triangle = SimdFloat::Select(
+          low,
+          phase * slope_up,
+          one - (phase - pw) * slope_down);
+      next_sample += notch_saw * notch_amount + triangle * triangle_amount;
+      previous_pw = pw;
+
+      ((SimdFloat(2.0f) * this_sample - one) / (one + notch_depth)).Store(out);
+      out += kSimdWidth;
+    }
+
+    phase.Store(phase_);
+    next_sample.Store(next_sample_);
+    previous_pw.Store(previous_pw_);
+    high.Store(high_);
+  }
+
+ private:
+  // Oscillator state.
+  float phase_[kSimdWidth];
+  float next_sample_[kSimdWidth];
+  float previous_pw_[kSimdWidth];
+  float high_[kSimdWidth];
+
+  // For interpolation of parameters.
+  float frequency_[kSimdWidth];
+  float pw_[kSimdWidth];
+  float waveshape_[kSimdWidth];
+
+  DISALLOW_COPY_AND_ASSIGN(VariableSawOscillatorBank);
+};
+
+// Lockstep version of SineOscillator.
+class SineOscillatorBank {
+ public:
+  SineOscillatorBank() { }
+  ~SineOscillatorBank() { }
+
+  void Init() {
+    InitLanes(phase_, 0.0f);
+    InitLanes(frequency_, 0.0f);
+    InitLanes(amplitude_, 0.0f);
+  }
+
+  void Render(
+      const float* frequency,
+      const float* amplitude,
+      float* out,
+      size_t size) {
+    RenderInternal<true>(frequency, amplitude, out, size);
+  }
+
+  void Render(const float* frequency, float* out, size_t size) {
+    RenderInternal<false>(frequency, NULL, out, size);
+  }
+
+ private:
+  template<bool additive>
+  void RenderInternal(
+      const float* frequency,
+      const float* amplitude,
+      float* out,
+      size_t size) {
+    const SimdFloat one(1.0f);
+    SimdParameterInterpolator fm(
+        frequency_,
+        SimdFloat::Min(SimdFloat::Load(frequency), SimdFloat(0.5f)),
+        size);
+    SimdParameterInterpolator am(
+        amplitude_,
+        additive ? SimdFloat::Load(amplitude) : SimdFloat::Load(amplitude_),
+        size);
+
+    SimdFloat phase = SimdFloat::Load(phase_);
+    while (size--) {
+      phase += fm.Next();
+      phase = SimdFloat::Select(phase >= one, phase - one, phase);
+      SimdFloat s = Interpolate(lut_sine, phase, 1024.0f);
+      if (additive) {
+        (SimdFloat::Load(out) + am.Next() * s).Store(out);
+      } else {
+        s.Store(out);
+      }
+      out += kSimdWidth;
+    }
+    phase.Store(phase_);
+  }
+
+  // Oscillator state.
+  float phase_[kSimdWidth];
+
+  // For interpolation of parameters.
+  float frequency_[kSimdWidth];
+  float amplitude_[kSimdWidth];
+
+  DISALLOW_COPY_AND_ASSIGN(SineOscillatorBank);
+};
+
+// Lockstep version of Oscillator. External and through-zero FM are not
+// supported.
+class OscillatorBank {
+ public:
+  OscillatorBank() { }
+  ~OscillatorBank() { }
+
+  void Init() {
+    InitLanes(phase_, 0.5f);
+    InitLanes(next_sample_, 0.0f);
+    InitLanes(lp_state_, 1.0f);
+    InitLanes(hp_state_, 0.0f);
+    SimdFloat::True().Store(high_);
+
+    InitLanes(frequency_, 0.001f);
+    InitLanes(pw_, 0.5f);
+  }
+
+  template<OscillatorShape shape>
+  void Render(
+      const float* frequency,
+      const float* pw,
+      float* out,
+      size_t size) {
+    const SimdFloat zero(0.0f);
+    const SimdFloat one(1.0f);
+    const SimdFloat half(0.5f);
+    const SimdFloat two(2.0f);
+
+    SimdFloat f = SimdFloat::Min(
+        SimdFloat::Max(SimdFloat::Load(frequency), SimdFloat(kMinFrequency)),
+        SimdFloat(kMaxFrequency));
+    SimdFloat target_pw = SimdFloat::Min(
+        SimdFloat::Max(SimdFloat::Load(pw), f * two),
+        one - two * f);
+
+    SimdParameterInterpolator fm(frequency_, f, size);
+    SimdParameterInterpolator pwm(pw_, target_pw, size);
+
+    SimdFloat phase = SimdFloat::Load(phase_);
+    SimdFloat next_sample = SimdFloat::Load(next_sample_);
+    SimdFloat lp_state = SimdFloat::Load(lp_state_);
+    SimdFloat hp_state = SimdFloat::Load(hp_state_);
+    SimdFloat high = SimdFloat::Load(high_);
+
+    while (size--) {
+      SimdFloat this_sample = next_sample;
+      next_sample = zero;
+
+      const SimdFloat frequency = fm.Next();
+      const SimdFloat pw = (shape == OSCILLATOR_SHAPE_SQUARE_TRIANGLE ||
+                            shape == OSCILLATOR_SHAPE_TRIANGLE)
+          ? half : pwm.Next();
+      phase += frequency;
+
+      if (shape <= OSCILLATOR_SHAPE_SAW) {
+        SimdFloat wrap = phase >= one;
+        if (wrap.any()) {
+          phase = SimdFloat::Select(wrap, phase - one, phase);
+          SimdFloat t = phase / frequency;
+          this_sample -= wrap & ThisBlepSample(t);
+          next_sample -= wrap & NextBlepSample(t);
+        }
+        next_sample += phase;
+
+        if (shape == OSCILLATOR_SHAPE_SAW) {
+          (two * this_sample - one).Store(out);
+        } else {
+          lp_state += SimdFloat(0.25f) * ((hp_state - this_sample) - lp_state);
+          (SimdFloat(4.0f) * lp_state).Store(out);
+          hp_state = this_sample;
+        }
+      } else if (shape <= OSCILLATOR_SHAPE_SLOPE) {
+        SimdFloat slope_up = two;
+        SimdFloat slope_down = two;
+        if (shape == OSCILLATOR_SHAPE_SLOPE) {
+          slope_up = one / pw;
+          slope_down = one / (one - pw);
+        }
+        const SimdFloat discontinuity = (slope_up + slope_down) * frequency;
+        SimdFloat edge = high ^ (phase < pw);
+        if (edge.any()) {
+          SimdFloat t = (phase - pw) / frequency;
+          this_sample -= edge & (ThisIntegratedBlepSample(t) * discontinuity);
+          next_sample -= edge & (NextIntegratedBlepSample(t) * discontinuity);
+          high = high ^ edge;
+        }
+        SimdFloat wrap = phase >= one;
+        if (wrap.any()) {
+          phase = SimdFloat::Select(wrap, phase - one, phase);
+          SimdFloat t = phase / frequency;
+          this_sample += wrap & (ThisIntegratedBlepSample(t) * discontinuity);
+          next_sample += wrap & (NextIntegratedBlepSample(t) * discontinuity);
+          high = high | wrap;
+        }
+        next_sample += SimdFloat::Select(
+            high,
+            phase * slope_up,
+            one - (phase - pw) * slope_down);
+        (two * this_sample - one).Store(out);
+      } else {
+        SimdFloat edge = high ^ (phase >= pw);
+        if (edge.any()) {
+          SimdFloat t = (phase - pw) / frequency;
+          this_sample += edge & ThisBlepSample(t);
+          next_sample += edge & NextBlepSample(t);
+          high = high ^ edge;
+        }
+        SimdFloat wrap = phase >= one;
+        if (wrap.any()) {
+          phase = SimdFloat::Select(wrap, phase - one, phase);
+          SimdFloat t = phase / frequency;
+          this_sample -= wrap & ThisBlepSample(t);
+          next_sample -= wrap & NextBlepSample(t);
+          high = SimdFloat::AndNot(wrap, high);
+        }
+        next_sample += SimdFloat::AndNot(phase < pw, one);
+
+        if (shape == OSCILLATOR_SHAPE_SQUARE_TRIANGLE) {
+          const SimdFloat integrator_coefficient = frequency * \
+              SimdFloat(0.0625f);
+          this_sample = SimdFloat(128.0f) * (this_sample - half);
+          lp_state += integrator_coefficient * (this_sample - lp_state);
+          lp_state.Store(out);
+        } else if (shape == OSCILLATOR_SHAPE_SQUARE_DARK) {
+          const SimdFloat integrator_coefficient = frequency * two;
+          this_sample = SimdFloat(4.0f) * (this_sample - half);
+          lp_state += integrator_coefficient * (this_sample - lp_state);
+          lp_state.Store(out);
+        } else if (shape == OSCILLATOR_SHAPE_SQUARE_BRIGHT) {
+          const SimdFloat integrator_coefficient = frequency * two;
+          this_sample = two * this_sample - one;
+          lp_state += integrator_coefficient * (this_sample - lp_state);
+          ((this_sample - lp_state) * half).Store(out);
+        } else {
+          (two * this_sample - one).Store(out);
+        }
+      }
+      out += kSimdWidth;
+    }
+
+    phase.Store(phase_);
+    next_sample.Store(next_sample_);
+    lp_state.Store(lp_state_);
+    hp_state.Store(hp_state_);
+    high.Store(high_);
+  }
+
+ private:
+  // Oscillator state.
+  float phase_[kSimdWidth];
+  float next_sample_[kSimdWidth];
+  float lp_state_[kSimdWidth];
+  float hp_state_[kSimdWidth];
+  float high_[kSimdWidth];
+
+  // For interpolation of parameters.
+  float frequency_[kSimdWidth];
+  float pw_[kSimdWidth];
+
+  DISALLOW_COPY_AND_ASSIGN(OscillatorBank);
+};
+
+}  // namespace plaits
+
+#endif  // PLAITS_DSP_OSCILLATOR_OSCILLATOR_BANK_H_
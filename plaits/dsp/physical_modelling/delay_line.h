@@ -25,6 +25,8 @@
 // -----------------------------------------------------------------------------
 //
 // Delay line (same implementation as from stmlib, but does not own its buffer).
+// The size is a power of two, so that taps are wrapped with a mask, and
+// fractional delays can also be read with a 6-point Lagrange interpolator.
 
 #ifndef PLAITS_DSP_PHYSICAL_MODELLING_DELAY_LINE_H_
 #define PLAITS_DSP_PHYSICAL_MODELLING_DELAY_LINE_H_
@@ -35,6 +37,63 @@
 
 namespace plaits {
 
+// Fractional reads of a power-of-two ring buffer, between the samples at
+// index "t" and "t + 1". Also used by the delay lines of rings, including
+// those whose size is only known at run time.
+
+// 4-point, 3rd order Hermite interpolation.
+template<typename T>
+inline T InterpolateDelayHermite(
+    const T* line,
+    size_t mask,
+    size_t t,
+    float fractional) {
+  const T xm1 = line[(t - 1) & mask];
+  const T x0 = line[t & mask];
+  const T x1 = line[(t + 1) & mask];
+  const T x2 = line[(t + 2) & mask];
+  const T c = (x1 - xm1) * 0.5f;
+  const T v = x0 - x1;
+  const T w = c + v;
+  const T a = w + v + (x2 - x0) * 0.5f;
+  const T b_neg = w + a;
+  const T f = fractional;
+  return (((a * f) - b_neg) * f + c) * f + x0;
+}
+
+// 6-point, 5th order Lagrange interpolation. Flatter and more linear in phase
+// than the Hermite one up to about a quarter of the sample rate, for twice the
+// multiplications. Reads 2 samples before "t", so the delay must be at least
+// 3 samples.
+template<typename T>
+inline T InterpolateDelayLagrange(
+    const T* line,
+    size_t mask,
+    size_t t,
+    float fractional) {
+  const T f = fractional;
+  const T d[6] = { f + 2.0f, f + 1.0f, f, f - 1.0f, f - 2.0f, f - 3.0f };
+  
+  // Products of the distances to all the other samples, from the left and
+  // from the right.
+  const T l1 = d[0];
+  const T l2 = l1 * d[1];
+  const T l3 = l2 * d[2];
+  const T l4 = l3 * d[3];
+  const T r4 = d[5];
+  const T r3 = r4 * d[4];
+  const T r2 = r3 * d[3];
+  const T r1 = r2 * d[2];
+  
+  T y = line[(t - 2) & mask] * (d[1] * r1 * (-1.0f / 120.0f));
+  y += line[(t - 1) & mask] * (l1 * r1 * (1.0f / 24.0f));
+  y += line[t & mask] * (l2 * r2 * (-1.0f / 12.0f));
+  y += line[(t + 1) & mask] * (l3 * r3 * (1.0f / 12.0f));
+  y += line[(t + 2) & mask] * (l4 * r4 * (-1.0f / 24.0f));
+  y += line[(t + 3) & mask] * (l4 * d[4] * (1.0f / 120.0f));
+  return y;
+}
+
 template<typename T, size_t max_delay>
 class DelayLine {
  public:
@@ -47,17 +106,18 @@ class DelayLine {
   }
   
   void Reset() {
+    STATIC_ASSERT(!(max_delay & (max_delay - 1)), power_of_two_size);
     std::fill(&line_[0], &line_[max_delay], T(0));
     write_ptr_ = 0;
   }
   
   inline void Write(const T sample) {
     line_[write_ptr_] = sample;
-    write_ptr_ = (write_ptr_ - 1 + max_delay) % max_delay;
+    write_ptr_ = (write_ptr_ - 1) & kMask;
   }
   
   inline const T Allpass(const T sample, size_t delay, const T coefficient) {
-    T read = line_[(write_ptr_ + delay) % max_delay];
+    T read = line_[(write_ptr_ + delay) & kMask];
     T write = sample + coefficient * read;
     Write(write);
     return -write * coefficient + read;
@@ -70,28 +130,27 @@ class DelayLine {
   
   inline const T Read(float delay) const {
     MAKE_INTEGRAL_FRACTIONAL(delay)
-    const T a = line_[(write_ptr_ + delay_integral) % max_delay];
-    const T b = line_[(write_ptr_ + delay_integral + 1) % max_delay];
+    const T a = line_[(write_ptr_ + delay_integral) & kMask];
+    const T b = line_[(write_ptr_ + delay_integral + 1) & kMask];
     return a + (b - a) * T(delay_fractional);
   }
   
   inline const T ReadHermite(float delay) const {
     MAKE_INTEGRAL_FRACTIONAL(delay)
-    int32_t t = (write_ptr_ + delay_integral + max_delay);
-    const T xm1 = line_[(t - 1) % max_delay];
-    const T x0 = line_[(t) % max_delay];
-    const T x1 = line_[(t + 1) % max_delay];
-    const T x2 = line_[(t + 2) % max_delay];
-    const T c = (x1 - xm1) * 0.5f;
-    const T v = x0 - x1;
-    const T w = c + v;
-    const T a = w + v + (x2 - x0) * 0.5f;
-    const T b_neg = w + a;
-    const T f = delay_fractional;
-    return (((a * f) - b_neg) * f + c) * f + x0;
+    return InterpolateDelayHermite(
+        line_, kMask, write_ptr_ + delay_integral, delay_fractional);
+  }
+  
+  // The delay must be at least 3 samples.
+  inline const T ReadLagrange(float delay) const {
+    MAKE_INTEGRAL_FRACTIONAL(delay)
+    return InterpolateDelayLagrange(
+        line_, kMask, write_ptr_ + delay_integral, delay_fractional);
   }
 
  private:
+  static const size_t kMask = max_delay - 1;
+  
   size_t write_ptr_;
   T* line_;
   
@@ -54,6 +54,10 @@ void Resonator::Init(float position, int resolution) {
   for (int i = 0; i < kMaxNumModes / kModeBatchSize; ++i) {
     mode_filters_[i].Init();
   }
+  for (int i = 0; i < kMaxNumSimdModeBatches; ++i) {
+    simd_mode_filters_[i].Init();
+  }
+  backend_ = kDefaultResonatorBackend;
 }
 
 inline float NthHarmonicCompensation(int n, float stiffness) {
@@ -88,37 +92,26 @@ void Resonator::Process(
   brightness *= 1.0f - damping * 0.3f;
   float q_loss = brightness * (2.0f - brightness) * 0.85f + 0.15f;
   
-  float mode_q[kModeBatchSize];
-  float mode_f[kModeBatchSize];
-  float mode_a[kModeBatchSize];
-  int batch_counter = 0;
-  
-  ResonatorSvf<kModeBatchSize>* batch_processor = &mode_filters_[0];
+  // Modes which do not fill a complete batch of the scalar backend are not
+  // rendered, whatever the backend.
+  const int num_modes = resolution_ - resolution_ % kModeBatchSize;
   
+  // Padded with silent modes, to fill the last batch of the SIMD backend.
+  const int kNumModes = kMaxNumSimdModeBatches * kSimdModeBatchSize;
+  float mode_q[kNumModes];
+  float mode_f[kNumModes];
+  float mode_a[kNumModes];
   
-  for (int i = 0; i < resolution_; ++i) {
+  for (int i = 0; i < num_modes; ++i) {
     float mode_frequency = harmonic * stretch_factor;
     if (mode_frequency >= 0.499f) {
       mode_frequency = 0.499f;
     }
     const float mode_attenuation = 1.0f - mode_frequency * 2.0f;
     
-    mode_f[batch_counter] = mode_frequency;
-    mode_q[batch_counter] = 1.0f + mode_frequency * q;
-    mode_a[batch_counter] = mode_amplitude_[i] * mode_attenuation;
-    ++batch_counter;
-    
-    if (batch_counter == kModeBatchSize) {
-      batch_counter = 0;
-      batch_processor->Process<FILTER_MODE_BAND_PASS, true>(
-          mode_f,
-          mode_q,
-          mode_a,
-          in,
-          out,
-          size);
-      ++batch_processor;
-    }
+    mode_f[i] = mode_frequency;
+    mode_q[i] = 1.0f + mode_frequency * q;
+    mode_a[i] = mode_amplitude_[i] * mode_attenuation;
     
     stretch_factor += stiffness;
     if (stiffness < 0.0f) {
@@ -131,6 +124,61 @@ void Resonator::Process(
     harmonic += f0;
     q *= q_loss;
   }
+  
+  if (backend_ == RESONATOR_BACKEND_SIMD) {
+    fill(&mode_f[num_modes], &mode_f[kNumModes], 0.25f);
+    fill(&mode_q[num_modes], &mode_q[kNumModes], 1.0f);
+    fill(&mode_a[num_modes], &mode_a[kNumModes], 0.0f);
+    ProcessSimd(num_modes, mode_f, mode_q, mode_a, in, out, size);
+  } else {
+    for (int i = 0; i < num_modes / kModeBatchSize; ++i) {
+      const int offset = i * kModeBatchSize;
+      mode_filters_[i].Process<FILTER_MODE_BAND_PASS, true>(
+          &mode_f[offset],
+          &mode_q[offset],
+          &mode_a[offset],
+          in,
+          out,
+          size);
+    }
+  }
+}
+
+void Resonator::ProcessSimd(
+    int num_modes,
+    const float* mode_f,
+    const float* mode_q,
+    const float* mode_a,
+    const float* in,
+    float* out,
+    size_t size) {
+  const int num_batches = \
+      (num_modes + kSimdModeBatchSize - 1) / kSimdModeBatchSize;
+  
+  float lanes[kSimdModeChunkSize * kSimdWidth];
+  while (size) {
+    const size_t chunk_size = min(size, kSimdModeChunkSize);
+    fill(&lanes[0], &lanes[chunk_size * kSimdWidth], 0.0f);
+    for (int i = 0; i < num_batches; ++i) {
+      const int offset = i * kSimdModeBatchSize;
+      simd_mode_filters_[i].Process(
+          &mode_f[offset],
+          &mode_q[offset],
+          &mode_a[offset],
+          in,
+          lanes,
+          chunk_size);
+    }
+    for (size_t i = 0; i < chunk_size; ++i) {
+      float s = 0.0f;
+      for (size_t j = 0; j < kSimdWidth; ++j) {
+        s += lanes[i * kSimdWidth + j];
+      }
+      *out++ += s;
+    }
+    in += chunk_size;
+    size -= chunk_size;
+  }
 }
 
 }  // namespace plaits
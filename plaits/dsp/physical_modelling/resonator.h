@@ -29,13 +29,44 @@
 #ifndef PLAITS_DSP_PHYSICAL_MODELLING_RESONATOR_H_
 #define PLAITS_DSP_PHYSICAL_MODELLING_RESONATOR_H_
 
+#include <algorithm>
+
 #include "stmlib/dsp/filter.h"
 
+#include "plaits/dsp/simd.h"
+
 namespace plaits {
 
+// The number of modes can be raised on hosts with more CPU.
+#ifdef PLAITS_MAX_NUM_MODES
+const int kMaxNumModes = PLAITS_MAX_NUM_MODES;
+#else
 const int kMaxNumModes = 24;
+#endif  // PLAITS_MAX_NUM_MODES
+
 const int kModeBatchSize = 4;
 
+// Number of modes rendered together by the SIMD backend (a multiple of
+// kSimdWidth).
+const int kSimdModeBatchSize = 24;
+const int kSimdModeVectors = kSimdModeBatchSize / kSimdWidth;
+const int kMaxNumSimdModeBatches = \
+    (kMaxNumModes + kSimdModeBatchSize - 1) / kSimdModeBatchSize;
+
+// Number of samples processed by each batch before moving to the next one.
+const size_t kSimdModeChunkSize = 32;
+
+enum ResonatorBackend {
+  RESONATOR_BACKEND_SCALAR,
+  RESONATOR_BACKEND_SIMD
+};
+
+#if defined(__SSE2__)
+const ResonatorBackend kDefaultResonatorBackend = RESONATOR_BACKEND_SIMD;
+#else
+const ResonatorBackend kDefaultResonatorBackend = RESONATOR_BACKEND_SCALAR;
+#endif  // __SSE2__
+
 // We render 4 modes simultaneously since there are enough registers to hold
 // all state variables.
 template<int batch_size>
@@ -105,6 +136,88 @@ class ResonatorSvf {
   DISALLOW_COPY_AND_ASSIGN(ResonatorSvf);
 };
 
+// Same filters as ResonatorSvf, with one mode per SIMD lane. Several vectors
+// are processed in the same loop to hide the latency of the recursion.
+//
+// The band-pass outputs are accumulated, for each lane, in a buffer of
+// interleaved frames (out[i * kSimdWidth + lane]): the sum across lanes is
+// done only once, after all the batches have been rendered.
+template<int num_vectors>
+class ResonatorSvfSimd {
+ public:
+  ResonatorSvfSimd() { }
+  ~ResonatorSvfSimd() { }
+  
+  enum {
+    batch_size = num_vectors * kSimdWidth
+  };
+  
+  void Init() {
+    std::fill(&state_1_[0], &state_1_[batch_size], 0.0f);
+    std::fill(&state_2_[0], &state_2_[batch_size], 0.0f);
+  }
+  
+  void Process(
+      const float* f,
+      const float* q,
+      const float* gain,
+      const float* in,
+      float* out,
+      size_t size) {
+    float coefficients[3][batch_size];
+    for (int i = 0; i < batch_size; ++i) {
+      const float g = stmlib::OnePole::tan<stmlib::FREQUENCY_FAST>(f[i]);
+      const float r = 1.0f / q[i];
+      coefficients[0][i] = g;
+      coefficients[1][i] = r + g;
+      coefficients[2][i] = 1.0f / (1.0f + r * g + g * g);
+    }
+    
+    SimdFloat g[num_vectors];
+    SimdFloat r_plus_g[num_vectors];
+    SimdFloat h[num_vectors];
+    SimdFloat gains[num_vectors];
+    SimdFloat state_1[num_vectors];
+    SimdFloat state_2[num_vectors];
+    for (int j = 0; j < num_vectors; ++j) {
+      const int offset = j * kSimdWidth;
+      g[j] = SimdFloat::Load(&coefficients[0][offset]);
+      r_plus_g[j] = SimdFloat::Load(&coefficients[1][offset]);
+      h[j] = SimdFloat::Load(&coefficients[2][offset]);
+      gains[j] = SimdFloat::Load(&gain[offset]);
+      state_1[j] = SimdFloat::Load(&state_1_[offset]);
+      state_2[j] = SimdFloat::Load(&state_2_[offset]);
+    }
+    
+    while (size--) {
+      const SimdFloat s_in = *in++;
+      SimdFloat s_out = SimdFloat::Load(out);
+      for (int j = 0; j < num_vectors; ++j) {
+        const SimdFloat hp = (s_in - r_plus_g[j] * state_1[j] - state_2[j]) * \
+            h[j];
+        const SimdFloat bp = g[j] * hp + state_1[j];
+        state_1[j] = g[j] * hp + bp;
+        const SimdFloat lp = g[j] * bp + state_2[j];
+        state_2[j] = g[j] * bp + lp;
+        s_out += gains[j] * bp;
+      }
+      s_out.Store(out);
+      out += kSimdWidth;
+    }
+    
+    for (int j = 0; j < num_vectors; ++j) {
+      state_1[j].Store(&state_1_[j * kSimdWidth]);
+      state_2[j].Store(&state_2_[j * kSimdWidth]);
+    }
+  }
+  
+ private:
+  float state_1_[batch_size];
+  float state_2_[batch_size];
+  
+  DISALLOW_COPY_AND_ASSIGN(ResonatorSvfSimd);
+};
+
 class Resonator {
  public:
   Resonator() { }
@@ -120,11 +233,28 @@ class Resonator {
       float* out,
       size_t size);
   
+  // Can be called after Init, for benchmarks and tests.
+  inline void set_backend(ResonatorBackend backend) {
+    backend_ = backend;
+  }
+  
  private:
+  void ProcessSimd(
+      int num_modes,
+      const float* mode_f,
+      const float* mode_q,
+      const float* mode_a,
+      const float* in,
+      float* out,
+      size_t size);
+  
   int resolution_;
+  ResonatorBackend backend_;
   
   float mode_amplitude_[kMaxNumModes];
   ResonatorSvf<kModeBatchSize> mode_filters_[kMaxNumModes / kModeBatchSize];
+  ResonatorSvfSimd<kSimdModeVectors> simd_mode_filters_[
+      kMaxNumSimdModeBatches];
   
   DISALLOW_COPY_AND_ASSIGN(Resonator);
 };
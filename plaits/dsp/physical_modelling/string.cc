@@ -43,10 +43,12 @@ namespace plaits {
 using namespace std;
 using namespace stmlib;
 
-void String::Init(BufferAllocator* allocator) {
+void String::Init(BufferAllocator* allocator, float sample_rate) {
+  sample_rate_ = sample_rate;
   string_.Init(allocator->Allocate<float>(kDelayLineSize));
   stretch_.Init(allocator->Allocate<float>(kDelayLineSize / 4));
   delay_ = 100.0f;
+  interpolation_ = STRING_INTERPOLATION_HERMITE;
   Reset();
 }
 
@@ -54,11 +56,12 @@ void String::Reset() {
   string_.Reset();
   stretch_.Reset();
   iir_damping_filter_.Init();
-  dc_blocker_.Init(1.0f - 20.0f / kSampleRate);
+  dc_blocker_.Init(1.0f - 20.0f / sample_rate_);
   dispersion_noise_ = 0.0f;
   curved_bridge_ = 0.0f;
-  out_sample_[0] = out_sample_[1] = 0.0f;
+  fill(&out_sample_[0], &out_sample_[4], 0.0f);
   src_phase_ = 0.0f;
+  input_sum_ = 0.0f;
 }
 
 void String::Process(
@@ -91,8 +94,7 @@ void String::ProcessInternal(
   CONSTRAIN(delay, 4.0f, kDelayLineSize - 4.0f);
   
   // If there is not enough delay time in the delay line, we play at the
-  // lowest possible note and we upsample on the fly with a shitty linear
-  // interpolator. We don't care because it's a corner case (f0 < 11.7Hz)
+  // lowest possible note and we upsample on the fly.
   float src_ratio = delay * f0;
   if (src_ratio >= 0.9999f) {
     // When we are above 11.7 Hz, we make sure that the linear interpolator
@@ -104,7 +106,8 @@ void String::ProcessInternal(
   float damping_cutoff = min(
       12.0f + damping * damping * 60.0f + brightness * 24.0f,
       84.0f);
-  float damping_f = min(f0 * SemitonesToRatio(damping_cutoff), 0.499f);
+  float damping_f = min(
+      f0 / src_ratio * SemitonesToRatio(damping_cutoff), 0.499f);
   
   // Crossfade to infinite decay.
   if (damping >= 0.95f) {
@@ -123,7 +126,7 @@ void String::ProcessInternal(
       &delay_, delay * damping_compensation, size);
   
   float stretch_point = non_linearity_amount * (2.0f - non_linearity_amount) * 0.225f;
-  float stretch_correction = (160.0f / kSampleRate) * delay;
+  float stretch_correction = (160.0f / sample_rate_) * delay;
   CONSTRAIN(stretch_correction, 1.0f, 2.1f);
   
   float noise_amount_sqrt = non_linearity_amount > 0.75f
@@ -139,6 +142,7 @@ void String::ProcessInternal(
   
   while (size--) {
     src_phase_ += src_ratio;
+    input_sum_ += *in++;
     if (src_phase_ > 1.0f) {
       src_phase_ -= 1.0f;
       
@@ -160,10 +164,10 @@ void String::ProcessInternal(
           s = string_.Read(main_delay);
           s = stretch_.Allpass(s, ap_delay, ap_gain);
         } else {
-          s = string_.ReadHermite(delay);
+          s = ReadString(delay);
         }
       } else {
-        s = string_.ReadHermite(delay);
+        s = ReadString(delay);
       }
       
       if (non_linearity == STRING_NON_LINEARITY_CURVED_BRIDGE) {
@@ -172,18 +176,25 @@ void String::ProcessInternal(
         curved_bridge_ = (fabsf(value) + value) * sign;
       }
     
-      s += *in;
+      // Average of the input samples received since the last step.
+      s += input_sum_ * src_ratio;
+      input_sum_ = 0.0f;
       CONSTRAIN(s, -20.0f, +20.0f);
       
       dc_blocker_.Process(&s, 1);
       s = iir_damping_filter_.Process<FILTER_MODE_LOW_PASS>(s);
       string_.Write(s);
 
-      out_sample_[1] = out_sample_[0];
+      for (int32_t i = 3; i > 0; --i) {
+        out_sample_[i] = out_sample_[i - 1];
+      }
       out_sample_[0] = s;
     }
-    *out++ += Crossfade(out_sample_[1], out_sample_[0], src_phase_);
-    in++;
+    if (src_ratio < 1.0f) {
+      *out++ += InterpolateHistory(out_sample_, src_phase_);
+    } else {
+      *out++ += Crossfade(out_sample_[1], out_sample_[0], src_phase_);
+    }
   }
 }
 
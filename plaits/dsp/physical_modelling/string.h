@@ -42,6 +42,27 @@ namespace plaits {
 
 const size_t kDelayLineSize = 1024;
 
+enum StringInterpolation {
+  STRING_INTERPOLATION_HERMITE,
+  // Flatter delay and gain on the upper partials, for about 15% more CPU.
+  STRING_INTERPOLATION_LAGRANGE
+};
+
+// Cubic interpolation between the third and second most recent samples of a
+// history of 4 samples.
+inline float InterpolateHistory(const float* history, float t) {
+  const float xm1 = history[3];
+  const float x0 = history[2];
+  const float x1 = history[1];
+  const float x2 = history[0];
+  const float c = (x1 - xm1) * 0.5f;
+  const float v = x0 - x1;
+  const float w = c + v;
+  const float a = w + v + (x2 - x0) * 0.5f;
+  const float b_neg = w + a;
+  return (((a * t) - b_neg) * t + c) * t + x0;
+}
+
 enum StringNonLinearity {
   STRING_NON_LINEARITY_CURVED_BRIDGE,
   STRING_NON_LINEARITY_DISPERSION
@@ -52,7 +73,7 @@ class String {
   String() { }
   ~String() { }
   
-  void Init(stmlib::BufferAllocator* allocator);
+  void Init(stmlib::BufferAllocator* allocator, float sample_rate);
   void Reset();
   void Process(
       float f0,
@@ -62,6 +83,11 @@ class String {
       const float* in,
       float* out,
       size_t size);
+  
+  // Can be called after Init, for benchmarks and tests.
+  inline void set_interpolation(StringInterpolation interpolation) {
+    interpolation_ = interpolation;
+  }
 
  private:
   template<StringNonLinearity non_linearity>
@@ -74,20 +100,31 @@ class String {
       float* out,
       size_t size);
   
+  inline float ReadString(float delay) const {
+    return interpolation_ == STRING_INTERPOLATION_LAGRANGE && delay >= 3.0f
+        ? string_.ReadLagrange(delay)
+        : string_.ReadHermite(delay);
+  }
+  
   DelayLine<float, kDelayLineSize> string_;
   DelayLine<float, kDelayLineSize / 4> stretch_;
   
   stmlib::Svf iir_damping_filter_;
   stmlib::DCBlocker dc_blocker_;
   
+  float sample_rate_;
   float delay_;
   float dispersion_noise_;
   float curved_bridge_;
   
-  // Very crappy linear interpolation upsampler used for low pitches that
-  // do not fit the delay line. Rarely used.
+  StringInterpolation interpolation_;
+  
+  // For low pitches that do not fit the delay line, the string runs at a
+  // lower rate. Its input is averaged, and its output interpolated from the
+  // last 4 samples.
   float src_phase_;
-  float out_sample_[2];
+  float input_sum_;
+  float out_sample_[4];
 
   DISALLOW_COPY_AND_ASSIGN(String);
 };
@@ -0,0 +1,383 @@
+// Copyright 2016 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Thin wrapper around a vector of floats, used to run several independent
+// voices in lockstep (one voice per lane). Uses AVX2 or SSE2 when available,
+// and falls back to plain C otherwise - so that the code using it still
+// builds for the hardware. Also used by rings and clouds, which include it
+// from their own dsp/simd.h.
+//
+// Comparisons return masks (all bits set in the lanes for which the condition
+// is true), which can be combined with the bitwise operators and Select().
+
+#ifndef PLAITS_DSP_SIMD_H_
+#define PLAITS_DSP_SIMD_H_
+
+#include "stmlib/stmlib.h"
+#include "stmlib/dsp/dsp.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+#elif defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+
+namespace plaits {
+
+#if defined(__AVX2__)
+
+const size_t kSimdWidth = 8;
+
+class SimdFloat {
+ public:
+  SimdFloat() { }
+  SimdFloat(float x) : v_(_mm256_set1_ps(x)) { }
+  SimdFloat(__m256 v) : v_(v) { }
+
+  static inline SimdFloat Load(const float* p) {
+    return _mm256_loadu_ps(p);
+  }
+  inline void Store(float* p) const { _mm256_storeu_ps(p, v_); }
+
+  inline SimdFloat operator+(SimdFloat b) const {
+    return _mm256_add_ps(v_, b.v_);
+  }
+  inline SimdFloat operator-(SimdFloat b) const {
+    return _mm256_sub_ps(v_, b.v_);
+  }
+  inline SimdFloat operator*(SimdFloat b) const {
+    return _mm256_mul_ps(v_, b.v_);
+  }
+  inline SimdFloat operator/(SimdFloat b) const {
+    return _mm256_div_ps(v_, b.v_);
+  }
+  inline SimdFloat operator&(SimdFloat b) const {
+    return _mm256_and_ps(v_, b.v_);
+  }
+  inline SimdFloat operator|(SimdFloat b) const {
+    return _mm256_or_ps(v_, b.v_);
+  }
+  inline SimdFloat operator^(SimdFloat b) const {
+    return _mm256_xor_ps(v_, b.v_);
+  }
+  inline SimdFloat operator<(SimdFloat b) const {
+    return _mm256_cmp_ps(v_, b.v_, _CMP_LT_OQ);
+  }
+  inline SimdFloat operator>=(SimdFloat b) const {
+    return _mm256_cmp_ps(v_, b.v_, _CMP_GE_OQ);
+  }
+
+  // Lanes of a for which the mask is clear.
+  static inline SimdFloat AndNot(SimdFloat mask, SimdFloat a) {
+    return _mm256_andnot_ps(mask.v_, a.v_);
+  }
+  static inline SimdFloat Select(SimdFloat mask, SimdFloat a, SimdFloat b) {
+    return _mm256_blendv_ps(b.v_, a.v_, mask.v_);
+  }
+  static inline SimdFloat Min(SimdFloat a, SimdFloat b) {
+    return _mm256_min_ps(a.v_, b.v_);
+  }
+  static inline SimdFloat Max(SimdFloat a, SimdFloat b) {
+    return _mm256_max_ps(a.v_, b.v_);
+  }
+  static inline SimdFloat Sqrt(SimdFloat a) { return _mm256_sqrt_ps(a.v_); }
+  static inline SimdFloat True() {
+    return _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+  }
+  inline bool any() const { return _mm256_movemask_ps(v_) != 0; }
+
+  // One table lookup per lane.
+  static inline SimdFloat Gather(const float* table, const int32_t* indices) {
+    return _mm256_i32gather_ps(
+        table,
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices)),
+        4);
+  }
+
+  // Splits a vector of positive numbers into integral and fractional parts.
+  inline void Split(int32_t* integral, SimdFloat* fractional) const {
+    __m256i i = _mm256_cvttps_epi32(v_);
+    _mm256_storeu_si256((__m256i*)(integral), i);
+    *fractional = _mm256_sub_ps(v_, _mm256_cvtepi32_ps(i));
+  }
+
+ private:
+  __m256 v_;
+};
+
+#elif defined(__SSE2__)
+
+const size_t kSimdWidth = 4;
+
+class SimdFloat {
+ public:
+  SimdFloat() { }
+  SimdFloat(float x) : v_(_mm_set1_ps(x)) { }
+  SimdFloat(__m128 v) : v_(v) { }
+
+  static inline SimdFloat Load(const float* p) { return _mm_loadu_ps(p); }
+  inline void Store(float* p) const { _mm_storeu_ps(p, v_); }
+
+  inline SimdFloat operator+(SimdFloat b) const { return _mm_add_ps(v_, b.v_); }
+  inline SimdFloat operator-(SimdFloat b) const { return _mm_sub_ps(v_, b.v_); }
+  inline SimdFloat operator*(SimdFloat b) const { return _mm_mul_ps(v_, b.v_); }
+  inline SimdFloat operator/(SimdFloat b) const { return _mm_div_ps(v_, b.v_); }
+  inline SimdFloat operator&(SimdFloat b) const { return _mm_and_ps(v_, b.v_); }
+  inline SimdFloat operator|(SimdFloat b) const { return _mm_or_ps(v_, b.v_); }
+  inline SimdFloat operator^(SimdFloat b) const { return _mm_xor_ps(v_, b.v_); }
+  inline SimdFloat operator<(SimdFloat b) const {
+    return _mm_cmplt_ps(v_, b.v_);
+  }
+  inline SimdFloat operator>=(SimdFloat b) const {
+    return _mm_cmpge_ps(v_, b.v_);
+  }
+
+  static inline SimdFloat AndNot(SimdFloat mask, SimdFloat a) {
+    return _mm_andnot_ps(mask.v_, a.v_);
+  }
+  static inline SimdFloat Select(SimdFloat mask, SimdFloat a, SimdFloat b) {
+    return _mm_or_ps(_mm_and_ps(mask.v_, a.v_), _mm_andnot_ps(mask.v_, b.v_));
+  }
+  static inline SimdFloat Min(SimdFloat a, SimdFloat b) {
+    return _mm_min_ps(a.v_, b.v_);
+  }
+  static inline SimdFloat Max(SimdFloat a, SimdFloat b) {
+    return _mm_max_ps(a.v_, b.v_);
+  }
+  static inline SimdFloat Sqrt(SimdFloat a) { return _mm_sqrt_ps(a.v_); }
+  static inline SimdFloat True() {
+    return _mm_castsi128_ps(_mm_set1_epi32(-1));
+  }
+  inline bool any() const { return _mm_movemask_ps(v_) != 0; }
+
+  static inline SimdFloat Gather(const float* table, const int32_t* indices) {
+    return _mm_set_ps(
+        table[indices[3]],
+        table[indices[2]],
+        table[indices[1]],
+        table[indices[0]]);
+  }
+
+  inline void Split(int32_t* integral, SimdFloat* fractional) const {
+    __m128i i = _mm_cvttps_epi32(v_);
+    _mm_storeu_si128((__m128i*)(integral), i);
+    *fractional = _mm_sub_ps(v_, _mm_cvtepi32_ps(i));
+  }
+
+ private:
+  __m128 v_;
+};
+
+#else
+
+const size_t kSimdWidth = 4;
+
+class SimdFloat {
+ public:
+  SimdFloat() { }
+  SimdFloat(float x) {
+    for (size_t i = 0; i < kSimdWidth; ++i) v_[i] = x;
+  }
+
+  static inline SimdFloat Load(const float* p) {
+    SimdFloat r;
+    std::memcpy(r.v_, p, sizeof(r.v_));
+    return r;
+  }
+  inline void Store(float* p) const { std::memcpy(p, v_, sizeof(v_)); }
+
+  inline SimdFloat operator+(SimdFloat b) const {
+    SimdFloat r;
+    for (size_t i = 0; i < kSimdWidth; ++i) r.v_[i] = v_[i] + b.v_[i];
+    return r;
+  }
+  inline SimdFloat operator-(SimdFloat b) const {
+    SimdFloat r;
+    for (size_t i = 0; i < kSimdWidth; ++i) r.v_[i] = v_[i] - b.v_[i];
+    return r;
+  }
+  inline SimdFloat operator*(SimdFloat b) const {
+    SimdFloat r;
+    for (size_t i = 0; i < kSimdWidth; ++i) r.v_[i] = v_[i] * b.v_[i];
+    return r;
+  }
+  inline SimdFloat operator/(SimdFloat b) const {
+    SimdFloat r;
+    for (size_t i = 0; i < kSimdWidth; ++i) r.v_[i] = v_[i] / b.v_[i];
+    return r;
+  }
+  inline SimdFloat operator&(SimdFloat b) const {
+    SimdFloat r;
+    for (size_t i = 0; i < kSimdWidth; ++i) r.set_bits(i, bits(i) & b.bits(i));
+    return r;
+  }
+  inline SimdFloat operator|(SimdFloat b) const {
+    SimdFloat r;
+    for (size_t i = 0; i < kSimdWidth; ++i) r.set_bits(i, bits(i) | b.bits(i));
+    return r;
+  }
+  inline SimdFloat operator^(SimdFloat b) const {
+    SimdFloat r;
+    for (size_t i = 0; i < kSimdWidth; ++i) r.set_bits(i, bits(i) ^ b.bits(i));
+    return r;
+  }
+  inline SimdFloat operator<(SimdFloat b) const {
+    SimdFloat r;
+    for (size_t i = 0; i < kSimdWidth; ++i) {
+      r.set_bits(i, v_[i] < b.v_[i] ? 0xffffffff : 0);
+    }
+    return r;
+  }
+  inline SimdFloat operator>=(SimdFloat b) const {
+    SimdFloat r;
+    for (size_t i = 0; i < kSimdWidth; ++i) {
+      r.set_bits(i, v_[i] >= b.v_[i] ? 0xffffffff : 0);
+    }
+    return r;
+  }
+
+  static inline SimdFloat AndNot(SimdFloat mask, SimdFloat a) {
+    SimdFloat r;
+    for (size_t i = 0; i < kSimdWidth; ++i) {
+      r.set_bits(i, ~mask.bits(i) & a.bits(i));
+    }
+    return r;
+  }
+  static inline SimdFloat Select(SimdFloat mask, SimdFloat a, SimdFloat b) {
+    SimdFloat r;
+    for (size_t i = 0; i < kSimdWidth; ++i) {
+      r.v_[i] = mask.bits(i) ? a.v_[i] : b.v_[i];
+    }
+    return r;
+  }
+  static inline SimdFloat Min(SimdFloat a, SimdFloat b) {
+    SimdFloat r;
+    for (size_t i = 0; i < kSimdWidth; ++i) {
+      r.v_[i] = a.v_[i] < b.v_[i] ? a.v_[i] : b.v_[i];
+    }
+    return r;
+  }
+  static inline SimdFloat Max(SimdFloat a, SimdFloat b) {
+    SimdFloat r;
+    for (size_t i = 0; i < kSimdWidth; ++i) {
+      r.v_[i] = a.v_[i] > b.v_[i] ? a.v_[i] : b.v_[i];
+    }
+    return r;
+  }
+  static inline SimdFloat Sqrt(SimdFloat a) {
+    SimdFloat r;
+    for (size_t i = 0; i < kSimdWidth; ++i) r.v_[i] = sqrtf(a.v_[i]);
+    return r;
+  }
+  static inline SimdFloat True() {
+    SimdFloat r;
+    for (size_t i = 0; i < kSimdWidth; ++i) r.set_bits(i, 0xffffffff);
+    return r;
+  }
+  inline bool any() const {
+    uint32_t x = 0;
+    for (size_t i = 0; i < kSimdWidth; ++i) x |= bits(i);
+    return x != 0;
+  }
+
+  static inline SimdFloat Gather(const float* table, const int32_t* indices) {
+    SimdFloat r;
+    for (size_t i = 0; i < kSimdWidth; ++i) r.v_[i] = table[indices[i]];
+    return r;
+  }
+
+  inline void Split(int32_t* integral, SimdFloat* fractional) const {
+    for (size_t i = 0; i < kSimdWidth; ++i) {
+      integral[i] = static_cast<int32_t>(v_[i]);
+      fractional->v_[i] = v_[i] - static_cast<float>(integral[i]);
+    }
+  }
+
+ private:
+  inline uint32_t bits(size_t i) const {
+    uint32_t b;
+    std::memcpy(&b, &v_[i], sizeof(b));
+    return b;
+  }
+  inline void set_bits(size_t i, uint32_t b) {
+    std::memcpy(&v_[i], &b, sizeof(b));
+  }
+
+  float v_[kSimdWidth];
+};
+
+#endif
+
+inline SimdFloat& operator+=(SimdFloat& a, SimdFloat b) { return a = a + b; }
+inline SimdFloat& operator-=(SimdFloat& a, SimdFloat b) { return a = a - b; }
+inline SimdFloat& operator*=(SimdFloat& a, SimdFloat b) { return a = a * b; }
+
+// Vector counterpart of stmlib::Interpolate - one table lookup per lane. The
+// scalar version stays visible to the code of the plaits namespace which does
+// "using namespace stmlib".
+using stmlib::Interpolate;
+
+inline SimdFloat Interpolate(const float* table, SimdFloat index, float size) {
+  int32_t integral[kSimdWidth];
+  SimdFloat fractional;
+  (index * SimdFloat(size)).Split(integral, &fractional);
+  SimdFloat x0 = SimdFloat::Gather(table, integral);
+  SimdFloat x1 = SimdFloat::Gather(table + 1, integral);
+  return x0 + (x1 - x0) * fractional;
+}
+
+// Vector counterpart of stmlib::ParameterInterpolator.
+class SimdParameterInterpolator {
+ public:
+  SimdParameterInterpolator(float* state, SimdFloat new_value, size_t size) {
+    state_ = state;
+    value_ = SimdFloat::Load(state);
+    increment_ = (new_value - value_) / SimdFloat(static_cast<float>(size));
+  }
+
+  ~SimdParameterInterpolator() {
+    value_.Store(state_);
+  }
+
+  inline SimdFloat Next() {
+    value_ += increment_;
+    return value_;
+  }
+
+ private:
+  float* state_;
+  SimdFloat value_;
+  SimdFloat increment_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimdParameterInterpolator);
+};
+
+}  // namespace plaits
+
+#endif  // PLAITS_DSP_SIMD_H_
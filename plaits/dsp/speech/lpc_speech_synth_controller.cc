@@ -203,7 +203,10 @@ bool LPCSpeechSynthWordBank::Load(int bank) {
   return true;
 }
 
-void LPCSpeechSynthController::Init(LPCSpeechSynthWordBank* word_bank) {
+void LPCSpeechSynthController::Init(
+    const SampleRateConstants& rate,
+    LPCSpeechSynthWordBank* word_bank) {
+  rate_ = rate;
   word_bank_ = word_bank;
   
   clock_phase_ = 0.0f;
@@ -233,11 +236,12 @@ void LPCSpeechSynthController::Render(
     float* output,
     size_t size) {
   const float rate_ratio = SemitonesToRatio((formant_shift - 0.5f) * 36.0f);
-  const float rate = rate_ratio / 6.0f;
+  const float rate = rate_ratio / \
+      (rate_.sample_rate / kLPCSpeechSynthClockRate);
   
   // All utterances have been normalized for an average f0 of 100 Hz.
   const float pitch_shift = frequency / \
-      (rate_ratio * kLPCSpeechSynthDefaultF0 / kCorrectedSampleRate);
+      (rate_ratio * kLPCSpeechSynthDefaultF0 / rate_.corrected_sample_rate);
   const float time_stretch = SemitonesToRatio(-speed * 24.0f +
         (formant_shift < 0.4f ? (formant_shift - 0.4f) * -45.0f
             : (formant_shift > 0.6f ? (formant_shift - 0.6f) * -45.0f : 0.0f)));
@@ -283,7 +287,7 @@ void LPCSpeechSynthController::Render(
   } else {
     if (remaining_frame_samples_ == 0) {
       synth_.PlayFrame(frames, float(playback_frame_), false);
-      remaining_frame_samples_ = kSampleRate / kLPCSpeechSynthFPS * \
+      remaining_frame_samples_ = rate_.sample_rate / kLPCSpeechSynthFPS * \
           time_stretch;
       ++playback_frame_;
       if (playback_frame_ >= last_playback_frame_) {
@@ -91,6 +91,7 @@ const int kLPCSpeechSynthNumConsonants = 10;
 const int kLPCSpeechSynthNumPhonemes = \
     kLPCSpeechSynthNumVowels + kLPCSpeechSynthNumConsonants;
 const float kLPCSpeechSynthFPS = 40.0f;
+const float kLPCSpeechSynthClockRate = 8000.0f;
 
 struct LPCSpeechSynthWordBankData {
   const uint8_t* data;
@@ -158,7 +159,9 @@ class LPCSpeechSynthController {
   LPCSpeechSynthController() { }
   ~LPCSpeechSynthController() { }
   
-  void Init(LPCSpeechSynthWordBank* word_bank);
+  void Init(
+      const SampleRateConstants& rate,
+      LPCSpeechSynthWordBank* word_bank);
   
   void Render(
       bool free_running,
@@ -175,6 +178,8 @@ class LPCSpeechSynthController {
       size_t size);
   
  private:
+  SampleRateConstants rate_;
+  
   float clock_phase_;
   float sample_[2];
   float next_sample_[2];
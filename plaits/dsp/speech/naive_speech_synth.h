@@ -46,7 +46,7 @@ class NaiveSpeechSynth {
   NaiveSpeechSynth() { }
   ~NaiveSpeechSynth() { }
 
-  void Init();
+  void Init(const SampleRateConstants& rate);
   
   void Render(
       bool click,
@@ -68,6 +68,8 @@ class NaiveSpeechSynth {
     Formant formant[kNaiveSpeechNumFormants];
   };
 
+  SampleRateConstants rate_;
+  
   Oscillator pulse_;
   float frequency_;
   size_t click_duration_;
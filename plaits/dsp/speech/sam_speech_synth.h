@@ -43,7 +43,7 @@ class SAMSpeechSynth {
   SAMSpeechSynth() { }
   ~SAMSpeechSynth() { }
 
-  void Init();
+  void Init(float sample_rate);
   
   void Render(
       bool consonant,
@@ -61,6 +61,8 @@ class SAMSpeechSynth {
       uint32_t* formant_frequency,
       float* formant_amplitude);
   
+  float sample_rate_;
+  
   struct Formant {
     uint8_t frequency;
     uint8_t amplitude;
@@ -28,12 +28,22 @@
 
 #include "plaits/dsp/voice.h"
 
+#include "plaits/resources.h"
+
 namespace plaits {
 
 using namespace std;
 using namespace stmlib;
 
-void Voice::Init(BufferAllocator* allocator) {
+void Voice::Init(
+    BufferAllocator* allocator,
+    const VoiceSharedTables* shared_tables,
+    const VoiceSettings& settings) {
+  rate_.Init(settings.sample_rate);
+  if (shared_tables) {
+    chord_engine_.set_shared_ratios(shared_tables->chord_ratios);
+  }
+  
   engines_.Init();
   engines_.RegisterInstance(&virtual_analog_engine_, false, 0.8f, 0.8f);
   engines_.RegisterInstance(&waveshaping_engine_, false, 0.7f, 0.6f);
@@ -52,18 +62,36 @@ void Voice::Init(BufferAllocator* allocator) {
   engines_.RegisterInstance(&bass_drum_engine_, true, 0.8f, 0.8f);
   engines_.RegisterInstance(&snare_drum_engine_, true, 0.8f, 0.8f);
   engines_.RegisterInstance(&hi_hat_engine_, true, 0.8f, 0.8f);
+  
+  // The engines allocate their buffers from the rest of the RAM block.
+  const size_t ram_size = allocator->free();
+  allocator_.Init(allocator->Allocate<uint8_t>(ram_size), ram_size);
+  
+#ifdef PLAITS_ENGINE_CROSSFADE
+  crossfade_engines_ = settings.crossfade_engines;
+#endif  // PLAITS_ENGINE_CROSSFADE
+  initialized_engines_ = 0;
   for (int i = 0; i < engines_.size(); ++i) {
-    // All engines will share the same RAM space.
-    allocator->Free();
-    engines_.get(i)->Init(allocator);
+    engines_.get(i)->set_sample_rate(rate_);
+    if (!settings.lazy_engine_init) {
+      InitEngine(i);
+    }
   }
   
   engine_quantizer_.Init();
   previous_engine_index_ = -1;
   engine_cv_ = 0.0f;
   
-  out_post_processor_.Init();
-  aux_post_processor_.Init();
+#ifdef PLAITS_ENGINE_CROSSFADE
+  fading_engine_index_ = -1;
+  crossfade_phase_ = 0.0f;
+#endif  // PLAITS_ENGINE_CROSSFADE
+  
+  for (int i = 0; i < kNumPostProcessors; ++i) {
+    out_post_processor_[i].Init();
+    aux_post_processor_[i].Init();
+  }
+  active_post_processor_ = 0;
 
   decay_envelope_.Init();
   lpg_envelope_.Init();
@@ -71,7 +99,26 @@ void Voice::Init(BufferAllocator* allocator) {
   trigger_state_ = false;
   previous_note_ = 0.0f;
   
-  trigger_delay_.Init(trigger_delay_line_);
+  trigger_delay_.Init(static_cast<size_t>(
+      float(kTriggerDelay) * rate_.sample_rate / kSampleRate));
+  
+#ifdef PLAITS_VOICE_PROFILER
+  profiler_.Init();
+#endif  // PLAITS_VOICE_PROFILER
+}
+
+void Voice::InitEngine(int index) {
+  // All engines share the same RAM space - unless two of them have to run at
+  // the same time during a crossfade.
+#ifdef PLAITS_ENGINE_CROSSFADE
+  if (!crossfade_engines_) {
+    allocator_.Free();
+  }
+#else
+  allocator_.Free();
+#endif  // PLAITS_ENGINE_CROSSFADE
+  engines_.get(index)->Init(&allocator_);
+  initialized_engines_ |= 1 << index;
 }
 
 void Voice::Render(
@@ -79,27 +126,27 @@ void Voice::Render(
     const Modulations& modulations,
     Frame* frames,
     size_t size) {
+#ifdef PLAITS_VOICE_PROFILER
+  VoiceProfileRecord profile;
+  profile.size = static_cast<uint16_t>(size);
+  profile.render = 0;
+  profile.post_processor = 0;
+  profile.limiter = 0;
+#endif  // PLAITS_VOICE_PROFILER
+  VOICE_PROFILER_TIMESTAMP(start);
+  
   // Trigger, LPG, internal envelope.
       
   // Delay trigger by 1ms to deal with sequencers or MIDI interfaces whose
   // CV out lags behind the GATE out.
-  trigger_delay_.Write(modulations.trigger);
-  float trigger_value = trigger_delay_.Read(kTriggerDelay);
-  
   bool previous_trigger_state = trigger_state_;
-  if (!previous_trigger_state) {
-    if (trigger_value > 0.3f) {
-      trigger_state_ = true;
-      if (!modulations.level_patched) {
-        lpg_envelope_.Trigger();
-      }
-      decay_envelope_.Trigger();
-      engine_cv_ = modulations.engine;
-    }
-  } else {
-    if (trigger_value < 0.1f) {
-      trigger_state_ = false;
+  trigger_state_ = trigger_delay_.Process(modulations.trigger, size);
+  if (trigger_state_ && !previous_trigger_state) {
+    if (!modulations.level_patched) {
+      lpg_envelope_.Trigger();
     }
+    decay_envelope_.Trigger();
+    engine_cv_ = modulations.engine;
   }
   if (!modulations.trigger_patched) {
     engine_cv_ = modulations.engine;
@@ -115,8 +162,25 @@ void Voice::Render(
   Engine* e = engines_.get(engine_index);
   
   if (engine_index != previous_engine_index_) {
-    e->Reset();
-    out_post_processor_.Reset();
+    if (!(initialized_engines_ & (1 << engine_index))) {
+      InitEngine(engine_index);
+    }
+    bool reset = true;
+#ifdef PLAITS_ENGINE_CROSSFADE
+    if (crossfade_engines_ && previous_engine_index_ != -1) {
+      // If a crossfade is already in progress, the engine being faded out is
+      // replaced by the new one, at the same gain. When the new engine is the
+      // one being faded out, this just reverses the crossfade.
+      reset = engine_index != fading_engine_index_;
+      crossfade_phase_ = crossfading() ? 1.0f - crossfade_phase_ : 0.0f;
+      fading_engine_index_ = previous_engine_index_;
+      active_post_processor_ ^= 1;
+    }
+#endif  // PLAITS_ENGINE_CROSSFADE
+    if (reset) {
+      e->Reset();
+      out_post_processor_[active_post_processor_].Reset();
+    }
     previous_engine_index_ = engine_index;
   }
   EngineParameters p;
@@ -131,11 +195,6 @@ void Voice::Render(
   } else {
     p.trigger = TRIGGER_UNPATCHED;
   }
-  
-  const float short_decay = (200.0f * kBlockSize) / kSampleRate *
-      SemitonesToRatio(-96.0f * patch.decay);
-
-  decay_envelope_.Process(short_decay * 2.0f);
 
   const float compressed_level = max(
       1.3f * modulations.level / (0.3f + fabsf(modulations.level)),
@@ -160,82 +219,219 @@ void Voice::Render(
         !modulations.trigger_patched || modulations.morph_patched ?
             0.0f : patch.morph_modulation_amount);
   }
+  
+  // The internal envelope, the LPG and the engines are updated at the control
+  // rate of the hardware, once every kBlockSize samples, whatever the size of
+  // the block. The envelope and LPG coefficients are proportional to the
+  // duration of an update. The engines smooth and delay their parameters once
+  // per call, so they are always rendered in steps of kBlockSize samples.
+  const float decay_ratio = SemitonesToRatio(-96.0f * patch.decay);
+  
+  const float hf = patch.lpg_colour;
+  const float tail_ratio = SemitonesToRatio(-72.0f * patch.decay + 12.0f * hf);
+  
+  bool lpg_bypass = true;
+  bool fading_lpg_bypass = true;
+#ifdef PLAITS_ENGINE_CROSSFADE
+  Engine* fading_engine = crossfading()
+      ? engines_.get(fading_engine_index_)
+      : NULL;
+  const int fading_post_processor = active_post_processor_ ^ 1;
+  const PostProcessingSettings* fading_pp_s = fading_engine
+      ? &fading_engine->post_processing_settings
+      : NULL;
+#endif  // PLAITS_ENGINE_CROSSFADE
+  
+  for (size_t offset = 0; offset < size; offset += kBlockSize) {
+    const size_t step = min(size - offset, kBlockSize);
+    const float short_decay = (200.0f * step) / rate_.sample_rate * \
+        decay_ratio;
+    decay_envelope_.Process(short_decay * 2.0f);
+    
+    p.note = ApplyModulations(
+        patch.note + note,
+        patch.frequency_modulation_amount,
+        modulations.frequency_patched,
+        modulations.frequency,
+        use_internal_envelope,
+        internal_envelope_amplitude * \
+            decay_envelope_.value() * decay_envelope_.value() * 48.0f,
+        1.0f,
+        -119.0f,
+        120.0f);
+
+    p.timbre = ApplyModulations(
+        patch.timbre,
+        patch.timbre_modulation_amount,
+        modulations.timbre_patched,
+        modulations.timbre,
+        use_internal_envelope,
+        decay_envelope_.value(),
+        0.0f,
+        0.0f,
+        1.0f);
+
+    p.morph = ApplyModulations(
+        patch.morph,
+        patch.morph_modulation_amount,
+        modulations.morph_patched,
+        modulations.morph,
+        use_internal_envelope,
+        internal_envelope_amplitude * decay_envelope_.value(),
+        0.0f,
+        0.0f,
+        1.0f);
+
+    bool already_enveloped = pp_s.already_enveloped;
+    VOICE_PROFILER_TIMESTAMP(render_start);
+    e->Render(
+        p,
+        out_buffer_ + offset,
+        aux_buffer_ + offset,
+        step,
+        &already_enveloped);
+    VOICE_PROFILER_ACCUMULATE(profile.render, render_start);
+    lpg_bypass = already_enveloped || \
+        (!modulations.level_patched && !modulations.trigger_patched);
+    
+#ifdef PLAITS_ENGINE_CROSSFADE
+    if (fading_engine) {
+      bool fading_already_enveloped = fading_pp_s->already_enveloped;
+      VOICE_PROFILER_TIMESTAMP(fading_render_start);
+      fading_engine->Render(
+          p,
+          fading_out_buffer_ + offset,
+          fading_aux_buffer_ + offset,
+          step,
+          &fading_already_enveloped);
+      VOICE_PROFILER_ACCUMULATE(profile.render, fading_render_start);
+      fading_lpg_bypass = fading_already_enveloped || \
+          (!modulations.level_patched && !modulations.trigger_patched);
+    }
+#endif  // PLAITS_ENGINE_CROSSFADE
+    
+    // The rising edge is only seen by the first step.
+    if (p.trigger == TRIGGER_RISING_EDGE) {
+      p.trigger = TRIGGER_LOW;
+    }
+    VOICE_PROFILER_TIMESTAMP(post_processor_start);
+    
+    // Compute LPG parameters.
+    if (!lpg_bypass || !fading_lpg_bypass) {
+      const float decay_tail = (20.0f * step) / rate_.sample_rate * \
+          tail_ratio - short_decay;
+      
+      if (modulations.level_patched) {
+        lpg_envelope_.ProcessLP(compressed_level, short_decay, decay_tail, hf);
+      } else {
+        const float attack = NoteToFrequency(p.note, rate_.a0) * \
+            float(step) * 2.0f;
+        lpg_envelope_.ProcessPing(attack, short_decay, decay_tail, hf);
+      }
+    }
+    const float lpg_frequency = min(
+        lpg_envelope_.frequency() * rate_.frequency_scale, 0.49f);
+    
+    out_post_processor_[active_post_processor_].Process(
+        pp_s.out_gain,
+        lpg_bypass,
+        lpg_envelope_.gain(),
+        lpg_frequency,
+        lpg_envelope_.hf_bleed(),
+        out_buffer_ + offset,
+        &frames[offset].out,
+        step,
+        2);
 
-  p.note = ApplyModulations(
-      patch.note + note,
-      patch.frequency_modulation_amount,
-      modulations.frequency_patched,
-      modulations.frequency,
-      use_internal_envelope,
-      internal_envelope_amplitude * \
-          decay_envelope_.value() * decay_envelope_.value() * 48.0f,
-      1.0f,
-      -119.0f,
-      120.0f);
-
-  p.timbre = ApplyModulations(
-      patch.timbre,
-      patch.timbre_modulation_amount,
-      modulations.timbre_patched,
-      modulations.timbre,
-      use_internal_envelope,
-      decay_envelope_.value(),
-      0.0f,
-      0.0f,
-      1.0f);
-
-  p.morph = ApplyModulations(
-      patch.morph,
-      patch.morph_modulation_amount,
-      modulations.morph_patched,
-      modulations.morph,
-      use_internal_envelope,
-      internal_envelope_amplitude * decay_envelope_.value(),
-      0.0f,
-      0.0f,
-      1.0f);
-
-  bool already_enveloped = pp_s.already_enveloped;
-  e->Render(p, out_buffer_, aux_buffer_, size, &already_enveloped);
-  
-  bool lpg_bypass = already_enveloped || \
-      (!modulations.level_patched && !modulations.trigger_patched);
-  
-  // Compute LPG parameters.
-  if (!lpg_bypass) {
-    const float hf = patch.lpg_colour;
-    const float decay_tail = (20.0f * kBlockSize) / kSampleRate *
-        SemitonesToRatio(-72.0f * patch.decay + 12.0f * hf) - short_decay;
+    aux_post_processor_[active_post_processor_].Process(
+        pp_s.aux_gain,
+        lpg_bypass,
+        lpg_envelope_.gain(),
+        lpg_frequency,
+        lpg_envelope_.hf_bleed(),
+        aux_buffer_ + offset,
+        &frames[offset].aux,
+        step,
+        2);
     
-    if (modulations.level_patched) {
-      lpg_envelope_.ProcessLP(compressed_level, short_decay, decay_tail, hf);
-    } else {
-      const float attack = NoteToFrequency(p.note) * float(kBlockSize) * 2.0f;
-      lpg_envelope_.ProcessPing(attack, short_decay, decay_tail, hf);
+#ifdef PLAITS_ENGINE_CROSSFADE
+    if (fading_engine) {
+      out_post_processor_[fading_post_processor].Process(
+          fading_pp_s->out_gain,
+          fading_lpg_bypass,
+          lpg_envelope_.gain(),
+          lpg_frequency,
+          lpg_envelope_.hf_bleed(),
+          fading_out_buffer_ + offset,
+          &fading_frames_[offset].out,
+          step,
+          2);
+      aux_post_processor_[fading_post_processor].Process(
+          fading_pp_s->aux_gain,
+          fading_lpg_bypass,
+          lpg_envelope_.gain(),
+          lpg_frequency,
+          lpg_envelope_.hf_bleed(),
+          fading_aux_buffer_ + offset,
+          &fading_frames_[offset].aux,
+          step,
+          2);
     }
+#endif  // PLAITS_ENGINE_CROSSFADE
+    VOICE_PROFILER_ACCUMULATE(profile.post_processor, post_processor_start);
+  }
+  
+#ifdef PLAITS_VOICE_PROFILER
+  // Before the end of the crossfade clears fading_engine_index_.
+  profile.engine = static_cast<uint8_t>(engine_index);
+  profile.fading_engine = kVoiceProfilerNoEngine;
+#ifdef PLAITS_ENGINE_CROSSFADE
+  if (fading_engine) {
+    profile.fading_engine = static_cast<uint8_t>(fading_engine_index_);
+  }
+#endif  // PLAITS_ENGINE_CROSSFADE
+#endif  // PLAITS_VOICE_PROFILER
+  
+#ifdef PLAITS_ENGINE_CROSSFADE
+  if (fading_engine) {
+    Crossfade(fading_frames_, frames, size);
   }
+#endif  // PLAITS_ENGINE_CROSSFADE
   
-  out_post_processor_.Process(
-      pp_s.out_gain,
-      lpg_bypass,
-      lpg_envelope_.gain(),
-      lpg_envelope_.frequency(),
-      lpg_envelope_.hf_bleed(),
-      out_buffer_,
-      &frames->out,
-      size,
-      2);
-
-  aux_post_processor_.Process(
-      pp_s.aux_gain,
-      lpg_bypass,
-      lpg_envelope_.gain(),
-      lpg_envelope_.frequency(),
-      lpg_envelope_.hf_bleed(),
-      aux_buffer_,
-      &frames->aux,
-      size,
-      2);
+#ifdef PLAITS_VOICE_PROFILER
+  for (int i = 0; i < kNumPostProcessors; ++i) {
+    profile.limiter += out_post_processor_[i].ConsumeLimiterCycles();
+    profile.limiter += aux_post_processor_[i].ConsumeLimiterCycles();
+  }
+  profile.post_processor -= profile.limiter;
+  profile.total = ReadCycleCounter() - start;
+  profiler_.Write(profile);
+#endif  // PLAITS_VOICE_PROFILER
+}
+
+#ifdef PLAITS_ENGINE_CROSSFADE
+void Voice::Crossfade(const Frame* fading_frames, Frame* frames, size_t size) {
+  // Equal-power: the gains of the two engines are cos and sin of the same
+  // angle, read from the first quarter of the sine LUT.
+  const float increment = 1.0f / float(kEngineCrossfadeDuration);
+  float phase = crossfade_phase_;
+  for (size_t i = 0; i < size; ++i) {
+    phase = min(phase + increment, 1.0f);
+    const float fade_in = Interpolate(lut_sine, phase * 0.25f, 1024.0f);
+    const float fade_out = Interpolate(
+        lut_sine, phase * 0.25f + 0.25f, 1024.0f);
+    frames[i].out = Clip16(static_cast<int32_t>(
+        fade_in * float(frames[i].out) +
+        fade_out * float(fading_frames[i].out)));
+    frames[i].aux = Clip16(static_cast<int32_t>(
+        fade_in * float(frames[i].aux) +
+        fade_out * float(fading_frames[i].aux)));
+  }
+  crossfade_phase_ = phase;
+  if (crossfade_phase_ >= 1.0f) {
+    fading_engine_index_ = -1;
+  }
 }
+#endif  // PLAITS_ENGINE_CROSSFADE
   
 }  // namespace plaits
@@ -54,14 +54,50 @@
 #include "plaits/dsp/engine/wavetable_engine.h"
 
 #include "plaits/dsp/envelope.h"
+#include "plaits/dsp/voice_profiler.h"
 
 #include "plaits/dsp/fx/low_pass_gate.h"
 
 namespace plaits {
 
 const int kMaxEngines = 16;
-const int kMaxTriggerDelay = 8;
-const int kTriggerDelay = 5;
+
+// Delay of the trigger input, in samples at kSampleRate (1ms). At other
+// sample rates, the delay is scaled to the same duration.
+const size_t kTriggerDelay = 48;
+
+// Must be a power of 2, longer than the trigger delay at the highest sample
+// rate (1ms at 192kHz).
+const size_t kMaxTriggerDelay = 256;
+
+// RAM block shared by all engines: 16kB on the hardware, plus room for two
+// larger temporary buffers when kMaxBlockSize is raised.
+const size_t kVoiceRamSize = 16384 + \
+    2 * (kMaxBlockSize - 2 * kBlockSize) * sizeof(float);
+
+// When engine crossfading is enabled, the previous engine keeps running for
+// this number of samples after a switch, and is faded out while the new one
+// fades in. Each engine then needs its own buffers, so the voice needs a RAM
+// block of at least kVoiceCrossfadeRamSize bytes: the sum of all the engines'
+// allocations, 8 of which are temporary block buffers.
+//
+// Only compiled in when PLAITS_ENGINE_CROSSFADE is defined: the second set of
+// buffers and post-processors would otherwise take RAM on the hardware, which
+// does not use it.
+const size_t kEngineCrossfadeDuration = 480;
+const size_t kVoiceCrossfadeRamSize = \
+    8 * kMaxBlockSize * sizeof(float) + \
+    kChordNumChords * kChordNumVoices * sizeof(float) + \
+    kDiffuserBufferSize * sizeof(uint16_t) + \
+    kLPCSpeechSynthMaxFrames * sizeof(LPCSpeechSynth::Frame) + \
+    (kNumStrings * (kDelayLineSize + kDelayLineSize / 4) + \
+        kStringEngineF0DelaySize) * sizeof(float);
+
+#ifdef PLAITS_ENGINE_CROSSFADE
+const int kNumPostProcessors = 2;
+#else
+const int kNumPostProcessors = 1;
+#endif  // PLAITS_ENGINE_CROSSFADE
 
 class ChannelPostProcessor {
  public:
@@ -71,6 +107,9 @@ class ChannelPostProcessor {
   void Init() {
     lpg_.Init();
     Reset();
+#ifdef PLAITS_VOICE_PROFILER
+    limiter_cycles_ = 0;
+#endif  // PLAITS_VOICE_PROFILER
   }
   
   void Reset() {
@@ -88,7 +127,9 @@ class ChannelPostProcessor {
       size_t size,
       size_t stride) {
     if (gain < 0.0f) {
+      VOICE_PROFILER_TIMESTAMP(start);
       limiter_.Process(-gain, in, size);
+      VOICE_PROFILER_ACCUMULATE(limiter_cycles_, start);
     }
     const float post_gain = (gain < 0.0f ? 1.0f : gain) * -32767.0f;
     if (!bypass_lpg) {
@@ -108,13 +149,69 @@ class ChannelPostProcessor {
     }
   }
   
+#ifdef PLAITS_VOICE_PROFILER
+  // Returns the cycles spent in the limiter since the previous call.
+  inline uint32_t ConsumeLimiterCycles() {
+    uint32_t cycles = limiter_cycles_;
+    limiter_cycles_ = 0;
+    return cycles;
+  }
+#endif  // PLAITS_VOICE_PROFILER
+  
  private:
   stmlib::Limiter limiter_;
   LowPassGate lpg_;
   
+#ifdef PLAITS_VOICE_PROFILER
+  uint32_t limiter_cycles_;
+#endif  // PLAITS_VOICE_PROFILER
+  
   DISALLOW_COPY_AND_ASSIGN(ChannelPostProcessor);
 };
 
+// Delays the trigger input by a number of samples, whatever the size of the
+// blocks. The hysteresis is applied before the delay, so only one bit per
+// sample needs to be stored.
+class TriggerDelay {
+ public:
+  TriggerDelay() { }
+  ~TriggerDelay() { }
+  
+  void Init(size_t delay) {
+    STATIC_ASSERT(
+        !(kMaxTriggerDelay & (kMaxTriggerDelay - 1)),
+        power_of_two_size);
+    delay_ = std::min(delay, kMaxTriggerDelay - 1);
+    std::fill(&bits_[0], &bits_[kMaxTriggerDelay / 32], 0);
+    write_ptr_ = 0;
+    state_ = false;
+  }
+  
+  // Returns the state of the trigger input delay samples before the last
+  // sample of the block.
+  inline bool Process(float trigger, size_t size) {
+    state_ = state_ ? trigger >= 0.1f : trigger > 0.3f;
+    const uint32_t value = state_ ? 0xffffffff : 0;
+    size = std::min(size, kMaxTriggerDelay);
+    while (size--) {
+      write_ptr_ = (write_ptr_ + 1) & (kMaxTriggerDelay - 1);
+      const uint32_t mask = 1U << (write_ptr_ & 31);
+      uint32_t* word = &bits_[write_ptr_ >> 5];
+      *word = (*word & ~mask) | (value & mask);
+    }
+    const size_t read_ptr = (write_ptr_ - delay_) & (kMaxTriggerDelay - 1);
+    return bits_[read_ptr >> 5] & (1U << (read_ptr & 31));
+  }
+  
+ private:
+  uint32_t bits_[kMaxTriggerDelay / 32];
+  size_t write_ptr_;
+  size_t delay_;
+  bool state_;
+  
+  DISALLOW_COPY_AND_ASSIGN(TriggerDelay);
+};
+
 struct Patch {
   float note;
   float harmonics;
@@ -146,6 +243,42 @@ struct Modulations {
   bool level_patched;
 };
 
+// Read-only data which can be computed once and shared by all the voices
+// running in the same process (see VoicePool). On the hardware, it is instead
+// rebuilt in the RAM block shared by all engines, whenever an engine is
+// selected. Wavetables and other LUTs are already stored in resources.cc.
+struct VoiceSharedTables {
+  float chord_ratios[kChordNumChords * kChordNumVoices];
+  
+  void Init() {
+    ChordEngine::ComputeRatios(chord_ratios);
+  }
+};
+
+// Options for voices running on other hosts. The hardware uses the defaults
+// set by Init().
+struct VoiceSettings {
+#ifdef PLAITS_ENGINE_CROSSFADE
+  // See kEngineCrossfadeDuration.
+  bool crossfade_engines;
+#endif  // PLAITS_ENGINE_CROSSFADE
+  
+  // Initialize an engine only the first time it is selected. This makes the
+  // creation of many voices faster, but the first block rendered by a newly
+  // selected engine is more expensive.
+  bool lazy_engine_init;
+  
+  float sample_rate;
+  
+  void Init() {
+#ifdef PLAITS_ENGINE_CROSSFADE
+    crossfade_engines = false;
+#endif  // PLAITS_ENGINE_CROSSFADE
+    lazy_engine_init = false;
+    sample_rate = kSampleRate;
+  }
+};
+
 class Voice {
  public:
   Voice() { }
@@ -156,16 +289,47 @@ class Voice {
     short aux;
   };
   
-  void Init(stmlib::BufferAllocator* allocator);
+  void Init(stmlib::BufferAllocator* allocator) {
+    Init(allocator, NULL);
+  }
+  void Init(
+      stmlib::BufferAllocator* allocator,
+      const VoiceSharedTables* shared_tables) {
+    VoiceSettings settings;
+    settings.Init();
+    Init(allocator, shared_tables, settings);
+  }
+  void Init(
+      stmlib::BufferAllocator* allocator,
+      const VoiceSharedTables* shared_tables,
+      const VoiceSettings& settings);
   void Render(
       const Patch& patch,
       const Modulations& modulations,
       Frame* frames,
       size_t size);
   inline int active_engine() const { return previous_engine_index_; }
+  
+#ifdef PLAITS_ENGINE_CROSSFADE
+  // True while two engines are rendered.
+  inline bool crossfading() const { return fading_engine_index_ != -1; }
+#endif  // PLAITS_ENGINE_CROSSFADE
+  
+  // For inspecting the statistics of an engine (eg. how often its block-rate
+  // coefficients have been reused).
+  inline const Engine* engine(int index) const { return engines_.get(index); }
+  
+#ifdef PLAITS_VOICE_PROFILER
+  // The records written at each block are to be drained by another thread.
+  inline VoiceProfiler* mutable_profiler() { return &profiler_; }
+#endif  // PLAITS_VOICE_PROFILER
     
  private:
   void ComputeDecayParameters(const Patch& settings);
+  void InitEngine(int index);
+#ifdef PLAITS_ENGINE_CROSSFADE
+  void Crossfade(const Frame* fading_frames, Frame* frames, size_t size);
+#endif  // PLAITS_ENGINE_CROSSFADE
   
   inline float ApplyModulations(
       float base_value,
@@ -208,26 +372,50 @@ class Voice {
 
   stmlib::HysteresisQuantizer engine_quantizer_;
   
+  SampleRateConstants rate_;
+  
+  // RAM block from which the engines allocate their buffers.
+  stmlib::BufferAllocator allocator_;
+  uint32_t initialized_engines_;
+  
   int previous_engine_index_;
   float engine_cv_;
   
+#ifdef PLAITS_ENGINE_CROSSFADE
+  bool crossfade_engines_;
+  int fading_engine_index_;
+  float crossfade_phase_;
+#endif  // PLAITS_ENGINE_CROSSFADE
+  
   float previous_note_;
   bool trigger_state_;
   
   DecayEnvelope decay_envelope_;
   LPGEnvelope lpg_envelope_;
   
-  float trigger_delay_line_[kMaxTriggerDelay];
-  DelayLine<float, kMaxTriggerDelay> trigger_delay_;
+  TriggerDelay trigger_delay_;
   
-  ChannelPostProcessor out_post_processor_;
-  ChannelPostProcessor aux_post_processor_;
+  // The engine being faded out keeps its own post-processors (LPG filter and
+  // limiter state), the other pair is used by the active engine.
+  ChannelPostProcessor out_post_processor_[kNumPostProcessors];
+  ChannelPostProcessor aux_post_processor_[kNumPostProcessors];
+  int active_post_processor_;
   
   EngineRegistry<kMaxEngines> engines_;
   
   float out_buffer_[kMaxBlockSize];
   float aux_buffer_[kMaxBlockSize];
   
+#ifdef PLAITS_ENGINE_CROSSFADE
+  float fading_out_buffer_[kMaxBlockSize];
+  float fading_aux_buffer_[kMaxBlockSize];
+  Frame fading_frames_[kMaxBlockSize];
+#endif  // PLAITS_ENGINE_CROSSFADE
+  
+#ifdef PLAITS_VOICE_PROFILER
+  VoiceProfiler profiler_;
+#endif  // PLAITS_VOICE_PROFILER
+  
   DISALLOW_COPY_AND_ASSIGN(Voice);
 };
 
@@ -0,0 +1,105 @@
+// Copyright 2016 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Bank of synthesis voices, for running many instances of the Plaits voice
+// in the same process.
+
+#ifndef PLAITS_DSP_VOICE_POOL_H_
+#define PLAITS_DSP_VOICE_POOL_H_
+
+#include "stmlib/stmlib.h"
+
+#include "stmlib/utils/buffer_allocator.h"
+
+#include "plaits/dsp/voice.h"
+
+namespace plaits {
+
+// Each voice and its RAM block are stored next to each other, so that all the
+// mutable state touched while rendering a voice is contiguous. The read-only
+// tables are computed once and shared by all voices.
+//
+// This object is large (at least 21kB per voice) and should not be allocated on
+// the stack.
+template<int num_voices>
+class VoicePool {
+ public:
+  VoicePool() { }
+  ~VoicePool() { }
+  
+  void Init() {
+    Init(false);
+  }
+  
+  // With lazy_engine_init, the engines of each voice are initialized only
+  // when they are first selected - to quickly create many voices.
+  void Init(bool lazy_engine_init) {
+    VoiceSettings settings;
+    settings.Init();
+    settings.lazy_engine_init = lazy_engine_init;
+    
+    shared_tables_.Init();
+    for (int i = 0; i < num_voices; ++i) {
+      stmlib::BufferAllocator allocator(slot_[i].ram, kVoiceRamSize);
+      slot_[i].voice.Init(&allocator, &shared_tables_, settings);
+    }
+  }
+  
+  // Renders all the voices. patch and modulations contain one entry per
+  // voice; the block of voice i is written at frames[i * size].
+  void Render(
+      const Patch* patch,
+      const Modulations* modulations,
+      Voice::Frame* frames,
+      size_t size) {
+    for (int i = 0; i < num_voices; ++i) {
+      slot_[i].voice.Render(
+          patch[i],
+          modulations[i],
+          &frames[i * size],
+          size);
+    }
+  }
+  
+  inline Voice* mutable_voice(int i) { return &slot_[i].voice; }
+  inline int size() const { return num_voices; }
+  
+ private:
+  struct Slot {
+    // Placed first to be aligned like the struct itself.
+    char ram[kVoiceRamSize];
+    Voice voice;
+  };
+  
+  VoiceSharedTables shared_tables_;
+  Slot slot_[num_voices];
+  
+  DISALLOW_COPY_AND_ASSIGN(VoicePool);
+};
+
+}  // namespace plaits
+
+#endif  // PLAITS_DSP_VOICE_POOL_H_
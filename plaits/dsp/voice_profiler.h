@@ -0,0 +1,228 @@
+// Copyright 2016 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Optional measurement of the CPU time spent by each engine. Only compiled in
+// when PLAITS_VOICE_PROFILER is defined - otherwise the VOICE_PROFILER_ macros
+// expand to nothing and the voice is unchanged.
+//
+// The audio thread writes one record per rendered block into a single-
+// producer / single-consumer ring. Another thread (or the main loop on the
+// hardware) drains it, and accumulates the records into VoiceProfileStatistics.
+
+#ifndef PLAITS_DSP_VOICE_PROFILER_H_
+#define PLAITS_DSP_VOICE_PROFILER_H_
+
+#include "stmlib/stmlib.h"
+
+#ifdef PLAITS_VOICE_PROFILER
+
+#include <algorithm>
+
+#ifdef TEST
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#else
+#include <ctime>
+#endif  // __i386__ || __x86_64__
+#endif  // TEST
+
+namespace plaits {
+
+const int kVoiceProfilerRingSize = 256;  // Must be a power of 2.
+const int kVoiceProfilerNumEngines = 16;
+const int kVoiceProfilerNumBins = 32;
+const uint8_t kVoiceProfilerNoEngine = 0xff;
+
+#ifndef TEST
+
+// DWT registers of the Cortex-M4.
+#define VOICE_PROFILER_DEMCR (*reinterpret_cast<volatile uint32_t*>(0xe000edfc))
+#define VOICE_PROFILER_DWT_CTRL (*reinterpret_cast<volatile uint32_t*>(0xe0001000))
+#define VOICE_PROFILER_DWT_CYCCNT (*reinterpret_cast<volatile uint32_t*>(0xe0001004))
+
+#endif  // TEST
+
+inline uint32_t ReadCycleCounter() {
+#ifdef TEST
+#if defined(__i386__) || defined(__x86_64__)
+  return static_cast<uint32_t>(__rdtsc());
+#else
+  return static_cast<uint32_t>(clock());
+#endif  // __i386__ || __x86_64__
+#else
+  return VOICE_PROFILER_DWT_CYCCNT;
+#endif  // TEST
+}
+
+struct VoiceProfileRecord {
+  uint8_t engine;
+  uint8_t fading_engine;  // kVoiceProfilerNoEngine when not crossfading.
+  uint16_t size;
+  
+  // Cycles spent in Engine::Render(), in the LPG and output conversion, and
+  // in the limiter. The time spent rendering the engine being faded out is
+  // included.
+  uint32_t render;
+  uint32_t post_processor;
+  uint32_t limiter;
+  
+  // Duration of the whole call to Voice::Render().
+  uint32_t total;
+};
+
+class VoiceProfiler {
+ public:
+  VoiceProfiler() { }
+  ~VoiceProfiler() { }
+  
+  void Init() {
+#ifndef TEST
+    // Enable the cycle counter (TRCENA, then CYCCNTENA).
+    VOICE_PROFILER_DEMCR |= 0x01000000;
+    VOICE_PROFILER_DWT_CTRL |= 0x00000001;
+#endif  // TEST
+    read_ptr_ = write_ptr_ = 0;
+    num_dropped_records_ = 0;
+  }
+  
+  // Called from the audio thread. When the ring is full the record is lost,
+  // the audio thread never waits for the reader.
+  inline void Write(const VoiceProfileRecord& record) {
+    uint32_t w = write_ptr_;
+    if (w - read_ptr_ >= uint32_t(kVoiceProfilerRingSize)) {
+      ++num_dropped_records_;
+      return;
+    }
+    records_[w & (kVoiceProfilerRingSize - 1)] = record;
+    // The record must be visible before the updated write pointer.
+    __sync_synchronize();
+    write_ptr_ = w + 1;
+  }
+  
+  // Called from the reader thread. Returns false when the ring is empty.
+  inline bool Read(VoiceProfileRecord* record) {
+    uint32_t r = read_ptr_;
+    if (r == write_ptr_) {
+      return false;
+    }
+    __sync_synchronize();
+    *record = records_[r & (kVoiceProfilerRingSize - 1)];
+    // The record must be copied before its slot is handed back.
+    __sync_synchronize();
+    read_ptr_ = r + 1;
+    return true;
+  }
+  
+  inline uint32_t num_dropped_records() const { return num_dropped_records_; }
+  
+ private:
+  VoiceProfileRecord records_[kVoiceProfilerRingSize];
+  
+  // Free-running counters, only written by one side each.
+  volatile uint32_t read_ptr_;
+  volatile uint32_t write_ptr_;
+  volatile uint32_t num_dropped_records_;
+  
+  DISALLOW_COPY_AND_ASSIGN(VoiceProfiler);
+};
+
+// Per-engine totals, worst case, and histogram of block durations. Bin i
+// counts the blocks which took between 2^i and 2^(i+1) - 1 cycles. Only
+// touched by the reader thread.
+class VoiceProfileStatistics {
+ public:
+  VoiceProfileStatistics() { }
+  ~VoiceProfileStatistics() { }
+  
+  struct Engine {
+    uint32_t num_blocks;
+    uint32_t num_samples;
+    uint64_t render;
+    uint64_t post_processor;
+    uint64_t limiter;
+    uint64_t total;
+    uint32_t worst_block;
+    uint32_t histogram[kVoiceProfilerNumBins];
+  };
+  
+  void Init() {
+    std::fill(
+        reinterpret_cast<uint8_t*>(&engine_[0]),
+        reinterpret_cast<uint8_t*>(&engine_[kVoiceProfilerNumEngines]),
+        0);
+  }
+  
+  // Blocks rendered while crossfading are accounted to the new engine.
+  void Add(const VoiceProfileRecord& record) {
+    if (record.engine >= kVoiceProfilerNumEngines) {
+      return;
+    }
+    Engine* e = &engine_[record.engine];
+    ++e->num_blocks;
+    e->num_samples += record.size;
+    e->render += record.render;
+    e->post_processor += record.post_processor;
+    e->limiter += record.limiter;
+    e->total += record.total;
+    e->worst_block = std::max(e->worst_block, record.total);
+    
+    int bin = 0;
+    for (uint32_t t = record.total >> 1; t; t >>= 1) {
+      ++bin;
+    }
+    ++e->histogram[bin];
+  }
+  
+  // Drains all the records currently available from a profiler.
+  void Add(VoiceProfiler* profiler) {
+    VoiceProfileRecord record;
+    while (profiler->Read(&record)) {
+      Add(record);
+    }
+  }
+  
+  inline const Engine& engine(int index) const { return engine_[index]; }
+  
+ private:
+  Engine engine_[kVoiceProfilerNumEngines];
+  
+  DISALLOW_COPY_AND_ASSIGN(VoiceProfileStatistics);
+};
+
+}  // namespace plaits
+
+#define VOICE_PROFILER_TIMESTAMP(t) const uint32_t t = plaits::ReadCycleCounter()
+#define VOICE_PROFILER_ACCUMULATE(counter, t) \
+    counter += plaits::ReadCycleCounter() - t
+
+#else
+
+#define VOICE_PROFILER_TIMESTAMP(t)
+#define VOICE_PROFILER_ACCUMULATE(counter, t)
+
+#endif  // PLAITS_VOICE_PROFILER
+
+#endif  // PLAITS_DSP_VOICE_PROFILER_H_
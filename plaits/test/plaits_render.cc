@@ -0,0 +1,498 @@
+// Copyright 2016 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// -----------------------------------------------------------------------------
+//
+// Offline renderer. Renders a voice as fast as possible, either to a WAV file
+// or, with --bench, just to measure the CPU cost of each engine.
+//
+// Usage:
+//   plaits_render [--engine N] [--duration S] [--script FILE]
+//                 [--output FILE] [--block-size N] [--sample-rate HZ]
+//                 [--crossfade] [--bench]
+//
+// --block-size sets the number of samples rendered by each call to
+// Voice::Render (24 by default, up to kMaxBlockSize).
+// --sample-rate sets the rate at which the voice runs (48000 by default).
+// --crossfade enables engine crossfading in the voice. In benchmark mode, the
+// cost of crossfading is always measured, by switching engines every 100ms.
+// Both need a build with PLAITS_ENGINE_CROSSFADE defined.
+//
+// The automation script is a text file with one keyframe per line:
+//
+//   # time (s)  parameter  value
+//   0.0         timbre     0.0
+//   4.0         timbre     1.0
+//   2.0         trigger    1.0
+//   2.01        trigger    0.0
+//
+// Parameters are linearly interpolated between successive keyframes, and held
+// before the first and after the last one. engine, trigger and the *_patched
+// flags are stepped instead. When the script does not mention trigger, the
+// voice is struck every 250ms.
+
+#include <time.h>
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "plaits/dsp/dsp.h"
+#include "plaits/dsp/voice.h"
+
+#include "stmlib/test/wav_writer.h"
+
+using namespace std;
+using namespace stmlib;
+using namespace plaits;
+
+const size_t kDefaultBlockSize = 24;
+const size_t kMaxKeyframes = 4096;
+
+const char* kEngineNames[kMaxEngines] = {
+  "virtual_analog",
+  "waveshaping",
+  "fm",
+  "grain",
+  "additive",
+  "wavetable",
+  "chord",
+  "speech",
+  "swarm",
+  "noise",
+  "particle",
+  "string",
+  "modal",
+  "bass_drum",
+  "snare_drum",
+  "hi_hat",
+};
+
+enum Parameter {
+  PARAMETER_NOTE,
+  PARAMETER_HARMONICS,
+  PARAMETER_TIMBRE,
+  PARAMETER_MORPH,
+  PARAMETER_FM_AMOUNT,
+  PARAMETER_TIMBRE_MOD_AMOUNT,
+  PARAMETER_MORPH_MOD_AMOUNT,
+  PARAMETER_DECAY,
+  PARAMETER_LPG_COLOUR,
+  PARAMETER_ENGINE,
+  PARAMETER_MOD_ENGINE,
+  PARAMETER_MOD_NOTE,
+  PARAMETER_MOD_FREQUENCY,
+  PARAMETER_MOD_HARMONICS,
+  PARAMETER_MOD_TIMBRE,
+  PARAMETER_MOD_MORPH,
+  PARAMETER_TRIGGER,
+  PARAMETER_LEVEL,
+  PARAMETER_FREQUENCY_PATCHED,
+  PARAMETER_TIMBRE_PATCHED,
+  PARAMETER_MORPH_PATCHED,
+  PARAMETER_TRIGGER_PATCHED,
+  PARAMETER_LEVEL_PATCHED,
+  PARAMETER_LAST
+};
+
+const char* kParameterNames[PARAMETER_LAST] = {
+  "note",
+  "harmonics",
+  "timbre",
+  "morph",
+  "fm_amount",
+  "timbre_mod_amount",
+  "morph_mod_amount",
+  "decay",
+  "lpg_colour",
+  "engine",
+  "mod_engine",
+  "mod_note",
+  "mod_frequency",
+  "mod_harmonics",
+  "mod_timbre",
+  "mod_morph",
+  "trigger",
+  "level",
+  "frequency_patched",
+  "timbre_patched",
+  "morph_patched",
+  "trigger_patched",
+  "level_patched",
+};
+
+struct Keyframe {
+  float time;
+  Parameter parameter;
+  float value;
+};
+
+bool operator<(const Keyframe& a, const Keyframe& b) {
+  return a.parameter == b.parameter
+      ? a.time < b.time
+      : a.parameter < b.parameter;
+}
+
+class AutomationScript {
+ public:
+  AutomationScript() { }
+  ~AutomationScript() { }
+
+  void Init() {
+    num_keyframes_ = 0;
+  }
+
+  bool Load(const char* file_name) {
+    FILE* fp = fopen(file_name, "r");
+    if (!fp) {
+      fprintf(stderr, "Cannot open %s\n", file_name);
+      return false;
+    }
+    char line[256];
+    int line_number = 0;
+    bool success = true;
+    while (success && fgets(line, sizeof(line), fp)) {
+      ++line_number;
+      char* comment = strchr(line, '#');
+      if (comment) {
+        *comment = '\0';
+      }
+      float time;
+      char name[64];
+      float value;
+      int num_fields = sscanf(line, "%f %63s %f", &time, name, &value);
+      if (num_fields <= 0) {
+        continue;
+      }
+      int parameter = ParameterByName(name);
+      if (num_fields != 3 || parameter == PARAMETER_LAST) {
+        fprintf(stderr, "%s:%d: syntax error\n", file_name, line_number);
+        success = false;
+      } else if (num_keyframes_ == kMaxKeyframes) {
+        fprintf(stderr, "%s:%d: too many keyframes\n", file_name, line_number);
+        success = false;
+      } else {
+        Keyframe* k = &keyframes_[num_keyframes_++];
+        k->time = time;
+        k->parameter = static_cast<Parameter>(parameter);
+        k->value = value;
+      }
+    }
+    fclose(fp);
+    stable_sort(&keyframes_[0], &keyframes_[num_keyframes_]);
+    return success;
+  }
+
+  bool has(Parameter parameter) const {
+    for (size_t i = 0; i < num_keyframes_; ++i) {
+      if (keyframes_[i].parameter == parameter) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void Apply(float time, Patch* patch, Modulations* modulations) const {
+    size_t i = 0;
+    while (i < num_keyframes_) {
+      Parameter parameter = keyframes_[i].parameter;
+      size_t end = i;
+      while (end < num_keyframes_ && keyframes_[end].parameter == parameter) {
+        ++end;
+      }
+      Set(parameter, Evaluate(parameter, &keyframes_[i], &keyframes_[end],
+          time), patch, modulations);
+      i = end;
+    }
+  }
+
+ private:
+  static int ParameterByName(const char* name) {
+    for (int i = 0; i < PARAMETER_LAST; ++i) {
+      if (!strcmp(name, kParameterNames[i])) {
+        return i;
+      }
+    }
+    return PARAMETER_LAST;
+  }
+
+  static bool stepped(Parameter parameter) {
+    return parameter == PARAMETER_ENGINE ||
+        (parameter >= PARAMETER_TRIGGER && parameter != PARAMETER_LEVEL);
+  }
+
+  static float Evaluate(
+      Parameter parameter,
+      const Keyframe* begin,
+      const Keyframe* end,
+      float time) {
+    const Keyframe* next = begin;
+    while (next != end && next->time <= time) {
+      ++next;
+    }
+    if (next == begin) {
+      return begin->value;
+    } else if (next == end || stepped(parameter)) {
+      return (next - 1)->value;
+    }
+    const Keyframe* previous = next - 1;
+    float t = (time - previous->time) / (next->time - previous->time);
+    return previous->value + (next->value - previous->value) * t;
+  }
+
+  static void Set(
+      Parameter parameter,
+      float value,
+      Patch* p,
+      Modulations* m) {
+    switch (parameter) {
+      case PARAMETER_NOTE: p->note = value; break;
+      case PARAMETER_HARMONICS: p->harmonics = value; break;
+      case PARAMETER_TIMBRE: p->timbre = value; break;
+      case PARAMETER_MORPH: p->morph = value; break;
+      case PARAMETER_FM_AMOUNT: p->frequency_modulation_amount = value; break;
+      case PARAMETER_TIMBRE_MOD_AMOUNT: p->timbre_modulation_amount = value;
+        break;
+      case PARAMETER_MORPH_MOD_AMOUNT: p->morph_modulation_amount = value;
+        break;
+      case PARAMETER_DECAY: p->decay = value; break;
+      case PARAMETER_LPG_COLOUR: p->lpg_colour = value; break;
+      case PARAMETER_ENGINE: p->engine = static_cast<int>(value); break;
+      case PARAMETER_MOD_ENGINE: m->engine = value; break;
+      case PARAMETER_MOD_NOTE: m->note = value; break;
+      case PARAMETER_MOD_FREQUENCY: m->frequency = value; break;
+      case PARAMETER_MOD_HARMONICS: m->harmonics = value; break;
+      case PARAMETER_MOD_TIMBRE: m->timbre = value; break;
+      case PARAMETER_MOD_MORPH: m->morph = value; break;
+      case PARAMETER_TRIGGER: m->trigger = value; break;
+      case PARAMETER_LEVEL: m->level = value; break;
+      case PARAMETER_FREQUENCY_PATCHED: m->frequency_patched = value != 0.0f;
+        break;
+      case PARAMETER_TIMBRE_PATCHED: m->timbre_patched = value != 0.0f;
+        break;
+      case PARAMETER_MORPH_PATCHED: m->morph_patched = value != 0.0f;
+        break;
+      case PARAMETER_TRIGGER_PATCHED: m->trigger_patched = value != 0.0f;
+        break;
+      case PARAMETER_LEVEL_PATCHED: m->level_patched = value != 0.0f;
+        break;
+      default: break;
+    }
+  }
+
+  Keyframe keyframes_[kMaxKeyframes];
+  size_t num_keyframes_;
+
+  DISALLOW_COPY_AND_ASSIGN(AutomationScript);
+};
+
+void InitPatch(Patch* patch, Modulations* modulations) {
+  patch->engine = 0;
+  patch->note = 48.0f;
+  patch->harmonics = 0.5f;
+  patch->timbre = 0.5f;
+  patch->morph = 0.5f;
+  patch->frequency_modulation_amount = 0.0f;
+  patch->timbre_modulation_amount = 0.0f;
+  patch->morph_modulation_amount = 0.0f;
+  patch->decay = 0.5f;
+  patch->lpg_colour = 0.5f;
+
+  modulations->engine = 0.0f;
+  modulations->note = 0.0f;
+  modulations->frequency = 0.0f;
+  modulations->harmonics = 0.0f;
+  modulations->timbre = 0.0f;
+  modulations->morph = 0.0f;
+  modulations->trigger = 0.0f;
+  modulations->level = 1.0f;
+  modulations->frequency_patched = false;
+  modulations->timbre_patched = false;
+  modulations->morph_patched = false;
+  modulations->trigger_patched = true;
+  modulations->level_patched = false;
+}
+
+double Now() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return double(t.tv_sec) + double(t.tv_nsec) * 1e-9;
+}
+
+char ram_block[kVoiceCrossfadeRamSize];
+Voice voice;
+AutomationScript script;
+size_t block_size = kDefaultBlockSize;
+float sample_rate = kSampleRate;
+
+// Renders duration seconds of audio and returns the time it took, in seconds.
+// wav_writer is NULL when the output is not needed. When switch_interval is
+// not null, the voice moves to the next engine every switch_interval samples.
+double Render(
+    int engine,
+    size_t duration,
+    bool crossfade_engines,
+    size_t switch_interval,
+    WavWriter* wav_writer) {
+  BufferAllocator allocator(ram_block, sizeof(ram_block));
+  VoiceSettings settings;
+  settings.Init();
+#ifdef PLAITS_ENGINE_CROSSFADE
+  settings.crossfade_engines = crossfade_engines;
+#endif  // PLAITS_ENGINE_CROSSFADE
+  settings.sample_rate = sample_rate;
+  voice.Init(&allocator, NULL, settings);
+
+  Patch patch;
+  Modulations modulations;
+  InitPatch(&patch, &modulations);
+  patch.engine = engine;
+
+  bool auto_trigger = !script.has(PARAMETER_TRIGGER);
+  double elapsed = 0.0;
+  const size_t num_samples = duration * size_t(sample_rate);
+  for (size_t t = 0; t < num_samples; t += block_size) {
+    const size_t size = min(block_size, num_samples - t);
+    script.Apply(float(t) / sample_rate, &patch, &modulations);
+    if (auto_trigger) {
+      size_t pulse_duration = max(block_size, size_t(120));
+      size_t period = size_t(sample_rate) / 4;
+      modulations.trigger = t % period < pulse_duration ? 1.0f : 0.0f;
+    }
+    if (switch_interval) {
+      patch.engine = (engine + t / switch_interval) % kMaxEngines;
+    }
+
+    Voice::Frame frames[kMaxBlockSize];
+    double start = Now();
+    voice.Render(patch, modulations, frames, size);
+    elapsed += Now() - start;
+
+    if (wav_writer) {
+      wav_writer->WriteFrames(&frames[0].out, size);
+    }
+  }
+  return elapsed;
+}
+
+void Usage() {
+  fprintf(stderr,
+      "Usage: plaits_render [--engine N] [--duration S] [--script FILE]\n"
+      "                     [--output FILE] [--block-size N]\n"
+      "                     [--sample-rate HZ] [--crossfade] [--bench]\n");
+}
+
+int main(int argc, char** argv) {
+  _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+
+  int engine = -1;
+  int duration = 10;
+  const char* script_file_name = NULL;
+  const char* output_file_name = "plaits_render.wav";
+  bool bench = false;
+  bool crossfade_engines = false;
+
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (!strcmp(argv[i], "--engine") && has_value) {
+      engine = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--duration") && has_value) {
+      duration = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--script") && has_value) {
+      script_file_name = argv[++i];
+    } else if (!strcmp(argv[i], "--output") && has_value) {
+      output_file_name = argv[++i];
+    } else if (!strcmp(argv[i], "--block-size") && has_value) {
+      block_size = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--sample-rate") && has_value) {
+      sample_rate = atoi(argv[++i]);
+#ifdef PLAITS_ENGINE_CROSSFADE
+    } else if (!strcmp(argv[i], "--crossfade")) {
+      crossfade_engines = true;
+#endif  // PLAITS_ENGINE_CROSSFADE
+    } else if (!strcmp(argv[i], "--bench")) {
+      bench = true;
+    } else {
+      Usage();
+      return 1;
+    }
+  }
+
+  if (engine >= kMaxEngines || duration <= 0 || \
+      block_size == 0 || block_size > kMaxBlockSize || \
+      sample_rate < 8000.0f || sample_rate > 192000.0f) {
+    Usage();
+    return 1;
+  }
+
+  script.Init();
+  if (script_file_name && !script.Load(script_file_name)) {
+    return 1;
+  }
+
+  if (!bench) {
+    WavWriter wav_writer(2, size_t(sample_rate), duration);
+    wav_writer.Open(output_file_name);
+    double elapsed = Render(
+        engine < 0 ? 0 : engine, duration, crossfade_engines, 0, &wav_writer);
+    printf("%s: %d s rendered in %.3f s\n",
+        output_file_name, duration, elapsed);
+    return 0;
+  }
+
+  // In benchmark mode, the engine index restricts the run to a single engine.
+  printf("%-16s %12s %12s\n", "engine", "ns/sample", "realtime");
+  double total = 0.0;
+  int first = engine < 0 ? 0 : engine;
+  int last = engine < 0 ? kMaxEngines - 1 : engine;
+  for (int i = first; i <= last; ++i) {
+    double elapsed = Render(i, duration, crossfade_engines, 0, NULL);
+    double ns_per_sample = elapsed * 1e9 / (duration * sample_rate);
+    printf("%2d %-13s %12.1f %11.1fx\n",
+        i, kEngineNames[i], ns_per_sample, duration / elapsed);
+    total += elapsed;
+  }
+  if (first != last) {
+    int num_engines = last - first + 1;
+    printf("%-16s %12.1f %11.1fx\n",
+        "average",
+        total * 1e9 / (num_engines * duration * sample_rate),
+        num_engines * duration / total);
+  }
+  
+#ifdef PLAITS_ENGINE_CROSSFADE
+  // Cost of crossfading: during kEngineCrossfadeDuration samples after each
+  // switch, two engines are rendered. It is thus bounded by the cost of the
+  // most expensive engine, times the fraction of time spent crossfading.
+  const size_t switch_interval = size_t(sample_rate) / 10;
+  double hard_switch = Render(first, duration, false, switch_interval, NULL);
+  double crossfade = Render(first, duration, true, switch_interval, NULL);
+  printf("\nswitching engines every 100ms, %.1fms crossfade\n",
+      float(kEngineCrossfadeDuration) * 1000.0f / sample_rate);
+  printf("%-16s %12.1f %11.1fx\n",
+      "hard switch",
+      hard_switch * 1e9 / (duration * sample_rate),
+      duration / hard_switch);
+  printf("%-16s %12.1f %11.1fx %+.1f%%\n",
+      "crossfade",
+      crossfade * 1e9 / (duration * sample_rate),
+      duration / crossfade,
+      (crossfade / hard_switch - 1.0) * 100.0);
+#endif  // PLAITS_ENGINE_CROSSFADE
+  return 0;
+}
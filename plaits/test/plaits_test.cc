@@ -15,9 +15,11 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cassert>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <xmmintrin.h>
 
 #include "plaits/dsp/dsp.h"
@@ -45,15 +47,21 @@
 #include "plaits/dsp/oscillator/grainlet_oscillator.h"
 #include "plaits/dsp/oscillator/harmonic_oscillator.h"
 #include "plaits/dsp/oscillator/oscillator.h"
+#include "plaits/dsp/oscillator/oscillator_bank.h"
 #include "plaits/dsp/oscillator/string_synth_oscillator.h"
 #include "plaits/dsp/oscillator/variable_saw_oscillator.h"
 #include "plaits/dsp/oscillator/variable_shape_oscillator.h"
 #include "plaits/dsp/oscillator/vosim_oscillator.h"
+#include "plaits/dsp/oscillator/sine_oscillator.h"
 #include "plaits/dsp/oscillator/z_oscillator.h"
+#include "plaits/dsp/physical_modelling/resonator.h"
+#include "plaits/dsp/physical_modelling/string.h"
 
 #include "plaits/dsp/voice.h"
+#include "plaits/dsp/voice_pool.h"
 
 #include "stmlib/test/wav_writer.h"
+#include "stmlib/utils/random.h"
 
 using namespace std;
 using namespace stmlib;
@@ -61,7 +69,7 @@ using namespace plaits;
 
 const size_t kAudioBlockSize = 24;
 
-char ram_block[16 * 1024];
+char ram_block[kVoiceRamSize];
 
 void TestOscillator() {
   WavWriter wav_writer(1, kSampleRate, 20);
@@ -263,7 +271,7 @@ void TestChordEngine() {
   WavWriter wav_writer(2, kSampleRate, 80);
   wav_writer.Open("plaits_chord_engine.wav");
   
-  BufferAllocator allocator(ram_block, 16384);
+  BufferAllocator allocator(ram_block, kVoiceRamSize);
   ChordEngine e;
   e.Init(&allocator);
   e.Reset();
@@ -369,7 +377,7 @@ void TestNoiseEngine() {
   WavWriter wav_writer(2, kSampleRate, 80);
   wav_writer.Open("plaits_noise_engine.wav");
   
-  BufferAllocator allocator(ram_block, 16384);
+  BufferAllocator allocator(ram_block, kVoiceRamSize);
   NoiseEngine e;
   e.Init(&allocator);
   e.Reset();
@@ -394,7 +402,7 @@ void TestParticleEngine() {
   WavWriter wav_writer(2, kSampleRate, 80);
   wav_writer.Open("plaits_particle_engine.wav");
   
-  BufferAllocator allocator(ram_block, 16384);
+  BufferAllocator allocator(ram_block, kVoiceRamSize);
   ParticleEngine e;
   e.Init(&allocator);
   e.Reset();
@@ -419,7 +427,7 @@ void TestSpeechEngine() {
   WavWriter wav_writer(2, kSampleRate, 80);
   wav_writer.Open("plaits_speech_engine.wav");
   
-  BufferAllocator allocator(ram_block, 16384);
+  BufferAllocator allocator(ram_block, kVoiceRamSize);
   SpeechEngine e;
   e.Init(&allocator);
   e.Reset();
@@ -452,7 +460,7 @@ void GenerateStringTuningData() {
     sprintf(file_name, "string_%02d.wav", pass);
     wav_writer.Open(file_name);
     
-    BufferAllocator allocator(ram_block, 16384);
+    BufferAllocator allocator(ram_block, kVoiceRamSize);
     StringEngine e;
     e.Init(&allocator);
     e.Reset();
@@ -476,7 +484,7 @@ void GenerateStringTuningData() {
   WavWriter wav_writer(1, kSampleRate, 40);
   wav_writer.Open("string_sweep.wav");
   
-  BufferAllocator allocator(ram_block, 16384);
+  BufferAllocator allocator(ram_block, kVoiceRamSize);
   StringEngine e;
   e.Init(&allocator);
   e.Reset();
@@ -505,7 +513,7 @@ void GenerateModalTuningData() {
     sprintf(file_name, "modal_%02d.wav", pass);
     wav_writer.Open(file_name);
     
-    BufferAllocator allocator(ram_block, 16384);
+    BufferAllocator allocator(ram_block, kVoiceRamSize);
     ModalEngine e;
     e.Init(&allocator);
     e.Reset();
@@ -532,7 +540,7 @@ void TestStringEngine() {
   WavWriter wav_writer(2, kSampleRate, 80);
   wav_writer.Open("plaits_string_engine.wav");
   
-  BufferAllocator allocator(ram_block, 16384);
+  BufferAllocator allocator(ram_block, kVoiceRamSize);
   StringEngine e;
   e.Init(&allocator);
   e.Reset();
@@ -566,7 +574,7 @@ void TestSwarmEngine() {
   WavWriter wav_writer(2, kSampleRate, 80);
   wav_writer.Open("plaits_swarm_engine.wav");
   
-  BufferAllocator allocator(ram_block, 16384);
+  BufferAllocator allocator(ram_block, kVoiceRamSize);
   SwarmEngine e;
   e.Init(&allocator);
   e.Reset();
@@ -602,7 +610,7 @@ void TestVirtualAnalogEngine() {
   WavWriter wav_writer(2, kSampleRate, 80);
   wav_writer.Open("plaits_virtual_analog_engine.wav");
   
-  BufferAllocator allocator(ram_block, 16384);
+  BufferAllocator allocator(ram_block, kVoiceRamSize);
   VirtualAnalogEngine e;
   e.Init(&allocator);
   e.Reset();
@@ -798,7 +806,7 @@ void TestHiHatEngine() {
   WavWriter wav_writer(2, kSampleRate, 80);
   wav_writer.Open("plaits_hi_hat_engine.wav");
   
-  BufferAllocator allocator(ram_block, 16384);
+  BufferAllocator allocator(ram_block, kVoiceRamSize);
   HiHatEngine e;
   e.Init(&allocator);
   e.Reset();
@@ -828,7 +836,7 @@ void TestVoice() {
   WavWriter wav_writer(2, kSampleRate, 200);
   wav_writer.Open("plaits_voice.wav");
   
-  BufferAllocator allocator(ram_block, 16384);
+  BufferAllocator allocator(ram_block, kVoiceRamSize);
   Voice v;
   
   v.Init(&allocator);
@@ -874,7 +882,7 @@ void TestFMGlitch() {
   WavWriter wav_writer(2, kSampleRate, 200);
   wav_writer.Open("plaits_fm_glitch.wav");
   
-  BufferAllocator allocator(ram_block, 16384);
+  BufferAllocator allocator(ram_block, kVoiceRamSize);
   Voice v;
 
   v.Init(&allocator);
@@ -920,7 +928,7 @@ void TestLPGAttackDecay() {
   WavWriter wav_writer(2, kSampleRate, 20);
   wav_writer.Open("plaits_lpg_attack_decay.wav");
   
-  BufferAllocator allocator(ram_block, 16384);
+  BufferAllocator allocator(ram_block, kVoiceRamSize);
   Voice v;
 
   v.Init(&allocator);
@@ -974,7 +982,7 @@ void TestLimiterGlitch() {
   WavWriter wav_writer(2, kSampleRate, 50);
   wav_writer.Open("plaits_limiter_glitch.wav");
   
-  BufferAllocator allocator(ram_block, 16384);
+  BufferAllocator allocator(ram_block, kVoiceRamSize);
   Voice v;
 
   v.Init(&allocator);
@@ -1015,6 +1023,735 @@ void TestLimiterGlitch() {
   }
 }
 
+float MaxLaneError(
+    const float* bank_out,
+    size_t lane,
+    const float* out,
+    size_t size) {
+  float error = 0.0f;
+  for (size_t i = 0; i < size; ++i) {
+    error = max(error, fabsf(bank_out[i * kSimdWidth + lane] - out[i]));
+  }
+  return error;
+}
+
+template<OscillatorShape shape>
+float CompareOscillatorBank() {
+  Oscillator osc[kSimdWidth];
+  OscillatorBank bank;
+  
+  bank.Init();
+  for (size_t lane = 0; lane < kSimdWidth; ++lane) {
+    osc[lane].Init();
+  }
+  
+  float error = 0.0f;
+  for (size_t block = 0; block < 4000; ++block) {
+    float f[kSimdWidth];
+    float pw[kSimdWidth];
+    for (size_t lane = 0; lane < kSimdWidth; ++lane) {
+      f[lane] = (30.0f + 110.0f * lane) / kSampleRate * (
+          1.0f + 8.0f * Random::GetFloat());
+      pw[lane] = Random::GetFloat();
+    }
+    float bank_out[kAudioBlockSize * kSimdWidth];
+    bank.Render<shape>(f, pw, bank_out, kAudioBlockSize);
+    for (size_t lane = 0; lane < kSimdWidth; ++lane) {
+      float out[kAudioBlockSize];
+      osc[lane].Render<shape>(f[lane], pw[lane], out, kAudioBlockSize);
+      error = max(error, MaxLaneError(bank_out, lane, out, kAudioBlockSize));
+    }
+  }
+  return error;
+}
+
+void TestOscillatorBanks() {
+  VariableShapeOscillator variable_shape[kSimdWidth];
+  VariableShapeOscillatorBank variable_shape_bank;
+  VariableSawOscillator variable_saw[kSimdWidth];
+  VariableSawOscillatorBank variable_saw_bank;
+  SineOscillator sine[kSimdWidth];
+  SineOscillatorBank sine_bank;
+  
+  variable_shape_bank.Init();
+  variable_saw_bank.Init();
+  sine_bank.Init();
+  for (size_t lane = 0; lane < kSimdWidth; ++lane) {
+    variable_shape[lane].Init();
+    variable_saw[lane].Init();
+    sine[lane].Init();
+  }
+  
+  float error[3] = { 0.0f, 0.0f, 0.0f };
+  for (size_t block = 0; block < 4000; ++block) {
+    float master_f[kSimdWidth];
+    float f[kSimdWidth];
+    float pw[kSimdWidth];
+    float shape[kSimdWidth];
+    float amplitude[kSimdWidth];
+    for (size_t lane = 0; lane < kSimdWidth; ++lane) {
+      master_f[lane] = (30.0f + 110.0f * lane) / kSampleRate;
+      f[lane] = master_f[lane] * (1.0f + 4.0f * Random::GetFloat());
+      pw[lane] = Random::GetFloat();
+      shape[lane] = Random::GetFloat();
+      amplitude[lane] = Random::GetFloat();
+    }
+    
+    float bank_out[kAudioBlockSize * kSimdWidth];
+    float out[kAudioBlockSize];
+    
+    variable_shape_bank.Render<true>(
+        master_f, f, pw, shape, bank_out, kAudioBlockSize);
+    for (size_t lane = 0; lane < kSimdWidth; ++lane) {
+      variable_shape[lane].Render<true>(
+          master_f[lane], f[lane], pw[lane], shape[lane], out,
+          kAudioBlockSize);
+      error[0] = max(
+          error[0], MaxLaneError(bank_out, lane, out, kAudioBlockSize));
+    }
+
+    variable_saw_bank.Render(f, pw, shape, bank_out, kAudioBlockSize);
+    for (size_t lane = 0; lane < kSimdWidth; ++lane) {
+      variable_saw[lane].Render(
+          f[lane], pw[lane], shape[lane], out, kAudioBlockSize);
+      error[1] = max(
+          error[1], MaxLaneError(bank_out, lane, out, kAudioBlockSize));
+    }
+    
+    fill(&bank_out[0], &bank_out[kAudioBlockSize * kSimdWidth], 0.0f);
+    sine_bank.Render(f, amplitude, bank_out, kAudioBlockSize);
+    for (size_t lane = 0; lane < kSimdWidth; ++lane) {
+      fill(&out[0], &out[kAudioBlockSize], 0.0f);
+      sine[lane].Render(f[lane], amplitude[lane], out, kAudioBlockSize);
+      error[2] = max(
+          error[2], MaxLaneError(bank_out, lane, out, kAudioBlockSize));
+    }
+  }
+  
+  float oscillator_error[8] = {
+    CompareOscillatorBank<OSCILLATOR_SHAPE_IMPULSE_TRAIN>(),
+    CompareOscillatorBank<OSCILLATOR_SHAPE_SAW>(),
+    CompareOscillatorBank<OSCILLATOR_SHAPE_TRIANGLE>(),
+    CompareOscillatorBank<OSCILLATOR_SHAPE_SLOPE>(),
+    CompareOscillatorBank<OSCILLATOR_SHAPE_SQUARE>(),
+    CompareOscillatorBank<OSCILLATOR_SHAPE_SQUARE_BRIGHT>(),
+    CompareOscillatorBank<OSCILLATOR_SHAPE_SQUARE_DARK>(),
+    CompareOscillatorBank<OSCILLATOR_SHAPE_SQUARE_TRIANGLE>(),
+  };
+  
+  // The banks are sample-exact when the compiler does not contract the scalar
+  // code into FMAs. When it does, the slope shape amplifies the rounding
+  // differences through its division by the pulse width.
+  const float kTolerance = 1e-3f;
+  float max_error = max(max(error[0], error[1]), error[2]);
+  printf("%d lanes\n", int(kSimdWidth));
+  printf("VariableShapeOscillatorBank: %g\n", error[0]);
+  printf("VariableSawOscillatorBank: %g\n", error[1]);
+  printf("SineOscillatorBank: %g\n", error[2]);
+  for (int i = 0; i < 8; ++i) {
+    printf("OscillatorBank, shape %d: %g\n", i, oscillator_error[i]);
+    max_error = max(max_error, oscillator_error[i]);
+  }
+  printf(max_error <= kTolerance ? "OK\n" : "FAILED\n");
+}
+
+void InitPatch(Patch* patch, Modulations* modulations) {
+  patch->engine = 0;
+  patch->note = 48.0f;
+  patch->harmonics = 0.5f;
+  patch->timbre = 0.5f;
+  patch->morph = 0.5f;
+  patch->frequency_modulation_amount = 0.0f;
+  patch->timbre_modulation_amount = 0.0f;
+  patch->morph_modulation_amount = 0.0f;
+  patch->decay = 0.5f;
+  patch->lpg_colour = 0.5f;
+  
+  modulations->engine = 0.0f;
+  modulations->note = 0.0f;
+  modulations->frequency = 0.0f;
+  modulations->harmonics = 0.0f;
+  modulations->timbre = 0.0f;
+  modulations->morph = 0.0f;
+  modulations->trigger = 0.0f;
+  modulations->level = 1.0f;
+  modulations->frequency_patched = false;
+  modulations->timbre_patched = false;
+  modulations->morph_patched = false;
+  modulations->trigger_patched = true;
+  modulations->level_patched = false;
+}
+
+#ifdef PLAITS_ENGINE_CROSSFADE
+void TestEngineCrossfade() {
+  WavWriter wav_writer(2, kSampleRate, 20);
+  wav_writer.Open("plaits_crossfade.wav");
+  
+  static char crossfade_ram_block[kVoiceCrossfadeRamSize];
+  BufferAllocator allocator(crossfade_ram_block, kVoiceCrossfadeRamSize);
+  Voice v;
+  VoiceSettings settings;
+  settings.Init();
+  settings.crossfade_engines = true;
+  
+  v.Init(&allocator, NULL, settings);
+  
+  Patch patch;
+  Modulations modulations;
+  InitPatch(&patch, &modulations);
+  modulations.trigger_patched = false;
+  
+  size_t num_crossfade_blocks = 0;
+  for (size_t i = 0; i < kSampleRate * 20; i += kAudioBlockSize) {
+    // Move to the next engine every 250ms, sometimes coming back before the
+    // end of the crossfade.
+    size_t block = i / kAudioBlockSize;
+    patch.engine = (block / 500) % kMaxEngines;
+    if (block % 500 == 5) {
+      patch.engine = (patch.engine + 1) % kMaxEngines;
+    }
+    Voice::Frame frames[kAudioBlockSize];
+    v.Render(patch, modulations, frames, kAudioBlockSize);
+    num_crossfade_blocks += v.crossfading() ? 1 : 0;
+    wav_writer.WriteFrames(&frames[0].out, kAudioBlockSize);
+  }
+  printf("Crossfading during %.1f%% of the time\n",
+      100.0f * num_crossfade_blocks * kAudioBlockSize / (kSampleRate * 20));
+}
+#endif  // PLAITS_ENGINE_CROSSFADE
+
+void TestTriggerDelay() {
+  const float kSampleRates[] = { 44100.0f, 48000.0f, 96000.0f };
+  const size_t kBlockSizes[] = { 1, 8, 12, 60, 512 };
+  
+  printf("trigger delay (samples)\n");
+  for (size_t i = 0; i < 3; ++i) {
+    printf("%6.0f Hz:", kSampleRates[i]);
+    for (size_t j = 0; j < sizeof(kBlockSizes) / sizeof(size_t); ++j) {
+      const size_t size = kBlockSizes[j];
+      TriggerDelay trigger_delay;
+      trigger_delay.Init(static_cast<size_t>(
+          float(kTriggerDelay) * kSampleRates[i] / kSampleRate));
+      
+      // The trigger goes high at the beginning of a block. Prints when the
+      // block in which it is seen starts - the delay, rounded down to a whole
+      // number of blocks.
+      const size_t rising_edge = size * 10;
+      size_t t = 0;
+      while (!trigger_delay.Process(t >= rising_edge ? 1.0f : 0.0f, size)) {
+        t += size;
+      }
+      printf(" %4d@%d", int(t - rising_edge), int(size));
+    }
+    printf("\n");
+  }
+}
+
+// Renders a note-on - a trigger and a jump of two octaves - with the voice
+// rendering blocks of "size" samples. The trigger is seen by the voice at
+// sample kNoteOn. Returns the RMS level and the number of zero crossings of
+// the output in windows of kNoteOnWindow samples after the note-on.
+const size_t kNoteOn = 512 * 30;
+const size_t kNoteOnWindow = 480;
+const size_t kNoteOnNumWindows = 20;
+
+void RenderNoteOn(
+    int engine,
+    size_t size,
+    float* level,
+    float* zero_crossings) {
+  static Voice v;
+  static Voice::Frame frames[kMaxBlockSize];
+  static float out[kNoteOn + kNoteOnWindow * kNoteOnNumWindows];
+  const size_t num_samples = sizeof(out) / sizeof(float);
+  
+  BufferAllocator allocator(ram_block, kVoiceRamSize);
+  v.Init(&allocator);
+  Patch patch;
+  Modulations modulations;
+  InitPatch(&patch, &modulations);
+  patch.engine = engine;
+  Random::Seed(0x21);
+  
+  // The voice sees the trigger at the end of the block in which it was
+  // delayed by kTriggerDelay samples.
+  const size_t rising_edge = size > kTriggerDelay
+      ? kNoteOn
+      : kNoteOn - kTriggerDelay;
+  for (size_t i = 0; i < num_samples; i += size) {
+    modulations.trigger = i >= rising_edge ? 1.0f : 0.0f;
+    patch.note = i >= kNoteOn ? 72.0f : 48.0f;
+    v.Render(patch, modulations, frames, size);
+    for (size_t j = 0; j < size; ++j) {
+      out[i + j] = frames[j].out / 32768.0f;
+    }
+  }
+  
+  for (size_t i = 0; i < kNoteOnNumWindows; ++i) {
+    const float* x = &out[kNoteOn + i * kNoteOnWindow];
+    float power = 0.0f;
+    zero_crossings[i] = 0.0f;
+    for (size_t j = 0; j < kNoteOnWindow; ++j) {
+      power += x[j] * x[j];
+      if (j && (x[j] >= 0.0f) != (x[j - 1] >= 0.0f)) {
+        zero_crossings[i] += 1.0f;
+      }
+    }
+    level[i] = sqrtf(power / kNoteOnWindow);
+  }
+}
+
+void TestBlockSizeNoteOn() {
+  // The engines smooth and delay their parameters once per call. Their
+  // response to a note-on must not depend on the size of the blocks rendered
+  // by the voice. For example, the string engine delays its f0 by 14 calls:
+  // 150ms if it was called with 512-sample blocks.
+  // The engines driven by random numbers (speech, swarm, noise, particle,
+  // snare and hi-hat) are left out: their output does not repeat.
+  const int kEngines[] = { 0, 1, 2, 3, 4, 5, 6, 11, 12, 13 };
+  const size_t kBlockSizes[] = { kBlockSize, 512 };
+  const float kTolerance = 0.1f;
+  
+  float max_error = 0.0f;
+  printf("engine   level error   zero crossings error\n");
+  for (size_t k = 0; k < sizeof(kEngines) / sizeof(int); ++k) {
+    const int engine = kEngines[k];
+    float level[2][kNoteOnNumWindows];
+    float zero_crossings[2][kNoteOnNumWindows];
+    for (int j = 0; j < 2; ++j) {
+      RenderNoteOn(engine, kBlockSizes[j], level[j], zero_crossings[j]);
+    }
+    
+    // Errors relative to the peak level, and to the number of zero crossings
+    // in the same window.
+    float peak = 0.0f;
+    for (size_t i = 0; i < kNoteOnNumWindows; ++i) {
+      peak = max(peak, level[0][i]);
+    }
+    float level_error = 0.0f;
+    float zero_crossings_error = 0.0f;
+    for (size_t i = 0; i < kNoteOnNumWindows; ++i) {
+      level_error = max(
+          level_error,
+          fabsf(level[1][i] - level[0][i]) / max(peak, 1e-4f));
+      zero_crossings_error = max(
+          zero_crossings_error,
+          fabsf(zero_crossings[1][i] - zero_crossings[0][i]) / \
+              max(zero_crossings[0][i], 10.0f));
+    }
+    printf("%6d %13.3f %22.3f\n", engine, level_error, zero_crossings_error);
+    max_error = max(max_error, max(level_error, zero_crossings_error));
+  }
+  printf(max_error <= kTolerance ? "OK\n" : "FAILED\n");
+  assert(max_error <= kTolerance);
+}
+
+void BenchmarkVoicePool() {
+  const int kNumVoices = 32;
+  const size_t kDuration = 10;
+  
+  static VoicePool<kNumVoices> pool;
+  static Voice::Frame frames[kNumVoices * kAudioBlockSize];
+  Patch patch[kNumVoices];
+  Modulations modulations[kNumVoices];
+  
+  pool.Init();
+  for (int v = 0; v < kNumVoices; ++v) {
+    InitPatch(&patch[v], &modulations[v]);
+    patch[v].engine = v % kMaxEngines;
+    patch[v].note = 36.0f + float(v);
+  }
+
+  clock_t start = clock();
+  for (size_t i = 0; i < kSampleRate * kDuration; i += kAudioBlockSize) {
+    size_t block = i / kAudioBlockSize;
+    for (int v = 0; v < kNumVoices; ++v) {
+      modulations[v].trigger = (block + v * 37) % 500 < 5 ? 1.0f : 0.0f;
+    }
+    pool.Render(patch, modulations, frames, kAudioBlockSize);
+  }
+  float elapsed = float(clock() - start) / CLOCKS_PER_SEC;
+  
+  printf("VoicePool: %d voices, %d s rendered in %.2f s\n",
+      kNumVoices, int(kDuration), elapsed);
+  printf("%.1f voices per core at %.0f Hz\n",
+      float(kNumVoices * kDuration) / elapsed, kSampleRate);
+}
+
+void BenchmarkLazyEngineInit() {
+  const int kNumVoices = 128;
+  
+  static VoicePool<kNumVoices> pool;
+  static Voice::Frame frames[kNumVoices * kAudioBlockSize];
+  Patch patch[kNumVoices];
+  Modulations modulations[kNumVoices];
+  
+  for (int v = 0; v < kNumVoices; ++v) {
+    InitPatch(&patch[v], &modulations[v]);
+    patch[v].engine = v % kMaxEngines;
+  }
+
+  // With lazy initialization, the cost of initializing an engine is moved to
+  // the first block it renders.
+  for (int lazy = 0; lazy < 2; ++lazy) {
+    clock_t start = clock();
+    pool.Init(lazy);
+    float init_time = float(clock() - start) / CLOCKS_PER_SEC;
+    
+    start = clock();
+    pool.Render(patch, modulations, frames, kAudioBlockSize);
+    float first_block_time = float(clock() - start) / CLOCKS_PER_SEC;
+    
+    start = clock();
+    pool.Render(patch, modulations, frames, kAudioBlockSize);
+    float block_time = float(clock() - start) / CLOCKS_PER_SEC;
+    
+    printf("%s: %d voices initialized in %.2f ms, ",
+        lazy ? "lazy " : "eager", kNumVoices, init_time * 1e3f);
+    printf("first block %.3f ms, next block %.3f ms\n",
+        first_block_time * 1e3f, block_time * 1e3f);
+  }
+}
+
+void BenchmarkParameterChangeDetection() {
+  const int kEngines[] = { 4, 6 };  // Additive, chord.
+  const int kNumEngines = sizeof(kEngines) / sizeof(int);
+  const size_t kDuration = 5;
+  
+  static Voice v;
+  static Voice::Frame frames[kBlockSize];
+  Patch patch;
+  Modulations modulations;
+
+  // A static patch, and then a slow timbre sweep, for which the block-rate
+  // coefficients have to be recomputed at each block.
+  for (int i = 0; i < kNumEngines; ++i) {
+    for (int sweep = 0; sweep < 2; ++sweep) {
+      BufferAllocator allocator(ram_block, kVoiceRamSize);
+      v.Init(&allocator);
+      InitPatch(&patch, &modulations);
+      patch.engine = kEngines[i];
+      
+      const Engine* e = v.engine(kEngines[i]);
+      uint32_t num_tracked_blocks = e->num_tracked_blocks();
+      uint32_t num_fast_path_blocks = e->num_fast_path_blocks();
+      
+      const size_t num_samples = kSampleRate * kDuration;
+      clock_t start = clock();
+      for (size_t j = 0; j < num_samples; j += kBlockSize) {
+        if (sweep) {
+          patch.timbre = float(j) / float(num_samples);
+        }
+        v.Render(patch, modulations, frames, kBlockSize);
+      }
+      float elapsed = float(clock() - start) / CLOCKS_PER_SEC;
+      
+      num_tracked_blocks = e->num_tracked_blocks() - num_tracked_blocks;
+      num_fast_path_blocks = e->num_fast_path_blocks() - num_fast_path_blocks;
+      printf("engine %d, %s: %.1f ns/sample, %d/%d blocks on the fast path\n",
+          kEngines[i],
+          sweep ? "sweep " : "static",
+          elapsed * 1e9f / num_samples,
+          int(num_fast_path_blocks),
+          int(num_tracked_blocks));
+    }
+  }
+}
+
+#ifdef PLAITS_VOICE_PROFILER
+
+// To be built with -DPLAITS_VOICE_PROFILER.
+void TestVoiceProfiler() {
+  const size_t kDuration = 2;
+  const size_t kDrainInterval = 64;  // Blocks.
+  
+  static Voice v;
+  static Voice::Frame frames[kBlockSize];
+  static VoiceProfileStatistics statistics;
+  Patch patch;
+  Modulations modulations;
+  
+  BufferAllocator allocator(ram_block, kVoiceRamSize);
+  v.Init(&allocator);
+  InitPatch(&patch, &modulations);
+  statistics.Init();
+  
+  // The records are drained every few blocks, as the main loop of the
+  // hardware or a low-priority thread would do.
+  for (int engine = 0; engine < kMaxEngines; ++engine) {
+    patch.engine = engine;
+    size_t num_blocks = 0;
+    for (size_t i = 0; i < kSampleRate * kDuration; i += kBlockSize) {
+      modulations.trigger = i % 12000 < 120 ? 1.0f : 0.0f;
+      v.Render(patch, modulations, frames, kBlockSize);
+      if (++num_blocks % kDrainInterval == 0) {
+        statistics.Add(v.mutable_profiler());
+      }
+    }
+    statistics.Add(v.mutable_profiler());
+  }
+  
+  printf("         cycles/sample:  render      pp limiter   total   worst\n");
+  for (int engine = 0; engine < kMaxEngines; ++engine) {
+    const VoiceProfileStatistics::Engine& e = statistics.engine(engine);
+    float scale = 1.0f / float(e.num_samples);
+    printf("engine %2d             %8.1f%8.1f%8.1f%8.1f%8d",
+        engine,
+        float(e.render) * scale,
+        float(e.post_processor) * scale,
+        float(e.limiter) * scale,
+        float(e.total) * scale,
+        int(e.worst_block));
+    int worst_bin = kVoiceProfilerNumBins - 1;
+    while (worst_bin && !e.histogram[worst_bin]) {
+      --worst_bin;
+    }
+    printf("  [2^%d: %d blocks]\n", worst_bin, int(e.histogram[worst_bin]));
+  }
+  printf("%d records dropped\n", int(v.mutable_profiler()->num_dropped_records()));
+}
+
+#endif  // PLAITS_VOICE_PROFILER
+
+void BenchmarkBlockSizes() {
+  const size_t kBlockSizes[] = { 24, 64, 256, 512 };
+  const size_t kNumBlockSizes = sizeof(kBlockSizes) / sizeof(size_t);
+  const size_t kDuration = 5;
+  
+  static Voice v;
+  static Voice::Frame frames[kMaxBlockSize];
+  Patch patch;
+  Modulations modulations;
+  
+  printf("ns/sample   ");
+  for (size_t j = 0; j < kNumBlockSizes; ++j) {
+    printf("%8d", int(kBlockSizes[j]));
+  }
+  printf("\n");
+  
+  float total[kNumBlockSizes];
+  fill(&total[0], &total[kNumBlockSizes], 0.0f);
+  for (int engine = 0; engine < kMaxEngines; ++engine) {
+    printf("engine %2d   ", engine);
+    for (size_t j = 0; j < kNumBlockSizes; ++j) {
+      const size_t size = kBlockSizes[j];
+      BufferAllocator allocator(ram_block, kVoiceRamSize);
+      v.Init(&allocator);
+      InitPatch(&patch, &modulations);
+      patch.engine = engine;
+      
+      clock_t start = clock();
+      for (size_t i = 0; i < kSampleRate * kDuration; i += size) {
+        modulations.trigger = i % 12000 < max(size, size_t(120)) ? 1.0f : 0.0f;
+        v.Render(patch, modulations, frames, size);
+      }
+      float elapsed = float(clock() - start) / CLOCKS_PER_SEC;
+      float ns_per_sample = elapsed * 1e9f / (kSampleRate * kDuration);
+      total[j] += ns_per_sample / kMaxEngines;
+      printf("%8.1f", ns_per_sample);
+    }
+    printf("\n");
+  }
+  printf("average     ");
+  for (size_t j = 0; j < kNumBlockSizes; ++j) {
+    printf("%8.1f", total[j]);
+  }
+  printf("\n");
+}
+
+void BenchmarkResonator() {
+  const size_t kSize = 24;
+  const size_t kNumBlocks = 40000;
+  const ResonatorBackend kBackends[] = {
+    RESONATOR_BACKEND_SCALAR,
+    RESONATOR_BACKEND_SIMD
+  };
+  
+  static Resonator resonator[2];
+  float in[kSize];
+  float out[2][kSize];
+  
+  printf("modes   scalar modes/us   simd modes/us   max error\n");
+  // Some resolutions are not a multiple of the batch size of the scalar
+  // backend, whose incomplete last batch is not rendered.
+  for (int resolution = 6; resolution <= kMaxNumModes; resolution += 6) {
+    // Check that both backends render the same thing.
+    float max_error = 0.0f;
+    for (int j = 0; j < 2; ++j) {
+      resonator[j].Init(0.015f, resolution);
+      resonator[j].set_backend(kBackends[j]);
+    }
+    for (size_t i = 0; i < kNumBlocks / 10; ++i) {
+      fill(&in[0], &in[kSize], 0.0f);
+      in[0] = i % 200 == 0 ? 0.5f : 0.0f;
+      for (int j = 0; j < 2; ++j) {
+        fill(&out[j][0], &out[j][kSize], 0.0f);
+        resonator[j].Process(0.005f, 0.6f, 0.5f, 0.7f, in, out[j], kSize);
+      }
+      for (size_t k = 0; k < kSize; ++k) {
+        max_error = max(max_error, fabsf(out[0][k] - out[1][k]));
+      }
+    }
+    
+    float modes_per_us[2];
+    for (int j = 0; j < 2; ++j) {
+      resonator[j].Init(0.015f, resolution);
+      resonator[j].set_backend(kBackends[j]);
+      fill(&out[j][0], &out[j][kSize], 0.0f);
+      clock_t start = clock();
+      for (size_t i = 0; i < kNumBlocks; ++i) {
+        fill(&in[0], &in[kSize], 0.0f);
+        in[0] = i % 200 == 0 ? 0.5f : 0.0f;
+        resonator[j].Process(0.005f, 0.6f, 0.5f, 0.7f, in, out[j], kSize);
+      }
+      float elapsed = float(clock() - start) / CLOCKS_PER_SEC;
+      modes_per_us[j] = resolution * kNumBlocks * kSize / (elapsed * 1e6f);
+    }
+    printf("%5d %17.1f %15.1f %11.2e\n",
+        resolution, modes_per_us[0], modes_per_us[1], max_error);
+  }
+}
+
+// Frequency of the strongest component of a signal within 150 cents of the
+// expected frequency, from the peak of its Hann-windowed spectrum: a 1 cent
+// grid, then a 0.01 cent grid.
+float MeasureFrequency(const float* x, size_t size, float expected_frequency) {
+  float best_frequency = expected_frequency;
+  float step = 1.0f;
+  for (int pass = 0; pass < 2; ++pass) {
+    float center = best_frequency;
+    float best_magnitude = 0.0f;
+    for (int i = -150; i <= 150; ++i) {
+      float f = center * SemitonesToRatio(i * step / 100.0f);
+      double re = 0.0;
+      double im = 0.0;
+      for (size_t j = 0; j < size; ++j) {
+        double w = 0.5 - 0.5 * cos(2.0 * M_PI * j / size);
+        double phi = 2.0 * M_PI * f * j;
+        re += w * x[j] * cos(phi);
+        im += w * x[j] * sin(phi);
+      }
+      float magnitude = static_cast<float>(re * re + im * im);
+      if (magnitude > best_magnitude) {
+        best_magnitude = magnitude;
+        best_frequency = f;
+      }
+    }
+    step = 0.01f;
+  }
+  return best_frequency;
+}
+
+// Error of the phase delay of a fractional delay read, in samples, and its
+// gain, at the normalized frequency "f" - worst case over all fractional
+// delays.
+void MeasureInterpolator(
+    StringInterpolation interpolation,
+    float f,
+    float* max_delay_error,
+    float* min_gain) {
+  float buffer[64];
+  DelayLine<float, 64> line;
+  *max_delay_error = 0.0f;
+  *min_gain = 1.0f;
+  for (int i = 0; i < 32; ++i) {
+    float delay = 8.0f + i / 32.0f;
+    
+    // H(f) * exp(2 pi j f delay), from the impulse response of the read.
+    float re = 0.0f;
+    float im = 0.0f;
+    line.Init(buffer);
+    for (int n = 1; n < 16; ++n) {
+      line.Write(n == 1 ? 1.0f : 0.0f);
+      float h = interpolation == STRING_INTERPOLATION_LAGRANGE
+          ? line.ReadLagrange(delay)
+          : line.ReadHermite(delay);
+      float phi = 2.0f * M_PI * f * (delay - n);
+      re += h * cosf(phi);
+      im += h * sinf(phi);
+    }
+    float error = -atan2f(im, re) / (2.0f * M_PI * f);
+    *max_delay_error = max(*max_delay_error, fabsf(error));
+    *min_gain = min(*min_gain, sqrtf(re * re + im * im));
+  }
+}
+
+void BenchmarkStringInterpolation() {
+  const size_t kSize = kAudioBlockSize;
+  const size_t kAnalysisStart = 4800;
+  const size_t kAnalysisSize = 32768;
+  // Rendered in whole blocks.
+  const size_t kRenderSize =
+      (kAnalysisStart + kAnalysisSize + kSize - 1) / kSize * kSize;
+  const float kFrequencies[] = {
+    30.0f, 65.4f, 130.8f, 261.6f, 523.3f, 1046.5f, 2093.0f, 4186.0f
+  };
+  const StringInterpolation kInterpolations[] = {
+    STRING_INTERPOLATION_HERMITE,
+    STRING_INTERPOLATION_LAGRANGE
+  };
+  
+  static float buffer[kRenderSize];
+  
+  // A phase delay error of e samples detunes the partials of frequency f by
+  // about -1200 * log2(1 + e * f / f0) cents.
+  printf("f/fs   delay error (samples)   gain (dB)\n");
+  printf("         hermite lagrange    hermite lagrange\n");
+  const float kAnalysisFrequencies[] = { 0.02f, 0.05f, 0.1f, 0.2f, 0.3f };
+  for (size_t i = 0; i < sizeof(kAnalysisFrequencies) / sizeof(float); ++i) {
+    float error[2];
+    float gain[2];
+    for (int j = 0; j < 2; ++j) {
+      MeasureInterpolator(
+          kInterpolations[j], kAnalysisFrequencies[i], &error[j], &gain[j]);
+    }
+    printf("%4.2f %10.4f %8.4f %10.2f %8.2f\n",
+        kAnalysisFrequencies[i], error[0], error[1],
+        20.0f * log10f(gain[0]), 20.0f * log10f(gain[1]));
+  }
+  
+  // Tuning error of the fundamental - mostly caused by the damping filter,
+  // whatever the interpolator. Below 47 Hz, the string does not fit the
+  // delay line and is upsampled.
+  printf("f0 (Hz)   error (cents)   ns/sample\n");
+  printf("          hermite lagrange   hermite lagrange\n");
+  for (size_t i = 0; i < sizeof(kFrequencies) / sizeof(float); ++i) {
+    float f0 = kFrequencies[i] / kSampleRate;
+    float cents[2];
+    float ns_per_sample[2];
+    for (int j = 0; j < 2; ++j) {
+      // Best of 3 runs.
+      ns_per_sample[j] = 1e9f;
+      for (int run = 0; run < 3; ++run) {
+        BufferAllocator allocator(ram_block, kVoiceRamSize);
+        String string;
+        string.Init(&allocator, kSampleRate);
+        string.set_interpolation(kInterpolations[j]);
+        
+        fill(&buffer[0], &buffer[kRenderSize], 0.0f);
+        float in[kSize];
+        fill(&in[0], &in[kSize], 0.0f);
+        in[0] = 1.0f;
+        clock_t start = clock();
+        for (size_t k = 0; k < kRenderSize; k += kSize) {
+          string.Process(f0, 0.0f, 0.3f, 0.9f, in, &buffer[k], kSize);
+          in[0] = 0.0f;
+        }
+        float elapsed = float(clock() - start) / CLOCKS_PER_SEC;
+        ns_per_sample[j] = min(
+            ns_per_sample[j],
+            elapsed * 1e9f / kRenderSize);
+      }
+      
+      float f = MeasureFrequency(&buffer[kAnalysisStart], kAnalysisSize, f0);
+      cents[j] = 1200.0f * logf(f / f0) / logf(2.0f);
+    }
+    printf("%7.1f %9.2f %8.2f %9.1f %8.1f\n",
+        kFrequencies[i], cents[0], cents[1],
+        ns_per_sample[0], ns_per_sample[1]);
+  }
+}
+
 int main(void) {
   _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
   // TestFormantOscillator();
@@ -1053,4 +1790,20 @@ int main(void) {
   // EnumerateWavetables();
   
   // TestLPGAttackDecay();
+  
+  // TestOscillatorBanks();
+#ifdef PLAITS_ENGINE_CROSSFADE
+  // TestEngineCrossfade();
+#endif  // PLAITS_ENGINE_CROSSFADE
+  // TestTriggerDelay();
+  // TestBlockSizeNoteOn();
+  // BenchmarkVoicePool();
+  // BenchmarkLazyEngineInit();
+  // BenchmarkBlockSizes();
+  // BenchmarkResonator();
+  // BenchmarkStringInterpolation();
+  // BenchmarkParameterChangeDetection();
+#ifdef PLAITS_VOICE_PROFILER
+  // TestVoiceProfiler();
+#endif  // PLAITS_VOICE_PROFILER
 }
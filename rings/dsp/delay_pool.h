@@ -0,0 +1,256 @@
+// Copyright 2015 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+//
+// Delay lines carved from a shared block of memory.
+//
+// The pool is a buddy allocator: its memory is split into blocks of
+// kMaxDelaySliceSize samples, which are halved as many times as needed to
+// serve smaller requests, and merged back when both halves are free.
+// A PooledDelayLine is a power-of-two ring buffer: taps are wrapped with a
+// mask, and it can be moved to a slice of another size without losing the
+// most recent samples.
+
+#ifndef RINGS_DSP_DELAY_POOL_H_
+#define RINGS_DSP_DELAY_POOL_H_
+
+#include "stmlib/stmlib.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "stmlib/dsp/dsp.h"
+
+#include "rings/dsp/delay_line.h"
+
+namespace rings {
+
+const size_t kMinDelaySliceSize = 16;
+const size_t kMaxDelaySliceSize = 2048;
+const int32_t kNumDelaySliceClasses = 8;  // 16, 32, ..., 2048 samples.
+
+class DelayPool {
+ public:
+  DelayPool() { }
+  ~DelayPool() { }
+  
+  // Size in samples. Whatever does not fit in a multiple of
+  // kMaxDelaySliceSize is not used.
+  void Init(float* memory, size_t size) {
+    memory_ = memory;
+    num_blocks_ = size / kMaxDelaySliceSize;
+    Reset();
+  }
+  
+  // Frees all the slices.
+  void Reset() {
+    for (int32_t i = 0; i < kNumDelaySliceClasses; ++i) {
+      free_list_[i] = kNil;
+    }
+    for (size_t i = num_blocks_; i > 0; --i) {
+      Push(kNumDelaySliceClasses - 1, (i - 1) * kMaxDelaySliceSize);
+    }
+    num_allocated_samples_ = 0;
+  }
+  
+  // The size is a power of two between kMinDelaySliceSize and
+  // kMaxDelaySliceSize. Returns NULL when the pool is full.
+  float* Allocate(size_t size) {
+    int32_t size_class = SizeClass(size);
+    int32_t c = size_class;
+    while (c < kNumDelaySliceClasses && free_list_[c] == kNil) {
+      ++c;
+    }
+    if (c == kNumDelaySliceClasses) {
+      return NULL;
+    }
+    size_t offset = Pop(c);
+    while (c > size_class) {
+      --c;
+      Push(c, offset + (kMinDelaySliceSize << c));
+    }
+    num_allocated_samples_ += size;
+    return &memory_[offset];
+  }
+  
+  void Free(float* slice, size_t size) {
+    int32_t c = SizeClass(size);
+    size_t offset = slice - memory_;
+    num_allocated_samples_ -= size;
+    while (c < kNumDelaySliceClasses - 1) {
+      size_t buddy = offset ^ (kMinDelaySliceSize << c);
+      if (!Remove(c, buddy)) {
+        break;
+      }
+      offset = std::min(offset, buddy);
+      ++c;
+    }
+    Push(c, offset);
+  }
+  
+  inline size_t num_allocated_samples() const {
+    return num_allocated_samples_;
+  }
+  
+  inline size_t size() const { return num_blocks_ * kMaxDelaySliceSize; }
+  
+ private:
+  static const size_t kNil = ~0;
+  
+  static int32_t SizeClass(size_t size) {
+    int32_t c = 0;
+    while ((kMinDelaySliceSize << c) < size) {
+      ++c;
+    }
+    return c;
+  }
+  
+  // Free slices are chained through their first sample.
+  inline size_t Next(size_t offset) const {
+    size_t next;
+    memcpy(&next, &memory_[offset], sizeof(next));
+    return next;
+  }
+  
+  inline void SetNext(size_t offset, size_t next) {
+    memcpy(&memory_[offset], &next, sizeof(next));
+  }
+  
+  inline void Push(int32_t c, size_t offset) {
+    SetNext(offset, free_list_[c]);
+    free_list_[c] = offset;
+  }
+  
+  inline size_t Pop(int32_t c) {
+    size_t offset = free_list_[c];
+    free_list_[c] = Next(offset);
+    return offset;
+  }
+  
+  bool Remove(int32_t c, size_t offset) {
+    size_t previous = kNil;
+    size_t current = free_list_[c];
+    while (current != kNil) {
+      size_t next = Next(current);
+      if (current == offset) {
+        if (previous == kNil) {
+          free_list_[c] = next;
+        } else {
+          SetNext(previous, next);
+        }
+        return true;
+      }
+      previous = current;
+      current = next;
+    }
+    return false;
+  }
+  
+  float* memory_;
+  size_t num_blocks_;
+  size_t num_allocated_samples_;
+  size_t free_list_[kNumDelaySliceClasses];
+  
+  DISALLOW_COPY_AND_ASSIGN(DelayPool);
+};
+
+class PooledDelayLine {
+ public:
+  PooledDelayLine() { }
+  ~PooledDelayLine() { }
+  
+  void Init() {
+    line_ = NULL;
+    size_ = 0;
+    mask_ = 0;
+    write_ptr_ = 0;
+  }
+  
+  // Moves the line to a slice of "size" samples, keeping the most recent
+  // samples. Returns false, and leaves the line untouched, when the pool is
+  // full.
+  bool Resize(DelayPool* pool, size_t size) {
+    float* line = pool->Allocate(size);
+    if (!line) {
+      return false;
+    }
+    std::fill(&line[0], &line[size], 0.0f);
+    size_t mask = size - 1;
+    size_t num_samples = std::min(size, size_);
+    for (size_t i = 0; i < num_samples; ++i) {
+      line[i] = line_[(write_ptr_ + i) & mask_];
+    }
+    if (line_) {
+      pool->Free(line_, size_);
+    }
+    line_ = line;
+    size_ = size;
+    mask_ = mask;
+    write_ptr_ = 0;
+    return true;
+  }
+  
+  inline size_t size() const { return size_; }
+  
+  inline void Write(const float sample) {
+    line_[write_ptr_] = sample;
+    write_ptr_ = (write_ptr_ - 1) & mask_;
+  }
+  
+  inline const float Read(size_t delay) const {
+    return line_[(write_ptr_ + delay) & mask_];
+  }
+  
+  inline const float Read(float delay) const {
+    MAKE_INTEGRAL_FRACTIONAL(delay)
+    const float a = line_[(write_ptr_ + delay_integral) & mask_];
+    const float b = line_[(write_ptr_ + delay_integral + 1) & mask_];
+    return a + (b - a) * delay_fractional;
+  }
+  
+  inline const float ReadHermite(float delay) const {
+    MAKE_INTEGRAL_FRACTIONAL(delay)
+    return InterpolateDelayHermite(
+        line_, mask_, write_ptr_ + delay_integral, delay_fractional);
+  }
+  
+  // The delay must be at least 3 samples.
+  inline const float ReadLagrange(float delay) const {
+    MAKE_INTEGRAL_FRACTIONAL(delay)
+    return InterpolateDelayLagrange(
+        line_, mask_, write_ptr_ + delay_integral, delay_fractional);
+  }
+  
+ private:
+  float* line_;
+  size_t size_;
+  size_t mask_;
+  size_t write_ptr_;
+  
+  DISALLOW_COPY_AND_ASSIGN(PooledDelayLine);
+};
+
+}  // namespace rings
+
+#endif  // RINGS_DSP_DELAY_POOL_H_
@@ -38,19 +38,33 @@ using namespace std;
 using namespace stmlib;
 
 void Part::Init(uint16_t* reverb_buffer) {
+  Init(reverb_buffer, default_voices_, kMaxPolyphony);
+  mode_budget_ = kMaxModes;
+}
+
+void Part::Init(
+    uint16_t* reverb_buffer,
+    PartVoice* voices,
+    int32_t num_voices) {
   active_voice_ = 0;
   
-  fill(&note_[0], &note_[kMaxPolyphony], 0.0f);
+  voices_ = voices;
+  capacity_ = num_voices;
+  string_bank_ = NULL;
+  mode_budget_ = kMaxModes * num_voices;
   
   bypass_ = false;
   polyphony_ = 1;
   model_ = RESONATOR_MODEL_MODAL;
   dirty_ = true;
   
-  for (int32_t i = 0; i < kMaxPolyphony; ++i) {
-    excitation_filter_[i].Init();
-    plucker_[i].Init();
-    dc_blocker_[i].Init(1.0f - 10.0f / kSampleRate);
+  for (int32_t i = 0; i < capacity_; ++i) {
+    PartVoice* v = &voices_[i];
+    v->random.Init(kDefaultRandomSeed + i);
+    v->excitation_filter.Init();
+    v->plucker.Init(&v->random);
+    v->dc_blocker.Init(1.0f - 10.0f / kSampleRate);
+    v->note = 0.0f;
   }
   
   reverb_.Init(reverb_buffer);
@@ -72,10 +86,10 @@ void Part::ConfigureResonators() {
   switch (model_) {
     case RESONATOR_MODEL_MODAL:
       {
-        int32_t resolution = 64 / polyphony_ - 4;
+        int32_t resolution = min(mode_budget_ / polyphony_, kMaxModes) - 4;
         for (int32_t i = 0; i < polyphony_; ++i) {
-          resonator_[i].Init();
-          resonator_[i].set_resolution(resolution);
+          voices_[i].resonator.Init();
+          voices_[i].resonator.set_resolution(resolution);
         }
       }
       break;
@@ -88,17 +102,24 @@ void Part::ConfigureResonators() {
         float lfo_frequencies[kNumStrings] = {
           0.5f, 0.4f, 0.35f, 0.23f, 0.211f, 0.2f, 0.171f
         };
-        for (int32_t i = 0; i < kNumStrings; ++i) {
-          bool has_dispersion = model_ == RESONATOR_MODEL_STRING || \
-              model_ == RESONATOR_MODEL_STRING_AND_REVERB;
-          string_[i].Init(has_dispersion);
-
-          float f_lfo = float(kMaxBlockSize) / float(kSampleRate);
-          f_lfo *= lfo_frequencies[i];
-          lfo_[i].Init<COSINE_OSCILLATOR_APPROXIMATE>(f_lfo);
+        float f_lfo = float(kMaxBlockSize) / float(kSampleRate);
+        if (use_string_bank()) {
+          string_bank_->Reset();
+          for (int32_t i = 0; i < string_bank_->num_strings(); ++i) {
+            string_bank_->mutable_lfo(i)->Init<COSINE_OSCILLATOR_APPROXIMATE>(
+                f_lfo * lfo_frequencies[i % kNumStrings]);
+          }
+        } else {
+          for (int32_t i = 0; i < kNumStringsPerVoice * capacity_; ++i) {
+            bool has_dispersion = model_ == RESONATOR_MODEL_STRING || \
+                model_ == RESONATOR_MODEL_STRING_AND_REVERB;
+            mutable_string(i)->Init(has_dispersion);
+            mutable_lfo(i)->Init<COSINE_OSCILLATOR_APPROXIMATE>(
+                f_lfo * lfo_frequencies[i % kNumStrings]);
+          }
         }
         for (int32_t i = 0; i < polyphony_; ++i) {
-          plucker_[i].Init();
+          voices_[i].plucker.Init(&voices_[i].random);
         }
       }
       break;
@@ -106,7 +127,7 @@ void Part::ConfigureResonators() {
     case RESONATOR_MODEL_FM_VOICE:
       {
         for (int32_t i = 0; i < polyphony_; ++i) {
-          fm_voice_[i].Init();
+          voices_[i].fm_voice.Init();
         }
       }
       break;
@@ -265,9 +286,17 @@ void Part::ComputeSympatheticStringsNotes(
   if (parameter >= 2.0f) {
     // Quantized chords
     int32_t chord_index = parameter - 2.0f;
-    const float* chord = chords[polyphony_ - 1][chord_index];
+    const int32_t chord_polyphony = min(polyphony_, kMaxPolyphony);
+    const float* chord = chords[chord_polyphony - 1][chord_index];
+    const size_t chord_size = max(
+        kNumStrings / chord_polyphony, kNumStringsPerVoice);
     for (size_t i = 0; i < num_strings; ++i) {
-      destination[i] = chord[i] + note;
+      // The extra strings of a string bank play copies of the chord,
+      // alternately detuned up and down.
+      size_t copy = i / chord_size;
+      float detuning = detunings[i & 3] * static_cast<float>((copy + 1) >> 1);
+      destination[i] = chord[i % chord_size] + note + \
+          (copy & 1 ? detuning : -detuning);
     }
     return;
   }
@@ -303,25 +332,28 @@ void Part::RenderModalVoice(
     float frequency,
     float filter_cutoff,
     size_t size) {
+  PartVoice* v = &voices_[voice];
+  VoiceBuffers* b = mutable_buffers(voice);
+  
   // Internal exciter is a pulse, pre-filter.
   if (performance_state.internal_exciter &&
       voice == active_voice_ &&
       performance_state.strum) {
-    resonator_input_[0] += 0.25f * SemitonesToRatio(
+    b->resonator_input[0] += 0.25f * SemitonesToRatio(
         filter_cutoff * filter_cutoff * 24.0f) / filter_cutoff;
   }
   
   // Process through filter.
-  excitation_filter_[voice].Process<FILTER_MODE_LOW_PASS>(
-      resonator_input_, resonator_input_, size);
+  v->excitation_filter.Process<FILTER_MODE_LOW_PASS>(
+      b->resonator_input, b->resonator_input, size);
 
-  Resonator& r = resonator_[voice];
+  Resonator& r = v->resonator;
   r.set_frequency(frequency);
   r.set_structure(patch.structure);
   r.set_brightness(patch.brightness * patch.brightness);
   r.set_position(patch.position);
   r.set_damping(patch.damping);
-  r.Process(resonator_input_, out_buffer_, aux_buffer_, size);
+  r.Process(b->resonator_input, b->out_buffer, b->aux_buffer, size);
 }
 
 void Part::RenderFMVoice(
@@ -331,20 +363,22 @@ void Part::RenderFMVoice(
     float frequency,
     float filter_cutoff,
     size_t size) {
-  FMVoice& v = fm_voice_[voice];
+  PartVoice* v = &voices_[voice];
+  VoiceBuffers* b = mutable_buffers(voice);
+  FMVoice& fm = v->fm_voice;
   if (performance_state.internal_exciter &&
       voice == active_voice_ &&
       performance_state.strum) {
-    v.TriggerInternalEnvelope();
+    fm.TriggerInternalEnvelope();
   }
 
-  v.set_frequency(frequency);
-  v.set_ratio(patch.structure);
-  v.set_brightness(patch.brightness);
-  v.set_feedback_amount(patch.position);
-  v.set_position(/*patch.position*/ 0.0f);
-  v.set_damping(patch.damping);
-  v.Process(resonator_input_, out_buffer_, aux_buffer_, size);
+  fm.set_frequency(frequency);
+  fm.set_ratio(patch.structure);
+  fm.set_brightness(patch.brightness);
+  fm.set_feedback_amount(patch.position);
+  fm.set_position(/*patch.position*/ 0.0f);
+  fm.set_damping(patch.damping);
+  fm.Process(b->resonator_input, b->out_buffer, b->aux_buffer, size);
 }
 
 void Part::RenderStringVoice(
@@ -354,25 +388,16 @@ void Part::RenderStringVoice(
     float frequency,
     float filter_cutoff,
     size_t size) {
+  PartVoice* v = &voices_[voice];
+  VoiceBuffers* b = mutable_buffers(voice);
+  
   // Compute number of strings and frequency.
   int32_t num_strings = 1;
-  float frequencies[kNumStrings];
+  float frequencies[kMaxBankStrings];
 
   if (model_ == RESONATOR_MODEL_SYMPATHETIC_STRING ||
       model_ == RESONATOR_MODEL_SYMPATHETIC_STRING_QUANTIZED) {
-    num_strings = 2 * kMaxPolyphony / polyphony_;
-    float parameter = model_ == RESONATOR_MODEL_SYMPATHETIC_STRING
-        ? patch.structure
-        : 2.0f + performance_state.chord;
-    ComputeSympatheticStringsNotes(
-        performance_state.tonic + performance_state.fm,
-        performance_state.tonic + note_[voice] + performance_state.fm,
-        parameter,
-        frequencies,
-        num_strings);
-    for (int32_t i = 0; i < num_strings; ++i) {
-      frequencies[i] = SemitonesToRatio(frequencies[i] - 69.0f) * a3;
-    }
+    num_strings = ComputeSympatheticStringsFrequencies(*v, frequencies);
   } else {
     frequencies[0] = frequency;
   }
@@ -380,28 +405,28 @@ void Part::RenderStringVoice(
   if (voice == active_voice_) {
     const float gain = 1.0f / Sqrt(static_cast<float>(num_strings) * 2.0f);
     for (size_t i = 0; i < size; ++i) {
-      resonator_input_[i] *= gain;
+      b->resonator_input[i] *= gain;
     }
   }
 
   // Process external input.
-  excitation_filter_[voice].Process<FILTER_MODE_LOW_PASS>(
-      resonator_input_, resonator_input_, size);
+  v->excitation_filter.Process<FILTER_MODE_LOW_PASS>(
+      b->resonator_input, b->resonator_input, size);
 
   // Add noise burst.
   if (performance_state.internal_exciter) {
     if (voice == active_voice_ && performance_state.strum) {
-      plucker_[voice].Trigger(frequency, filter_cutoff * 8.0f, patch.position);
+      v->plucker.Trigger(frequency, filter_cutoff * 8.0f, patch.position);
     }
-    plucker_[voice].Process(noise_burst_buffer_, size);
+    v->plucker.Process(b->noise_burst_buffer, size);
     for (size_t i = 0; i < size; ++i) {
-      resonator_input_[i] += noise_burst_buffer_[i];
+      b->resonator_input[i] += b->noise_burst_buffer[i];
     }
   }
-  dc_blocker_[voice].Process(resonator_input_, size);
+  v->dc_blocker.Process(b->resonator_input, size);
   
-  fill(&out_buffer_[0], &out_buffer_[size], 0.0f);
-  fill(&aux_buffer_[0], &aux_buffer_[size], 0.0f);
+  fill(&b->out_buffer[0], &b->out_buffer[size], 0.0f);
+  fill(&b->aux_buffer[0], &b->aux_buffer[size], 0.0f);
   
   float structure = patch.structure;
   float dispersion = structure < 0.24f
@@ -410,52 +435,116 @@ void Part::RenderStringVoice(
   
   for (int32_t string = 0; string < num_strings; ++string) {
     int32_t i = voice + string * polyphony_;
-    String& s = string_[i];
-    float lfo_value = lfo_[i].Next();
-    
-    float brightness = patch.brightness;
-    float damping = patch.damping;
-    float position = patch.position;
-    float glide = 1.0f;
-    float string_index = static_cast<float>(string) / static_cast<float>(num_strings);
-    const float* input = resonator_input_;
-    
-    if (model_ == RESONATOR_MODEL_STRING_AND_REVERB) {
-      damping *= (2.0f - damping);
-    }
-    
-    // When the internal exciter is used, string 0 is the main
-    // source, the other strings are vibrating by sympathetic resonance.
-    // When the internal exciter is not used, all strings are vibrating
-    // by sympathetic resonance.
-    if (string > 0 && performance_state.internal_exciter) {
-      brightness *= (2.0f - brightness);
-      brightness *= (2.0f - brightness);
-      damping = 0.7f + patch.damping * 0.27f;
-      float amount = (0.5f - fabs(0.5f - patch.position)) * 0.9f;
-      position = patch.position + lfo_value * amount;
-      glide = SemitonesToRatio((brightness - 1.0f) * 36.0f);
-      input = sympathetic_resonator_input_;
+    if (use_string_bank()) {
+      RenderString(
+          string_bank_->mutable_string(i),
+          string_bank_->mutable_lfo(i),
+          &v->random,
+          b,
+          performance_state,
+          patch,
+          string,
+          num_strings,
+          frequencies[string],
+          dispersion,
+          size);
+    } else {
+      RenderString(
+          mutable_string(i),
+          mutable_lfo(i),
+          &v->random,
+          b,
+          performance_state,
+          patch,
+          string,
+          num_strings,
+          frequencies[string],
+          dispersion,
+          size);
     }
     
-    s.set_dispersion(dispersion);
-    s.set_frequency(frequencies[string], glide);
-    s.set_brightness(brightness);
-    s.set_position(position);
-    s.set_damping(damping + string_index * (0.95f - damping));
-    s.Process(input, out_buffer_, aux_buffer_, size);
-    
     if (string == 0) {
       // Was 0.1f, Ben Wilson -> 0.2f
       float gain = 0.2f / static_cast<float>(num_strings);
       for (size_t i = 0; i < size; ++i) {
-        float sum = out_buffer_[i] - aux_buffer_[i];
-        sympathetic_resonator_input_[i] = gain * sum;
+        float sum = b->out_buffer[i] - b->aux_buffer[i];
+        b->sympathetic_resonator_input[i] = gain * sum;
       }
     }
   }
 }
 
+template<typename S>
+void Part::RenderString(
+    S* s,
+    CosineOscillator* lfo,
+    RandomGenerator* random,
+    VoiceBuffers* b,
+    const PerformanceState& performance_state,
+    const Patch& patch,
+    int32_t string,
+    int32_t num_strings,
+    float frequency,
+    float dispersion,
+    size_t size) {
+  float lfo_value = lfo->Next();
+  
+  float brightness = patch.brightness;
+  float damping = patch.damping;
+  float position = patch.position;
+  float glide = 1.0f;
+  float string_index = static_cast<float>(string) / static_cast<float>(num_strings);
+  const float* input = b->resonator_input;
+  
+  if (model_ == RESONATOR_MODEL_STRING_AND_REVERB) {
+    damping *= (2.0f - damping);
+  }
+  
+  // When the internal exciter is used, string 0 is the main
+  // source, the other strings are vibrating by sympathetic resonance.
+  // When the internal exciter is not used, all strings are vibrating
+  // by sympathetic resonance.
+  if (string > 0 && performance_state.internal_exciter) {
+    brightness *= (2.0f - brightness);
+    brightness *= (2.0f - brightness);
+    damping = 0.7f + patch.damping * 0.27f;
+    float amount = (0.5f - fabs(0.5f - patch.position)) * 0.9f;
+    position = patch.position + lfo_value * amount;
+    glide = SemitonesToRatio((brightness - 1.0f) * 36.0f);
+    input = b->sympathetic_resonator_input;
+  }
+  
+  s->set_dispersion(dispersion);
+  s->set_random_generator(random);
+  s->set_frequency(frequency, glide);
+  s->set_brightness(brightness);
+  s->set_position(position);
+  s->set_damping(damping + string_index * (0.95f - damping));
+  s->Process(input, b->out_buffer, b->aux_buffer, size);
+}
+
+int32_t Part::ComputeSympatheticStringsFrequencies(
+    const PartVoice& v,
+    float* frequencies) {
+  const PerformanceState& performance_state = performance_state_;
+  int32_t num_strings = use_string_bank()
+      ? string_bank_->num_strings() / polyphony_
+      : max(kNumStrings / polyphony_, kNumStringsPerVoice);
+  float parameter = model_ == RESONATOR_MODEL_SYMPATHETIC_STRING
+      ? patch_.structure
+      : 2.0f + performance_state.chord;
+  ComputeSympatheticStringsNotes(
+      performance_state.tonic + performance_state.fm,
+      performance_state.tonic + v.note + performance_state.fm,
+      parameter,
+      frequencies,
+      num_strings);
+  for (int32_t i = 0; i < num_strings; ++i) {
+    frequencies[i] = SemitonesToRatio(frequencies[i] - 69.0f) * a3;
+  }
+  return num_strings;
+}
+
 const int32_t kPingPattern[] = {
   1, 0, 2, 1, 0, 2, 1, 0
 };
@@ -475,6 +564,23 @@ void Part::Process(
     return;
   }
   
+  // Each voice is mixed as soon as it has been rendered, so that the voices
+  // can share their scratch buffers on the hardware.
+  BeginBlock(performance_state, patch, in, size);
+  fill(&out[0], &out[size], 0.0f);
+  fill(&aux[0], &aux[size], 0.0f);
+  for (int32_t voice = 0; voice < polyphony_; ++voice) {
+    RenderVoice(voice);
+    MixVoice(voice, out, aux);
+  }
+  ProcessOutputs(out, aux);
+}
+
+void Part::BeginBlock(
+    const PerformanceState& performance_state,
+    const Patch& patch,
+    const float* in,
+    size_t size) {
   ConfigureResonators();
   
   note_filter_.Process(
@@ -482,8 +588,9 @@ void Part::Process(
       performance_state.strum);
 
   if (performance_state.strum) {
-    note_[active_voice_] = note_filter_.stable_note();
-    if (polyphony_ > 1 && polyphony_ & 1) {
+    voices_[active_voice_].note = note_filter_.stable_note();
+    // The ping pattern is designed for 3 voices.
+    if (polyphony_ == 3) {
       active_voice_ = kPingPattern[step_counter_ % 8];
       step_counter_ = (step_counter_ + 1) % 8;
     } else {
@@ -491,57 +598,100 @@ void Part::Process(
     }
   }
   
-  note_[active_voice_] = note_filter_.note();
+  voices_[active_voice_].note = note_filter_.note();
   
-  fill(&out[0], &out[size], 0.0f);
-  fill(&aux[0], &aux[size], 0.0f);
-  for (int32_t voice = 0; voice < polyphony_; ++voice) {
-    // Compute MIDI note value, frequency, and cutoff frequency for excitation
-    // filter.
-    float cutoff = patch.brightness * (2.0f - patch.brightness);
-    float note = note_[voice] + performance_state.tonic + performance_state.fm;
-    float frequency = SemitonesToRatio(note - 69.0f) * a3;
-    float filter_cutoff_range = performance_state.internal_exciter
-      ? frequency * SemitonesToRatio((cutoff - 0.5f) * 96.0f)
-      : 0.4f * SemitonesToRatio((cutoff - 1.0f) * 108.0f);
-    float filter_cutoff = min(voice == active_voice_
-      ? filter_cutoff_range
-      : (10.0f / kSampleRate), 0.499f);
-    float filter_q = performance_state.internal_exciter ? 1.5f : 0.8f;
-
-    // Process input with excitation filter. Inactive voices receive silence.
-    excitation_filter_[voice].set_f_q<FREQUENCY_DIRTY>(filter_cutoff, filter_q);
-    if (voice == active_voice_) {
-      copy(&in[0], &in[size], &resonator_input_[0]);
-    } else {
-      fill(&resonator_input_[0], &resonator_input_[size], 0.0f);
+  performance_state_ = performance_state;
+  patch_ = patch;
+  in_ = in;
+  size_ = size;
+  
+  // The delay lines of the bank are resized here, before the voices are
+  // rendered, possibly concurrently.
+  if (use_string_bank()) {
+    float frequencies[kMaxBankStrings];
+    for (int32_t voice = 0; voice < polyphony_; ++voice) {
+      int32_t num_strings = ComputeSympatheticStringsFrequencies(
+          voices_[voice], frequencies);
+      for (int32_t string = 0; string < num_strings; ++string) {
+        string_bank_->Reserve(voice + string * polyphony_, frequencies[string]);
+      }
     }
-    
-    if (model_ == RESONATOR_MODEL_MODAL) {
-      RenderModalVoice(
-          voice, performance_state, patch, frequency, filter_cutoff, size);
-    } else if (model_ == RESONATOR_MODEL_FM_VOICE) {
-      RenderFMVoice(
-          voice, performance_state, patch, frequency, filter_cutoff, size);
-    } else {
-      RenderStringVoice(
-          voice, performance_state, patch, frequency, filter_cutoff, size);
+  }
+}
+
+void Part::RenderVoice(int32_t voice) {
+  const PerformanceState& performance_state = performance_state_;
+  const Patch& patch = patch_;
+  const size_t size = size_;
+  PartVoice* v = &voices_[voice];
+  VoiceBuffers* b = mutable_buffers(voice);
+  
+  // Compute MIDI note value, frequency, and cutoff frequency for excitation
+  // filter.
+  float cutoff = patch.brightness * (2.0f - patch.brightness);
+  float note = v->note + performance_state.tonic + performance_state.fm;
+  float frequency = SemitonesToRatio(note - 69.0f) * a3;
+  float filter_cutoff_range = performance_state.internal_exciter
+    ? frequency * SemitonesToRatio((cutoff - 0.5f) * 96.0f)
+    : 0.4f * SemitonesToRatio((cutoff - 1.0f) * 108.0f);
+  float filter_cutoff = min(voice == active_voice_
+    ? filter_cutoff_range
+    : (10.0f / kSampleRate), 0.499f);
+  float filter_q = performance_state.internal_exciter ? 1.5f : 0.8f;
+
+  // Process input with excitation filter. Inactive voices receive silence.
+  v->excitation_filter.set_f_q<FREQUENCY_DIRTY>(filter_cutoff, filter_q);
+  if (voice == active_voice_) {
+    copy(&in_[0], &in_[size], &b->resonator_input[0]);
+  } else {
+    fill(&b->resonator_input[0], &b->resonator_input[size], 0.0f);
+  }
+  
+  if (model_ == RESONATOR_MODEL_MODAL) {
+    RenderModalVoice(
+        voice, performance_state, patch, frequency, filter_cutoff, size);
+  } else if (model_ == RESONATOR_MODEL_FM_VOICE) {
+    RenderFMVoice(
+        voice, performance_state, patch, frequency, filter_cutoff, size);
+  } else {
+    RenderStringVoice(
+        voice, performance_state, patch, frequency, filter_cutoff, size);
+  }
+}
+
+#ifdef TEST
+void Part::EndBlock(float* out, float* aux) {
+  // The voices are always mixed in the same order.
+  fill(&out[0], &out[size_], 0.0f);
+  fill(&aux[0], &aux[size_], 0.0f);
+  for (int32_t voice = 0; voice < polyphony_; ++voice) {
+    MixVoice(voice, out, aux);
+  }
+  ProcessOutputs(out, aux);
+}
+#endif  // TEST
+
+void Part::MixVoice(int32_t voice, float* out, float* aux) {
+  const size_t size = size_;
+  const VoiceBuffers* b = mutable_buffers(voice);
+  if (polyphony_ == 1) {
+    // Send the two sets of harmonics / pickups to individual outputs.
+    for (size_t i = 0; i < size; ++i) {
+      out[i] += b->out_buffer[i];
+      aux[i] += b->aux_buffer[i];
     }
-    
-    if (polyphony_ == 1) {
-      // Send the two sets of harmonics / pickups to individual outputs.
-      for (size_t i = 0; i < size; ++i) {
-        out[i] += out_buffer_[i];
-        aux[i] += aux_buffer_[i];
-      }
-    } else {
-      // Dispatch odd/even voices to individual outputs.
-      float* destination = voice & 1 ? aux : out;
-      for (size_t i = 0; i < size; ++i) {
-        destination[i] += out_buffer_[i] - aux_buffer_[i];
-      }
+  } else {
+    // Dispatch odd/even voices to individual outputs.
+    float* destination = voice & 1 ? aux : out;
+    for (size_t i = 0; i < size; ++i) {
+      destination[i] += b->out_buffer[i] - b->aux_buffer[i];
     }
   }
+}
+
+void Part::ProcessOutputs(float* out, float* aux) {
+  const Patch& patch = patch_;
+  const size_t size = size_;
   
   if (model_ == RESONATOR_MODEL_STRING_AND_REVERB) {
     for (size_t i = 0; i < size; ++i) {
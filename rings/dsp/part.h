@@ -43,8 +43,10 @@
 #include "rings/dsp/patch.h"
 #include "rings/dsp/performance_state.h"
 #include "rings/dsp/plucker.h"
+#include "rings/dsp/random_generator.h"
 #include "rings/dsp/resonator.h"
 #include "rings/dsp/string.h"
+#include "rings/dsp/string_bank.h"
 
 namespace rings {
 
@@ -63,6 +65,43 @@ enum ResonatorModel {
 const int32_t kMaxPolyphony = 4;
 const int32_t kNumStrings = kMaxPolyphony * 2;
 
+// With a low polyphony, a voice also uses the strings of the idle voices as
+// extra sympathetic strings - up to kNumStrings.
+const int32_t kNumStringsPerVoice = kNumStrings / kMaxPolyphony;
+
+// Scratch buffers used while a voice is rendered. On the hardware, the voices
+// are rendered one after the other and share a single set, owned by Part. In
+// TEST builds, each voice has its own, so that the voices can be rendered
+// concurrently.
+struct VoiceBuffers {
+  float resonator_input[kMaxBlockSize];
+  float sympathetic_resonator_input[kMaxBlockSize];
+  float noise_burst_buffer[kMaxBlockSize];
+  
+  float out_buffer[kMaxBlockSize];
+  float aux_buffer[kMaxBlockSize];
+};
+
+// State of a voice. Hosts with more CPU can run more than kMaxPolyphony voices
+// by passing a larger array of them to Part::Init().
+struct PartVoice {
+  Resonator resonator;
+  String string[kNumStringsPerVoice];
+  stmlib::CosineOscillator lfo[kNumStringsPerVoice];
+  FMVoice fm_voice;
+  
+  stmlib::Svf excitation_filter;
+  stmlib::DCBlocker dc_blocker;
+  Plucker plucker;
+  RandomGenerator random;
+  
+  float note;
+  
+#ifdef TEST
+  VoiceBuffers buffers;
+#endif  // TEST
+};
+
 class Part {
  public:
   Part() { }
@@ -70,6 +109,12 @@ class Part {
   
   void Init(uint16_t* reverb_buffer);
   
+  // Renders up to num_voices voices (at least kMaxPolyphony), with their state
+  // stored in "voices" instead of the internal array of kMaxPolyphony voices.
+  // The mode budget is raised so that each voice gets the full modal
+  // resolution.
+  void Init(uint16_t* reverb_buffer, PartVoice* voices, int32_t num_voices);
+  
   void Process(
       const PerformanceState& performance_state,
       const Patch& patch,
@@ -77,6 +122,24 @@ class Part {
       float* out,
       float* aux,
       size_t size);
+  
+  // Process() in three steps, for hosts rendering the voices on several
+  // threads (see rings/test/voice_worker_pool.h). Between BeginBlock() and
+  // EndBlock(), RenderVoice() must be called once for each voice below
+  // polyphony(), and can be called concurrently for different voices.
+  // EndBlock() mixes the voices in a fixed order, so the output does not
+  // depend on the order in which they have been rendered. The bypass setting
+  // is not handled. EndBlock() needs the scratch buffers of each voice, and
+  // is only available in TEST builds.
+  void BeginBlock(
+      const PerformanceState& performance_state,
+      const Patch& patch,
+      const float* in,
+      size_t size);
+  void RenderVoice(int32_t voice);
+#ifdef TEST
+  void EndBlock(float* out, float* aux);
+#endif  // TEST
 
   inline bool bypass() const { return bypass_; }
   inline void set_bypass(bool bypass) { bypass_ = bypass; }
@@ -84,13 +147,32 @@ class Part {
   inline int32_t polyphony() const { return polyphony_; }
   inline void set_polyphony(int32_t polyphony) {
     int32_t old_polyphony = polyphony_;
-    polyphony_ = std::min(polyphony, kMaxPolyphony);
+    polyphony_ = std::min(polyphony, capacity_);
     for (int32_t i = old_polyphony; i < polyphony_; ++i) {
-      note_[i] = note_[0] + i * 0.05f;
+      voices_[i].note = voices_[0].note + i * 0.05f;
     }
     dirty_ = true;
   }
   
+  // Maximum polyphony.
+  inline int32_t capacity() const { return capacity_; }
+  
+  // Total number of modes shared by the voices of the modal resonator - the
+  // hardware has 64. Each voice gets at most kMaxModes - 4 modes.
+  inline void set_mode_budget(int32_t num_modes) {
+    mode_budget_ = num_modes;
+    dirty_ = true;
+  }
+  
+  // Runs the sympathetic string models on the strings of a bank, shared
+  // evenly by the voices, instead of the strings of the voices. The bank
+  // needs at least one string per voice. Pass NULL to use the strings of the
+  // voices again.
+  inline void set_string_bank(StringBank* string_bank) {
+    string_bank_ = string_bank;
+    dirty_ = true;
+  }
+  
   inline ResonatorModel model() const { return model_; }
   inline void set_model(ResonatorModel model) {
     if (model != model_) {
@@ -122,6 +204,19 @@ class Part {
       float frequency,
       float filter_cutoff,
       size_t size);
+  template<typename S>
+  void RenderString(
+      S* s,
+      stmlib::CosineOscillator* lfo,
+      RandomGenerator* random,
+      VoiceBuffers* b,
+      const PerformanceState& performance_state,
+      const Patch& patch,
+      int32_t string,
+      int32_t num_strings,
+      float frequency,
+      float dispersion,
+      size_t size);
   
 
   inline float Squash(float x) const {
@@ -143,6 +238,17 @@ class Part {
     return x;
   }
 
+  void MixVoice(int32_t voice, float* out, float* aux);
+  void ProcessOutputs(float* out, float* aux);
+  
+  inline VoiceBuffers* mutable_buffers(int32_t voice) {
+#ifdef TEST
+    return &voices_[voice].buffers;
+#else
+    return &buffers_;
+#endif  // TEST
+  }
+
   void ComputeSympatheticStringsNotes(
       float tonic,
       float note,
@@ -150,6 +256,29 @@ class Part {
       float* destination,
       size_t num_strings);
   
+  // Frequencies of the strings of a voice, for the sympathetic string models.
+  // Returns the number of strings.
+  int32_t ComputeSympatheticStringsFrequencies(
+      const PartVoice& v,
+      float* frequencies);
+  
+  inline bool use_string_bank() const {
+    return string_bank_ &&
+        (model_ == RESONATOR_MODEL_SYMPATHETIC_STRING ||
+         model_ == RESONATOR_MODEL_SYMPATHETIC_STRING_QUANTIZED) &&
+        string_bank_->num_strings() >= polyphony_;
+  }
+  
+  // The strings of all voices, numbered like on the hardware: string i
+  // belongs to voice i % capacity_.
+  inline String* mutable_string(int32_t i) {
+    return &voices_[i % capacity_].string[i / capacity_];
+  }
+  
+  inline stmlib::CosineOscillator* mutable_lfo(int32_t i) {
+    return &voices_[i % capacity_].lfo[i / capacity_];
+  }
+  
   bool bypass_;
   bool dirty_;
 
@@ -159,25 +288,23 @@ class Part {
   int32_t active_voice_;
   uint32_t step_counter_;
   int32_t polyphony_;
+  int32_t capacity_;
+  int32_t mode_budget_;
   
-  Resonator resonator_[kMaxPolyphony];
-  String string_[kNumStrings];
-  stmlib::CosineOscillator lfo_[kNumStrings];
-  FMVoice fm_voice_[kMaxPolyphony];
+  PartVoice* voices_;
+  PartVoice default_voices_[kMaxPolyphony];
+#ifndef TEST
+  VoiceBuffers buffers_;
+#endif  // TEST
+  StringBank* string_bank_;
   
-  stmlib::Svf excitation_filter_[kMaxPolyphony];
-  stmlib::DCBlocker dc_blocker_[kMaxPolyphony];
-  Plucker plucker_[kMaxPolyphony];
-
-  float note_[kMaxPolyphony];
   NoteFilter note_filter_;
   
-  float resonator_input_[kMaxBlockSize];
-  float sympathetic_resonator_input_[kMaxBlockSize];
-  float noise_burst_buffer_[kMaxBlockSize];
-  
-  float out_buffer_[kMaxBlockSize];
-  float aux_buffer_[kMaxBlockSize];
+  // Block being rendered.
+  PerformanceState performance_state_;
+  Patch patch_;
+  const float* in_;
+  size_t size_;
   
   Reverb reverb_;
   Limiter limiter_;
@@ -50,6 +50,12 @@ void Resonator::Init() {
   set_damping(0.3f);
   set_position(0.999f);
   set_resolution(kMaxModes);
+  
+#ifdef RINGS_RESONATOR_SIMD
+  fill(&state_1_[0], &state_1_[kMaxModes], 0.0f);
+  fill(&state_2_[0], &state_2_[kMaxModes], 0.0f);
+#endif  // RINGS_RESONATOR_SIMD
+  backend_ = kDefaultResonatorBackend;
 }
 
 int32_t Resonator::ComputeFilters() {
@@ -100,6 +106,13 @@ int32_t Resonator::ComputeFilters() {
 void Resonator::Process(const float* in, float* out, float* aux, size_t size) {
   int32_t num_modes = ComputeFilters();
   
+#ifdef RINGS_RESONATOR_SIMD
+  if (backend_ == RESONATOR_BACKEND_SIMD) {
+    ProcessSimd(num_modes, in, out, aux, size);
+    return;
+  }
+#endif  // RINGS_RESONATOR_SIMD
+  
   ParameterInterpolator position(&previous_position_, position_, size);
   while (size--) {
     CosineOscillator amplitudes;
@@ -118,4 +131,158 @@ void Resonator::Process(const float* in, float* out, float* aux, size_t size) {
   }
 }
 
+#ifdef RINGS_RESONATOR_SIMD
+
+void Resonator::ProcessSimd(
+    int32_t num_modes,
+    const float* in,
+    float* out,
+    float* aux,
+    size_t size) {
+  if (!size) {
+    return;
+  }
+  
+  // Like in the scalar code, modes are rendered in (odd, even) pairs.
+  const int32_t num_pairs = (num_modes + 1) >> 1;
+  const int32_t width = kSimdWidth;
+  const int32_t num_vectors = (num_pairs + width - 1) / width;
+  
+  // The amplitudes given by the position are computed at both ends of the
+  // block, and linearly interpolated in between, instead of running the
+  // cosine oscillator again for each sample. They are exactly the same as
+  // the scalar code's when the position does not change.
+  //
+  // The lanes padding the last vectors are silent, and their state is frozen
+  // (g = 0) - just like the scalar code leaves the modes above num_modes
+  // untouched.
+  CosineOscillator start;
+  CosineOscillator end;
+  start.Init<COSINE_OSCILLATOR_APPROXIMATE>(previous_position_);
+  end.Init<COSINE_OSCILLATOR_APPROXIMATE>(position_);
+  start.Start();
+  end.Start();
+  previous_position_ = position_;
+  
+  const float increment = 1.0f / static_cast<float>(size);
+  for (int32_t i = 0; i < 2 * num_vectors * width; ++i) {
+    const int32_t index = (i & 1) * kModesPerBank + (i >> 1);
+    const bool active = i < 2 * num_pairs;
+    g_[index] = active ? f_[i].g() : 0.0f;
+    r_[index] = f_[i].r();
+    h_[index] = f_[i].h();
+    float a = 0.0f;
+    float b = 0.0f;
+    if (active) {
+      a = start.Next();
+      b = end.Next();
+    }
+    amplitude_[index] = a;
+    amplitude_increment_[index] = (b - a) * increment;
+  }
+  
+  float odd[kSimdModeChunkSize * kSimdWidth];
+  float even[kSimdModeChunkSize * kSimdWidth];
+  while (size) {
+    const size_t chunk_size = min(size, kSimdModeChunkSize);
+    fill(&odd[0], &odd[chunk_size * kSimdWidth], 0.0f);
+    fill(&even[0], &even[chunk_size * kSimdWidth], 0.0f);
+    for (int32_t i = 0; i < num_vectors; i += kMaxSimdBatchVectors) {
+      const int32_t first_mode = i * width;
+      switch (min(num_vectors - i, kMaxSimdBatchVectors)) {
+        case 1:
+          ProcessSimdBatch<1>(first_mode, in, odd, even, chunk_size);
+          break;
+        case 2:
+          ProcessSimdBatch<2>(first_mode, in, odd, even, chunk_size);
+          break;
+        case 3:
+          ProcessSimdBatch<3>(first_mode, in, odd, even, chunk_size);
+          break;
+        default:
+          ProcessSimdBatch<4>(first_mode, in, odd, even, chunk_size);
+          break;
+      }
+    }
+    for (size_t i = 0; i < chunk_size; ++i) {
+      float s_odd = 0.0f;
+      float s_even = 0.0f;
+      for (size_t j = 0; j < kSimdWidth; ++j) {
+        s_odd += odd[i * kSimdWidth + j];
+        s_even += even[i * kSimdWidth + j];
+      }
+      *out++ = s_odd;
+      *aux++ = s_even;
+    }
+    in += chunk_size;
+    size -= chunk_size;
+  }
+}
+
+// Renders num_vectors vectors of odd modes and num_vectors vectors of even
+// modes, starting at first_mode in each bank. The outputs are accumulated,
+// for each lane, in buffers of interleaved frames.
+template<int32_t num_vectors>
+void Resonator::ProcessSimdBatch(
+    int32_t first_mode,
+    const float* in,
+    float* odd,
+    float* even,
+    size_t size) {
+  const int32_t kNumVectors = 2 * num_vectors;
+  SimdFloat g[kNumVectors];
+  SimdFloat r[kNumVectors];
+  SimdFloat h[kNumVectors];
+  SimdFloat state_1[kNumVectors];
+  SimdFloat state_2[kNumVectors];
+  SimdFloat amplitude[kNumVectors];
+  SimdFloat amplitude_increment[kNumVectors];
+  int32_t index[kNumVectors];
+  for (int32_t j = 0; j < kNumVectors; ++j) {
+    // The odd modes come first.
+    const int32_t bank = j < num_vectors ? 0 : 1;
+    const int32_t vector = j - bank * num_vectors;
+    index[j] = bank * kModesPerBank + first_mode + vector * kSimdWidth;
+    g[j] = SimdFloat::Load(&g_[index[j]]);
+    r[j] = SimdFloat::Load(&r_[index[j]]);
+    h[j] = SimdFloat::Load(&h_[index[j]]);
+    state_1[j] = SimdFloat::Load(&state_1_[index[j]]);
+    state_2[j] = SimdFloat::Load(&state_2_[index[j]]);
+    amplitude[j] = SimdFloat::Load(&amplitude_[index[j]]);
+    amplitude_increment[j] = SimdFloat::Load(&amplitude_increment_[index[j]]);
+  }
+  
+  while (size--) {
+    const SimdFloat s_in = *in++ * 0.125f;
+    SimdFloat s_odd = SimdFloat::Load(odd);
+    SimdFloat s_even = SimdFloat::Load(even);
+    for (int32_t j = 0; j < kNumVectors; ++j) {
+      const SimdFloat hp = \
+          (s_in - r[j] * state_1[j] - g[j] * state_1[j] - state_2[j]) * h[j];
+      const SimdFloat bp = g[j] * hp + state_1[j];
+      state_1[j] = g[j] * hp + bp;
+      const SimdFloat lp = g[j] * bp + state_2[j];
+      state_2[j] = g[j] * bp + lp;
+      amplitude[j] += amplitude_increment[j];
+      if (j < num_vectors) {
+        s_odd += amplitude[j] * bp;
+      } else {
+        s_even += amplitude[j] * bp;
+      }
+    }
+    s_odd.Store(odd);
+    s_even.Store(even);
+    odd += kSimdWidth;
+    even += kSimdWidth;
+  }
+  
+  for (int32_t j = 0; j < kNumVectors; ++j) {
+    state_1[j].Store(&state_1_[index[j]]);
+    state_2[j].Store(&state_2_[index[j]]);
+    amplitude[j].Store(&amplitude_[index[j]]);
+  }
+}
+
+#endif  // RINGS_RESONATOR_SIMD
+
 }  // namespace rings
@@ -37,10 +37,47 @@
 #include "stmlib/dsp/filter.h"
 #include "stmlib/dsp/delay_line.h"
 
+// The SIMD backend is only built for hosts with a vector unit - on the
+// hardware, its state would only make Part bigger.
+#if defined(__SSE2__)
+#define RINGS_RESONATOR_SIMD
+#endif  // __SSE2__
+
+#ifdef RINGS_RESONATOR_SIMD
+#include "rings/dsp/simd.h"
+#endif  // RINGS_RESONATOR_SIMD
+
 namespace rings {
 
 const int32_t kMaxModes = 64;
 
+#ifdef RINGS_RESONATOR_SIMD
+
+// The SIMD backend renders the odd modes (sent to the main output) and the
+// even modes (sent to the aux output) in two separate banks, with one mode
+// per lane.
+const int32_t kModesPerBank = kMaxModes / 2;
+
+// Number of modes of each bank rendered in the same loop.
+const int32_t kSimdModeBatchSize = 16;
+const int32_t kMaxSimdBatchVectors = kSimdModeBatchSize / kSimdWidth;
+
+// Number of samples rendered by each batch before moving to the next one.
+const size_t kSimdModeChunkSize = 32;
+
+#endif  // RINGS_RESONATOR_SIMD
+
+enum ResonatorBackend {
+  RESONATOR_BACKEND_SCALAR,
+  RESONATOR_BACKEND_SIMD
+};
+
+#ifdef RINGS_RESONATOR_SIMD
+const ResonatorBackend kDefaultResonatorBackend = RESONATOR_BACKEND_SIMD;
+#else
+const ResonatorBackend kDefaultResonatorBackend = RESONATOR_BACKEND_SCALAR;
+#endif  // RINGS_RESONATOR_SIMD
+
 class Resonator {
  public:
   Resonator() { }
@@ -78,8 +115,33 @@ class Resonator {
     resolution_ = std::min(resolution, kMaxModes);
   }
   
+  // Can be called after Init, for benchmarks and tests. Without the SIMD
+  // backend, the scalar one is always used.
+  inline void set_backend(ResonatorBackend backend) {
+#ifndef RINGS_RESONATOR_SIMD
+    backend = RESONATOR_BACKEND_SCALAR;
+#endif  // RINGS_RESONATOR_SIMD
+    backend_ = backend;
+  }
+  
  private:
   int32_t ComputeFilters();
+#ifdef RINGS_RESONATOR_SIMD
+  void ProcessSimd(
+      int32_t num_modes,
+      const float* in,
+      float* out,
+      float* aux,
+      size_t size);
+  template<int32_t num_vectors>
+  void ProcessSimdBatch(
+      int32_t first_mode,
+      const float* in,
+      float* odd,
+      float* even,
+      size_t size);
+#endif  // RINGS_RESONATOR_SIMD
+  
   float frequency_;
   float structure_;
   float brightness_;
@@ -89,8 +151,22 @@ class Resonator {
   
   int32_t resolution_;
   
+  ResonatorBackend backend_;
+  
   stmlib::Svf f_[kMaxModes];
   
+#ifdef RINGS_RESONATOR_SIMD
+  // State of the SIMD backend, one array per variable. The odd modes are
+  // stored in the first half, the even modes in the second half.
+  float g_[kMaxModes];
+  float r_[kMaxModes];
+  float h_[kMaxModes];
+  float state_1_[kMaxModes];
+  float state_2_[kMaxModes];
+  float amplitude_[kMaxModes];
+  float amplitude_increment_[kMaxModes];
+#endif  // RINGS_RESONATOR_SIMD
+  
   DISALLOW_COPY_AND_ASSIGN(Resonator);
 };
 
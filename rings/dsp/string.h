@@ -32,16 +32,43 @@
 #include "stmlib/stmlib.h"
 
 #include <algorithm>
+#include <cmath>
 
-#include "stmlib/dsp/delay_line.h"
+#include "stmlib/dsp/dsp.h"
 #include "stmlib/dsp/filter.h"
+#include "stmlib/dsp/parameter_interpolator.h"
+#include "stmlib/dsp/units.h"
 
+#include "rings/dsp/delay_line.h"
 #include "rings/dsp/dsp.h"
+#include "rings/dsp/random_generator.h"
+#include "rings/resources.h"
 
 namespace rings {
 
 const size_t kDelayLineSize = 2048;
 
+enum StringInterpolation {
+  STRING_INTERPOLATION_HERMITE,
+  // Flatter delay and gain on the upper partials, for about 15% more CPU.
+  STRING_INTERPOLATION_LAGRANGE
+};
+
+// Cubic interpolation between the third and second most recent samples of a
+// history of 4 samples.
+inline float InterpolateHistory(const float* history, float t) {
+  const float xm1 = history[3];
+  const float x0 = history[2];
+  const float x1 = history[1];
+  const float x2 = history[0];
+  const float c = (x1 - xm1) * 0.5f;
+  const float v = x0 - x1;
+  const float w = c + v;
+  const float a = w + v + (x2 - x0) * 0.5f;
+  const float b_neg = w + a;
+  return (((a * t) - b_neg) * t + c) * t + x0;
+}
+
 class DampingFilter {
  public:
   DampingFilter() { }
@@ -90,16 +117,146 @@ class DampingFilter {
   DISALLOW_COPY_AND_ASSIGN(DampingFilter);
 };
 
-typedef stmlib::DelayLine<float, kDelayLineSize> StringDelayLine;
-typedef stmlib::DelayLine<float, kDelayLineSize / 2> StiffnessDelayLine;
+typedef DelayLine<float, kDelayLineSize> StringDelayLine;
+typedef DelayLine<float, kDelayLineSize / 2> StiffnessDelayLine;
 
-class String {
+// Reads the delay line as is, for strings without stiffness.
+class NoDispersion {
  public:
-  String() { }
-  ~String() { }
+  NoDispersion() { }
+  ~NoDispersion() { }
   
-  void Init(bool enable_dispersion);
-  void Process(const float* in, float* out, float* aux, size_t size);
+  template<typename S>
+  inline float Read(const S& string, float delay) {
+    return string.ReadString(delay);
+  }
+  
+ private:
+  DISALLOW_COPY_AND_ASSIGN(NoDispersion);
+};
+
+// Stiffness (an allpass filter in the loop, with a noisy delay), or "buzz"
+// from a curved bridge for negative amounts.
+class StringDispersion {
+ public:
+  StringDispersion() { }
+  ~StringDispersion() { }
+  
+  void Init() {
+    stretch_.Init(stretch_buffer_);
+    random_ = NULL;
+    previous_dispersion_ = 0.0f;
+    dispersion_increment_ = 0.0f;
+    dispersion_noise_ = 0.0f;
+    noise_filter_ = 0.0f;
+    curved_bridge_ = 0.0f;
+    dc_blocker_.Init(1.0f - 20.0f / kSampleRate);
+  }
+  
+  inline void set_random_generator(RandomGenerator* random) {
+    random_ = random;
+  }
+  
+  // Interpolates the amount of dispersion over the next "size" steps.
+  inline void Start(float dispersion, float brightness, size_t size) {
+    noise_filter_ = stmlib::SemitonesToRatio((brightness - 1.0f) * 48.0f);
+    dispersion_increment_ = (dispersion - previous_dispersion_) /
+        static_cast<float>(size);
+  }
+  
+  template<typename S>
+  inline float Read(const S& string, float delay) {
+    float noise = 2.0f * random_->GetFloat() - 1.0f;
+    noise *= 1.0f / (0.2f + noise_filter_);
+    dispersion_noise_ += noise_filter_ * (noise - dispersion_noise_);
+
+    previous_dispersion_ += dispersion_increment_;
+    float dispersion = previous_dispersion_;
+    float stretch_point = dispersion <= 0.0f
+        ? 0.0f
+        : dispersion * (2.0f - dispersion) * 0.475f;
+    float noise_amount = dispersion > 0.75f
+        ? 4.0f * (dispersion - 0.75f)
+        : 0.0f;
+    float bridge_curving = dispersion < 0.0f
+        ? -dispersion
+        : 0.0f;
+    
+    noise_amount = noise_amount * noise_amount * 0.025f;
+    float ac_blocking_amount = bridge_curving;
+
+    bridge_curving = bridge_curving * bridge_curving * 0.01f;
+    float ap_gain = -0.618f * dispersion / (0.15f + fabsf(dispersion));
+    
+    float delay_fm = 1.0f;
+    delay_fm += dispersion_noise_ * noise_amount;
+    delay_fm -= curved_bridge_ * bridge_curving;
+    delay *= delay_fm;
+    
+    float s;
+    float ap_delay = delay * stretch_point;
+    float main_delay = delay - ap_delay;
+    if (ap_delay >= 4.0f && main_delay >= 4.0f) {
+      s = string.ReadString(main_delay);
+      s = stretch_.Allpass(s, ap_delay, ap_gain);
+    } else {
+      s = string.ReadString(delay);
+    }
+    float s_ac = s;
+    dc_blocker_.Process(&s_ac, 1);
+    s += ac_blocking_amount * (s_ac - s);
+    
+    float value = fabsf(s) - 0.025f;
+    float sign = s > 0.0f ? 1.0f : -1.5f;
+    curved_bridge_ = (fabsf(value) + value) * sign;
+    return s;
+  }
+  
+ private:
+  RandomGenerator* random_;
+  float previous_dispersion_;
+  float dispersion_increment_;
+  float dispersion_noise_;
+  float noise_filter_;
+  float curved_bridge_;
+  
+  StiffnessDelayLine stretch_;
+  stmlib::DCBlocker dc_blocker_;
+  
+  float stretch_buffer_[kDelayLineSize / 2];
+  
+  DISALLOW_COPY_AND_ASSIGN(StringDispersion);
+};
+
+// Comb filter, damping and low pitch upsampling shared by String and
+// BankString, which only differ by the type of their delay line and by
+// their dispersion.
+template<typename Line>
+class StringBase {
+ public:
+  StringBase() { }
+  ~StringBase() { }
+  
+  // The delay line is initialized by the derived class.
+  void Init() {
+    fir_damping_filter_.Init();
+    iir_damping_filter_.Init();
+    
+    set_frequency(220.0f / kSampleRate);
+    set_brightness(0.5f);
+    set_damping(0.3f);
+    set_position(0.8f);
+    
+    delay_ = 1.0f / frequency_;
+    clamped_position_ = 0.0f;
+    previous_damping_compensation_ = 0.0f;
+    
+    interpolation_ = STRING_INTERPOLATION_HERMITE;
+    src_phase_ = 0.0f;
+    input_sum_ = 0.0f;
+    std::fill(&out_sample_[0], &out_sample_[4], 0.0f);
+    std::fill(&aux_sample_[0], &aux_sample_[4], 0.0f);
+  }
   
   inline void set_frequency(float frequency) {
     frequency_ = frequency;
@@ -109,10 +266,6 @@ class String {
     frequency_ += coefficient * (frequency - frequency_);
   }
 
-  inline void set_dispersion(float dispersion) {
-    dispersion_ = dispersion;
-  }
-  
   inline void set_brightness(float brightness) {
     brightness_ = brightness;
   }
@@ -125,41 +278,185 @@ class String {
     position_ = position;
   }
   
-  inline StringDelayLine* mutable_string() { return &string_; }
+  // Can be called after Init, for benchmarks and tests.
+  inline void set_interpolation(StringInterpolation interpolation) {
+    interpolation_ = interpolation;
+  }
+  
+  inline float ReadString(float delay) const {
+    return interpolation_ == STRING_INTERPOLATION_LAGRANGE && delay >= 3.0f
+        ? string_.ReadLagrange(delay)
+        : string_.ReadHermite(delay);
+  }
+  
+ protected:
+  template<typename Dispersion>
+  void ProcessInternal(
+      const float* in,
+      float* out,
+      float* aux,
+      size_t size,
+      size_t line_size,
+      Dispersion* dispersion);
   
- private:
-  template<bool enable_dispersion>
-  void ProcessInternal(const float* in, float* out, float* aux, size_t size);
-   
   float frequency_;
-  float dispersion_;
   float brightness_;
   float damping_;
   float position_;
   
   float delay_;
   float clamped_position_;
-  float previous_dispersion_;
   float previous_damping_compensation_;
   
-  bool enable_dispersion_;
-  bool enable_iir_damping_;
-  float dispersion_noise_;
+  StringInterpolation interpolation_;
   
-  // Very crappy linear interpolation upsampler used for low pitches that
-  // do not fit the delay line. Rarely used.
+  // For low pitches that do not fit the delay line, the string runs at a
+  // lower rate. Its input is averaged, and its output interpolated from the
+  // last 4 samples.
   float src_phase_;
-  float out_sample_[2];
-  float aux_sample_[2];
+  float input_sum_;
+  float out_sample_[4];
+  float aux_sample_[4];
   
-  float curved_bridge_;
-  
-  StringDelayLine string_;
-  StiffnessDelayLine stretch_;
+  Line string_;
   
   DampingFilter fir_damping_filter_;
   stmlib::Svf iir_damping_filter_;
-  stmlib::DCBlocker dc_blocker_;
+  
+  DISALLOW_COPY_AND_ASSIGN(StringBase);
+};
+
+template<typename Line>
+template<typename Dispersion>
+void StringBase<Line>::ProcessInternal(
+    const float* in,
+    float* out,
+    float* aux,
+    size_t size,
+    size_t line_size,
+    Dispersion* dispersion) {
+  using namespace stmlib;
+  
+  float delay = 1.0f / frequency_;
+  CONSTRAIN(delay, 4.0f, static_cast<float>(line_size) - 4.0f);
+  
+  // If there is not enough delay time in the delay line, we play at the
+  // lowest possible note and we upsample on the fly. It's a corner case
+  // (f0 < 11.7Hz with the delay line of a String).
+  float src_ratio = delay * frequency_;
+  if (src_ratio >= 0.9999f) {
+    // When we are above 11.7 Hz, we make sure that the linear interpolator
+    // does not get in the way.
+    src_phase_ = 1.0f;
+    src_ratio = 1.0f;
+  }
+
+  float clamped_position = 0.5f - 0.98f * fabsf(position_ - 0.5f);
+  
+  // Linearly interpolate all comb-related CV parameters for each sample.
+  ParameterInterpolator delay_modulation(
+      &delay_, delay, size);
+  ParameterInterpolator position_modulation(
+      &clamped_position_, clamped_position, size);
+  
+  // For damping/absorption, the interpolation is done in the filter code.
+  float lf_damping = damping_ * (2.0f - damping_);
+  float rt60 = 0.07f * SemitonesToRatio(lf_damping * 96.0f) * kSampleRate;
+  float rt60_base_2_12 = std::max(
+      -120.0f * delay / src_ratio / rt60, -127.0f);
+  float damping_coefficient = SemitonesToRatio(rt60_base_2_12);
+  float brightness = brightness_ * brightness_;
+  float damping_cutoff = std::min(
+      24.0f + damping_ * damping_ * 48.0f + brightness_ * brightness_ * 24.0f,
+      84.0f);
+  float damping_f = std::min(
+      frequency_ / src_ratio * SemitonesToRatio(damping_cutoff), 0.499f);
+  
+  // Crossfade to infinite decay.
+  if (damping_ >= 0.95f) {
+    float to_infinite = 20.0f * (damping_ - 0.95f);
+    damping_coefficient += to_infinite * (1.0f - damping_coefficient);
+    brightness += to_infinite * (1.0f - brightness);
+    damping_f += to_infinite * (0.4999f - damping_f);
+    damping_cutoff += to_infinite * (128.0f - damping_cutoff);
+  }
+  
+  fir_damping_filter_.Configure(damping_coefficient, brightness, size);
+  iir_damping_filter_.template set_f_q<FREQUENCY_ACCURATE>(damping_f, 0.5f);
+  ParameterInterpolator damping_compensation_modulation(
+      &previous_damping_compensation_,
+      1.0f - Interpolate(lut_svf_shift, damping_cutoff, 1.0f),
+      size);
+  
+  while (size--) {
+    src_phase_ += src_ratio;
+    input_sum_ += *in++;
+    if (src_phase_ > 1.0f) {
+      src_phase_ -= 1.0f;
+      
+      float delay = delay_modulation.Next();
+      float comb_delay = delay * position_modulation.Next();
+    
+#ifndef MIC_W
+      delay *= damping_compensation_modulation.Next();  // IIR delay.
+#endif  // MIC_W
+      delay -= 1.0f; // FIR delay.
+    
+      float s = dispersion->Read(*this, delay);
+    
+      // Average of the input samples received since the last step.
+      s += input_sum_ * src_ratio;
+      input_sum_ = 0.0f;
+      s = fir_damping_filter_.Process(s);
+#ifndef MIC_W
+      s = iir_damping_filter_.template Process<FILTER_MODE_LOW_PASS>(s);
+#endif  // MIC_W
+      string_.Write(s);
+
+      for (int32_t i = 3; i > 0; --i) {
+        out_sample_[i] = out_sample_[i - 1];
+        aux_sample_[i] = aux_sample_[i - 1];
+      }
+      out_sample_[0] = s;
+      aux_sample_[0] = string_.Read(comb_delay);
+    }
+    if (src_ratio < 1.0f) {
+      *out++ += InterpolateHistory(out_sample_, src_phase_);
+      *aux++ += InterpolateHistory(aux_sample_, src_phase_);
+    } else {
+      *out++ += Crossfade(out_sample_[1], out_sample_[0], src_phase_);
+      *aux++ += Crossfade(aux_sample_[1], aux_sample_[0], src_phase_);
+    }
+  }
+}
+
+class String : public StringBase<StringDelayLine> {
+ public:
+  String() { }
+  ~String() { }
+  
+  void Init(bool enable_dispersion);
+  void Process(const float* in, float* out, float* aux, size_t size);
+  
+  inline void set_dispersion(float dispersion) {
+    dispersion_ = dispersion;
+  }
+  
+  // The dispersion noise is drawn from the generator of the voice rendering
+  // the string. It must be set before Process() when dispersion is enabled.
+  inline void set_random_generator(RandomGenerator* random) {
+    stiffness_.set_random_generator(random);
+  }
+  
+  inline StringDelayLine* mutable_string() { return &string_; }
+  
+ private:
+  float dispersion_;
+  bool enable_dispersion_;
+  
+  StringDispersion stiffness_;
+  
+  float string_buffer_[kDelayLineSize];
   
   DISALLOW_COPY_AND_ASSIGN(String);
 };
@@ -0,0 +1,78 @@
+// Copyright 2015 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+//
+// Bank of sympathetic strings sharing a pool of delay memory.
+
+#include "rings/dsp/string_bank.h"
+
+#include <algorithm>
+
+namespace rings {
+  
+using namespace std;
+
+void BankString::Init() {
+  string_.Init();
+  StringBase<PooledDelayLine>::Init();
+}
+
+void BankString::Reserve(DelayPool* pool, float frequency) {
+  // Room for the Hermite interpolator, like in String.
+  float delay = max(delay_, 1.0f / min(frequency, frequency_)) + 4.0f;
+  size_t size = kMinDelaySliceSize;
+  while (size < kMaxDelaySliceSize && static_cast<float>(size) < delay) {
+    size <<= 1;
+  }
+  if (size > string_.size() || size * 4 <= string_.size()) {
+    string_.Resize(pool, size);
+  }
+}
+
+void BankString::Process(
+    const float* in,
+    float* out,
+    float* aux,
+    size_t size) {
+  if (!string_.size()) {
+    return;
+  }
+  NoDispersion no_dispersion;
+  ProcessInternal(in, out, aux, size, string_.size(), &no_dispersion);
+}
+
+void StringBank::Init(float* memory, size_t memory_size, int32_t num_strings) {
+  pool_.Init(memory, memory_size);
+  num_strings_ = min(num_strings, kMaxBankStrings);
+  Reset();
+}
+
+void StringBank::Reset() {
+  pool_.Reset();
+  for (int32_t i = 0; i < num_strings_; ++i) {
+    strings_[i].Init();
+  }
+}
+
+}  // namespace rings
@@ -0,0 +1,115 @@
+// Copyright 2015 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+//
+// Bank of sympathetic strings sharing a pool of delay memory.
+//
+// A String carries a delay line of kDelayLineSize samples and a stiffness
+// line of half that size, whatever its pitch - most of this memory is never
+// touched above a few dozen Hz. The strings of a StringBank get a delay line
+// from a DelayPool instead, sized to the power of two just above their
+// period, so that many more strings can run with the same memory traffic.
+// They run the loop of String (see StringBase) on their pooled line, without
+// dispersion, like the strings of the sympathetic string models.
+
+#ifndef RINGS_DSP_STRING_BANK_H_
+#define RINGS_DSP_STRING_BANK_H_
+
+#include "stmlib/stmlib.h"
+
+#include "stmlib/dsp/cosine_oscillator.h"
+
+#include "rings/dsp/delay_pool.h"
+#include "rings/dsp/dsp.h"
+#include "rings/dsp/string.h"
+
+namespace rings {
+
+const int32_t kMaxBankStrings = 48;
+
+class BankString : public StringBase<PooledDelayLine> {
+ public:
+  BankString() { }
+  ~BankString() { }
+  
+  void Init();
+  
+  // Resizes the delay line to fit the current frequency and "frequency",
+  // the frequency the string is about to glide to. Lines are grown as soon
+  // as needed, and shrunk when they are 4 times too long. When the pool is
+  // full, the line keeps its size and low notes are played through the
+  // upsampler, like in String.
+  void Reserve(DelayPool* pool, float frequency);
+  
+  void Process(const float* in, float* out, float* aux, size_t size);
+  
+  // No dispersion in sympathetic strings.
+  inline void set_dispersion(float dispersion) { }
+  inline void set_random_generator(RandomGenerator* random) { }
+  
+  inline size_t delay_line_size() const { return string_.size(); }
+  
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BankString);
+};
+
+class StringBank {
+ public:
+  StringBank() { }
+  ~StringBank() { }
+  
+  // Size in samples. 1024 samples per string are enough for notes down to
+  // 50 Hz.
+  void Init(float* memory, size_t memory_size, int32_t num_strings);
+  
+  // Initializes the strings and gives their memory back to the pool.
+  void Reset();
+  
+  inline void Reserve(int32_t i, float frequency) {
+    strings_[i].Reserve(&pool_, frequency);
+  }
+  
+  inline BankString* mutable_string(int32_t i) { return &strings_[i]; }
+  inline stmlib::CosineOscillator* mutable_lfo(int32_t i) { return &lfo_[i]; }
+  
+  inline int32_t num_strings() const { return num_strings_; }
+  
+  // In bytes.
+  inline size_t memory_usage() const {
+    return pool_.num_allocated_samples() * sizeof(float);
+  }
+  
+ private:
+  int32_t num_strings_;
+  
+  DelayPool pool_;
+  BankString strings_[kMaxBankStrings];
+  stmlib::CosineOscillator lfo_[kMaxBankStrings];
+  
+  DISALLOW_COPY_AND_ASSIGN(StringBank);
+};
+
+}  // namespace rings
+
+#endif  // RINGS_DSP_STRING_BANK_H_
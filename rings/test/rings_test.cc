@@ -13,17 +13,23 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <cassert>
 #include <cmath>
 #include <cstdio>
+#include <cmath>
 #include <cstring>
 #include <cstdlib>
+#include <ctime>
 #include <xmmintrin.h>
 
 #include "rings/dsp/part.h"
+#include "rings/dsp/resonator.h"
+#include "rings/dsp/string_bank.h"
 #include "rings/dsp/onset_detector.h"
 #include "rings/dsp/string_synth_part.h"
 #include "rings/dsp/string_synth_oscillator.h"
 #include "rings/dsp/string_synth_voice.h"
+#include "rings/test/voice_worker_pool.h"
 
 #include "stmlib/test/wav_writer.h"
 #include "stmlib/dsp/units.h"
@@ -556,6 +562,586 @@ void TestStringSynthPart() {
   }
 }
 
+void TestResonatorSimd() {
+  const size_t kSize = kAudioBlockSize;
+  const ResonatorBackend kBackends[] = {
+    RESONATOR_BACKEND_SCALAR,
+    RESONATOR_BACKEND_SIMD
+  };
+  
+  static Resonator resonator[2];
+  float in[kSize];
+  float out[2][kSize];
+  float aux[2][kSize];
+  
+  printf("modes   max error   max error (moving position)\n");
+  for (int32_t resolution = 8; resolution <= kMaxModes; resolution += 8) {
+    float max_error[2] = { 0.0f, 0.0f };
+    for (int32_t j = 0; j < 2; ++j) {
+      resonator[j].Init();
+      resonator[j].set_resolution(resolution);
+      resonator[j].set_backend(kBackends[j]);
+    }
+    for (size_t i = 0; i < ::kSampleRate / kSize * 4; ++i) {
+      const float t = static_cast<float>(i * kSize) / ::kSampleRate;
+      // The position is constant for the first half of the test.
+      const bool moving = t >= 2.0f;
+      fill(&in[0], &in[kSize], 0.0f);
+      in[0] = i % 400 == 0 ? 1.0f : 0.0f;
+      for (int32_t j = 0; j < 2; ++j) {
+        resonator[j].set_frequency(
+            SemitonesToRatio(24.0f * sinf(t * 3.0f)) * 110.0f / ::kSampleRate);
+        resonator[j].set_structure(0.5f + 0.45f * sinf(t * 2.0f));
+        resonator[j].set_brightness(0.6f);
+        resonator[j].set_damping(0.7f);
+        resonator[j].set_position(
+            0.3f + (moving ? 0.25f * sinf((t - 2.0f) * 5.0f) : 0.0f));
+        resonator[j].Process(in, out[j], aux[j], kSize);
+      }
+      // On the first block, the position glides from 0.
+      float* e = &max_error[moving];
+      for (size_t k = 0; i != 0 && k < kSize; ++k) {
+        *e = max(*e, fabsf(out[0][k] - out[1][k]));
+        *e = max(*e, fabsf(aux[0][k] - aux[1][k]));
+      }
+    }
+    printf("%5d %11.2e %11.2e\n", resolution, max_error[0], max_error[1]);
+  }
+}
+
+void BenchmarkResonator() {
+  const size_t kSize = kAudioBlockSize;
+  const size_t kNumBlocks = 20000;
+  const ResonatorBackend kBackends[] = {
+    RESONATOR_BACKEND_SCALAR,
+    RESONATOR_BACKEND_SIMD
+  };
+  
+  static Resonator resonator[kMaxPolyphony];
+  float in[kSize];
+  float out[kSize];
+  float aux[kSize];
+  
+  printf("modes voices   scalar modes/us   simd modes/us\n");
+  for (int32_t resolution = 16; resolution <= kMaxModes; resolution *= 2) {
+    for (int32_t num_voices = 1; num_voices <= kMaxPolyphony; ++num_voices) {
+      float modes_per_us[2];
+      for (int32_t j = 0; j < 2; ++j) {
+        for (int32_t v = 0; v < num_voices; ++v) {
+          resonator[v].Init();
+          resonator[v].set_resolution(resolution);
+          resonator[v].set_frequency(55.0f * (v + 1) / ::kSampleRate);
+          resonator[v].set_structure(0.25f);
+          resonator[v].set_backend(kBackends[j]);
+        }
+        clock_t start = clock();
+        for (size_t i = 0; i < kNumBlocks; ++i) {
+          fill(&in[0], &in[kSize], 0.0f);
+          in[0] = i % 200 == 0 ? 0.5f : 0.0f;
+          for (int32_t v = 0; v < num_voices; ++v) {
+            resonator[v].Process(in, out, aux, kSize);
+          }
+        }
+        float elapsed = float(clock() - start) / CLOCKS_PER_SEC;
+        modes_per_us[j] = resolution * num_voices * kNumBlocks * kSize / \
+            (elapsed * 1e6f);
+      }
+      printf("%5d %6d %17.1f %15.1f\n",
+          resolution, num_voices, modes_per_us[0], modes_per_us[1]);
+    }
+  }
+}
+
+void BenchmarkPolyphony() {
+  const int32_t kNumVoices = 16;
+  const size_t kNumBlocks = 4000;
+  const ResonatorModel kModels[] = {
+    RESONATOR_MODEL_MODAL,
+    RESONATOR_MODEL_SYMPATHETIC_STRING,
+    RESONATOR_MODEL_STRING,
+    RESONATOR_MODEL_FM_VOICE
+  };
+  const char* kModelNames[] = { "modal", "sympathetic", "string", "fm" };
+  const int32_t kPolyphonies[] = { 1, 2, 4, 8, 16 };
+  
+  static PartVoice voices[kNumVoices];
+  static Part part;
+  
+  Patch patch;
+  patch.structure = 0.25f;
+  patch.brightness = 0.5f;
+  patch.damping = 0.8f;
+  patch.position = 0.3f;
+  
+  printf("model         voices   us/voice/block   %% of a core/voice\n");
+  for (size_t m = 0; m < sizeof(kModels) / sizeof(kModels[0]); ++m) {
+    for (size_t p = 0; p < sizeof(kPolyphonies) / sizeof(int32_t); ++p) {
+      part.Init(reverb_buffer, voices, kNumVoices);
+      part.set_polyphony(kPolyphonies[p]);
+      part.set_model(kModels[m]);
+      
+      clock_t start = clock();
+      for (size_t i = 0; i < kNumBlocks; ++i) {
+        float in[kAudioBlockSize];
+        float out[kAudioBlockSize];
+        float aux[kAudioBlockSize];
+        fill(&in[0], &in[kAudioBlockSize], 0.0f);
+        
+        PerformanceState performance;
+        performance.strum = i % 100 == 0;
+        performance.internal_exciter = true;
+        performance.note = static_cast<float>((i / 100) % 12);
+        performance.tonic = 36.0f;
+        performance.fm = 0.0f;
+        performance.chord = 0;
+        part.Process(performance, patch, in, out, aux, kAudioBlockSize);
+      }
+      float elapsed = float(clock() - start) / CLOCKS_PER_SEC;
+      float us_per_voice = elapsed * 1e6f / kNumBlocks / kPolyphonies[p];
+      float block_duration = 1e6f * kAudioBlockSize / ::kSampleRate;
+      printf("%-12s %7d %16.2f %19.1f\n",
+          kModelNames[m],
+          kPolyphonies[p],
+          us_per_voice,
+          100.0f * us_per_voice / block_duration);
+    }
+  }
+}
+
+void TestVoiceWorkerPool() {
+  const int32_t kNumVoices = 16;
+  const size_t kNumThreads[] = { 1, 2, 4 };
+  const size_t kNumNumThreads = sizeof(kNumThreads) / sizeof(size_t);
+  const ResonatorModel kModels[] = {
+    RESONATOR_MODEL_MODAL,
+    RESONATOR_MODEL_SYMPATHETIC_STRING,
+    RESONATOR_MODEL_STRING_AND_REVERB
+  };
+  const char* kModelNames[] = { "modal", "sympathetic", "string+reverb" };
+  const size_t kNumModels = sizeof(kModels) / sizeof(ResonatorModel);
+  const size_t kRenderDuration = 4;
+  const long kBlockDuration = 1000000000L / ::kSampleRate * kAudioBlockSize;
+  
+  static PartVoice voices[2][kNumVoices];
+  static Part part[2];
+  static uint16_t reverb_buffers[2][65536];
+  
+  Patch patch;
+  patch.structure = 0.25f;
+  patch.brightness = 0.6f;
+  patch.damping = 0.8f;
+  patch.position = 0.3f;
+  
+  // Time spent on the audio thread for each block, with all voices playing.
+  // Blocks are rendered in real time, as in an audio callback, and the
+  // deadline is the duration of a block. The exciter switches between the
+  // external input and the internal one - noise bursts, and dispersion noise
+  // in the string model - every 200 blocks. Since each voice draws its noise
+  // from its own generator, the output must be the same as Part::Process()'s
+  // with both.
+  size_t num_late_configurations = 0;
+  printf("model          threads  mean (ns)  worst (ns)  missed  identical\n");
+  for (size_t m = 0; m < kNumModels; ++m) {
+    for (size_t t = 0; t < kNumNumThreads; ++t) {
+      for (int32_t j = 0; j < 2; ++j) {
+        part[j].Init(reverb_buffers[j], voices[j], kNumVoices);
+        part[j].set_polyphony(kNumVoices);
+        part[j].set_model(kModels[m]);
+      }
+      VoiceWorkerPool pool;
+      if (!pool.Init(&part[1], kNumThreads[t])) {
+        printf("Could not start %d threads\n", int(kNumThreads[t]));
+        return;
+      }
+      
+      double total = 0.0;
+      double worst = 0.0;
+      size_t num_missed = 0;
+      bool identical = true;
+      size_t num_blocks = ::kSampleRate * kRenderDuration / kAudioBlockSize;
+      timespec deadline;
+      clock_gettime(CLOCK_MONOTONIC, &deadline);
+      for (size_t i = 0; i < num_blocks; ++i) {
+        deadline.tv_nsec += kBlockDuration;
+        if (deadline.tv_nsec >= 1000000000L) {
+          deadline.tv_nsec -= 1000000000L;
+          ++deadline.tv_sec;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+        
+        float in[kAudioBlockSize];
+        float out[2][kAudioBlockSize];
+        float aux[2][kAudioBlockSize];
+        for (size_t k = 0; k < kAudioBlockSize; ++k) {
+          in[k] = k == 0 && i % 20 == 0 ? 0.5f : 0.0f;
+        }
+        
+        PerformanceState performance;
+        performance.strum = i % 20 == 0;
+        performance.internal_exciter = (i / 200) % 2 == 1;
+        performance.note = static_cast<float>((i / 20) % 24);
+        performance.tonic = 36.0f;
+        performance.fm = 0.0f;
+        performance.chord = 0;
+        
+        part[0].Process(
+            performance, patch, in, out[0], aux[0], kAudioBlockSize);
+        
+        timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        pool.Process(performance, patch, in, out[1], aux[1], kAudioBlockSize);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = (end.tv_sec - start.tv_sec) * 1e9 + \
+            (end.tv_nsec - start.tv_nsec);
+        // The first block initializes the voices.
+        if (i != 0) {
+          total += elapsed;
+          worst = max(worst, elapsed);
+          if (elapsed > kBlockDuration) {
+            ++num_missed;
+          }
+        }
+        
+        identical = identical && \
+            !memcmp(out[0], out[1], sizeof(out[0])) && \
+            !memcmp(aux[0], aux[1], sizeof(aux[0]));
+      }
+      size_t num_threads = pool.num_threads();
+      pool.Stop();
+      
+      printf(
+          "%-13s  %7d  %9.0f  %10.0f  %6d  %9s%s\n",
+          kModelNames[m],
+          int(num_threads),
+          total / (num_blocks - 1),
+          worst,
+          int(num_missed),
+          identical ? "yes" : "NO",
+          num_missed ? "  <- MISSED DEADLINES" : "");
+      assert(identical);
+      if (num_missed) {
+        ++num_late_configurations;
+      }
+    }
+  }
+  // Preemption by the OS can make a block late even when the voices are
+  // rendered in time, so missed deadlines are only reported.
+  printf(
+      "%d of %d configurations missed deadlines\n",
+      int(num_late_configurations),
+      int(kNumModels * kNumNumThreads));
+}
+
+void TestStringBank() {
+  const size_t kSize = kAudioBlockSize;
+  const int32_t kNumBankStrings = 48;
+  
+  // A string of the bank must sound like a String without dispersion, while
+  // its delay line grows and shrinks with the pitch.
+  static String string;
+  static BankString bank_string;
+  static DelayPool pool;
+  static float memory[kMaxDelaySliceSize * 2];
+  
+  pool.Init(memory, sizeof(memory) / sizeof(float));
+  string.Init(false);
+  bank_string.Init();
+  
+  float max_error = 0.0f;
+  int32_t num_resizes = 0;
+  size_t delay_line_size = 0;
+  for (size_t i = 0; i < ::kSampleRate / kSize * 8; ++i) {
+    const float t = static_cast<float>(i * kSize) / ::kSampleRate;
+    float in[kSize];
+    float out[2][kSize];
+    float aux[2][kSize];
+    fill(&in[0], &in[kSize], 0.0f);
+    for (int32_t j = 0; j < 2; ++j) {
+      fill(&out[j][0], &out[j][kSize], 0.0f);
+      fill(&aux[j][0], &aux[j][kSize], 0.0f);
+    }
+    in[0] = i % 300 == 0 ? 1.0f : 0.0f;
+    
+    // From 27.5 Hz to 880 Hz and back.
+    float f = 27.5f * SemitonesToRatio(30.0f - 30.0f * cosf(t * 1.5f));
+    f /= ::kSampleRate;
+    bank_string.Reserve(&pool, f);
+    if (bank_string.delay_line_size() != delay_line_size) {
+      delay_line_size = bank_string.delay_line_size();
+      ++num_resizes;
+    }
+    string.set_frequency(f, 0.1f);
+    bank_string.set_frequency(f, 0.1f);
+    string.set_brightness(0.5f);
+    bank_string.set_brightness(0.5f);
+    string.set_damping(0.9f);
+    bank_string.set_damping(0.9f);
+    string.set_position(0.3f);
+    bank_string.set_position(0.3f);
+    string.Process(in, out[0], aux[0], kSize);
+    bank_string.Process(in, out[1], aux[1], kSize);
+    for (size_t k = 0; k < kSize; ++k) {
+      max_error = max(max_error, fabsf(out[0][k] - out[1][k]));
+      max_error = max(max_error, fabsf(aux[0][k] - aux[1][k]));
+    }
+  }
+  printf("Max error: %.2e, %d delay line sizes\n", max_error, num_resizes);
+  
+  // Drone on a bank of strings.
+  static StringBank bank;
+  static float bank_memory[kNumBankStrings * 1024];
+  bank.Init(bank_memory, sizeof(bank_memory) / sizeof(float), kNumBankStrings);
+  
+  WavWriter wav_writer(2, ::kSampleRate, 20);
+  wav_writer.Open("rings_string_bank.wav");
+  
+  Part part;
+  part.Init(reverb_buffer);
+  part.set_polyphony(2);
+  part.set_model(RESONATOR_MODEL_SYMPATHETIC_STRING);
+  part.set_string_bank(&bank);
+  
+  Patch patch;
+  patch.structure = 0.4f;
+  patch.brightness = 0.6f;
+  patch.damping = 0.9f;
+  patch.position = 0.3f;
+  
+  size_t max_memory_usage = 0;
+  for (uint32_t i = 0; i < ::kSampleRate * 20; i += kAudioBlockSize) {
+    float in[kAudioBlockSize];
+    float out[kAudioBlockSize];
+    float aux[kAudioBlockSize];
+    fill(&in[0], &in[kAudioBlockSize], 0.0f);
+    
+    PerformanceState performance;
+    performance.strum = i % (::kSampleRate * 2) == 0;
+    performance.internal_exciter = true;
+    performance.note = (i / (::kSampleRate * 4)) % 2 ? 5.0f : 0.0f;
+    performance.tonic = 33.0f;
+    performance.fm = 0.0f;
+    performance.chord = 0;
+    
+    part.Process(performance, patch, in, out, aux, kAudioBlockSize);
+    wav_writer.Write(out, aux, kAudioBlockSize);
+    max_memory_usage = max(max_memory_usage, bank.memory_usage());
+  }
+  printf("%d strings, %lu bytes of delay memory\n",
+      kNumBankStrings, static_cast<unsigned long>(max_memory_usage));
+}
+
+void BenchmarkStringBank() {
+  const size_t kSize = kAudioBlockSize;
+  const size_t kNumBlocks = 4000;
+  const int32_t kNumStrings[] = { 8, 24, 48 };
+  
+  static String strings[kMaxBankStrings];
+  static StringBank bank;
+  static float bank_memory[kMaxBankStrings * 1024];
+  
+  // The per-string allocation touches the whole delay line of every string,
+  // whatever its pitch - the bank only the slices sized to the pitch. Each
+  // string is rendered in turn, so the working set is the total memory of the
+  // delay lines: once it exceeds the cache, every block starts with misses.
+  printf("strings   working set (kB)   ns/string/sample\n");
+  printf("          string    bank     string      bank\n");
+  for (size_t n = 0; n < sizeof(kNumStrings) / sizeof(int32_t); ++n) {
+    int32_t num_strings = kNumStrings[n];
+    float frequencies[kMaxBankStrings];
+    for (int32_t i = 0; i < num_strings; ++i) {
+      // Notes from A1 to A5.
+      float note = 33.0f + static_cast<float>((i * 7) % 48);
+      frequencies[i] = SemitonesToRatio(note - 69.0f) * a3;
+      strings[i].Init(false);
+    }
+    bank.Init(
+        bank_memory, sizeof(bank_memory) / sizeof(float), num_strings);
+    for (int32_t i = 0; i < num_strings; ++i) {
+      bank.Reserve(i, frequencies[i]);
+    }
+    
+    float ns_per_sample[2];
+    for (int32_t j = 0; j < 2; ++j) {
+      clock_t start = clock();
+      for (size_t i = 0; i < kNumBlocks; ++i) {
+        float in[kSize];
+        float out[kSize];
+        float aux[kSize];
+        fill(&in[0], &in[kSize], 0.0f);
+        fill(&out[0], &out[kSize], 0.0f);
+        fill(&aux[0], &aux[kSize], 0.0f);
+        in[0] = i % 200 == 0 ? 0.5f : 0.0f;
+        for (int32_t k = 0; k < num_strings; ++k) {
+          if (j == 0) {
+            strings[k].set_frequency(frequencies[k]);
+            strings[k].set_damping(0.9f);
+            strings[k].Process(in, out, aux, kSize);
+          } else {
+            BankString* s = bank.mutable_string(k);
+            s->set_frequency(frequencies[k]);
+            s->set_damping(0.9f);
+            s->Process(in, out, aux, kSize);
+          }
+        }
+      }
+      float elapsed = float(clock() - start) / CLOCKS_PER_SEC;
+      ns_per_sample[j] = elapsed * 1e9f / (kNumBlocks * kSize * num_strings);
+    }
+    printf("%7d %9.1f %7.1f %10.2f %9.2f\n",
+        num_strings,
+        num_strings * kDelayLineSize * sizeof(float) / 1024.0f,
+        bank.memory_usage() / 1024.0f,
+        ns_per_sample[0],
+        ns_per_sample[1]);
+  }
+}
+
+// Frequency of the strongest component of a signal within 150 cents of the
+// expected frequency, from the peak of its Hann-windowed spectrum: a 1 cent
+// grid, then a 0.01 cent grid.
+float MeasureFrequency(const float* x, size_t size, float expected_frequency) {
+  float best_frequency = expected_frequency;
+  float step = 1.0f;
+  for (int32_t pass = 0; pass < 2; ++pass) {
+    float center = best_frequency;
+    float best_magnitude = 0.0f;
+    for (int32_t i = -150; i <= 150; ++i) {
+      float f = center * SemitonesToRatio(i * step / 100.0f);
+      double re = 0.0;
+      double im = 0.0;
+      for (size_t j = 0; j < size; ++j) {
+        double w = 0.5 - 0.5 * cos(2.0 * M_PI * j / size);
+        double phi = 2.0 * M_PI * f * j;
+        re += w * x[j] * cos(phi);
+        im += w * x[j] * sin(phi);
+      }
+      float magnitude = static_cast<float>(re * re + im * im);
+      if (magnitude > best_magnitude) {
+        best_magnitude = magnitude;
+        best_frequency = f;
+      }
+    }
+    step = 0.01f;
+  }
+  return best_frequency;
+}
+
+// Error of the phase delay of a fractional delay read, in samples, and its
+// gain, at the normalized frequency "f" - worst case over all fractional
+// delays.
+void MeasureInterpolator(
+    StringInterpolation interpolation,
+    float f,
+    float* max_delay_error,
+    float* min_gain) {
+  float buffer[64];
+  rings::DelayLine<float, 64> line;
+  *max_delay_error = 0.0f;
+  *min_gain = 1.0f;
+  for (int32_t i = 0; i < 32; ++i) {
+    float delay = 8.0f + i / 32.0f;
+    
+    // H(f) * exp(2 pi j f delay), from the impulse response of the read.
+    float re = 0.0f;
+    float im = 0.0f;
+    line.Init(buffer);
+    for (int32_t n = 1; n < 16; ++n) {
+      line.Write(n == 1 ? 1.0f : 0.0f);
+      float h = interpolation == STRING_INTERPOLATION_LAGRANGE
+          ? line.ReadLagrange(delay)
+          : line.ReadHermite(delay);
+      float phi = 2.0f * M_PI * f * (delay - n);
+      re += h * cosf(phi);
+      im += h * sinf(phi);
+    }
+    float error = -atan2f(im, re) / (2.0f * M_PI * f);
+    *max_delay_error = max(*max_delay_error, fabsf(error));
+    *min_gain = min(*min_gain, sqrtf(re * re + im * im));
+  }
+}
+
+void BenchmarkStringInterpolation() {
+  const size_t kSize = kAudioBlockSize;
+  const size_t kAnalysisStart = 4800;
+  const size_t kAnalysisSize = 32768;
+  // Rendered in whole blocks.
+  const size_t kRenderSize =
+      (kAnalysisStart + kAnalysisSize + kSize - 1) / kSize * kSize;
+  const float kFrequencies[] = {
+    8.0f, 32.7f, 65.4f, 130.8f, 261.6f, 523.3f, 1046.5f, 2093.0f, 4186.0f
+  };
+  const StringInterpolation kInterpolations[] = {
+    STRING_INTERPOLATION_HERMITE,
+    STRING_INTERPOLATION_LAGRANGE
+  };
+  
+  static String string;
+  static float buffer[kRenderSize];
+  
+  // A phase delay error of e samples detunes the partials of frequency f by
+  // about -1200 * log2(1 + e * f / f0) cents.
+  printf("f/fs   delay error (samples)   gain (dB)\n");
+  printf("         hermite lagrange    hermite lagrange\n");
+  const float kAnalysisFrequencies[] = { 0.02f, 0.05f, 0.1f, 0.2f, 0.3f };
+  for (size_t i = 0; i < sizeof(kAnalysisFrequencies) / sizeof(float); ++i) {
+    float error[2];
+    float gain[2];
+    for (int32_t j = 0; j < 2; ++j) {
+      MeasureInterpolator(
+          kInterpolations[j], kAnalysisFrequencies[i], &error[j], &gain[j]);
+    }
+    printf("%4.2f %10.4f %8.4f %10.2f %8.2f\n",
+        kAnalysisFrequencies[i], error[0], error[1],
+        20.0f * log10f(gain[0]), 20.0f * log10f(gain[1]));
+  }
+  
+  // Tuning error of the fundamental - mostly caused by the damping filter,
+  // whatever the interpolator, up to about 2 kHz. Above, the phase delay
+  // error of the Hermite read makes the string flat (about -24 cents at
+  // 4186 Hz, -1 cent with Lagrange). Below 11.7 Hz, the string does not fit
+  // the delay line and is upsampled.
+  printf("f0 (Hz)   error (cents)   ns/sample\n");
+  printf("          hermite lagrange   hermite lagrange\n");
+  for (size_t i = 0; i < sizeof(kFrequencies) / sizeof(float); ++i) {
+    float f0 = kFrequencies[i] / ::kSampleRate;
+    float cents[2];
+    float ns_per_sample[2];
+    for (int32_t j = 0; j < 2; ++j) {
+      // Best of 3 runs.
+      ns_per_sample[j] = 1e9f;
+      for (int32_t run = 0; run < 3; ++run) {
+        string.Init(false);
+        string.set_interpolation(kInterpolations[j]);
+        string.set_frequency(f0);
+        string.set_brightness(0.3f);
+        string.set_damping(0.9f);
+        string.set_position(0.2f);
+        
+        fill(&buffer[0], &buffer[kRenderSize], 0.0f);
+        float in[kSize];
+        fill(&in[0], &in[kSize], 0.0f);
+        in[0] = 1.0f;
+        clock_t start = clock();
+        for (size_t k = 0; k < kRenderSize; k += kSize) {
+          float aux[kSize];
+          string.Process(in, &buffer[k], aux, kSize);
+          in[0] = 0.0f;
+        }
+        float elapsed = float(clock() - start) / CLOCKS_PER_SEC;
+        ns_per_sample[j] = min(
+            ns_per_sample[j],
+            elapsed * 1e9f / kRenderSize);
+      }
+      
+      float f = MeasureFrequency(&buffer[kAnalysisStart], kAnalysisSize, f0);
+      cents[j] = 1200.0f * logf(f / f0) / logf(2.0f);
+    }
+    printf("%7.1f %9.2f %8.2f %9.1f %8.1f\n",
+        kFrequencies[i], cents[0], cents[1],
+        ns_per_sample[0], ns_per_sample[1]);
+  }
+}
+
 int main(void) {
   _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
   TestNoteFilter();
@@ -569,4 +1155,11 @@ int main(void) {
   TestStringSynthOscillator();
   TestStringSynthVoice();
   TestStringSynthPart();
+  // TestResonatorSimd();
+  // BenchmarkResonator();
+  // BenchmarkPolyphony();
+  // TestVoiceWorkerPool();
+  // TestStringBank();
+  // BenchmarkStringBank();
+  // BenchmarkStringInterpolation();
 }
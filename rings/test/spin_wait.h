@@ -0,0 +1,78 @@
+// Copyright 2015 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Busy-waiting used by the voice worker pool. Waiting threads poll rather
+// than sleep, so that hand-offs do not involve any lock or system call, but
+// they yield the CPU from time to time so that they do not starve the thread
+// they are waiting for.
+
+#ifndef RINGS_TEST_SPIN_WAIT_H_
+#define RINGS_TEST_SPIN_WAIT_H_
+
+#include "stmlib/stmlib.h"
+
+#include <sched.h>
+
+namespace rings {
+
+// Number of polls before yielding the CPU.
+const int32_t kSpinCount = 4096;
+
+class Spinner {
+ public:
+  Spinner() : spin_(0) { }
+  ~Spinner() { }
+  
+  // Called after each unsuccessful poll.
+  inline void Pause() {
+    if (++spin_ >= kSpinCount) {
+      sched_yield();
+      spin_ = 0;
+    }
+  }
+  
+  inline void Reset() { spin_ = 0; }
+  
+ private:
+  int32_t spin_;
+  
+  DISALLOW_COPY_AND_ASSIGN(Spinner);
+};
+
+// Waits until a counter, which only increases (and wraps around), reaches
+// target. The writes made before the counter was incremented are visible
+// when it returns.
+inline void SpinWaitFor(volatile uint32_t* counter, uint32_t target) {
+  Spinner spinner;
+  while (static_cast<int32_t>(target - *counter) > 0) {
+    spinner.Pause();
+  }
+  __sync_synchronize();
+}
+
+}  // namespace rings
+
+#endif  // RINGS_TEST_SPIN_WAIT_H_
@@ -0,0 +1,129 @@
+// Copyright 2015 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Renders the voices of a rings::Part on several threads.
+
+#include "rings/test/voice_worker_pool.h"
+
+#include <algorithm>
+
+#include "rings/test/spin_wait.h"
+
+namespace rings {
+
+using namespace std;
+
+bool VoiceWorkerPool::Init(Part* part, size_t num_threads) {
+  part_ = part;
+  num_threads_ = max(min(num_threads, kMaxNumVoiceThreads), size_t(1));
+  polyphony_ = 0;
+  generation_ = 0;
+  num_finished_ = 0;
+  num_expected_ = 0;
+  running_ = true;
+  __sync_synchronize();
+  
+  // Thread 0 is the calling thread.
+  for (size_t i = 1; i < num_threads_; ++i) {
+    workers_[i].pool = this;
+    workers_[i].index = i;
+    if (pthread_create(
+            &workers_[i].thread,
+            NULL,
+            &WorkerEntryPoint,
+            &workers_[i])) {
+      num_threads_ = i;
+      Stop();
+      return false;
+    }
+  }
+  return true;
+}
+
+void VoiceWorkerPool::Stop() {
+  running_ = false;
+  __sync_synchronize();
+  __sync_fetch_and_add(&generation_, 1);
+  for (size_t i = 1; i < num_threads_; ++i) {
+    pthread_join(workers_[i].thread, NULL);
+  }
+  num_threads_ = 1;
+}
+
+void VoiceWorkerPool::Process(
+    const PerformanceState& performance_state,
+    const Patch& patch,
+    const float* in,
+    float* out,
+    float* aux,
+    size_t size) {
+  if (part_->bypass() || num_threads_ == 1) {
+    part_->Process(performance_state, patch, in, out, aux, size);
+    return;
+  }
+  
+  part_->BeginBlock(performance_state, patch, in, size);
+  
+  // Workers have all finished the previous block: the polyphony can be
+  // overwritten.
+  polyphony_ = part_->polyphony();
+  num_expected_ += num_threads_ - 1;
+  __sync_synchronize();
+  __sync_fetch_and_add(&generation_, 1);
+  
+  RenderVoices(0);
+  SpinWaitFor(&num_finished_, num_expected_);
+  
+  part_->EndBlock(out, aux);
+}
+
+void VoiceWorkerPool::RenderVoices(size_t index) {
+  for (int32_t i = index; i < polyphony_; i += num_threads_) {
+    part_->RenderVoice(i);
+  }
+}
+
+/* static */
+void* VoiceWorkerPool::WorkerEntryPoint(void* worker) {
+  Worker* w = static_cast<Worker*>(worker);
+  w->pool->Work(w->index);
+  return NULL;
+}
+
+void VoiceWorkerPool::Work(size_t index) {
+  uint32_t generation = 0;
+  while (true) {
+    SpinWaitFor(&generation_, generation + 1);
+    generation = generation_;
+    if (!running_) {
+      break;
+    }
+    RenderVoices(index);
+    __sync_fetch_and_add(&num_finished_, 1);
+  }
+}
+
+}  // namespace rings
@@ -0,0 +1,109 @@
+// Copyright 2015 Olivier Gillet.
+//
+// Author: Olivier Gillet (ol.gillet@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+// See http://creativecommons.org/licenses/MIT/ for more information.
+//
+// -----------------------------------------------------------------------------
+//
+// Renders the voices of a rings::Part on several threads.
+//
+// For each block, the calling thread runs Part::BeginBlock(), publishes the
+// block to the workers, renders its own share of the voices, and waits until
+// the workers have rendered theirs. It then mixes the voices and applies the
+// reverb and limiter with Part::EndBlock(). Voice i is always rendered by
+// thread i % num_threads (the calling thread being thread 0), and the voices
+// are mixed in a fixed order. Idle workers poll for the next block rather
+// than sleep, so that the hand-off does not involve any lock or system call.
+//
+// Settings (model, polyphony...) can be changed between calls to Process().
+//
+// Each voice draws its noise (noise bursts of the internal exciter, dispersion
+// of the strings) from its own generator, so the output is bit-identical to
+// Part::Process(), whatever the number of threads.
+
+#ifndef RINGS_TEST_VOICE_WORKER_POOL_H_
+#define RINGS_TEST_VOICE_WORKER_POOL_H_
+
+#include "stmlib/stmlib.h"
+
+#include <pthread.h>
+
+#include "rings/dsp/part.h"
+
+namespace rings {
+
+const size_t kMaxNumVoiceThreads = 16;
+
+class VoiceWorkerPool {
+ public:
+  VoiceWorkerPool() { }
+  ~VoiceWorkerPool() { }
+  
+  // The part must be initialized. num_threads includes the calling thread.
+  // Returns false if the worker threads could not be started.
+  bool Init(Part* part, size_t num_threads);
+  void Stop();
+  
+  // Same as Part::Process().
+  void Process(
+      const PerformanceState& performance_state,
+      const Patch& patch,
+      const float* in,
+      float* out,
+      float* aux,
+      size_t size);
+  
+  inline size_t num_threads() const { return num_threads_; }
+  
+ private:
+  struct Worker {
+    VoiceWorkerPool* pool;
+    size_t index;
+    pthread_t thread;
+  };
+  
+  static void* WorkerEntryPoint(void* worker);
+  void Work(size_t index);
+  void RenderVoices(size_t index);
+  
+  Part* part_;
+  
+  Worker workers_[kMaxNumVoiceThreads];
+  size_t num_threads_;
+  
+  // Polyphony of the block published to the workers.
+  int32_t polyphony_;
+  
+  // All counters only increase (and wrap around): the number of blocks
+  // published, and the number of blocks finished by the workers - all of
+  // them, including those with no voice to render.
+  volatile uint32_t generation_;
+  volatile uint32_t num_finished_;
+  uint32_t num_expected_;
+  volatile bool running_;
+  
+  DISALLOW_COPY_AND_ASSIGN(VoiceWorkerPool);
+};
+
+}  // namespace rings
+
+#endif  // RINGS_TEST_VOICE_WORKER_POOL_H_